@@ -18,12 +18,13 @@ char *abbreviation(double heading);
 
 int main(int argc, char **argv)
 {
-    int             rc, w, h;
+    int             rc;
     sdlx_event_t    event;
     sdlx_texture_t *compass = NULL;
-    unsigned char  *pixels = NULL;
     double          heading = 0;
     bool            quit = false;
+    bool            fusion;
+    sdlx_orientation_t orientation;
 
     // save args
     if (argc != 2) {
@@ -41,20 +42,16 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // read the compass image pixels from file, and
-    // create compass image texture
-    rc = util_read_png_file(data_dir, "compass.png", &pixels, &w, &h);
-    if (rc != 0) {
-        printf("ERROR %s failed to decode png file %s\n", progname, "compass.png");
-        goto cleanup_and_return;
-    }
-    compass = sdlx_create_texture_from_pixels(pixels, w, h);
+    // create compass image texture from the png file
+    compass = sdlx_create_texture_from_png_file(data_dir, "compass.png");
     if (compass == NULL) {
         printf("ERROR %s failed to create compass texture\n", progname);
         goto cleanup_and_return;
     }
-    free(pixels);
-    pixels = NULL;
+
+    // the heading is from the sensor fusion if it is available, and otherwise
+    // from the magnetometer reading, which is smoothed here
+    fusion = (sdlx_sensor_fusion_start() == 0);
 
     // runtime loop
     while (!quit) {
@@ -62,8 +59,19 @@ int main(int argc, char **argv)
         sdlx_display_init(COLOR_BLACK);
         sdlx_print_init(DEFAULT_FONT, COLOR_WHITE, COLOR_BLACK);
 
-        // read the magnetic heading sensor
-        sdlx_sensor_read_mag_heading(&heading);
+        // get the magnetic heading
+        if (fusion) {
+            if (sdlx_sensor_get_orientation(&orientation) == 0) {
+                heading = orientation.heading;
+            } else {
+                heading = INVALID_NUMBER;
+            }
+        } else {
+            sdlx_sensor_read_mag_heading(&heading);
+            if (heading != INVALID_NUMBER) {
+                heading = smooth(heading);
+            }
+        }
 
         // if magnetic heading is valid then
         //   display heading info
@@ -71,9 +79,6 @@ int main(int argc, char **argv)
         //   display "NO DATA"
         // endif
         if (heading != INVALID_NUMBER) {
-            // remove jitter from the heading value
-            heading = smooth(heading);
-
             // display white background in the area where the compass 
             // will be displayed
             sdlx_render_fill_rect(0, 100, 1000, 1000, COLOR_WHITE);
@@ -120,8 +125,8 @@ int main(int argc, char **argv)
 
 cleanup_and_return:
     // cleanup
-    if (pixels) {
-        free(pixels);
+    if (fusion) {
+        sdlx_sensor_fusion_stop();
     }
     if (compass) {
         sdlx_destroy_texture(compass);
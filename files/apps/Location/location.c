@@ -28,12 +28,18 @@
 char *progname;
 char *data_dir;
 int   y_history_top_reset;
+
+loc_hist_rec_t loc_hist_recs[MAX_LOC_HIST];
+char           loc_hist_strs[MAX_LOC_HIST][100];
+char          *loc_hist_lines[MAX_LOC_HIST];
+int            loc_hist_count;
     
 //
 // prototypes
 //
 
 void settings(void);
+void update_loc_hist_lines(util_ts_t *loc_hist);
 
 // -----------------  MAIN  ------------------------------------------
     
@@ -42,7 +48,7 @@ int main(int argc, char **argv)
     int          rc, y;
     sdlx_event_t event;
     bool         done = false;
-    loc_hist_t  *loc_hist;
+    util_ts_t   *loc_hist;
 
     double       y_history_top;
     int          y_history_display_begin;
@@ -53,7 +59,6 @@ int main(int argc, char **argv)
 
     char         loc_curr[MAX_SVC_REQ_DATA] = "Not Initialized";
     char        *loc_curr_lines[1] = {loc_curr};
-    char        *loc_hist_lines[MAX_LOC_HIST];
 
     bool         settings_changed = false;
 
@@ -73,13 +78,13 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // map location history file
-    // - create_if_needed = false
+    // open the location history store, read_only; it sees the
+    // entries appended by the Location svc
+    // - segment_records = 0, for the default
     // - read_only = true 
-    // - created (return flag) = NULL
-    loc_hist = util_map_file("svcs/Location", LOC_HIST_FILENAME, sizeof(loc_hist_t), false, true, NULL);
+    loc_hist = util_ts_open("svcs/Location", LOC_HIST_NAME, sizeof(loc_hist_rec_t), 0, true);
     if (loc_hist == NULL) {
-        printf("ERROR: %s failed to map %s\n", progname, LOC_HIST_FILENAME);
+        printf("ERROR: %s failed to open %s\n", progname, LOC_HIST_NAME);
         return 1; 
     }
 
@@ -130,12 +135,9 @@ int main(int argc, char **argv)
             y_history_display_end   = sdlx_win_height-2*sdlx_char_height;  // need a define or routine for this ?
         }
         // - display the history, starting at most recent
-        int count = loc_hist->count;
-        for (int i = 0; i < count; i++) {
-            loc_hist_lines[i] = loc_hist->loc[count-1-i].data_str;
-        }
+        update_loc_hist_lines(loc_hist);
         sdlx_render_multiline_text(y_history_top, y_history_display_begin, y_history_display_end, 
-                                   loc_hist_lines, loc_hist->count);
+                                   loc_hist_lines, loc_hist_count);
 
         // register for events
         sdlx_register_event(NULL, EVID_MOTION);
@@ -172,11 +174,56 @@ int main(int argc, char **argv)
     }
 
     // cleanup and end program
+    util_ts_close(loc_hist);
     sdlx_quit(SUBSYS_VIDEO);
     printf("INFO %s: terminating\n", progname);
     return 0;
 }
 
+// -----------------  LOCATION HISTORY  --------------------------------
+
+// reads the most recent MAX_LOC_HIST entries when the history has changed,
+// and formats them to loc_hist_lines, most recent first
+void update_loc_hist_lines(util_ts_t *loc_hist)
+{
+    static long    last_count = -1;
+    static long    last_timestamp = -1;
+    loc_hist_rec_t latest;
+    long           count, timestamp;
+    struct tm     *tm;
+    char           time_str[50];
+    int            i;
+
+    // check for a change in the number of entries, or the most recent entry
+    count = util_ts_count(loc_hist);
+    timestamp = (util_ts_latest(loc_hist, &latest, 1) == 1 ? latest.timestamp : -1);
+    if (count == last_count && timestamp == last_timestamp) {
+        return;
+    }
+    last_count = count;
+    last_timestamp = timestamp;
+
+    // read the most recent entries, and format them, for example
+    //   Bolton
+    //   Dec 5 23:00:00 EST
+    //   -42.1234 -130.1234
+    loc_hist_count = util_ts_latest(loc_hist, loc_hist_recs, MAX_LOC_HIST);
+    for (i = 0; i < loc_hist_count; i++) {
+        loc_hist_rec_t *rec = &loc_hist_recs[loc_hist_count-1-i];
+        time_t t = rec->timestamp;
+        char *str = loc_hist_strs[i];
+
+        tm = localtime(&t);
+        strftime(time_str, sizeof(time_str), "%b %d %H:%M:%S %Z", tm);
+        if (rec->latitude != INVALID_NUMBER && rec->longitude != INVALID_NUMBER) {
+            sprintf(str, "%s\n%s\n%0.4f %0.4f\n\n", rec->name, time_str, rec->latitude, rec->longitude);
+        } else {
+            sprintf(str, "%s\n%s\nLocation Unavailable\n\n", rec->name, time_str);
+        }
+        loc_hist_lines[i] = str;
+    }
+}
+
 // -----------------  SETTINGS  ----------------------------------------
 
 #define EVID_DEL_COUNTRY      20  // through 24
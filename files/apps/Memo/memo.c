@@ -198,7 +198,7 @@ int main(int argc, char **argv)
             char new_filename[100];
 
             localtime_r(&t, &tm);
-            sprintf(new_filename, "%04d%02d%02d%02d%02d%02d.raw",
+            sprintf(new_filename, "%04d%02d%02d%02d%02d%02d.mp3",
                     tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
             //printf("INFO %s: EVID_NEW recording to '%s'\n", progname, new_filename);
             sdlx_audio_record(data_dir, new_filename, 30, 2, false);
@@ -233,7 +233,7 @@ void get_list_of_files(void)
 {
     FILE *fp;
     int   i;
-    char  cmd[100], s[100];
+    char  cmd[300], s[100];
     long  mtime;
 
     static long mtime_last;
@@ -252,8 +252,8 @@ void get_list_of_files(void)
     cleanup_filename_allocations();
 
     // run 'ls -lr' to get reverse sorted list of filenames,
-    // starting with the most recent
-    sprintf(cmd, "cd %s; /bin/ls -1r *.raw", data_dir);
+    // starting with the most recent; older recordings are raw
+    sprintf(cmd, "cd %s; /bin/ls -1r *.mp3 *.raw 2>/dev/null", data_dir);
     fp = popen(cmd, "r");
     while (fgets(s, sizeof(s), fp)) {
         remove_trailing_newline(s);
@@ -262,7 +262,7 @@ void get_list_of_files(void)
     pclose(fp);
 
     // create friendly filenames, for example:
-    // - filename:    20251219071933.raw
+    // - filename:    20251219071933.mp3
     // - friendlyname: Dec19-07:19
     for (i = 0; i < max_filename; i++) {
         char month[8], day[8], hour[8], minute[8], month_abbrev[16];
@@ -435,14 +435,20 @@ void bounce_ball_off_paddle(int which_paddle)
 void play_tone(int freq, int duration_ms)
 {
     static sdlx_tone_t t[2];
+    sdlx_sound_t *snd;
 
     if (!param_sound) {
         return;
     }
 
+    // play on a mixer voice, so that overlapping tones don't cut each other off
     t[0].freq = freq;
     t[0].intvl_ms = duration_ms;
-    sdlx_audio_play_tones(t);
+    snd = sdlx_sound_create_tones(t);
+    if (snd) {
+        sdlx_voice_play(snd, 1, 0, false);
+        sdlx_sound_free(snd);
+    }
 }
 
 double linear_interp(double v, double x1, double x2, double y1, double y2)
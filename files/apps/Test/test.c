@@ -641,10 +641,21 @@ static void add_gap(sdlx_tone_t **t, int intvl_ms);
 static void add_terminator(sdlx_tone_t **t);
 static char *audio_state_str(int x);
 static void generate_morse_code_tones(sdlx_tone_t **t, char *letters, int wpm);
+
+#define SPECTRUM_FFT_SIZE 4096
+#define SPECTRUM_MAX_HZ   4000
+
+static sdlx_spectrogram_t *spectrogram;
+static long                spectrogram_seq;
+static double              spectrum_db[SPECTRUM_FFT_SIZE/2+1];
        
 static void page_7_init(void)
 {
     sdlx_audio_print_devices_info();
+
+    // 4096 point fft, with a new column every 800 samples (60 per sec)
+    spectrogram = sdlx_spectrogram_create(SPECTRUM_FFT_SIZE, 800, 1);
+    spectrogram_seq = 0;
 }
 
 static void page_7_draw(void)
@@ -731,6 +742,31 @@ static void page_7_draw(void)
             y += sdlx_char_height;
         }
 
+        // when recording: the spectrum up to 4 khz, and its peak frequency,
+        // are displayed above the state section
+        if (spectrogram != NULL &&
+            (state.state == AUDIO_STATE_RECORD || state.state == AUDIO_STATE_RECORD_APPEND))
+        {
+            double bin_hz = sdlx_spectrogram_bin_hz(spectrogram);
+            int    num_bins = SPECTRUM_MAX_HZ / bin_hz;
+            int    base = sdlx_win_height - 660;
+            double peak_db, peak_hz;
+            int    k, x, h;
+
+            sdlx_spectrogram_read(spectrogram, &spectrogram_seq, spectrum_db, 1);
+            for (k = 1; k < num_bins; k++) {
+                // bar height is -80 dB to 0 dB
+                h = (spectrum_db[k] + 80) * 3;
+                if (h <= 0) continue;
+                x = sdlx_win_width * k / num_bins;
+                sdlx_render_line(x, base, x, base - (h < 240 ? h : 240), COLOR_GREEN);
+            }
+
+            peak_hz = sdlx_spectrogram_peak_hz(spectrogram, 50, SPECTRUM_MAX_HZ, &peak_db);
+            if (peak_db > -60) {
+                sdlx_render_printf(0, base - 240 - sdlx_char_height, "%.1f Hz", peak_hz);
+            }
+        }
     }
 
     //
@@ -832,6 +868,9 @@ static void page_7_process_event(sdlx_event_t *ev)
 static void page_7_exit(void)
 {
     sdlx_audio_ctl(AUDIO_REQ_STOP);
+
+    sdlx_spectrogram_destroy(spectrogram);
+    spectrogram = NULL;
 }
 
 static char *audio_state_str(int x)
@@ -36,6 +36,8 @@ int main(int argc, char **argv)
     int          rc;
     double       ax_raw, ay_raw, az_raw;
     double       ax=INVALID_NUMBER, ay=INVALID_NUMBER, az=INVALID_NUMBER;
+    bool         fusion;
+    sdlx_orientation_t orientation;
 
     // save args
     if (argc != 2) {
@@ -63,20 +65,35 @@ int main(int argc, char **argv)
     // use default font size and color
     sdlx_print_init(DEFAULT_FONT, COLOR_WHITE, COLOR_BLACK);
 
+    // the up direction is from the sensor fusion if it is available, and
+    // otherwise from the accelerometer reading, which is smoothed here
+    fusion = (sdlx_sensor_fusion_start() == 0);
+
     // runtime loop
     while (!end_program) {
-        // read accelerometer values
-        rc = sdlx_sensor_read_accelerometer(&ax_raw, &ay_raw, &az_raw);
-        if (rc != 0) {
-            no_accelerometer();
-            continue;
+        if (fusion) {
+            // get the up direction from the orientation
+            if (sdlx_sensor_get_orientation(&orientation) != 0) {
+                no_accelerometer();
+                continue;
+            }
+            ax = orientation.up[0];
+            ay = orientation.up[1];
+            az = orientation.up[2];
+        } else {
+            // read accelerometer values
+            rc = sdlx_sensor_read_accelerometer(&ax_raw, &ay_raw, &az_raw);
+            if (rc != 0) {
+                no_accelerometer();
+                continue;
+            }
+
+            // smooth accelerometer values
+            smooth(ax_raw, &ax);
+            smooth(ay_raw, &ay);
+            smooth(az_raw, &az);
         }
 
-        // smooth accelerometer values
-        smooth(ax_raw, &ax);
-        smooth(ay_raw, &ay);
-        smooth(az_raw, &az);
-
         // determine orientation
         // xxx todo
 
@@ -84,6 +101,11 @@ int main(int argc, char **argv)
         horizontal(ax, ay, az);
     }
 
+    // stop the sensor fusion
+    if (fusion) {
+        sdlx_sensor_fusion_stop();
+    }
+
     // free allocations
     sdlx_destroy_texture(green_circle);
     sdlx_destroy_texture(blue_circle);
@@ -450,6 +450,11 @@ void parse_forecast(int which)
     char *json_filename;
     forecast_t *forecast;
     long start_us;
+    json_value_t  periods;
+    json_cursor_t cursor;
+    util_json_query_t *q_periods, *q_is_daytime, *q_start_time, *q_icon;
+    util_json_query_t *q_short_forecast, *q_detailed_forecast, *q_temperature;
+    util_json_query_t *q_temperature_unit, *q_wind_speed, *q_wind_direction, *q_precip;
 
     // init json_filename, and forecast variables based on 'which' arg
     if (which == PARSE_DAILY_FORECAST) {
@@ -480,83 +485,95 @@ void parse_forecast(int which)
         return;
     }
 
+    // compile the json queries
+    q_periods           = util_json_query_compile("properties.periods");
+    q_is_daytime        = util_json_query_compile("isDaytime");
+    q_start_time        = util_json_query_compile("startTime");
+    q_icon              = util_json_query_compile("icon");
+    q_short_forecast    = util_json_query_compile("shortForecast");
+    q_detailed_forecast = util_json_query_compile("detailedForecast");
+    q_temperature       = util_json_query_compile("temperature");
+    q_temperature_unit  = util_json_query_compile("temperatureUnit");
+    q_wind_speed        = util_json_query_compile("windSpeed");
+    q_wind_direction    = util_json_query_compile("windDirection");
+    q_precip            = util_json_query_compile("probabilityOfPrecipitation.value");
+
     // loop over the periods of the json file
+    util_json_query(json, q_periods, &periods);
+    util_json_cursor_init(&cursor, periods.u.array);
     for (int i = 0; i < MAX_FORECAST; i++) {
         forecast_t   *x = &forecast[i];
-        json_value_t *value;
+        json_value_t  value;
         void         *period;
         char          tmp_str[1000];
-        char          period_str[200];
 
         // get json period object
-        sprintf(period_str, "%d", i);
-        value = util_json_get_value(json, "properties", "periods", &period_str, NULL);  // xxx picoc requires &period_str ?
-        if (value->type != JSON_TYPE_OBJECT) {
+        if (util_json_cursor_next(&cursor, &value) != 0 || value.type != JSON_TYPE_OBJECT) {
             break;
         }
-        period = value->u.object;
+        period = value.u.object;
 
         // get is_daytime
-        value = util_json_get_value(period, "isDaytime", NULL);
-        if (value->type != JSON_TYPE_FLAG) {
-            printf("ERROR %s: failed to get isDaytime, %d\n", progname, value->type);
+        util_json_query(period, q_is_daytime, &value);
+        if (value.type != JSON_TYPE_FLAG) {
+            printf("ERROR %s: failed to get isDaytime, %d\n", progname, value.type);
             continue;
         }
-        x->is_daytime = value->u.flag;
+        x->is_daytime = value.u.flag;
 
         // get day_name based on startTime of this period; and
         // also based o the is_daytime flag
-        value = util_json_get_value(period, "startTime", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get startTime, %d\n", progname, value->type);
+        util_json_query(period, q_start_time, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get startTime, %d\n", progname, value.type);
             continue;
         }
         if (which == PARSE_DAILY_FORECAST) {
             if (x->is_daytime) {
-                sprintf(tmp_str, "%s", get_day_name(value->u.string, false));
+                sprintf(tmp_str, "%s", get_day_name(value.u.string, false));
             } else {
-                sprintf(tmp_str, "%s Night", get_day_name(value->u.string, false));
+                sprintf(tmp_str, "%s Night", get_day_name(value.u.string, false));
             }
         } else {
             int hour;
-            sscanf(value->u.string+10, "T%d", &hour);
+            sscanf(value.u.string+10, "T%d", &hour);
             char *ampm = hour < 12 ? "AM" : "PM";
             if (hour > 12) hour -= 12;
             if (hour == 0) hour = 12;
-            sprintf(tmp_str, "%s %d%s", get_day_name(value->u.string, false), hour, ampm);
+            sprintf(tmp_str, "%s %d%s", get_day_name(value.u.string, false), hour, ampm);
         }
         x->day_name = strdup(tmp_str);
 
         // get day_name_unabbreviated based on startTime of this period; and
         // also based o the is_daytime flag
-        value = util_json_get_value(period, "startTime", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get startTime, %d\n", progname, value->type);
+        util_json_query(period, q_start_time, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get startTime, %d\n", progname, value.type);
             continue;
         }
         if (which == PARSE_DAILY_FORECAST) {
             if (x->is_daytime) {
-                sprintf(tmp_str, "%s", get_day_name(value->u.string, true));
+                sprintf(tmp_str, "%s", get_day_name(value.u.string, true));
             } else {
-                sprintf(tmp_str, "%s Night", get_day_name(value->u.string, true));
+                sprintf(tmp_str, "%s Night", get_day_name(value.u.string, true));
             }
         } else {
             int hour;
-            sscanf(value->u.string+10, "T%d", &hour);
+            sscanf(value.u.string+10, "T%d", &hour);
             char *ampm = hour < 12 ? "AM" : "PM";
             if (hour > 12) hour -= 12;
             if (hour == 0) hour = 12;
-            sprintf(tmp_str, "%s %d%s", get_day_name(value->u.string, true), hour, ampm);
+            sprintf(tmp_str, "%s %d%s", get_day_name(value.u.string, true), hour, ampm);
         }
         x->day_name_unabbreviated = strdup(tmp_str);
 
         // get icon_url
-        value = util_json_get_value(period, "icon", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get icon, %d\n", progname, value->type);
+        util_json_query(period, q_icon, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get icon, %d\n", progname, value.type);
             continue;
         }
-        x->icon_url = strdup(value->u.string);
+        x->icon_url = strdup(value.u.string);
 
         // create icon filename from icon url
         // url example: https://api.weather.gov/icons/land/day/few?size=medium
@@ -576,58 +593,58 @@ void parse_forecast(int which)
         }
 
         // get shortForecast
-        value = util_json_get_value(period, "shortForecast", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get shortForecast, %d\n", progname, value->type);
+        util_json_query(period, q_short_forecast, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get shortForecast, %d\n", progname, value.type);
             continue;
         }
-        x->short_forecast = strdup(value->u.string);
+        x->short_forecast = strdup(value.u.string);
 
         // get detailedForecast
-        value = util_json_get_value(period, "detailedForecast", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get detailedForecast, %d\n", progname, value->type);
+        util_json_query(period, q_detailed_forecast, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get detailedForecast, %d\n", progname, value.type);
             continue;
         }
-        if (strlen(value->u.string) > 0) {
-            sprintf(tmp_str, "%s. %s", x->day_name_unabbreviated, value->u.string);
+        if (strlen(value.u.string) > 0) {
+            sprintf(tmp_str, "%s. %s", x->day_name_unabbreviated, value.u.string);
             x->detailed_forecast = strdup(tmp_str);
         } else {
             x->detailed_forecast = strdup("");
         }
 
         // get temperature, and append temperatureUnit
-        value = util_json_get_value(period, "temperature", NULL);
-        if (value->type != JSON_TYPE_NUMBER) {
-            printf("ERROR %s: failed to get temperature, %d\n", progname, value->type);
+        util_json_query(period, q_temperature, &value);
+        if (value.type != JSON_TYPE_NUMBER) {
+            printf("ERROR %s: failed to get temperature, %d\n", progname, value.type);
             continue;
         }
-        double temperature = value->u.number;
-        value = util_json_get_value(period, "temperatureUnit", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get temperatureUnit, %d\n", progname, value->type);
+        double temperature = value.u.number;
+        util_json_query(period, q_temperature_unit, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get temperatureUnit, %d\n", progname, value.type);
             continue;
         }
-        sprintf(tmp_str, "%.0f%s", temperature, value->u.string);
+        sprintf(tmp_str, "%.0f%s", temperature, value.u.string);
         x->temperature = strdup(tmp_str);
 
         // get wind speed and direction
         int cnt, low, high;
         char wind_speed[40], wind_dir[40];
 
-        value = util_json_get_value(period, "windSpeed", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get windSpeed, %d\n", progname, value->type);
+        util_json_query(period, q_wind_speed, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get windSpeed, %d\n", progname, value.type);
             continue;
         }
-        strcpy(wind_speed, value->u.string);
+        strcpy(wind_speed, value.u.string);
 
-        value = util_json_get_value(period, "windDirection", NULL);
-        if (value->type != JSON_TYPE_STRING) {
-            printf("ERROR %s: failed to get windDirection, %d\n", progname, value->type);
+        util_json_query(period, q_wind_direction, &value);
+        if (value.type != JSON_TYPE_STRING) {
+            printf("ERROR %s: failed to get windDirection, %d\n", progname, value.type);
             continue;
         }
-        strcpy(wind_dir, value->u.string);
+        strcpy(wind_dir, value.u.string);
 
         cnt = sscanf(wind_speed, "%d to %d mph", &low, &high);
         if (cnt == 1) {
@@ -641,12 +658,12 @@ void parse_forecast(int which)
         x->wind = strdup(tmp_str);
 
         // get precip probability
-        value = util_json_get_value(period, "probabilityOfPrecipitation", "value", NULL);
-        if (value->type != JSON_TYPE_NUMBER) {
-            printf("ERROR %s: failed to get probabilityOfPrecipitation, %d\n", progname, value->type);
+        util_json_query(period, q_precip, &value);
+        if (value.type != JSON_TYPE_NUMBER) {
+            printf("ERROR %s: failed to get probabilityOfPrecipitation, %d\n", progname, value.type);
             continue;
         }
-        sprintf(tmp_str, "%.0f%%", value->u.number);
+        sprintf(tmp_str, "%.0f%%", value.u.number);
         x->precip = strdup(tmp_str);
 
         // set forecast item valid
@@ -654,7 +671,7 @@ void parse_forecast(int which)
 
         // debug print forecast info
         if (1) {
-            printf("INFO %s: %s periods[%s] ...\n", progname, json_filename, period_str);
+            printf("INFO %s: %s periods[%d] ...\n", progname, json_filename, cursor.index);
             printf("INFO %s:   is_daytime        %d\n", progname, x->is_daytime);
             printf("INFO %s:   day_name          %s\n", progname, x->day_name);
             printf("INFO %s:   day_name_unabbrev %s\n", progname, x->day_name_unabbreviated);
@@ -688,8 +705,6 @@ void parse_forecast(int which)
     // create icon_texture for each forecast element
     for (int i = 0; i < MAX_FORECAST; i++) {
         forecast_t        *x = &forecast[i];
-        unsigned char  *pixels = NULL;
-        int             rc, w, h;
         sdlx_texture_t *icon_texture;
 
         if (!x->valid) {
@@ -697,22 +712,27 @@ void parse_forecast(int which)
         }
 
         if (util_file_exists(icon_dir, x->icon_filename)) {
-            rc = util_read_png_file(icon_dir, x->icon_filename, &pixels, &w, &h);
-            if (rc != 0) {
-                printf("ERROR %s failed to decode png file %s\n", progname, x->icon_filename);
+            icon_texture = sdlx_create_texture_from_png_file(icon_dir, x->icon_filename);
+            if (icon_texture == NULL) {
+                printf("ERROR %s failed to create icon_texture\n", progname);
             } else {
-                icon_texture = sdlx_create_texture_from_pixels(pixels, w, h);
-                if (icon_texture == NULL) {
-                    printf("ERROR %s failed to create icon_texture\n", progname);
-                } else {
-                    x->icon_texture = icon_texture;
-                }
-                free(pixels);
+                x->icon_texture = icon_texture;
             }
         }
     }
 
     // cleanup and return
+    util_json_query_free(q_periods);
+    util_json_query_free(q_is_daytime);
+    util_json_query_free(q_start_time);
+    util_json_query_free(q_icon);
+    util_json_query_free(q_short_forecast);
+    util_json_query_free(q_detailed_forecast);
+    util_json_query_free(q_temperature);
+    util_json_query_free(q_temperature_unit);
+    util_json_query_free(q_wind_speed);
+    util_json_query_free(q_wind_direction);
+    util_json_query_free(q_precip);
     printf("INFO %s: parse_forecast %s completed, %0.3f secs\n", 
            progname, json_filename, 
            (util_microsec_timer() - start_us) / 1000000.0);
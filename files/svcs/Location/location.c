@@ -17,13 +17,34 @@
 // defines
 #define INTERVAL 60  // xxx was 3600
 
+// location history retention, in seconds: entries are kept for a year, and
+// after 30 days are downsampled to one per hour
+#define LOC_HIST_MAX_AGE              (365 * 86400L)
+#define LOC_HIST_DOWNSAMPLE_AGE       (30 * 86400L)
+#define LOC_HIST_DOWNSAMPLE_INTERVAL  3600L
+
+// the legacy loc_hist file, that preceded the loc_hist store; its entries
+// are strings formatted by create_loc_data_str, see import_legacy_loc_hist
+#define LEGACY_LOC_HIST_FILENAME      "loc_hist"
+#define MAX_LEGACY_LOC_HIST           1000
+
+// typedefs
+typedef struct {
+    int count;
+    int pad;
+    struct {
+        char data_str[100];
+    } loc[MAX_LEGACY_LOC_HIST];
+} legacy_loc_hist_t;
+
 // variables
-loc_hist_t *loc_hist;
+util_ts_t  *loc_hist;
 bool        param_enabled = false;
 bool        end_program = false;
 bool        test_loc_hist = false;
 
 // prototypes
+void import_legacy_loc_hist(void);
 void add_entry_to_loc_hist(time_t t, double latitude, double longitude, char *name);
 char *most_recent_loc_hist_name(void);
 void create_loc_data_str(time_t t, double latitude, double longitude, double elevation,
@@ -42,7 +63,6 @@ int main(int argc, char **argv)
     long          abstime;
     svc_req_t    *req;
     int           rc;
-    int           created;
 
     // save args
     if (argc != 2) {
@@ -60,19 +80,26 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // map the loc_hist file
-    // - create_if_needed = true
+    // open the loc_hist time series store, as its writer
+    // - segment_records = 0, for the default
     // - read_only = false
-    // - created (return flag) = NULL
-    loc_hist = util_map_file(data_dir, LOC_HIST_FILENAME, sizeof(loc_hist_t), true, false, &created);
+    loc_hist = util_ts_open(data_dir, LOC_HIST_NAME, sizeof(loc_hist_rec_t), 0, false);
     if (loc_hist == NULL) {
-        printf("ERROR: %s failed to map %s\n", progname, LOC_HIST_FILENAME);
+        printf("ERROR: %s failed to open %s\n", progname, LOC_HIST_NAME);
         return 1;
     }
+    util_ts_set_policy(loc_hist, LOC_HIST_MAX_AGE, 0, 
+                       LOC_HIST_DOWNSAMPLE_AGE, LOC_HIST_DOWNSAMPLE_INTERVAL);
+
+    // when the loc_hist store is empty, import the entries of the
+    // legacy loc_hist file, if it exists
+    if (util_ts_count(loc_hist) == 0) {
+        import_legacy_loc_hist();
+    }
 
-    // when test_mode is enabled and the loc_hist file was just created,
-    // add simulated entries to the loc_hist file
-    if (test_loc_hist && created) {
+    // when test_mode is enabled and the loc_hist store is empty,
+    // add simulated entries to the loc_hist store
+    if (test_loc_hist && util_ts_count(loc_hist) == 0) {
         add_simulated_entries_to_loc_hist();
     }
 
@@ -132,62 +159,172 @@ int main(int argc, char **argv)
 
     // cleanup and end program
     free_loc_data();
-    util_unmap_file(loc_hist, sizeof(loc_hist_t));
+    util_ts_close(loc_hist);
     printf("INFO %s: terminating\n", progname);
     return 0;
 }
 
 // -----------------  LOC_HIST SUPPORT  -----------------------------
 
-void add_entry_to_loc_hist(time_t t, double latitude, double longitude, char *name)
+// The legacy loc_hist file's entries are imported into the empty loc_hist
+// store, and the file is then renamed to loc_hist.imported. An entry is:
+//   Bolton
+//   Dec 05 23:00:00 EST
+//   42.1234 -71.1234          or 'Location Unavailable'
+// The entry's time has no year; the entries are in time order, so the year
+// is chosen so that the last entry is not in the future, and each entry is
+// not after the entry that follows it.
+void import_legacy_loc_hist(void)
 {
-    double miles = 0;       // not included in loc hist file
-    double elevation = 0;   // not included in loc hist file
+    char              *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char               path[300], new_path[300], month[4];
+    char               name[MAX_NAME], *data_str, *nl, *m;
+    FILE              *fp;
+    legacy_loc_hist_t *legacy;
+    loc_hist_rec_t    *recs;
+    struct tm          tm, now_tm;
+    time_t             now, t;
+    int                i, cnt, max_recs, mon, day, hr, min, sec;
+    double             latitude, longitude;
+
+    sprintf(path, "%s/%s", data_dir, LEGACY_LOC_HIST_FILENAME);
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return;
+    }
+
+    legacy = calloc(1, sizeof(legacy_loc_hist_t));
+    recs = calloc(MAX_LEGACY_LOC_HIST, sizeof(loc_hist_rec_t));
+    if (legacy == NULL || recs == NULL) {
+        // the legacy file is kept, and the import is tried again at the next start
+        printf("ERROR %s: out of memory importing %s\n", progname, path);
+        fclose(fp);
+        free(legacy);
+        free(recs);
+        return;
+    }
+    if (fread(legacy, 1, sizeof(legacy_loc_hist_t), fp) < 2 * sizeof(int)) {
+        printf("ERROR %s: failed to read %s\n", progname, path);
+        goto done;
+    }
+    if (legacy->count < 0 || legacy->count > MAX_LEGACY_LOC_HIST) {
+        printf("ERROR %s: %s count %d is invalid\n", progname, path, legacy->count);
+        goto done;
+    }
 
-    // if buffer is full then discard the first half (oldest data)
-    if (loc_hist->count == MAX_LOC_HIST) {
-        memmove(&loc_hist->loc[0], 
-                &loc_hist->loc[MAX_LOC_HIST-MAX_LOC_HIST/2], 
-                (MAX_LOC_HIST/2)*sizeof(loc_hist->loc[0]));
+    // parse the entries, walking back from the most recent, so that the
+    // year of each entry can be chosen
+    now = time(NULL);
+    localtime_r(&now, &now_tm);
+    t = now;
+    max_recs = 0;
+    for (i = legacy->count-1; i >= 0; i--) {
+        data_str = legacy->loc[i].data_str;
+        data_str[sizeof(legacy->loc[i].data_str)-1] = '\0';
+
+        // name line
+        nl = strchr(data_str, '\n');
+        if (nl == NULL || nl - data_str >= MAX_NAME) {
+            continue;
+        }
+        memcpy(name, data_str, nl-data_str);
+        name[nl-data_str] = '\0';
 
-        memset(&loc_hist->loc[MAX_LOC_HIST/2],
-               0,
-               (MAX_LOC_HIST-MAX_LOC_HIST/2)*sizeof(loc_hist->loc[0]));
+        // time line
+        cnt = sscanf(nl+1, "%3s %d %d:%d:%d", month, &day, &hr, &min, &sec);
+        if (cnt != 5) {
+            continue;
+        }
+        m = strstr(months, month);
+        if (strlen(month) != 3 || m == NULL || (m - months) % 3 != 0) {
+            continue;
+        }
+        mon = (m - months) / 3;
 
-        loc_hist->count = MAX_LOC_HIST/2;
-    }
+        // location line
+        nl = strchr(nl+1, '\n');
+        if (nl == NULL || sscanf(nl+1, "%lf %lf", &latitude, &longitude) != 2) {
+            latitude = longitude = INVALID_NUMBER;
+        }
+
+        // the entry's time is the latest time not after time t
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year  = now_tm.tm_year;
+        tm.tm_mon   = mon;
+        tm.tm_mday  = day;
+        tm.tm_hour  = hr;
+        tm.tm_min   = min;
+        tm.tm_sec   = sec;
+        tm.tm_isdst = -1;
+        while (mktime(&tm) > t && tm.tm_year > 70) {
+            tm.tm_year--;
+            tm.tm_mon   = mon;
+            tm.tm_mday  = day;
+            tm.tm_hour  = hr;
+            tm.tm_min   = min;
+            tm.tm_sec   = sec;
+            tm.tm_isdst = -1;
+        }
+        t = mktime(&tm);
 
-    // add entry
-    create_loc_data_str(t, latitude, longitude, elevation, name, miles,
-                        false, loc_hist->loc[loc_hist->count].data_str);
-    loc_hist->count++;
+        recs[max_recs].timestamp = t;
+        recs[max_recs].latitude  = latitude;
+        recs[max_recs].longitude = longitude;
+        strncpy(recs[max_recs].name, name, MAX_NAME-1);
+        max_recs++;
+    }
 
-    // sync memory mapped buffer to storage
-    util_sync_file(loc_hist, sizeof(loc_hist_t));
+    // add the entries to the store, oldest first
+    for (i = max_recs-1; i >= 0; i--) {
+        if (util_ts_append(loc_hist, &recs[i]) != 0) {
+            printf("ERROR %s: failed to import loc_hist entry '%s'\n", progname, recs[i].name);
+        }
+    }
+    util_ts_sync(loc_hist);
+    printf("INFO %s: imported %d of %d entries from %s\n", progname, max_recs, legacy->count, path);
+
+done:
+    // the legacy file is renamed, even if it was not valid, so that it
+    // is not read again
+    fclose(fp);
+    free(legacy);
+    free(recs);
+    sprintf(new_path, "%s.imported", path);
+    if (rename(path, new_path) != 0) {
+        printf("ERROR %s: rename %s failed\n", progname, path);
+    }
 }
 
-char *most_recent_loc_hist_name(void)
+void add_entry_to_loc_hist(time_t t, double latitude, double longitude, char *name)
 {
-    static char name[MAX_NAME];
-    char *ptr, *data_str;
-
-    if (loc_hist->count == 0) {
-        return "";
+    loc_hist_rec_t rec;
+
+    // add entry; when it is older than the most recent entry, which can
+    // happen if the clock is set back, the store rejects it
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = t;
+    rec.latitude  = latitude;
+    rec.longitude = longitude;
+    strncpy(rec.name, name, MAX_NAME-1);
+    if (util_ts_append(loc_hist, &rec) != 0) {
+        printf("ERROR %s: failed to add loc_hist entry '%s'\n", progname, name);
+        return;
     }
 
-    data_str = loc_hist->loc[loc_hist->count-1].data_str;
+    // sync the store to storage
+    util_ts_sync(loc_hist);
+}
+
+char *most_recent_loc_hist_name(void)
+{
+    static loc_hist_rec_t rec;
 
-    ptr = strchr(data_str, '\n');
-    if (ptr == NULL) {
-        printf("ERROR %s: newline char not found in data_str '%s'\n", progname, data_str);
+    if (util_ts_latest(loc_hist, &rec, 1) != 1) {
         return "";
     }
 
-    memcpy(name, data_str, ptr-data_str);
-    name[ptr-data_str] = '\0';
-
-    printf("INFO %s: most recent name = '%s'\n", progname, name);
-    return name;
+    printf("INFO %s: most recent name = '%s'\n", progname, rec.name);
+    return rec.name;
 }
 
 #define METERS_TO_FEET 3.28084
@@ -241,7 +378,7 @@ void add_simulated_entries_to_loc_hist(void)
         // find closest location from loc_data
         find_closest_loc_data(latitude, longitude, name, &miles);
 
-        // add to loc_hist file
+        // add to loc_hist store
         add_entry_to_loc_hist(t, latitude, longitude, name);
 
         // advance time one hour
@@ -260,9 +397,7 @@ double rand_double(void)
 
 void clear_loc_history(void)
 {
-    loc_hist->count++;
-    memset(loc_hist, 0, sizeof(loc_hist_t));
-    util_sync_file(loc_hist, sizeof(loc_hist_t));
+    util_ts_clear(loc_hist);
 }
 
 // -----------------  PROCESS REQ SUPPORT  --------------------------
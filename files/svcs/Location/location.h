@@ -9,17 +9,18 @@
 #define SVC_LOCATION_REQ_QUERY_ENABLED      15
 #define SVC_LOCATION_REQ_SET_ENABLED        16
 
-#define LOC_HIST_FILENAME   "loc_hist"
-#define MAX_LOC_HIST        1000
+#define LOC_HIST_NAME       "loc_history"
+#define MAX_LOC_HIST        1000   // most recent entries displayed
 
 #define MAX_NAME 32
 
+// the location history is a time series store, util_ts_open LOC_HIST_NAME
+// in dir "svcs/Location", of these records; timestamp is unix time in seconds
 typedef struct {
-    int count;
-    int pad;
-    struct loc_hist_entry_s {
-        char data_str[100];
-    } loc[MAX_LOC_HIST];
-} loc_hist_t;
+    long   timestamp;
+    double latitude;
+    double longitude;
+    char   name[MAX_NAME];
+} loc_hist_rec_t;
 
 #endif
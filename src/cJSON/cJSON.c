@@ -293,6 +293,7 @@ typedef struct
     size_t offset;
     size_t depth; /* How deeply nested (in arrays/objects) is the input at the current offset. */
     internal_hooks hooks;
+    cJSON_Arena *arena; /* when not NULL, the items and strings are allocated from the arena */
 } parse_buffer;
 
 /* check if the given size is left to read in a given parse buffer (starting with 1) */
@@ -303,6 +304,316 @@ typedef struct
 /* get a pointer to the buffer at the position */
 #define buffer_at_offset(buffer) ((buffer)->content + (buffer)->offset)
 
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size; /* bytes of data */
+    size_t used;
+    size_t last; /* offset of the last allocation, so it can be released */
+} arena_block;
+
+struct cJSON_Arena
+{
+    arena_block *blocks; /* the current block first */
+    size_t block_size; /* size of the next block */
+    size_t first_block_size;
+    cJSON_bool intern_keys;
+    unsigned char **intern_table; /* open addressing, of keys in the arena */
+    size_t intern_size;
+    size_t intern_count;
+    internal_hooks hooks;
+};
+
+#define ARENA_DEFAULT_BLOCK_SIZE 16384
+#define ARENA_ALIGN 16
+#define ARENA_HEADER_SIZE ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define arena_block_data(block) ((unsigned char*)(block) + ARENA_HEADER_SIZE)
+
+static arena_block *arena_add_block(cJSON_Arena * const arena, size_t size)
+{
+    arena_block *block = NULL;
+
+    block = (arena_block*)arena->hooks.allocate(ARENA_HEADER_SIZE + size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->next = arena->blocks;
+    block->size = size;
+    block->used = 0;
+    block->last = 0;
+    arena->blocks = block;
+
+    return block;
+}
+
+static void *arena_allocate(cJSON_Arena * const arena, size_t size, size_t align)
+{
+    arena_block *block = arena->blocks;
+    size_t offset = 0;
+
+    if (block != NULL)
+    {
+        offset = (block->used + align - 1) & ~(align - 1);
+    }
+    if ((block == NULL) || (offset + size > block->size))
+    {
+        /* the blocks double in size, so their number grows with the log of the total */
+        size_t block_size = arena->block_size;
+        while (block_size < size + align)
+        {
+            block_size *= 2;
+        }
+        block = arena_add_block(arena, block_size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        arena->block_size = block_size * 2;
+        offset = 0;
+    }
+
+    block->last = offset;
+    block->used = offset + size;
+
+    return arena_block_data(block) + offset;
+}
+
+/* only the last allocation is released, others stay until the arena is reset */
+static void arena_release(cJSON_Arena * const arena, void *pointer)
+{
+    arena_block *block = arena->blocks;
+
+    if ((block != NULL) && ((unsigned char*)pointer == arena_block_data(block) + block->last))
+    {
+        block->used = block->last;
+    }
+}
+
+static unsigned long arena_hash(const unsigned char *string)
+{
+    unsigned long hash = 5381;
+
+    while (*string != '\0')
+    {
+        hash = (hash * 33) ^ *string++;
+    }
+
+    return hash;
+}
+
+/* returns the interned copy of key, which was the arena's last allocation */
+static unsigned char *arena_intern(cJSON_Arena * const arena, unsigned char *key)
+{
+    size_t i = 0;
+    size_t mask = 0;
+
+    /* grow the table at half full */
+    if (2 * (arena->intern_count + 1) > arena->intern_size)
+    {
+        size_t new_size = (arena->intern_size == 0) ? 256 : 2 * arena->intern_size;
+        unsigned char **new_table = (unsigned char**)arena->hooks.allocate(new_size * sizeof(unsigned char*));
+        if (new_table == NULL)
+        {
+            return key;
+        }
+        memset(new_table, '\0', new_size * sizeof(unsigned char*));
+        for (i = 0; i < arena->intern_size; i++)
+        {
+            if (arena->intern_table[i] != NULL)
+            {
+                size_t j = arena_hash(arena->intern_table[i]) & (new_size - 1);
+                while (new_table[j] != NULL)
+                {
+                    j = (j + 1) & (new_size - 1);
+                }
+                new_table[j] = arena->intern_table[i];
+            }
+        }
+        if (arena->intern_table != NULL)
+        {
+            arena->hooks.deallocate(arena->intern_table);
+        }
+        arena->intern_table = new_table;
+        arena->intern_size = new_size;
+    }
+
+    mask = arena->intern_size - 1;
+    for (i = arena_hash(key) & mask; arena->intern_table[i] != NULL; i = (i + 1) & mask)
+    {
+        if (strcmp((const char*)arena->intern_table[i], (const char*)key) == 0)
+        {
+            arena_release(arena, key);
+            return arena->intern_table[i];
+        }
+    }
+    arena->intern_table[i] = key;
+    arena->intern_count++;
+
+    return key;
+}
+
+CJSON_PUBLIC(cJSON_Arena *) cJSON_CreateArena(size_t block_size, cJSON_bool intern_keys)
+{
+    cJSON_Arena *arena = (cJSON_Arena*)global_hooks.allocate(sizeof(cJSON_Arena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    memset(arena, '\0', sizeof(cJSON_Arena));
+
+    arena->hooks = global_hooks;
+    arena->intern_keys = intern_keys;
+    arena->first_block_size = (block_size == 0) ? ARENA_DEFAULT_BLOCK_SIZE : block_size;
+    arena->block_size = arena->first_block_size;
+
+    return arena;
+}
+
+CJSON_PUBLIC(void) cJSON_ResetArena(cJSON_Arena *arena)
+{
+    arena_block *block = NULL;
+
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    /* keep the first block, which is the last in the list */
+    while ((arena->blocks != NULL) && (arena->blocks->next != NULL))
+    {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        arena->hooks.deallocate(block);
+    }
+    if (arena->blocks != NULL)
+    {
+        arena->blocks->used = 0;
+        arena->blocks->last = 0;
+        arena->block_size = 2 * arena->blocks->size;
+    }
+    else
+    {
+        arena->block_size = arena->first_block_size;
+    }
+
+    if (arena->intern_table != NULL)
+    {
+        memset(arena->intern_table, '\0', arena->intern_size * sizeof(unsigned char*));
+    }
+    arena->intern_count = 0;
+}
+
+CJSON_PUBLIC(void) cJSON_DeleteArena(cJSON_Arena *arena)
+{
+    arena_block *block = NULL;
+
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    while (arena->blocks != NULL)
+    {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        arena->hooks.deallocate(block);
+    }
+    if (arena->intern_table != NULL)
+    {
+        arena->hooks.deallocate(arena->intern_table);
+    }
+    arena->hooks.deallocate(arena);
+}
+
+CJSON_PUBLIC(size_t) cJSON_ArenaUsed(const cJSON_Arena *arena)
+{
+    const arena_block *block = NULL;
+    size_t used = 0;
+
+    if (arena == NULL)
+    {
+        return 0;
+    }
+
+    for (block = arena->blocks; block != NULL; block = block->next)
+    {
+        used += block->used;
+    }
+
+    return used;
+}
+
+CJSON_PUBLIC(cJSON_bool) cJSON_ArenaContains(const cJSON_Arena *arena, const void *pointer)
+{
+    const arena_block *block = NULL;
+    const unsigned char *p = (const unsigned char*)pointer;
+
+    if (arena == NULL)
+    {
+        return false;
+    }
+
+    for (block = arena->blocks; block != NULL; block = block->next)
+    {
+        const unsigned char *data = (const unsigned char*)block + ARENA_HEADER_SIZE;
+        if ((p >= data) && (p < data + block->used))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* the parser allocates from the arena when it has one, and otherwise with the hooks */
+static void *parse_allocate(parse_buffer * const input_buffer, size_t size, size_t align)
+{
+    if (input_buffer->arena != NULL)
+    {
+        return arena_allocate(input_buffer->arena, size, align);
+    }
+    return input_buffer->hooks.allocate(size);
+}
+
+static void parse_deallocate(parse_buffer * const input_buffer, void *pointer)
+{
+    if (input_buffer->arena != NULL)
+    {
+        arena_release(input_buffer->arena, pointer);
+        return;
+    }
+    input_buffer->hooks.deallocate(pointer);
+}
+
+static cJSON *parse_new_item(parse_buffer * const input_buffer)
+{
+    cJSON *node = NULL;
+
+    if (input_buffer->arena == NULL)
+    {
+        return cJSON_New_Item(&input_buffer->hooks);
+    }
+
+    node = (cJSON*)arena_allocate(input_buffer->arena, sizeof(cJSON), sizeof(double));
+    if (node)
+    {
+        memset(node, '\0', sizeof(cJSON));
+    }
+
+    return node;
+}
+
+/* items allocated from an arena are released with the arena */
+static void parse_delete_items(parse_buffer * const input_buffer, cJSON *item)
+{
+    if (input_buffer->arena == NULL)
+    {
+        cJSON_Delete(item);
+    }
+}
+
+
 /* Parse the input text to generate a number, and populate the result into item. */
 static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -354,7 +665,7 @@ static cJSON_bool parse_number(cJSON * const item, parse_buffer * const input_bu
     }
 loop_end:
     /* malloc for temporary buffer, add 1 for '\0' */
-    number_c_string = (unsigned char *) input_buffer->hooks.allocate(number_string_length + 1);
+    number_c_string = (unsigned char *) parse_allocate(input_buffer, number_string_length + 1, 1);
     if (number_c_string == NULL)
     {
         return false; /* allocation failure */
@@ -379,7 +690,7 @@ loop_end:
     if (number_c_string == after_end)
     {
         /* free the temporary buffer */
-        input_buffer->hooks.deallocate(number_c_string);
+        parse_deallocate(input_buffer, number_c_string);
         return false; /* parse_error */
     }
 
@@ -403,7 +714,7 @@ loop_end:
 
     input_buffer->offset += (size_t)(after_end - number_c_string);
     /* free the temporary buffer */
-    input_buffer->hooks.deallocate(number_c_string);
+    parse_deallocate(input_buffer, number_c_string);
     return true;
 }
 
@@ -855,7 +1166,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
 
         /* This is at most how much we need for the output */
         allocation_length = (size_t) (input_end - buffer_at_offset(input_buffer)) - skipped_bytes;
-        output = (unsigned char*)input_buffer->hooks.allocate(allocation_length + sizeof(""));
+        output = (unsigned char*)parse_allocate(input_buffer, allocation_length + sizeof(""), 1);
         if (output == NULL)
         {
             goto fail; /* allocation failure */
@@ -933,7 +1244,7 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
 fail:
     if (output != NULL)
     {
-        input_buffer->hooks.deallocate(output);
+        parse_deallocate(input_buffer, output);
         output = NULL;
     }
 
@@ -1139,9 +1450,9 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return
 }
 
 /* Parse an object - create a new root, and populate. */
-CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+static cJSON *parse_root(cJSON_Arena * const arena, const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
 {
-    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 } };
+    parse_buffer buffer = { 0, 0, 0, 0, { 0, 0, 0 }, 0 };
     cJSON *item = NULL;
 
     /* reset error position */
@@ -1157,8 +1468,9 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
     buffer.length = buffer_length;
     buffer.offset = 0;
     buffer.hooks = global_hooks;
+    buffer.arena = arena;
 
-    item = cJSON_New_Item(&global_hooks);
+    item = parse_new_item(&buffer);
     if (item == NULL) /* memory fail */
     {
         goto fail;
@@ -1189,7 +1501,7 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer
 fail:
     if (item != NULL)
     {
-        cJSON_Delete(item);
+        parse_delete_items(&buffer, item);
     }
 
     if (value != NULL)
@@ -1218,6 +1530,21 @@ fail:
     return NULL;
 }
 
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    return parse_root(NULL, value, buffer_length, return_parse_end, require_null_terminated);
+}
+
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithArena(cJSON_Arena *arena, const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated)
+{
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+
+    return parse_root(arena, value, buffer_length, return_parse_end, require_null_terminated);
+}
+
 /* Default options for cJSON_Parse */
 CJSON_PUBLIC(cJSON *) cJSON_Parse(const char *value)
 {
@@ -1527,7 +1854,7 @@ static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buf
     do
     {
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        cJSON *new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1580,7 +1907,7 @@ success:
 fail:
     if (head != NULL)
     {
-        cJSON_Delete(head);
+        parse_delete_items(input_buffer, head);
     }
 
     return false;
@@ -1685,7 +2012,7 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
     do
     {
         /* allocate next item */
-        cJSON *new_item = cJSON_New_Item(&(input_buffer->hooks));
+        cJSON *new_item = parse_new_item(input_buffer);
         if (new_item == NULL)
         {
             goto fail; /* allocation failure */
@@ -1722,6 +2049,10 @@ static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_bu
         /* swap valuestring and string, because we parsed the name */
         current_item->string = current_item->valuestring;
         current_item->valuestring = NULL;
+        if ((input_buffer->arena != NULL) && input_buffer->arena->intern_keys)
+        {
+            current_item->string = (char*)arena_intern(input_buffer->arena, (unsigned char*)current_item->string);
+        }
 
         if (cannot_access_at_index(input_buffer, 0) || (buffer_at_offset(input_buffer)[0] != ':'))
         {
@@ -1760,7 +2091,7 @@ success:
 fail:
     if (head != NULL)
     {
-        cJSON_Delete(head);
+        parse_delete_items(input_buffer, head);
     }
 
     return false;
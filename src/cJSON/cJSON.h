@@ -158,6 +158,22 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithOpts(const char *value, const char **return_parse_end, cJSON_bool require_null_terminated);
 CJSON_PUBLIC(cJSON *) cJSON_ParseWithLengthOpts(const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
 
+/* Arena parsing: the items and strings of the trees parsed into an arena are allocated from the arena's blocks,
+ * which are obtained with the malloc hook and grow as needed, and are all released together by cJSON_ResetArena
+ * or cJSON_DeleteArena. These trees must be treated as read-only; they must not be passed to cJSON_Delete, or to the
+ * functions that add, detach, replace or delete items. With intern_keys, identical object keys share one string.
+ * block_size is the size of the first block, 0 for a default. */
+typedef struct cJSON_Arena cJSON_Arena;
+CJSON_PUBLIC(cJSON_Arena *) cJSON_CreateArena(size_t block_size, cJSON_bool intern_keys);
+CJSON_PUBLIC(cJSON *) cJSON_ParseWithArena(cJSON_Arena *arena, const char *value, size_t buffer_length, const char **return_parse_end, cJSON_bool require_null_terminated);
+/* Releases the trees parsed into the arena, keeping its first block for reuse. */
+CJSON_PUBLIC(void) cJSON_ResetArena(cJSON_Arena *arena);
+CJSON_PUBLIC(void) cJSON_DeleteArena(cJSON_Arena *arena);
+/* Returns the number of bytes allocated from the arena. */
+CJSON_PUBLIC(size_t) cJSON_ArenaUsed(const cJSON_Arena *arena);
+/* Returns true if pointer is to an item or string allocated from the arena. */
+CJSON_PUBLIC(cJSON_bool) cJSON_ArenaContains(const cJSON_Arena *arena, const void *pointer);
+
 /* Render a cJSON entity to text for transfer/storage. */
 CJSON_PUBLIC(char *) cJSON_Print(const cJSON *item);
 /* Render a cJSON entity to text for transfer/storage without any formatting. */
@@ -0,0 +1,205 @@
+/*
+ *      parse_bench.c
+ *
+ *      Parses a fixed, generated json corpus repeatedly with cJSON_Parse and
+ *      cJSON_Delete, and with cJSON_ParseWithArena, with and without key
+ *      interning, and prints one json line per mode with the parse rate in
+ *      MB/s of json text (cpu time, parse and free included), and for the
+ *      arena modes the arena bytes used by one tree.
+ *
+ *      The trees parsed into the arena must compare equal to the tree parsed
+ *      with the allocator.
+ *
+ *      usage: parse_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+
+#define DEFAULT_ITERATIONS 200
+#define PERIODS            700
+
+typedef struct
+{
+    const char *name;
+    int arena;
+    int intern_keys;
+} parse_mode_t;
+
+static const parse_mode_t modes[] =
+{
+    {"malloc", 0, 0},
+    {"arena", 1, 0},
+    {"arena_intern", 1, 1},
+};
+
+/* the corpus: an hourly weather forecast, like the ones the Weather app
+   parses; an object with a few properties and an array of periods, each an
+   object with about 15 members of all types */
+static char *make_corpus(void)
+{
+    static const char *forecasts[] = { "Sunny", "Mostly Cloudy", "Chance Rain Showers", "Partly Sunny" };
+    static const char *directions[] = { "N", "NE", "SW", "WNW" };
+    size_t size = PERIODS * 800 + 1000;
+    char *json = malloc(size);
+    size_t len = 0;
+    int i = 0;
+
+    if (json == NULL)
+    {
+        return NULL;
+    }
+
+    len += sprintf(json + len,
+                   "{\"@context\":[\"https://geojson.org/geojson-ld/geojson-context.jsonld\",{\"@version\":\"1.1\"}],"
+                   "\"type\":\"Feature\",\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[[-71.52,42.37],"
+                   "[-71.51,42.35],[-71.48,42.36],[-71.49,42.38],[-71.52,42.37]]]},"
+                   "\"properties\":{\"units\":\"us\",\"forecastGenerator\":\"HourlyForecastGenerator\","
+                   "\"generatedAt\":\"2024-03-01T12:00:00+00:00\",\"elevation\":{\"unitCode\":\"wmoUnit:m\",\"value\":54.864},"
+                   "\"periods\":[");
+    for (i = 0; i < PERIODS; i++)
+    {
+        len += sprintf(json + len,
+                       "%s{\"number\":%d,\"name\":\"\",\"startTime\":\"2024-03-%02dT%02d:00:00-05:00\","
+                       "\"endTime\":\"2024-03-%02dT%02d:00:00-05:00\",\"isDaytime\":%s,\"temperature\":%d,"
+                       "\"temperatureUnit\":\"F\",\"temperatureTrend\":null,"
+                       "\"probabilityOfPrecipitation\":{\"unitCode\":\"wmoUnit:percent\",\"value\":%d},"
+                       "\"dewpoint\":{\"unitCode\":\"wmoUnit:degC\",\"value\":%.10f},"
+                       "\"relativeHumidity\":{\"unitCode\":\"wmoUnit:percent\",\"value\":%d},"
+                       "\"windSpeed\":\"%d mph\",\"windDirection\":\"%s\","
+                       "\"icon\":\"https://api.weather.gov/icons/land/day/few?size=small\","
+                       "\"shortForecast\":\"%s\",\"detailedForecast\":\"\"}",
+                       (i ? "," : ""), i + 1, 1 + i / 24, i % 24, 1 + (i + 1) / 24, (i + 1) % 24,
+                       ((i % 24) >= 7 && (i % 24) < 19) ? "true" : "false",
+                       30 + (i * 7) % 25, (i * 13) % 100, -3.3333333333 + (i % 11) * 0.5555555556,
+                       40 + (i * 11) % 60, 5 + i % 15, directions[i % 4], forecasts[(i / 5) % 4]);
+    }
+    len += sprintf(json + len, "]}}");
+
+    return json;
+}
+
+static double cpu_secs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* returns the cpu seconds, or -1 if a parse failed or a tree differs */
+static double run(const parse_mode_t *mode, const char *json, size_t length, const cJSON *reference, int iterations,
+                  size_t *arena_used)
+{
+    cJSON_Arena *arena = NULL;
+    cJSON *tree = NULL;
+    double start = 0;
+    int ok = 1;
+    int i = 0;
+
+    if (mode->arena)
+    {
+        arena = cJSON_CreateArena(0, mode->intern_keys);
+        if (arena == NULL)
+        {
+            return -1;
+        }
+    }
+
+    start = cpu_secs();
+    for (i = 0; i < iterations; i++)
+    {
+        if (mode->arena)
+        {
+            tree = cJSON_ParseWithArena(arena, json, length, NULL, 1);
+        }
+        else
+        {
+            tree = cJSON_ParseWithLength(json, length);
+        }
+        if (tree == NULL)
+        {
+            ok = 0;
+            break;
+        }
+        if ((i == 0) && !cJSON_Compare(reference, tree, 1))
+        {
+            ok = 0;
+        }
+        if (mode->arena)
+        {
+            *arena_used = cJSON_ArenaUsed(arena);
+            cJSON_ResetArena(arena);
+        }
+        else
+        {
+            cJSON_Delete(tree);
+        }
+    }
+    start = cpu_secs() - start;
+
+    cJSON_DeleteArena(arena);
+    return ok ? start : -1;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = (argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS);
+    cJSON *reference = NULL;
+    char *json = NULL;
+    size_t length = 0;
+    double malloc_secs = 0;
+    int errors = 0;
+    int i = 0;
+
+    if (iterations <= 0)
+    {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    json = make_corpus();
+    if (json == NULL)
+    {
+        fprintf(stderr, "failed to allocate corpus\n");
+        return 1;
+    }
+    length = strlen(json) + 1;
+    reference = cJSON_Parse(json);
+    if (reference == NULL)
+    {
+        fprintf(stderr, "failed to parse corpus\n");
+        free(json);
+        return 1;
+    }
+
+    for (i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); i++)
+    {
+        size_t arena_used = 0;
+        double secs = run(&modes[i], json, length, reference, iterations, &arena_used);
+        double mbytes = (double)length * iterations / 1e6;
+
+        if (secs < 0)
+        {
+            fprintf(stderr, "%s: parse failed or tree differs\n", modes[i].name);
+            errors++;
+            continue;
+        }
+        if (i == 0)
+        {
+            malloc_secs = secs;
+        }
+
+        printf("{\"mode\":\"%s\", \"json_bytes\":%lu, \"iterations\":%d, \"mb_per_sec\":%.1f, "
+               "\"speedup\":%.2f, \"arena_bytes\":%lu, \"identical\":true}\n",
+               modes[i].name, (unsigned long)length, iterations, mbytes / secs,
+               malloc_secs > 0 ? malloc_secs / secs : 0.0, (unsigned long)arena_used);
+    }
+
+    cJSON_Delete(reference);
+    free(json);
+    return errors ? 1 : 0;
+}
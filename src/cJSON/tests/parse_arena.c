@@ -0,0 +1,223 @@
+/*
+  Copyright (c) 2009-2017 Dave Gamble and cJSON contributors
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "unity/examples/unity_config.h"
+#include "unity/src/unity.h"
+#include "common.h"
+
+static void parse_arena_should_match_parse(const char *filename, cJSON_bool intern_keys)
+{
+    char *content = read_file(filename);
+    cJSON_Arena *arena = NULL;
+    cJSON *tree = NULL;
+    cJSON *arena_tree = NULL;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(content, "Failed to read file.");
+
+    /* a small first block, so the arena has to grow */
+    arena = cJSON_CreateArena(64, intern_keys);
+    TEST_ASSERT_NOT_NULL(arena);
+
+    tree = cJSON_Parse(content);
+    TEST_ASSERT_NOT_NULL(tree);
+    arena_tree = cJSON_ParseWithArena(arena, content, strlen(content) + sizeof(""), NULL, false);
+    TEST_ASSERT_NOT_NULL(arena_tree);
+
+    TEST_ASSERT_TRUE(cJSON_Compare(tree, arena_tree, true));
+
+    cJSON_Delete(tree);
+    cJSON_DeleteArena(arena);
+    free(content);
+}
+
+static void parse_arena_should_parse_test_inputs(void)
+{
+    char filename[64];
+    int i = 0;
+
+    for (i = 1; i <= 11; i++)
+    {
+        /* test6 is not valid json */
+        if (i == 6)
+        {
+            continue;
+        }
+        sprintf(filename, "inputs/test%d", i);
+        parse_arena_should_match_parse(filename, false);
+        parse_arena_should_match_parse(filename, true);
+    }
+}
+
+static void parse_arena_should_intern_keys(void)
+{
+    const char json[] = "[{\"name\":\"a\",\"value\":1},{\"name\":\"b\",\"value\":2},{\"Name\":\"c\"}]";
+    cJSON_Arena *arena = NULL;
+    cJSON *tree = NULL;
+    cJSON *first = NULL;
+    cJSON *second = NULL;
+    cJSON *third = NULL;
+
+    arena = cJSON_CreateArena(0, true);
+    tree = cJSON_ParseWithArena(arena, json, sizeof(json), NULL, true);
+    TEST_ASSERT_NOT_NULL(tree);
+
+    first = cJSON_GetArrayItem(tree, 0);
+    second = cJSON_GetArrayItem(tree, 1);
+    third = cJSON_GetArrayItem(tree, 2);
+    TEST_ASSERT_EQUAL_PTR(first->child->string, second->child->string);
+    TEST_ASSERT_EQUAL_PTR(first->child->next->string, second->child->next->string);
+    TEST_ASSERT_TRUE(first->child->string != third->child->string);
+    TEST_ASSERT_EQUAL_STRING("Name", third->child->string);
+    TEST_ASSERT_EQUAL_STRING("b", cJSON_GetObjectItem(second, "name")->valuestring);
+    TEST_ASSERT_EQUAL_DOUBLE(2, cJSON_GetObjectItem(second, "value")->valuedouble);
+
+    cJSON_DeleteArena(arena);
+}
+
+static void parse_arena_should_grow(void)
+{
+    cJSON_Arena *arena = NULL;
+    cJSON *tree = NULL;
+    cJSON *arena_tree = NULL;
+    char *json = NULL;
+    int i = 0;
+
+    /* an array of many objects, much larger than the first block */
+    tree = cJSON_CreateArray();
+    for (i = 0; i < 2000; i++)
+    {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "number", i);
+        cJSON_AddStringToObject(item, "name", "a name");
+        cJSON_AddBoolToObject(item, "flag", i & 1);
+        cJSON_AddItemToArray(tree, item);
+    }
+    json = cJSON_PrintUnformatted(tree);
+    TEST_ASSERT_NOT_NULL(json);
+
+    arena = cJSON_CreateArena(1024, true);
+    arena_tree = cJSON_ParseWithArena(arena, json, strlen(json) + sizeof(""), NULL, true);
+    TEST_ASSERT_NOT_NULL(arena_tree);
+    TEST_ASSERT_TRUE(cJSON_Compare(tree, arena_tree, true));
+    TEST_ASSERT_TRUE(cJSON_ArenaUsed(arena) > strlen(json));
+
+    cJSON_DeleteArena(arena);
+    cJSON_Delete(tree);
+    free(json);
+}
+
+static void parse_arena_should_handle_errors(void)
+{
+    const char json[] = "{\"a\":[1,2,{\"b\":}]}";
+    const char *parse_end = NULL;
+    const char *arena_parse_end = NULL;
+    cJSON_Arena *arena = NULL;
+
+    arena = cJSON_CreateArena(0, true);
+
+    TEST_ASSERT_NULL(cJSON_ParseWithArena(NULL, json, sizeof(json), NULL, false));
+    TEST_ASSERT_NULL(cJSON_ParseWithArena(arena, NULL, 0, NULL, false));
+
+    TEST_ASSERT_NULL(cJSON_ParseWithOpts(json, &parse_end, true));
+    TEST_ASSERT_NULL(cJSON_ParseWithArena(arena, json, sizeof(json), &arena_parse_end, true));
+    TEST_ASSERT_EQUAL_PTR(parse_end, arena_parse_end);
+    TEST_ASSERT_EQUAL_PTR(parse_end, cJSON_GetErrorPtr());
+
+    /* the arena is still usable after a failed parse */
+    TEST_ASSERT_NOT_NULL(cJSON_ParseWithArena(arena, "{\"b\":[true]}", 13, NULL, true));
+
+    cJSON_DeleteArena(arena);
+}
+
+static void parse_arena_should_reset(void)
+{
+    const char json[] = "{\"key\":\"a string value that is long enough to take some space\",\"n\":[1,2,3]}";
+    cJSON_Arena *arena = NULL;
+    cJSON *tree = NULL;
+    size_t used = 0;
+    int i = 0;
+
+    arena = cJSON_CreateArena(256, true);
+
+    for (i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_NOT_NULL(cJSON_ParseWithArena(arena, json, sizeof(json), NULL, true));
+    }
+    used = cJSON_ArenaUsed(arena);
+    TEST_ASSERT_TRUE(used > 100 * (sizeof(json) / 2));
+
+    cJSON_ResetArena(arena);
+    TEST_ASSERT_EQUAL_UINT(0, cJSON_ArenaUsed(arena));
+
+    tree = cJSON_ParseWithArena(arena, json, sizeof(json), NULL, true);
+    TEST_ASSERT_NOT_NULL(tree);
+    TEST_ASSERT_EQUAL_INT(3, cJSON_GetArraySize(cJSON_GetObjectItem(tree, "n")));
+    TEST_ASSERT_TRUE(cJSON_ArenaUsed(arena) < used);
+
+    cJSON_DeleteArena(arena);
+}
+
+static void parse_arena_should_contain_its_items(void)
+{
+    const char json[] = "{\"a\":[1,2,{\"b\":\"c\"}]}";
+    cJSON_Arena *arena = NULL;
+    cJSON_Arena *other_arena = NULL;
+    cJSON *tree = NULL;
+    cJSON *other_tree = NULL;
+    cJSON *item = NULL;
+
+    arena = cJSON_CreateArena(64, true);
+    other_arena = cJSON_CreateArena(64, true);
+    tree = cJSON_ParseWithArena(arena, json, sizeof(json), NULL, true);
+    other_tree = cJSON_ParseWithArena(other_arena, json, sizeof(json), NULL, true);
+    TEST_ASSERT_NOT_NULL(tree);
+    TEST_ASSERT_NOT_NULL(other_tree);
+
+    item = cJSON_GetArrayItem(cJSON_GetObjectItem(tree, "a"), 2);
+    TEST_ASSERT_TRUE(cJSON_ArenaContains(arena, tree));
+    TEST_ASSERT_TRUE(cJSON_ArenaContains(arena, item));
+    TEST_ASSERT_TRUE(cJSON_ArenaContains(arena, cJSON_GetObjectItem(item, "b")->valuestring));
+    TEST_ASSERT_FALSE(cJSON_ArenaContains(other_arena, item));
+    TEST_ASSERT_FALSE(cJSON_ArenaContains(arena, other_tree));
+    TEST_ASSERT_FALSE(cJSON_ArenaContains(arena, json));
+    TEST_ASSERT_FALSE(cJSON_ArenaContains(NULL, tree));
+
+    cJSON_ResetArena(arena);
+    TEST_ASSERT_FALSE(cJSON_ArenaContains(arena, tree));
+
+    cJSON_DeleteArena(arena);
+    cJSON_DeleteArena(other_arena);
+}
+
+int CJSON_CDECL main(void)
+{
+    UNITY_BEGIN();
+
+    RUN_TEST(parse_arena_should_parse_test_inputs);
+    RUN_TEST(parse_arena_should_intern_keys);
+    RUN_TEST(parse_arena_should_grow);
+    RUN_TEST(parse_arena_should_handle_errors);
+    RUN_TEST(parse_arena_should_reset);
+    RUN_TEST(parse_arena_should_contain_its_items);
+
+    return UNITY_END();
+}
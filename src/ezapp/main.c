@@ -59,6 +59,7 @@ typedef struct {
     bool   foreground_enabled;
     double record_scale;
     double record_silence;
+    int    record_bitrate;
 } params_t;
 
 //
@@ -69,6 +70,32 @@ static char       *storage_path;
 static params_t    params;
 static pthread_t   server_tid;
 
+// bench.app_name is set when running an app headless for benchmarking
+static sdlx_bench_params_t bench = { NULL, 600, 60, NULL, NULL };
+
+// event trace record or replay
+static char       *trace_record_path;
+static char       *trace_replay_path;
+static bool        trace_replay_fast;
+
+// dsp kernel test and benchmark
+static bool        dsp_test;
+
+// sensor fusion test, over a sensor sample file
+static char       *fusion_test_path;
+
+// play back a sensor trace, in place of the device's sensors
+static char       *sensor_playback_path;
+static double      sensor_playback_speed = 1;
+
+// transcode raw recordings to mp3
+static bool        mp3_transcode;
+static int         mp3_bitrate = DEFAULT_RECORD_BITRATE;
+static int         mp3_threads;
+
+// key value store benchmark, in this dir
+static char       *kv_bench_dir;
+
 //
 // prototypes
 //
@@ -169,8 +196,12 @@ int lame_test(void)
 
 // -----------------  MAIN  ------------------------------------------
 
+static int parse_args(int argc, char **argv);
+static int trace_start(void);
 static int init(void);
 static void cleanup(void);
+static int bench_app(void);
+static int transcode(char *raw_path, char *mp3_path);
 static void sigusr2_hndlr(int signum);
 static void print_type_sizes(void);
 #ifdef ANDROID  // xxx get rid of some ifdefs
@@ -181,15 +212,113 @@ int MAIN(int argc, char **argv)
 {
     int rc;
 
+    rc = parse_args(argc, argv);
+    if (rc != 0) {
+        return 1;
+    }
+
+    if (dsp_test) {
+        return sdlx_dsp_test() == 0 ? 0 : 1;
+    }
+
+    if (fusion_test_path) {
+        return sdlx_fusion_test(fusion_test_path) == 0 ? 0 : 1;
+    }
+
+    if (mp3_transcode) {
+        return transcode(argv[optind], argv[optind+1]) == 0 ? 0 : 1;
+    }
+
+    if (kv_bench_dir) {
+        return util_kv_bench(kv_bench_dir) == 0 ? 0 : 1;
+    }
+
     rc = init();
     if (rc != 0) {
         return 1;
     }
 
-    processing();
+    if (bench.app_name == NULL) {
+        processing();
+        rc = 0;
+    } else {
+        rc = bench_app();
+    }
 
     cleanup();
 
+    return rc;
+}
+
+// options, used on Linux:
+//   -b <app>    : run <app> headless and report benchmark results
+//   -n <frames> : bench frame limit, default 600
+//   -t <secs>   : bench time limit, default 60
+//   -s <file>   : bench scripted input file
+//   -o <file>   : append bench report to file, default stdout
+//   -r <file>   : record events and sensor values to trace file
+//   -p <file>   : replay trace file, at recorded speed
+//   -f          : replay trace file as fast as possible
+//   -d          : test and benchmark the audio dsp kernels, and exit
+//   -u <file>   : run the sensor fusion over a sensor sample file, and exit
+//   -S <file>   : play back a sensor trace as the sensors
+//   -x <speed>  : sensor trace playback speed, default 1
+//   -m <raw> <mp3> : transcode a raw recording to mp3, and exit
+//   -k <kbps>   : transcode bitrate, default 64
+//   -j <threads>: transcode threads, default one per cpu
+//   -K <dir>    : benchmark the key value store, in dir, and exit
+static int parse_args(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:t:s:o:r:p:fdu:S:x:mk:j:K:")) != -1) {
+        switch (opt) {
+        case 'b': bench.app_name = optarg; break;
+        case 'n': bench.max_frames = atoi(optarg); break;
+        case 't': bench.max_secs = atoi(optarg); break;
+        case 's': bench.script_path = optarg; break;
+        case 'o': bench.report_path = optarg; break;
+        case 'r': trace_record_path = optarg; break;
+        case 'p': trace_replay_path = optarg; break;
+        case 'f': trace_replay_fast = true; break;
+        case 'd': dsp_test = true; break;
+        case 'u': fusion_test_path = optarg; break;
+        case 'S': sensor_playback_path = optarg; break;
+        case 'x': sensor_playback_speed = atof(optarg); break;
+        case 'm': mp3_transcode = true; break;
+        case 'k': mp3_bitrate = atoi(optarg); break;
+        case 'j': mp3_threads = atoi(optarg); break;
+        case 'K': kv_bench_dir = optarg; break;
+        default:
+            fprintf(stderr, "usage: ezapp [-b app [-n frames] [-t secs] [-s script] [-o report]]\n"
+                            "             [-r trace | -p trace [-f]] [-d] [-u samples]\n"
+                            "             [-S sensor_trace [-x speed]]\n"
+                            "             [-m [-k kbps] [-j threads] raw mp3] [-K dir]\n");
+            return -1;
+        }
+    }
+
+    if (mp3_transcode && argc - optind != 2) {
+        fprintf(stderr, "ERROR: -m expects the raw and mp3 file names\n");
+        return -1;
+    }
+
+    if (trace_record_path != NULL && trace_replay_path != NULL) {
+        fprintf(stderr, "ERROR: -r and -p are mutually exclusive\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int trace_start(void)
+{
+    if (trace_record_path != NULL) {
+        return sdlx_trace_record_start(trace_record_path);
+    }
+    if (trace_replay_path != NULL) {
+        return sdlx_trace_replay_start(trace_replay_path, trace_replay_fast);
+    }
     return 0;
 }
 
@@ -215,7 +344,8 @@ static int init(void)
     // get params, if they don't exist, set to default value
     params.devel_mode = util_get_numeric_param(".", "devel_mode", 0);
     params.devel_port = util_get_numeric_param(".", "devel_port", DEFAULT_DEVEL_PORT);
-    strcpy(params.devel_password, util_get_str_param(".", "devel_password", DEFAULT_DEVEL_PASSWORD));
+    util_get_str_param(".", "devel_password", DEFAULT_DEVEL_PASSWORD,
+                       params.devel_password, sizeof(params.devel_password));
     params.foreground_enabled = util_get_numeric_param(".", "foreground_enabled", 0);
 
     // xxx numeric keypad decimal point
@@ -223,9 +353,29 @@ static int init(void)
     // xxx audio record scaling, and params
     params.record_scale = util_get_numeric_param(".", "record_scale", DEFAULT_RECORD_SCALE);
     params.record_silence = util_get_numeric_param(".", "record_silence", DEFAULT_RECORD_SILENCE);
-    sdlx_audio_params_t ap = { params.record_scale, params.record_silence };
+    params.record_bitrate = util_get_numeric_param(".", "record_bitrate", DEFAULT_RECORD_BITRATE);
+    sdlx_audio_params_t ap = { params.record_scale, params.record_silence, params.record_bitrate };
     sdlx_audio_set_params(&ap);
 
+    // select the sensor trace playback backend, prior to sdlx_init
+    if (sensor_playback_path != NULL) {
+        if (sdlx_sensor_playback_init(sensor_playback_path, sensor_playback_speed) != 0) {
+            return -1;
+        }
+    }
+
+    // when benchmarking: run headless, and don't start the
+    // devel mode server, services, or foreground mode
+    if (bench.app_name != NULL) {
+        if (sdlx_bench_init(&bench) != 0) {
+            return -1;
+        }
+        if (sdlx_init(SUBSYS_VIDEO | SUBSYS_AUDIO | SUBSYS_SENSOR) != 0) {
+            return -1;
+        }
+        return trace_start();
+    }
+
 #ifdef ANDROID
     // copy asset files to the working directory
     sdlx_copy_asset_file("files.tar", ".");
@@ -273,6 +423,11 @@ static int init(void)
     }
 #endif
 
+    // start event trace record or replay, if requested
+    if (trace_start() != 0) {
+        return -1;
+    }
+
     // init services, this will xxx
     svcs_init();
 
@@ -297,11 +452,54 @@ static void cleanup(void)
 
     svcs_stop_all();
 
+    sdlx_trace_stop();
+
+    // write the params sets that haven't been written yet
+    util_flush_params();
+
     // xxx free svc_call allocations ?
 
     sdlx_quit(SUBSYS_VIDEO | SUBSYS_AUDIO | SUBSYS_SENSOR);
 }
 
+static int bench_app(void)
+{
+    int rc;
+
+    sdlx_print_init(DEFAULT_FONT, COLOR_WHITE, COLOR_BLACK);
+    sdlx_bench_app_start();
+    rc = run(bench.app_name, false);
+    sdlx_bench_report(rc);
+
+    return rc == 0 ? 0 : 1;
+}
+
+// transcodes a mono raw recording to mp3, and prints the wall clock time as json
+static int transcode(char *raw_path, char *mp3_path)
+{
+    long start_us, wall_us, size;
+    int  rc;
+
+    size = util_file_size(NULL, raw_path);
+    if (size <= 0) {
+        fprintf(stderr, "ERROR: '%s' is empty or does not exist\n", raw_path);
+        return -1;
+    }
+
+    start_us = util_microsec_timer();
+    rc = util_mp3_transcode(NULL, raw_path, mp3_path, SDLX_CAPTURE_SAMPLE_RATE, 1, mp3_bitrate, mp3_threads);
+    wall_us = util_microsec_timer() - start_us;
+    if (rc != 0) {
+        return -1;
+    }
+
+    printf("{\"file\":\"%s\", \"audio_secs\":%.1f, \"threads\":%d, \"wall_secs\":%.2f, \"realtime_factor\":%.1f}\n",
+           raw_path, size / 2. / SDLX_CAPTURE_SAMPLE_RATE,
+           (mp3_threads > 0 ? mp3_threads : (int)sysconf(_SC_NPROCESSORS_ONLN)),
+           wall_us / 1e6, size / 2. / SDLX_CAPTURE_SAMPLE_RATE / (wall_us / 1e6));
+    return 0;
+}
+
 #ifdef ANDROID
 static void create_files(int action)
 {
@@ -683,7 +881,7 @@ static void settings(void)
     #define RECORDING 1
     #define PLAYBACK  2
 
-    #define RECORD_TEST_FILENAME "record_test.raw"
+    #define RECORD_TEST_FILENAME "record_test.mp3"
 
     #define EVID_COPYRIGHT            1001
     #define EVID_DEVEL_MODE           1002
@@ -693,6 +891,7 @@ static void settings(void)
     #define EVID_RECORD_SCALE         1006
     #define EVID_RECORD_SILENCE       1007
     #define EVID_RECORD_TEST          1008
+    #define EVID_RECORD_BITRATE       1009
 #ifdef ANDROID
     #define EVID_RESET_APPS_AND_SVCS  1020
     #define EVID_FOREGROUND           1021
@@ -792,6 +991,13 @@ static void settings(void)
             sdlx_register_event(loc, EVID_RECORD_SILENCE);
         }
 
+        // display Record_Bitrate
+        if (GET_Y) {
+            sdlx_audio_get_params(&ap);
+            loc = sdlx_render_printf(0, y, "Record_Bitrate = %d", ap.record_bitrate);
+            sdlx_register_event(loc, EVID_RECORD_BITRATE);
+        }
+
         // display Record_Test
         if (GET_Y) {
             sdlx_audio_state(&as);
@@ -923,6 +1129,16 @@ static void settings(void)
                 sdlx_audio_set_params(&ap);
             }
             break; }
+        case EVID_RECORD_BITRATE: {
+            double number = get_number("Record_Bitrate", 32, 320);
+            if (number != INVALID_NUMBER) {
+                params.record_bitrate = number;
+                util_set_numeric_param(".", "record_bitrate", number);
+                sdlx_audio_get_params(&ap);
+                ap.record_bitrate = number;
+                sdlx_audio_set_params(&ap);
+            }
+            break; }
         case EVID_RECORD_TEST: {
             sdlx_audio_record(".", RECORD_TEST_FILENAME, 5, 2, false);
             record_test_state = RECORDING;
@@ -996,13 +1212,20 @@ static void copyright(void)
     int         len;
     sdlx_event_t event;
     bool        done = false;
+    sdlx_text_view_t *tv;
 
-    // read the copyright file
+    // read the copyright file, and create a text view for it
     str = util_read_file(".", "copyright", &len);
     if (str == NULL) {
         ERROR("failed to read copyright file\n");
         return;
     }
+    tv = sdlx_text_view_create(&str, 1);
+    free(str);
+    if (tv == NULL) {
+        ERROR("failed to create text view\n");
+        return;
+    }
 
     // init vars
     y_display_begin = 100;
@@ -1015,8 +1238,7 @@ static void copyright(void)
         sdlx_display_init(BG_COLOR);
         sdlx_print_init(SMALLEST_FONT, COLOR_WHITE, BG_COLOR);
         sdlx_register_event(NULL, EVID_MOTION);
-        char *lines[1] = { str };
-        sdlx_render_multiline_text(y_top, y_display_begin, y_display_end, lines, 1);
+        sdlx_text_view_render(tv, y_top, y_display_begin, y_display_end);
         sdlx_register_control_events(NULL, NULL, "X", COLOR_WHITE, BG_COLOR, 0, 0, EVID_QUIT);
         sdlx_display_present();
 
@@ -1038,8 +1260,8 @@ static void copyright(void)
         }
     }
 
-    // free allocated copyrght buffer
-    free(str);
+    // destroy the text view
+    sdlx_text_view_destroy(tv);
 }
 
 // ----------------- DEVEL MODE SERVER  ----------------
@@ -1223,6 +1445,8 @@ static int process_req_thread(void *cx)
         // the following cmdline are handled by this code;
         // - put        : create/update file on android device, arg=file_path
         // - get        : get file contents, arg=file_path
+        // - sensor_record : record the sensors to a trace file, arg=file_path,
+        //                   or arg=stop; the trace is then fetched with get
         // otherwise the cmdline is passed to popen for the 
         // android shell to process
         //
@@ -1274,35 +1498,65 @@ static int process_req_thread(void *cx)
             // free allocated data
             free(data);
         } else if (strncmp(str, "get ", 4) == 0) {
-            char  src_path[200];
-            char *data;
-            int   data_len, rc;
+            char        src_path[200];
+            char        buff[65536];
+            struct stat statbuf;
+            int         fd, data_len, len, rc;
+            long        offset;
 
             // save src_path
             strcpy(src_path, str+4);
 
-            // read android file
-            data = util_read_file(src_path, NULL, &data_len);
-            if (data == NULL) {
-                // failed to read file
+            // open android file, it is read into buff and written to the socket
+            // a piece at a time; it is read rather than mapped so that if the
+            // file is truncated while being sent the read is short, rather
+            // than the access to the mapping faulting
+            fd = open(src_path, O_RDONLY);
+            if (fd < 0 || fstat(fd, &statbuf) != 0) {
+                // failed to open file
                 status = (errno != 0 ? -errno : -EINVAL);
                 put_fmt(sockfp, "data_len %d\n", 0);
+                if (fd >= 0) {
+                    close(fd);
+                }
             } else {
                 // write data_len to socket
+                data_len = statbuf.st_size;
                 put_fmt(sockfp, "data_len %d\n", data_len);
 
-                // write data to socket
-                rc = fwrite(data, 1, data_len, sockfp);  // size=1, nmemb=data_len
-                if (rc != data_len) {
-                    ERROR("failed to write data to socket\n");
-                    free(data);
-                    goto disconnect;
+                // write data to socket; if the file is now shorter than
+                // data_len then disconnect, because data_len has been sent
+                for (offset = 0; offset < data_len; offset += len) {
+                    len = data_len - offset < sizeof(buff) ? data_len - offset : sizeof(buff);
+                    len = pread(fd, buff, len, offset);
+                    if (len <= 0) {
+                        ERROR("failed to read %s, %s\n", src_path, len < 0 ? strerror(errno) : "eof");
+                        close(fd);
+                        goto disconnect;
+                    }
+                    rc = fwrite(buff, 1, len, sockfp);  // size=1, nmemb=len
+                    if (rc != len) {
+                        ERROR("failed to write data to socket\n");
+                        close(fd);
+                        goto disconnect;
+                    }
                 }
 
-                // free data, and set success status
-                free(data);
+                // close file, and set success status
+                close(fd);
                 status = 0;
             }
+        } else if (strncmp(str, "sensor_record ", 14) == 0) {
+            char *arg = str+14;
+
+            // start or stop recording the sensors
+            if (strcmp(arg, "stop") == 0) {
+                sdlx_sensor_record_stop();
+                status = 0;
+            } else {
+                errno = 0;
+                status = (sdlx_sensor_record_start(arg) == 0 ? 0 : errno != 0 ? -errno : -EINVAL);
+            }
         } else {
             FILE *fp;
             int rc;
@@ -65,6 +65,8 @@ typedef struct {
 
 typedef struct sdlx_texture sdlx_texture_t;
 
+typedef struct sdlx_text_view sdlx_text_view_t;
+
 typedef struct {
     int ptsize;
     int char_width;
@@ -113,6 +115,12 @@ sdlx_loc_t *sdlx_render_text_xyctr(int x, int y, char *str);
 sdlx_loc_t *sdlx_render_printf_xyctr(int x, int y, char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
 void sdlx_render_multiline_text(int y_top, int y_display_begin, int y_display_end, char **lines, int n);
 
+// render text view, for scrolling large multiline text
+sdlx_text_view_t *sdlx_text_view_create(char **lines, int n);
+int sdlx_text_view_num_lines(sdlx_text_view_t *tv);
+void sdlx_text_view_render(sdlx_text_view_t *tv, int y_top, int y_display_begin, int y_display_end);
+void sdlx_text_view_destroy(sdlx_text_view_t *tv);
+
 // render rectangle, lines, circles, points
 void sdlx_render_rect(int x, int y, int w, int h, int line_width, int color);
 void sdlx_render_fill_rect(int x, int y, int w, int h, int color);
@@ -124,6 +132,8 @@ void sdlx_render_points(sdlx_point_t *points, int count, int color, int point_si
 
 // render using textures
 sdlx_texture_t *sdlx_create_texture_from_pixels(unsigned char *pixels, int w, int h);  // xxx color  xxx pixel_t ?
+sdlx_texture_t *sdlx_create_texture_from_png_file(char *dir, char *filename);
+sdlx_texture_t *sdlx_create_texture_from_png_file_rows(char *dir, char *filename);
 sdlx_texture_t *sdlx_create_filled_circle_texture(int radius, int color);  // xxx color
 sdlx_texture_t *sdlx_create_text_texture(char *str);  // xxx color
 sdlx_loc_t *sdlx_render_texture(int x, int y, int w, int h, sdlx_texture_t *texture);
@@ -156,6 +166,7 @@ void sdlx_show_toast(char *message);
 #define AUDIO_REQ_STOP     1
 #define AUDIO_REQ_PAUSE    2
 #define AUDIO_REQ_UNPAUSE  3
+#define AUDIO_REQ_SEEK     4   // use sdlx_audio_seek
 
 #define AUDIO_STATE_IDLE           0
 #define AUDIO_STATE_PLAY_FILE      1
@@ -178,13 +189,14 @@ typedef struct {
 } sdlx_audio_state_t;
 
 int sdlx_audio_play(char *dir, char *filename);
-int sdlx_audio_record(char *dir, char *filename, int max_duration_secs, int auto_stop_secs, bool append);
+int sdlx_audio_record(char *dir, char *filename, int max_duration_secs, int auto_stop_secs, bool append);  // .mp3 is encoded, NULL filename only monitors
 int sdlx_audio_play_tones(sdlx_tone_t *tones);
 int sdlx_audio_file_duration(char *dir, char *filename);
 
 int sdlx_audio_play_new(char *dir, char *filename);
 
 void sdlx_audio_ctl(int req);
+void sdlx_audio_seek(int ms);
 void sdlx_audio_state(sdlx_audio_state_t * state);
 
 void sdlx_audio_print_devices_info(void);
@@ -193,6 +205,31 @@ void sdlx_audio_create_test_file(char *dir, char *filename, int duration_secs, i
 void sdlx_start_playbackcapture(char *dir, char *filename);
 void sdlx_stop_playbackcapture(void);
 
+// sounds are played by mixer voices, which play concurrently with each other
+// and with the above; pan is -1 (left) to +1 (right), gain is 0 to 2
+#define SDLX_MIXER_MAX_VOICES 32
+typedef struct sdlx_sound sdlx_sound_t;
+sdlx_sound_t *sdlx_sound_load(char *dir, char *filename);  // .raw or .mp3
+sdlx_sound_t *sdlx_sound_create_tones(sdlx_tone_t *tones);
+void sdlx_sound_free(sdlx_sound_t *snd);  // deferred while voices are playing it
+int sdlx_sound_duration_ms(sdlx_sound_t *snd);
+int sdlx_voice_play(sdlx_sound_t *snd, double gain, double pan, bool loop);  // returns voice id
+void sdlx_voice_stop(int voice);
+void sdlx_voice_set(int voice, double gain, double pan);
+bool sdlx_voice_active(int voice);
+
+// spectrogram of the audio being recorded, in dB relative to a full scale sine;
+// sdlx_spectrogram_read returns the columns after *seq, oldest first, at most
+// max_cols of num_bins each; peak_hz returns 0 when there is no column yet
+#define SDLX_CAPTURE_SAMPLE_RATE 48000
+typedef struct sdlx_spectrogram sdlx_spectrogram_t;
+sdlx_spectrogram_t *sdlx_spectrogram_create(int fft_size, int hop, int history);
+void sdlx_spectrogram_destroy(sdlx_spectrogram_t *sg);
+int sdlx_spectrogram_num_bins(sdlx_spectrogram_t *sg);
+double sdlx_spectrogram_bin_hz(sdlx_spectrogram_t *sg);
+int sdlx_spectrogram_read(sdlx_spectrogram_t *sg, long *seq, double *db, int max_cols);
+double sdlx_spectrogram_peak_hz(sdlx_spectrogram_t *sg, double min_hz, double max_hz, double *peak_db);
+
 // not available in picoc
 #ifdef ANDROID
     #define DEFAULT_RECORD_SCALE 5
@@ -200,9 +237,11 @@ void sdlx_stop_playbackcapture(void);
     #define DEFAULT_RECORD_SCALE 1
 #endif
 #define DEFAULT_RECORD_SILENCE 10
+#define DEFAULT_RECORD_BITRATE 64   // kbps, used when recording to an mp3 file
 typedef struct {
     double record_scale;
     double record_silence;
+    int    record_bitrate;
 } sdlx_audio_params_t;
 void sdlx_audio_set_params(sdlx_audio_params_t *ap);
 void sdlx_audio_get_params(sdlx_audio_params_t *ap);
@@ -266,6 +305,45 @@ int sdlx_sensor_read_pressure(double *millibars);
 int sdlx_sensor_read_temperature(double *degrees_c);
 int sdlx_sensor_read_humidity(double *percent);
 
+// sensor streams: each open sensor keeps its last SDLX_SENSOR_STREAM_LEN samples,
+// as delivered by the sensor, in a ring; the sensor is opened by the first read
+// - sdlx_sensor_stream_read returns the samples after *cursor (start with 0),
+//   oldest first, up to max_samples, and advances *cursor past them; samples
+//   that dropped out of the ring before being read are skipped, and a *cursor
+//   beyond the newest sample is set to it
+// - timestamp_us is the sensor's timestamp of each sample; values are returned
+//   num_values per sample, num_values <= SDLX_SENSOR_MAX_VALUES
+// - sdlx_sensor_set_rate limits the samples kept to rate_hz, 0 keeps all
+#define SDLX_SENSOR_STREAM_LEN 1024
+#define SDLX_SENSOR_MAX_VALUES 6
+int sdlx_sensor_set_rate(int id, double rate_hz);
+int sdlx_sensor_stream_read(int id, long *cursor, long *timestamp_us, double *values,
+                            int num_values, int max_samples);  // returns num samples
+
+// sensor fusion: a thread fuses the accelerometer, gyroscope and magnetometer
+// streams into the device orientation; start and stop calls are counted
+// - q rotates device vectors to the earth frame: x magnetic north, y west, z up
+// - roll and pitch are as sdlx_sensor_read_roll_pitch, in degrees
+// - heading is the direction the top of the device points, degrees clockwise
+//   from magnetic north; up is the up direction as a unit vector in device axes
+typedef struct {
+    long   timestamp_us;
+    double q[4];
+    double roll;
+    double pitch;
+    double heading;
+    double up[3];
+} sdlx_orientation_t;
+int sdlx_sensor_fusion_start(void);  // requires an accelerometer
+void sdlx_sensor_fusion_stop(void);
+int sdlx_sensor_get_orientation(sdlx_orientation_t *o);  // returns -1 until available
+
+// sensor recording: the samples of the open sensors are written to a trace file,
+// which can be played back on Linux by the ezapp -S option; recording opens the
+// accelerometer, gyroscope, magnetometer and environment sensors
+int sdlx_sensor_record_start(char *path);
+void sdlx_sensor_record_stop(void);
+
 // --------------------
 // events   
 // --------------------
@@ -303,21 +381,133 @@ char *sdlx_get_input_str(char *prompt1, char *prompt2, bool numeric_keybd, int b
 // --------------------
 
 // sdlx_video.c
+typedef struct {
+    long frames;
+    long draw_calls;
+} sdlx_video_stats_t;
 int sdlx_video_init(void);
 void sdlx_video_quit(void);
 void sdlx_minimize_window(void);
+void sdlx_video_get_stats(sdlx_video_stats_t *stats);
 
 // sdlx_audio.c
 int sdlx_audio_init(void);
 void sdlx_audio_quit(void);
 
 // sdlx_sensor.c
+// - a backend's init fills tbl and returns the number of entries, its read
+//   returns the current values of an open sensor; the samples of the open
+//   sensors are passed to sdlx_sensor_stream_put, from any one thread
+typedef struct {
+    char *name;
+    int (*init)(sdlx_sensor_info_t *tbl, int max_tbl);
+    void (*quit)(void);
+    int (*open)(int id);
+    int (*read)(int id, double *data, int num_values);
+} sdlx_sensor_backend_t;
 int sdlx_sensor_init(void);
 void sdlx_sensor_quit(void);
+void sdlx_sensor_set_backend(sdlx_sensor_backend_t *b);  // NULL for the SDL backend
+void sdlx_sensor_stream_put(int id, long timestamp_us, double *values, int num_values);
+
+// sdlx_sensor_playback.c
+int sdlx_sensor_playback_init(char *path, double speed);  // call prior to sdlx_init
 
 // sdlx_event.c
 void sdlx_reset_events(void);
 
+// sdlx_bench.c
+typedef struct {
+    char *app_name;
+    int   max_frames;
+    int   max_secs;
+    char *script_path;  // scripted input, NULL if none
+    char *report_path;  // NULL for stdout
+} sdlx_bench_params_t;
+int sdlx_bench_init(sdlx_bench_params_t *bp);  // must be called prior to sdlx_init
+bool sdlx_bench_enabled(void);
+void sdlx_bench_app_start(void);
+void sdlx_bench_frame(void);
+void sdlx_bench_report(int app_rc);
+
+// sdlx_trace.c
+#define TRACE_SENSOR_STEP_COUNTER  2
+#define TRACE_SENSOR_MAG_HEADING   3
+#define TRACE_SENSOR_ACCELEROMETER 4
+#define TRACE_SENSOR_ROLL_PITCH    5
+#define TRACE_SENSOR_PRESSURE      6
+#define TRACE_SENSOR_TEMPERATURE   7
+#define TRACE_SENSOR_HUMIDITY      8
+#define TRACE_SENSOR_RAW(id)       (256 + (id))
+int sdlx_trace_record_start(char *path);
+int sdlx_trace_replay_start(char *path, bool fast);
+void sdlx_trace_stop(void);
+bool sdlx_trace_replaying(void);
+void sdlx_trace_record_event(sdlx_event_t *event);
+void sdlx_trace_replay_event(long timeout_us, sdlx_event_t *event);
+void sdlx_trace_record_sensor(int fn, int rc, double *values, int n);
+bool sdlx_trace_replay_sensor(int fn, double *values, int n, int *rc);
+
+// sdlx_mp3.c
+#define SDLX_MP3_MAX_DECODE_SAMPLES (4 * 1152)
+typedef struct sdlx_mp3 sdlx_mp3_t;
+sdlx_mp3_t *sdlx_mp3_open(char *path);
+void sdlx_mp3_close(sdlx_mp3_t *mp3);
+void sdlx_mp3_get_info(sdlx_mp3_t *mp3, int *sample_rate, int *channels, long *total_samples);
+int sdlx_mp3_get_bitrate(sdlx_mp3_t *mp3);  // kbps, of the first frame
+long sdlx_mp3_duration_ms(char *path);
+int sdlx_mp3_decode(sdlx_mp3_t *mp3, short *pcm);  // pcm must hold SDLX_MP3_MAX_DECODE_SAMPLES * channels
+long sdlx_mp3_seek(sdlx_mp3_t *mp3, long ms);
+long sdlx_mp3_tell(sdlx_mp3_t *mp3);
+
+// sdlx_mixer.c
+typedef struct {
+    bool paused;
+    int  pos_ms;
+    int  total_ms;
+    int  rms;
+} sdlx_voice_info_t;
+sdlx_sound_t *sdlx_sound_open_stream(char *path);  // mp3, decoded while played by one voice
+void sdlx_voice_pause(int voice, bool pause);
+void sdlx_voice_seek(int voice, int ms);
+bool sdlx_voice_get_info(int voice, sdlx_voice_info_t *info);
+void sdlx_mixer_sync(void);
+void sdlx_mixer_quit(void);
+
+// sdlx_spectrogram.c
+void sdlx_spectrogram_feed(short *samples, int n);
+
+// sdlx_fusion.c
+typedef struct sdlx_fusion sdlx_fusion_t;
+sdlx_fusion_t *sdlx_fusion_create(double beta);  // beta 0 for the default
+void sdlx_fusion_destroy(sdlx_fusion_t *f);
+bool sdlx_fusion_sample(sdlx_fusion_t *f, int type, long timestamp_us, double *values);
+int sdlx_fusion_get(sdlx_fusion_t *f, sdlx_orientation_t *o);
+int sdlx_fusion_test(char *path);
+
+// sdlx_dsp.c
+#define SDLX_DSP_MAX_MIX 8
+#define SDLX_DSP_LOWPASS   0
+#define SDLX_DSP_HIGHPASS  1
+#define SDLX_DSP_BANDPASS  2
+#define SDLX_DSP_NOTCH     3
+typedef struct sdlx_dsp_resampler sdlx_dsp_resampler_t;
+typedef struct {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+} sdlx_dsp_biquad_t;
+char *sdlx_dsp_kernels_name(void);
+void sdlx_dsp_gain(short *dst, short *src, int n, double gain);  // saturating
+void sdlx_dsp_meter(short *src, int n, double *rms, int *peak);
+void sdlx_dsp_mix(short *dst, short **src, double *gain, int nsrc, int n);
+sdlx_dsp_resampler_t *sdlx_dsp_resampler_create(int in_rate, int out_rate);
+void sdlx_dsp_resampler_destroy(sdlx_dsp_resampler_t *rs);
+int sdlx_dsp_resample(sdlx_dsp_resampler_t *rs, short *in, int n_in, short *out);
+int sdlx_dsp_resample_max_out(sdlx_dsp_resampler_t *rs, int n_in);
+void sdlx_dsp_biquad_init(sdlx_dsp_biquad_t *bq, int type, double freq, double q, int sample_rate);
+void sdlx_dsp_biquad(sdlx_dsp_biquad_t *bq, short *dst, short *src, int n);
+int sdlx_dsp_test(void);
+
 // sdlx_misc.c
 char *sdlx_get_storage_path(void);
 void sdlx_copy_asset_file(char *asset_filename, char *dest_dir);
@@ -7,20 +7,21 @@
 #include <SDL3/SDL.h>
 #include <SDL3_mixer/SDL_mixer.h>
 
+#include <lame/lame.h>
+
 //
 // defines
 //
 
 #define TEN_MS 10000
 
-#define FRAMES_PER_SEC 48000
+#define FRAMES_PER_SEC SDLX_CAPTURE_SAMPLE_RATE
 #define FRAMES_PER_MS  (FRAMES_PER_SEC/1000)
 
 #define BYTES_TO_SECS(b) ceil((double)(b) / 2 / FRAMES_PER_SEC)
 #define BYTES_TO_MS(b)   ceil((double)(b) / 2 / FRAMES_PER_MS)
 
-#define RECORD   true
-#define PLAYBACK false
+#define VOLUME_SCALE    (300. / 32768.)
 
 //
 // typedefs
@@ -30,22 +31,29 @@
 // variables
 //
 
-static SDL_AudioStream  *playback_stream;
 static SDL_AudioStream  *record_stream;
 static int               ctl_req;
-static sdlx_audio_state_t state;
+static sdlx_audio_state_t state;   // record
+
+// the file or tones being played, by a mixer voice
+static struct {
+    int  state;
+    int  voice;
+    char filename[100];
+} session;
+static pthread_mutex_t   session_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 //
 // prototypes
 //
 
-static int audio_open(bool record);
+static int record_open(void);
 static int calc_volume(void *buff, int bytes);
 
-static int play_file_thread(void *cx);
-static void play_buff(char *buff, int buff_len, bool *stop_req, int *queued_bytes);
+static int play_sound(sdlx_sound_t *snd, int session_state, char *filename);
 static int record_thread(void *cx);
-static int tones_thread(void *cx);
+static lame_global_flags *mp3_lame_init(int in_sample_rate, int out_sample_rate, int bitrate_kbps);
+static int mp3_enc_thread(void *cx);
 
 // -----------------INIT / EXIT  -------------------------------
 
@@ -75,13 +83,14 @@ void sdlx_audio_quit(void)
 {
     INFO("quitting\n");
 
-    // quit SDL audio
+    // stop the mixer, and quit SDL audio
+    sdlx_mixer_quit();
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
 }
 
-// -----------------  OPEN AUDIO FOR PLAYBACK OR RECORD --------------------
+// -----------------  OPEN AUDIO FOR RECORD  -------------
 
-static int audio_open(bool record)
+static int record_open(void)
 {
     const SDL_AudioSpec spec = { SDL_AUDIO_S16, 1, FRAMES_PER_SEC };
 
@@ -89,41 +98,23 @@ static int audio_open(bool record)
     // it will be stopped
     sdlx_audio_ctl(AUDIO_REQ_STOP);
 
-    // open playback audio stream
-    if (!record) {
-        if (playback_stream != NULL) {
-            return 0;
-        }
-        playback_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
-        if (playback_stream == NULL) {
-            ERROR("SDL_OpenAudioDeviceStream failed for playback\n");
-            return -1;
-        }
-        INFO("opened playback stream\n");
+    // open record audio stream
+    if (record_stream != NULL) {
         return 0;
     }
+    record_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_RECORDING, &spec, NULL, NULL);
+    if (record_stream == NULL) {
+        ERROR("SDL_OpenAudioDeviceStream failed for record\n");
+        return -1;
+    }
 
-    // open record audio stream
-    if (record) {
-        if (record_stream != NULL) {
-            return 0;
-        }
-        record_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_RECORDING, &spec, NULL, NULL);
-        if (record_stream == NULL) {
-            ERROR("SDL_OpenAudioDeviceStream failed for record\n");
-            return -1;
-        }
-
-        //bool succ = SDL_SetAudioDeviceGain(SDL_AUDIO_DEVICE_DEFAULT_RECORDING, 100);
-        //INFO("XXXXXXXXXXXXXXXXXXXXXX SET RECORD DEVICE GAIN %d\n", succ);
-
-        //bool succ = SDL_SetAudioStreamGain(record_stream, 1);
-        //INFO("XXXXXXXXXXXXXXXXXXXXXX SET RECORD GAIN %d\n", succ);
+    //bool succ = SDL_SetAudioDeviceGain(SDL_AUDIO_DEVICE_DEFAULT_RECORDING, 100);
+    //INFO("XXXXXXXXXXXXXXXXXXXXXX SET RECORD DEVICE GAIN %d\n", succ);
 
-        INFO("opened recording stream\n");
-        return 0;
-    }
+    //bool succ = SDL_SetAudioStreamGain(record_stream, 1);
+    //INFO("XXXXXXXXXXXXXXXXXXXXXX SET RECORD GAIN %d\n", succ);
 
+    INFO("opened recording stream\n");
     return 0;
 }
 
@@ -181,18 +172,12 @@ void sdlx_audio_create_test_file(char *dir, char *filename, int duration_secs, i
 // xxx put in another section
 static int calc_volume(void *buff, int bytes)
 {
-    short *samples = (short*)buff;
-    int    n = bytes/2;
-    long   sum_squares = 0;
-    int    volume;
-
-    #define VOLUME_SCALE    (300. / 32768.)
+    double rms;
+    int    peak, volume;
 
     // calculate volume using RMS value of samples 
-    for (int i = 0; i < n; i++) {
-        sum_squares += samples[i] * samples[i];
-    }
-    volume = sqrt(sum_squares / n) * VOLUME_SCALE;
+    sdlx_dsp_meter(buff, bytes/2, &rms, &peak);
+    volume = rms * VOLUME_SCALE;
 
     // limit volume to max value 100
     if (volume > 100) volume = 100;
@@ -206,27 +191,71 @@ static int calc_volume(void *buff, int bytes)
 
 // -----------------  CONTROL AND GET STATE  --------------
 
+// a recording is controlled through ctl_req, which record_thread polls;
+// the file or tones being played are controlled through their mixer voice
 void sdlx_audio_ctl(int req)
 {
-    if (state.state == AUDIO_STATE_IDLE) {
+    if (state.state == AUDIO_STATE_RECORD || state.state == AUDIO_STATE_RECORD_APPEND) {
+        ctl_req = req;
+        while (ctl_req != 0 && state.state != AUDIO_STATE_IDLE) {
+            usleep(TEN_MS);
+        }
         ctl_req = 0;
         return;
     }
 
-    ctl_req = req;
+    pthread_mutex_lock(&session_mutex);
+    if (session.state != AUDIO_STATE_IDLE) {
+        if (req == AUDIO_REQ_STOP) {
+            sdlx_voice_stop(session.voice);
+            memset(&session, 0, sizeof(session));
+        } else if (req == AUDIO_REQ_PAUSE || req == AUDIO_REQ_UNPAUSE) {
+            sdlx_voice_pause(session.voice, req == AUDIO_REQ_PAUSE);
+        }
+        sdlx_mixer_sync();
+    }
+    pthread_mutex_unlock(&session_mutex);
+}
 
-    while (ctl_req != 0) {
-        usleep(TEN_MS);
+void sdlx_audio_seek(int ms)
+{
+    pthread_mutex_lock(&session_mutex);
+    if (session.state == AUDIO_STATE_PLAY_FILE) {
+        sdlx_voice_seek(session.voice, ms);
+        sdlx_mixer_sync();
     }
+    pthread_mutex_unlock(&session_mutex);
 }
 
 void sdlx_audio_state(sdlx_audio_state_t *x)
 {
-    *x = state;
+    sdlx_voice_info_t info;
+
+    if (state.state != AUDIO_STATE_IDLE) {
+        *x = state;
+        return;
+    }
+
+    memset(x, 0, sizeof(sdlx_audio_state_t));
+
+    pthread_mutex_lock(&session_mutex);
+    if (session.state != AUDIO_STATE_IDLE) {
+        if (sdlx_voice_get_info(session.voice, &info)) {
+            x->state        = session.state;
+            x->paused       = info.paused;
+            x->processed_ms = info.pos_ms;
+            x->total_ms     = info.total_ms;
+            x->volume       = (info.rms * VOLUME_SCALE > 100 ? 100 : info.rms * VOLUME_SCALE);
+            strcpy(x->filename, session.filename);
+        } else {
+            memset(&session, 0, sizeof(session));
+        }
+    }
+    pthread_mutex_unlock(&session_mutex);
 }
 
 // xxx move this
-static sdlx_audio_params_t audio_params = { DEFAULT_RECORD_SCALE };
+static sdlx_audio_params_t audio_params = { DEFAULT_RECORD_SCALE, DEFAULT_RECORD_SILENCE, DEFAULT_RECORD_BITRATE };
 
 void sdlx_audio_set_params(sdlx_audio_params_t *ap)
 {
@@ -247,114 +276,64 @@ void sdlx_audio_get_params(sdlx_audio_params_t *ap)
 
 // -----------------  PLAY FILE ---------------------------
 
-typedef struct {
-    char *buff;
-    int   buff_len;
-} play_file_cx_t;
+static bool is_mp3_file(char *filename)
+{
+    int len = strlen(filename);
+
+    return len > 4 && strcasecmp(filename+len-4, ".mp3") == 0;
+}
 
+// raw files are mapped, and mp3 files are decoded as they are played
 int sdlx_audio_play(char *dir, char *filename)
 {
-    int rc, fd=-1;
-    void *buff=MAP_FAILED;
-    struct stat statbuf;
-    play_file_cx_t *cx=NULL;
-    char path[100];
+    sdlx_sound_t *snd;
+    char path[200];
 
-    // open audio for playback
-    rc = audio_open(PLAYBACK);
-    if (rc < 0) {
-        ERROR("failed to open audio for playback\n");
-        goto error;
-    }
+    // stop the current playback or record
+    sdlx_audio_ctl(AUDIO_REQ_STOP);
 
-    // obtain size of file, and map it
     sprintf(path, "%s/%s", dir, filename);
-    rc = stat(path, &statbuf);
-    if (rc < 0) {
-        ERROR("failed to stat '%s', %s\n", path, strerror(errno));
-        goto error;
-    }
-    fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        ERROR("failed to open '%s', %s\n", path, strerror(errno));
-        goto error;
-    }
-    buff = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
-    fd = -1;
-    if (buff == MAP_FAILED) {
-        ERROR("failed to map '%s', %s\n", path, strerror(errno));
-        goto error;
+    snd = (is_mp3_file(filename) ? sdlx_sound_open_stream(path) : sdlx_sound_load(dir, filename));
+    if (snd == NULL) {
+        ERROR("failed to open '%s'\n", path);
+        return -1;
     }
 
-    // init state
-    memset(&state, 0, sizeof(state));
-    state.state          = AUDIO_STATE_PLAY_FILE;
-    state.paused         = true;
-    state.total_ms      = BYTES_TO_MS(statbuf.st_size);
-    strcpy(state.filename, filename);
-
-    // create thread to monitor and process completion
-    cx = malloc(sizeof(play_file_cx_t));
-    cx->buff = buff;
-    cx->buff_len = statbuf.st_size;
-    sdlx_create_detached_thread(play_file_thread, cx);
-
-    // success
-    return 0;
-
-error:
-    // error cleanup and return
-    if (buff != MAP_FAILED) {
-        munmap(buff, statbuf.st_size);
-    }
-    if (fd >= 0) {
-        close(fd);
-    }
-    if (cx != NULL) {
-        free(cx);
-    }
-    memset(&state, 0, sizeof(state));
-    return -1;
+    return play_sound(snd, AUDIO_STATE_PLAY_FILE, filename);
 }
 
-static int play_file_thread(void *cx_arg)
+// plays the sound with a mixer voice, which holds the only reference to snd
+static int play_sound(sdlx_sound_t *snd, int session_state, char *filename)
 {
-    play_file_cx_t *cx = (play_file_cx_t*)cx_arg;
-    int queued_bytes = 0;
-    bool stop_req = false;
-
-    INFO("starting\n");
+    int voice;
 
-    // resume audio playback
-    SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(playback_stream));  // thread safe
-    state.paused = false;
-
-    // play the buffer
-    play_buff(cx->buff, cx->buff_len, &stop_req, &queued_bytes);  // thread safe
-    if (stop_req) {
-        goto done;
+    voice = sdlx_voice_play(snd, 1, 0, false);
+    sdlx_sound_free(snd);
+    if (voice < 0) {
+        ERROR("failed to play '%s'\n", filename);
+        return -1;
     }
 
-    // wait for all queued audio to be played
-    while (SDL_GetAudioStreamQueued(playback_stream) > 0) {
-        usleep(TEN_MS);
-    }
+    pthread_mutex_lock(&session_mutex);
+    session.state = session_state;
+    session.voice = voice;
+    strcpy(session.filename, filename);
+    pthread_mutex_unlock(&session_mutex);
 
-done:
-    // cleanup and return
-    INFO("completed\n");
-    SDL_PauseAudioDevice(SDL_GetAudioStreamDevice(playback_stream));
-    SDL_ClearAudioStream(playback_stream);
-    munmap(cx->buff, cx->buff_len);
-    free(cx);
-    memset(&state, 0, sizeof(state));
     return 0;
 }
 
 int sdlx_audio_file_duration(char *dir, char *filename)
 {
-    long size;
+    long size, ms;
+    char path[200];
+
+    // the duration of an mp3 file is determined from its headers
+    if (is_mp3_file(filename)) {
+        sprintf(path, "%s/%s", dir, filename);
+        ms = sdlx_mp3_duration_ms(path);
+        return (ms > 0 ? ceil(ms / 1000.) : 0);
+    }
 
     size = util_file_size(dir, filename);
     if (size < 0) {
@@ -364,110 +343,103 @@ int sdlx_audio_file_duration(char *dir, char *filename)
     return BYTES_TO_SECS(size);
 }
 
-static void play_buff(char *buff, int buff_len, bool *stop_req, int *queued_bytes)
-{
-    char  *buff_ptr = buff;
-    int    xfer_len, remaining;
-    bool   do_once;
-
-    *stop_req = false;
-
-    while (true) {
-        // queue 4096 samples of audio
-        remaining = buff_len - (buff_ptr - buff);
-        if (remaining == 0) {
-            break;
-        }
-        xfer_len = (remaining > 8192 ? 8192 : remaining);
-        SDL_PutAudioStreamData(playback_stream, buff_ptr, xfer_len);  // thread safe
-
-        // calculate volume for the samples just queued
-        state.volume = calc_volume(buff_ptr, xfer_len);
-
-        // while there is more than 200 ms queued OR do_once
-        // - process control requests
-        // - publish amount played
-        // - short sleep
-        // note SDL_GetAudioStreamQueued is thread safe
-        do_once = true;
-        while ((SDL_GetAudioStreamQueued(playback_stream) > FRAMES_PER_SEC / 5 * sizeof(short)) || (do_once)) {
-            // process control requests
-            if (ctl_req == AUDIO_REQ_STOP) {
-                *stop_req = true;
-                ctl_req = 0;
-                return;
-            } else if (ctl_req == AUDIO_REQ_PAUSE) {
-                SDL_PauseAudioDevice(SDL_GetAudioStreamDevice(playback_stream));  // thread safe
-                state.paused = true;
-                ctl_req = 0;
-            } else if (ctl_req == AUDIO_REQ_UNPAUSE) {
-                SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(playback_stream));  // thread safe
-                state.paused = false;
-                ctl_req = 0;
-            }
-
-            // publish duration played
-            state.processed_ms = BYTES_TO_MS(*queued_bytes);
-
-            // short sleep
-            usleep(TEN_MS);
+// -----------------  RECORD TO FILE ----------------------
 
-            // clear flag that ensures this code block is executed at leas once
-            do_once = false;
-        }
+// When the filename ends in .mp3 the recording is encoded as it is captured.
+// The record_thread passes the scaled sample buffers through a bounded queue to
+// the mp3_enc_thread, which runs the lame encoder and writes the mp3 frames; so
+// the capture is not stalled by the encoder. The Xing/Info header is not written,
+// which allows a later append to simply add frames to the end of the file; and
+// when appending, the bitrate and sample rate of the existing file are used.
 
-        // advance to next sub-buffer
-        buff_ptr += xfer_len;
-        *queued_bytes += xfer_len;
-    }
-}
+#define ENC_QUEUE_LEN      32     // blocks, about 2.7 secs
+#define ENC_BLOCK_SAMPLES  4096
+#define ENC_MP3BUF_SIZE    (ENC_BLOCK_SAMPLES * 5 / 4 + 7200)  // lame's worst case
 
-// -----------------  RECORD TO FILE ----------------------
+typedef struct {
+    lame_global_flags *gfp;
+    int                fd;
+    pthread_mutex_t    mutex;
+    pthread_cond_t     cond;
+    int                head;          // next block to encode
+    int                tail;          // next block to fill
+    bool               eof;
+    bool               done;
+    bool               error;
+    int                cnt[ENC_QUEUE_LEN];
+    short              block[ENC_QUEUE_LEN][ENC_BLOCK_SAMPLES];
+} mp3_enc_t;
 
 typedef struct {
-    int  fd;
-    int  max_secs;
-    int  auto_stop_secs;
-    int  existing_bytes;
+    int        fd;
+    int        max_secs;
+    int        auto_stop_secs;
+    int        existing_ms;
+    mp3_enc_t *enc;
 } record_cx_t;
 
+static mp3_enc_t *mp3_enc_create(int fd, char *path, bool append);
+static int mp3_enc_put(mp3_enc_t *enc, short *samples, int n);
+static int mp3_enc_finish(mp3_enc_t *enc);
+
 int sdlx_audio_record(char *dir, char *filename, int max_duration_secs, int auto_stop_secs, bool append)
 {
     int rc, fd=-1;
     record_cx_t *cx=NULL;
-    int existing_bytes;
+    mp3_enc_t *enc=NULL;
+    int existing_ms;
     struct stat statbuf;
     char path[100];
 
     // open audio to record
-    rc = audio_open(RECORD);
+    rc = record_open();
     if (rc < 0) {
         ERROR("failed to open audio for record\n");
         goto error;
     }
 
-    // if not appending then
+    // if filename is NULL then
+    //   the capture is only monitored, by the volume and spectrogram
+    // else if not appending then
     //   create new recording file
     // else
     //   open existing recording file, in append mode
-    //   determine the size of the existing file
+    //   determine the duration of the existing file
     // endif
-    sprintf(path, "%s/%s", dir, filename);
-    if (!append) {
+    if (filename == NULL) {
+        filename = "";
+        existing_ms = 0;
+    } else if (!append) {
+        sprintf(path, "%s/%s", dir, filename);
         fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
         if (fd < 0) {
             ERROR("failed to create '%s', %s\n", path, strerror(errno));
             goto error;
         }
-        existing_bytes = 0;
+        existing_ms = 0;
     } else {
+        sprintf(path, "%s/%s", dir, filename);
         fd = open(path, O_WRONLY|O_APPEND);
         if (fd < 0) {
             ERROR("failed to open for append '%s', %s\n", path, strerror(errno));
             goto error;
         }
-        fstat(fd, &statbuf);
-        existing_bytes = statbuf.st_size;
+        if (is_mp3_file(filename)) {
+            existing_ms = sdlx_mp3_duration_ms(path);
+            if (existing_ms < 0) existing_ms = 0;
+        } else {
+            fstat(fd, &statbuf);
+            existing_ms = BYTES_TO_MS(statbuf.st_size);
+        }
+    }
+
+    // if recording to an mp3 file then start the encoder
+    if (is_mp3_file(filename)) {
+        enc = mp3_enc_create(fd, path, append);
+        if (enc == NULL) {
+            ERROR("failed to create mp3 encoder for '%s'\n", path);
+            goto error;
+        }
     }
 
     // init state
@@ -481,7 +453,8 @@ int sdlx_audio_record(char *dir, char *filename, int max_duration_secs, int auto
     cx->fd              = fd;
     cx->max_secs        = max_duration_secs;
     cx->auto_stop_secs  = auto_stop_secs;
-    cx->existing_bytes  = existing_bytes;
+    cx->existing_ms     = existing_ms;
+    cx->enc             = enc;
     sdlx_create_detached_thread(record_thread, cx);
 
     // success
@@ -499,10 +472,30 @@ error:
     return -1;
 }
 
+// writes the samples to either the raw file or the mp3 encoder queue
+static int record_write(record_cx_t *cx, short *samples, int n)
+{
+    int rc;
+
+    if (cx->fd < 0) {
+        return 0;
+    }
+    if (cx->enc != NULL) {
+        return mp3_enc_put(cx->enc, samples, n);
+    }
+
+    rc = write(cx->fd, samples, 2*n);
+    if (rc != 2*n) {
+        ERROR("write failed, rc=%d, %s\n", rc, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 static int record_thread(void *cx_arg)
 {
     record_cx_t *cx = (record_cx_t*)cx_arg;
-    short        buff[4096];
+    short        buff[ENC_BLOCK_SAMPLES];
     int          rc, bytes, silence_bytes = 0;
     int          processed_bytes = 0;
 
@@ -526,21 +519,21 @@ static int record_thread(void *cx_arg)
             continue;
         }
 
-        // scale record data
-        for (int i = 0; i < bytes/2; i++) {
-            buff[i] = buff[i] * audio_params.record_scale;
-        }
+        // scale record data, saturating rather than wrapping when loud
+        sdlx_dsp_gain(buff, buff, bytes/2, audio_params.record_scale);
 
-        // write the data to the file
-        rc = write(cx->fd, buff, bytes);
-        if (rc != bytes) {
-            ERROR("write failed, rc=%d, %s\n", rc, strerror(errno));
+        // pass the data to the attached spectrograms
+        sdlx_spectrogram_feed(buff, bytes/2);
+
+        // write the data to the file, or to the mp3 encoder
+        rc = record_write(cx, buff, bytes/2);
+        if (rc < 0) {
             break;
         }
 
         // keep track of how long the recording has been in progress
         processed_bytes += bytes;
-        state.processed_ms = BYTES_TO_MS(processed_bytes + cx->existing_bytes);
+        state.processed_ms = BYTES_TO_MS(processed_bytes) + cx->existing_ms;
         state.total_ms     = state.processed_ms;
 
         // calculate volume of the samples just obtained
@@ -599,206 +592,232 @@ static int record_thread(void *cx_arg)
             tone[j] = AMPLITUDE * sin((2*M_PI) * ((double)j / N_ONE_SIN_WAV));
         }
     }
-    write(cx->fd, tone, 2 * N_TOTAL);
+    for (int j = 0; j < N_TOTAL; j += ENC_BLOCK_SAMPLES) {
+        int n = (N_TOTAL-j < ENC_BLOCK_SAMPLES ? N_TOTAL-j : ENC_BLOCK_SAMPLES);
+        if (record_write(cx, tone+j, n) < 0) {
+            break;
+        }
+    }
+
+    // if encoding to mp3 then wait for the encoder to complete
+    if (cx->enc != NULL) {
+        mp3_enc_finish(cx->enc);
+    }
 
     // cleanup and return
     INFO("completed\n");
-    close(cx->fd);
+    if (cx->fd >= 0) {
+        close(cx->fd);
+    }
     free(cx);
     memset(&state, 0, sizeof(state));
     return 0;
 }
 
-// -----------------  PLAY TONES  -------------------------
+// - - - - - - - - -  MP3 ENCODER  - - - - - - - - - - - - 
 
-typedef struct {
-    int n;
-    short data[0];
-} sine_wave_t;
-
-typedef struct {
-    int num_tones;
-    sdlx_tone_t tones[0];
-} play_tones_cx_t;
+static mp3_enc_t *mp3_enc_create(int fd, char *path, bool append)
+{
+    mp3_enc_t  *enc;
+    sdlx_mp3_t *mp3;
+    int         bitrate_kbps, out_sample_rate, sample_rate, channels;
+    long        total_samples;
+
+    // a new file uses the bitrate param, and lame chooses the sample rate for
+    // that bitrate; when appending the existing file's frame format is used
+    bitrate_kbps    = audio_params.record_bitrate;
+    out_sample_rate = 0;
+    if (append && (mp3 = sdlx_mp3_open(path)) != NULL) {
+        sdlx_mp3_get_info(mp3, &sample_rate, &channels, &total_samples);
+        bitrate_kbps = sdlx_mp3_get_bitrate(mp3);
+        out_sample_rate = sample_rate;
+        sdlx_mp3_close(mp3);
+        if (channels != 1) {
+            ERROR("can't append to '%s', channels=%d\n", path, channels);
+            return NULL;
+        }
+    }
 
-#define MIN_TONE_FREQ 100
-#define MAX_TONE_FREQ 3000 
+    enc = calloc(1, sizeof(mp3_enc_t));
+    if (enc == NULL) {
+        ERROR("failed to allocate mp3 encoder\n");
+        return NULL;
+    }
 
-static sine_wave_t *sine_waves[MAX_TONE_FREQ+1];
+    enc->gfp = mp3_lame_init(FRAMES_PER_SEC, out_sample_rate, bitrate_kbps);
+    if (enc->gfp == NULL) {
+        free(enc);
+        return NULL;
+    }
+    enc->fd = fd;
+    pthread_mutex_init(&enc->mutex, NULL);
+    pthread_cond_init(&enc->cond, NULL);
 
-static void smooth(short *buff, int len);
+    sdlx_create_detached_thread(mp3_enc_thread, enc);
+    return enc;
+}
 
-int sdlx_audio_play_tones(sdlx_tone_t *tones)
+// adds samples to the encoder queue, waiting if the queue is full;
+// n must not exceed ENC_BLOCK_SAMPLES
+static int mp3_enc_put(mp3_enc_t *enc, short *samples, int n)
 {
-    int num_tones, duration_ms, i, rc;
-    play_tones_cx_t *cx;
+    int rc = 0;
 
-    // open audio for playback
-    rc = audio_open(PLAYBACK);
-    if (rc < 0) {
-        ERROR("failed to open audio for playback\n");
-        return -1; 
+    pthread_mutex_lock(&enc->mutex);
+    while (enc->tail - enc->head == ENC_QUEUE_LEN && !enc->error) {
+        pthread_cond_wait(&enc->cond, &enc->mutex);
     }
-
-    // loop over tones to determine total duration and num_tones
-    num_tones = 0;
-    duration_ms = 0;
-    for (i = 0; tones[i].intvl_ms > 0; i++) {
-        sdlx_tone_t *t = &tones[i];
-        duration_ms += t->intvl_ms;
-        num_tones++;
+    if (enc->error) {
+        rc = -1;
+    } else {
+        int idx = enc->tail % ENC_QUEUE_LEN;
+        memcpy(enc->block[idx], samples, 2*n);
+        enc->cnt[idx] = n;
+        enc->tail++;
+        pthread_cond_broadcast(&enc->cond);
     }
+    pthread_mutex_unlock(&enc->mutex);
 
-    // init state for playing tones
-    memset(&state, 0, sizeof(state));
-    state.state          = AUDIO_STATE_PLAY_TONES; 
-    state.paused         = true;
-    state.total_ms       = ceil(duration_ms / 1000.);
-    strcpy(state.filename, "");
-
-    // create thread to play the tones
-    cx = malloc(sizeof(play_tones_cx_t) + num_tones * sizeof(sdlx_tone_t));
-    cx->num_tones = num_tones;
-    memcpy(cx->tones, tones, num_tones * sizeof(sdlx_tone_t));
-    sdlx_create_detached_thread(tones_thread, cx);
-
-    // success
-    return 0;
+    return rc;
 }
 
-static int tones_thread(void *cx_arg)
+// waits for the encoder to encode the queued samples and flush, and frees enc
+static int mp3_enc_finish(mp3_enc_t *enc)
 {
-    play_tones_cx_t *cx = (play_tones_cx_t*)cx_arg;
-    int              queued_bytes = 0;
-    bool             stop_req = false;
+    int rc;
 
-    static char     *buff;
-    static int       buff_len;
+    pthread_mutex_lock(&enc->mutex);
+    enc->eof = true;
+    pthread_cond_broadcast(&enc->cond);
+    while (!enc->done) {
+        pthread_cond_wait(&enc->cond, &enc->mutex);
+    }
+    pthread_mutex_unlock(&enc->mutex);
 
-    //INFO("starting\n");
+    rc = (enc->error ? -1 : 0);
+    pthread_mutex_destroy(&enc->mutex);
+    pthread_cond_destroy(&enc->cond);
+    free(enc);
 
-    // allocate buff to handle a tone or gap of up to 30 secs
-    buff_len = 30 * FRAMES_PER_SEC * sizeof(short);
-    buff = malloc(30 * FRAMES_PER_SEC * sizeof(short));
-    if (buff == NULL) {
-        ERROR("malloc %d failed\n", buff_len);
-        goto done;
-    }
+    return rc;
+}
+
+static int mp3_enc_thread(void *cx_arg)
+{
+    mp3_enc_t     *enc = (mp3_enc_t*)cx_arg;
+    unsigned char  mp3buf[ENC_MP3BUF_SIZE];
+    int            idx, len, rc;
 
-    // pre calculate the sine waves for the frequency(s) requested
-    for (int i = 0; i < cx->num_tones; i++) {
-        sdlx_tone_t *t = &cx->tones[i];
-        int n, j;
-        sine_wave_t *sw;
+    INFO("starting\n");
 
-        if (t->freq != 0 && t->freq < MIN_TONE_FREQ) {
-            t->freq = MIN_TONE_FREQ;
+    while (true) {
+        // wait for a block of samples, or eof
+        pthread_mutex_lock(&enc->mutex);
+        while (enc->head == enc->tail && !enc->eof) {
+            pthread_cond_wait(&enc->cond, &enc->mutex);
         }
-        if (t->freq > MAX_TONE_FREQ) {
-            t->freq = MAX_TONE_FREQ;
+        if (enc->head == enc->tail) {
+            pthread_mutex_unlock(&enc->mutex);
+            break;
         }
+        idx = enc->head % ENC_QUEUE_LEN;
+        pthread_mutex_unlock(&enc->mutex);
 
-        if (t->freq && sine_waves[t->freq] == NULL) {
-            n = nearbyint(FRAMES_PER_SEC / t->freq);
-            sw = malloc(sizeof(int) + n * sizeof(short));
-            sw->n = n;
-            for (j = 0; j < n; j++) {
-                sw->data[j] = 32767 * sin((2*M_PI) * ((double)j / n));
-            }
-            sine_waves[t->freq] = sw;
+        // encode the block, and write the mp3 frames to the file;
+        // the block is not released to the record_thread until it has been encoded
+        len = lame_encode_buffer(enc->gfp, enc->block[idx], NULL, enc->cnt[idx], mp3buf, sizeof(mp3buf));
+        if (len < 0) {
+            ERROR("lame_encode_buffer failed, rc=%d\n", len);
+            goto error;
+        }
+        rc = write(enc->fd, mp3buf, len);
+        if (rc != len) {
+            ERROR("write failed, rc=%d, %s\n", rc, strerror(errno));
+            goto error;
         }
-    }
-
-    // start playing tones
-    SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(playback_stream));  // thread safe
-    state.paused = false;
-
-    // loop over the tones
-    for (int i = 0; i < cx->num_tones; i++) {
-        sdlx_tone_t *t = &cx->tones[i];
-        int len;
 
-        //INFO("tone[%d] freq=%d millisecs=%d\n", i, t->freq, t->intvl_ms);
+        pthread_mutex_lock(&enc->mutex);
+        enc->head++;
+        pthread_cond_broadcast(&enc->cond);
+        pthread_mutex_unlock(&enc->mutex);
+    }
 
-        // construct buff for either:
-        // - gap  (when t->freq == 0), or
-        // - tone
-        if (t->freq == 0) {
-            len = FRAMES_PER_SEC * t->intvl_ms / 1000 * sizeof(short);
-            if (len > buff_len) {
-                len = buff_len;
-            }
-            memset(buff, 0, len);
-        } else {
-            sine_wave_t *sw = sine_waves[t->freq];
-            int num_sine_waves = t->intvl_ms * t->freq / 1000;
-            char *buff_ptr = buff;
+    // flush lame internal buffers, and write final mp3 data
+    len = lame_encode_flush(enc->gfp, mp3buf, sizeof(mp3buf));
+    if (len < 0) {
+        ERROR("lame_encode_flush failed, rc=%d\n", len);
+        goto error;
+    }
+    rc = write(enc->fd, mp3buf, len);
+    if (rc != len) {
+        ERROR("write failed, rc=%d, %s\n", rc, strerror(errno));
+        goto error;
+    }
 
-            if (num_sine_waves * sw->n * sizeof(short) > buff_len) {
-                num_sine_waves = buff_len / (sw->n * sizeof(short));
-            }
+    lame_close(enc->gfp);
+    INFO("completed\n");
+    pthread_mutex_lock(&enc->mutex);
+    enc->done = true;
+    pthread_cond_broadcast(&enc->cond);
+    pthread_mutex_unlock(&enc->mutex);
+    return 0;
 
-            for (int j = 0; j < num_sine_waves; j++) {
-                memcpy(buff_ptr, sw->data, sw->n * sizeof(short));
-                buff_ptr += sw->n * sizeof(short);
-            }
-            len = buff_ptr - buff;
+error:
+    // set the error flag, which causes the record_thread to stop
+    lame_close(enc->gfp);
+    pthread_mutex_lock(&enc->mutex);
+    enc->error = true;
+    enc->done = true;
+    pthread_cond_broadcast(&enc->cond);
+    pthread_mutex_unlock(&enc->mutex);
+    return -1;
+}
 
-            // xxx comments needed in this section
-            smooth((short*)buff, len/2);
-        }
+// inits lame to encode mono; out_sample_rate 0 lets lame choose the
+// sample rate that suits the bitrate
+static lame_global_flags *mp3_lame_init(int in_sample_rate, int out_sample_rate, int bitrate_kbps)
+{
+    lame_global_flags *gfp;
 
-        // play the tone, or gap
-        play_buff(buff, len, &stop_req, &queued_bytes);  // thread safe
-        if (stop_req) {
-            goto done;
-        }
+    gfp = lame_init();
+    if (gfp == NULL) {
+        ERROR("lame_init failed\n");
+        return NULL;
     }
 
-    // wait for all queued audio to be played
-    while (SDL_GetAudioStreamQueued(playback_stream) > 0) {  // thread safe
-        usleep(TEN_MS);
+    lame_set_num_channels(gfp, 1);
+    lame_set_in_samplerate(gfp, in_sample_rate);
+    lame_set_out_samplerate(gfp, out_sample_rate);
+    lame_set_brate(gfp, bitrate_kbps);
+    lame_set_mode(gfp, MONO);
+    lame_set_quality(gfp, 2);   // 2=high  5 = medium  7=low
+    lame_set_bWriteVbrTag(gfp, 0);
+
+    if (lame_init_params(gfp) == -1) {
+        ERROR("lame_init_params failed, bitrate=%d\n", bitrate_kbps);
+        lame_close(gfp);
+        return NULL;
     }
 
-done:
-    // cleanup and return
-    //INFO("completed\n");
-    SDL_PauseAudioDevice(SDL_GetAudioStreamDevice(playback_stream));  // thread safe
-    SDL_ClearAudioStream(playback_stream);  // thread safe
-    free(cx);
-    free(buff);
-    memset(&state, 0, sizeof(state));
-    return 0;
+    return gfp;
 }
 
-#define MAX_SMOOTHER  (FRAMES_PER_SEC / 200)   // number of frames in 5 ms
+// -----------------  PLAY TONES  -------------------------
 
-void smooth(short *buff, int len)
+int sdlx_audio_play_tones(sdlx_tone_t *tones)
 {
-    // xxx comment
-    // "equation for an s curve to smootly ramp up or down audio data"
-    // "plot 3x^2 - 2x^3"
+    sdlx_sound_t *snd;
 
-    static double *smoother;
-
-    if (len < 3 * MAX_SMOOTHER) {
-        return;
-    }
+    // stop the current playback or record
+    sdlx_audio_ctl(AUDIO_REQ_STOP);
 
-    if (smoother == NULL) {
-        smoother = calloc(MAX_SMOOTHER, sizeof(double));
-        for (int i = 0; i < MAX_SMOOTHER; i++) {
-            double x = (double)i / MAX_SMOOTHER;
-            double x_squared = x * x;
-            double x_cubed   = x_squared * x;
-            smoother[i] = 3 * x_squared - 2 * x_cubed;
-        }
+    snd = sdlx_sound_create_tones(tones);
+    if (snd == NULL) {
+        ERROR("failed to create tones\n");
+        return -1;
     }
 
-    for (int i = 0; i < MAX_SMOOTHER; i++) {
-        buff[i] *= smoother[i];
-        buff[len-1-i] *= smoother[i];
-    }
+    return play_sound(snd, AUDIO_STATE_PLAY_TONES, "");
 }
 
 // -----------------  PLAY USING SDL MIXER  ---------------
@@ -905,9 +924,6 @@ error:
 // xxx don't allow to run concurrently
 // xxx add util_concat
 
-// includes
-#include "lame/lame.h"
-
 // variables
 char               playbackcapture_mp3_filename[200];
 bool               playbackcapture_is_running;
@@ -940,16 +956,11 @@ void sdlx_stop_playbackcapture(void)
 // thread
 static int playbackcapture_thread(void *cx)
 {
-    #define STEREO           0
-    #define JOINT_STEREO     1
-    #define DUAL_CHANNEL     2
-    #define MONO             3
-
     #define MAX_RAW 8192
 
     int    len, fd_mp3=-1, ret=-1;;
     short  raw[MAX_RAW];
-    unsigned char  *mp3 = malloc(100000); // xxx maybe this can be smaller
+    unsigned char  *mp3 = NULL;
 
     // set thread is active flag
     playbackcapture_is_running = true;
@@ -961,28 +972,17 @@ static int playbackcapture_thread(void *cx)
         goto error;
     }
 
-    // allocate mp3 work buffer for lame
-    mp3 = malloc(100000); // xxx maybe this can be smaller
+    // allocate mp3 work buffer for lame, sized for lame's worst case
+    mp3 = malloc(MAX_RAW * 5 / 4 + 7200);
     if (mp3 == NULL) {
         ERROR("failed to allocate mp3 buffer\n");
         goto error;
     }
 
-    // init lame mp3 encoder
-    gfp = lame_init();
+    // init lame mp3 encoder; the playback capture is 48000 mono, the same
+    // as the record stream
+    gfp = mp3_lame_init(FRAMES_PER_SEC, 0, 64);  // xxx convert to jstereo
     if (gfp == NULL) {
-        ERROR("lame_init failed\n");
-        goto error;
-    }
-
-    lame_set_num_channels(gfp,1);  // xxx convert to jstereo
-    lame_set_in_samplerate(gfp,44100); // xxx use this instead of 48000
-    lame_set_brate(gfp,64);
-    lame_set_mode(gfp,MONO); 
-    lame_set_quality(gfp,2);   // 2=high  5 = medium  7=low
-
-    if (lame_init_params(gfp) == -1) {
-        ERROR("lame_init_params failed\n");
         goto error;
     }
 
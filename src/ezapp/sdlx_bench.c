@@ -0,0 +1,433 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+#include <SDL3/SDL.h>
+
+#include <sys/resource.h>
+#include <stdatomic.h>
+
+// Headless benchmark support, used on Linux by 'ezapp -b <app>'.
+//
+// The app is run with the offscreen video and dummy audio drivers. Each
+// sdlx_display_present is a frame. Scripted input events are pushed to the
+// SDL event queue at the frame numbers given in the script file, and
+// SDL_EVENT_QUIT is pushed when the frame or time limit is reached.
+// A single line of JSON is written to the report file (or stdout).
+//
+// Script file format, one event per line, x/y are logical coordinates:
+//   <frame> tap    <x> <y>
+//   <frame> swipe  <x1> <y1> <x2> <y2>
+//   <frame> motion <x> <y> <xrel> <yrel>
+//   <frame> key    <ch>            (single char, or decimal keycode)
+//   <frame> quit
+// Lines beginning with '#' are ignored.
+
+//
+// defines
+//
+
+#define MAX_SCRIPT 1000
+
+#define SCRIPT_TAP     1
+#define SCRIPT_SWIPE   2
+#define SCRIPT_MOTION  3
+#define SCRIPT_KEY     4
+#define SCRIPT_QUIT    5
+
+#define QUIT_GRACE_SECS 5
+
+#define SEC 1000000
+
+//
+// typedefs
+//
+
+typedef struct {
+    int frame;
+    int cmd;
+    int v[4];
+} script_t;
+
+//
+// variables
+//
+
+// defined in sdlx_video.c
+extern double scale;
+
+static bool                enabled;
+static sdlx_bench_params_t params;
+static script_t            script[MAX_SCRIPT];
+static int                 max_script;
+static int                 script_idx;
+
+static long                init_us;
+static long                app_start_us;
+static long                startup_us;
+static long                last_frame_us;
+static long                last_frame_cpu_us;
+static sdlx_video_stats_t  app_start_stats;
+
+static long               *frame_cpu_us;
+static long                frame_cpu_us_total;
+static long                frame_wall_us_total;
+static int                 frames;
+static atomic_bool         quit_pushed;    // set by the app thread or the watchdog
+static atomic_bool         timed_out;
+
+static pthread_mutex_t     report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool         report_done;
+
+//
+// prototypes
+//
+
+static int read_script(char *path);
+static void push_script_events(int frame);
+static void push_quit(void);
+static long cpu_microsec(void);
+static int watchdog_thread(void *cx);
+
+// -----------------  API  --------------------------------
+
+int sdlx_bench_init(sdlx_bench_params_t *bp)
+{
+    params = *bp;
+    init_us = util_monotonic_microsec_timer();
+
+    // validate params
+    if (params.app_name == NULL || params.max_frames <= 0 || params.max_secs <= 0) {
+        ERROR("invalid bench params\n");
+        return -1;
+    }
+
+    // read the optional input script
+    if (params.script_path != NULL && read_script(params.script_path) != 0) {
+        return -1;
+    }
+
+    // allocate per frame cpu time samples
+    frame_cpu_us = calloc(params.max_frames, sizeof(long));
+    if (frame_cpu_us == NULL) {
+        ERROR("failed to allocate frame_cpu_us, max_frames=%d\n", params.max_frames);
+        return -1;
+    }
+
+    // select headless drivers, this must be done prior to sdlx_init;
+    // note that SDL_VIDEO_DRIVER and SDL_AUDIO_DRIVER env vars take precedence
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+
+    INFO("app=%s max_frames=%d max_secs=%d script=%s report=%s\n",
+         params.app_name, params.max_frames, params.max_secs,
+         params.script_path ? params.script_path : "none",
+         params.report_path ? params.report_path : "stdout");
+
+    enabled = true;
+    return 0;
+}
+
+bool sdlx_bench_enabled(void)
+{
+    return enabled;
+}
+
+void sdlx_bench_app_start(void)
+{
+    if (!enabled) {
+        return;
+    }
+
+    app_start_us = util_monotonic_microsec_timer();
+    last_frame_us = app_start_us;
+    last_frame_cpu_us = cpu_microsec();
+    sdlx_video_get_stats(&app_start_stats);
+
+    // frame 0 script events are available to the app's first sdlx_get_event
+    push_script_events(0);
+
+    sdlx_create_detached_thread(watchdog_thread, NULL);
+}
+
+// called from sdlx_display_present
+void sdlx_bench_frame(void)
+{
+    long now_us, now_cpu_us, cpu_us;
+
+    if (!enabled || app_start_us == 0 || frames >= params.max_frames) {
+        return;
+    }
+
+    // accumulate the wall and cpu time of this frame
+    now_us = util_monotonic_microsec_timer();
+    now_cpu_us = cpu_microsec();
+    cpu_us = now_cpu_us - last_frame_cpu_us;
+    if (frames == 0) {
+        startup_us = now_us - app_start_us;
+    }
+    frame_cpu_us[frames] = cpu_us;
+    frame_cpu_us_total += cpu_us;
+    frame_wall_us_total += now_us - last_frame_us;
+    last_frame_us = now_us;
+    last_frame_cpu_us = now_cpu_us;
+    frames++;
+
+    // push scripted input for the next frame, and
+    // request the app to quit when the frame limit is reached
+    push_script_events(frames);
+    if (frames == params.max_frames) {
+        push_quit();
+    }
+}
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(long*)a, y = *(long*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+void sdlx_bench_report(int app_rc)
+{
+    FILE              *fp;
+    struct rusage      ru;
+    sdlx_video_stats_t stats;
+    long               draw_calls, cpu_p50 = 0, cpu_p95 = 0, cpu_max = 0;
+
+    if (!enabled) {
+        return;
+    }
+
+    // the report is written once, either here or by the watchdog
+    pthread_mutex_lock(&report_mutex);
+    if (report_done) {
+        pthread_mutex_unlock(&report_mutex);
+        return;
+    }
+    report_done = true;
+
+    // compute stats
+    sdlx_video_get_stats(&stats);
+    draw_calls = stats.draw_calls - app_start_stats.draw_calls;
+    if (frames > 0) {
+        qsort(frame_cpu_us, frames, sizeof(long), compare_long);
+        cpu_p50 = frame_cpu_us[frames/2];
+        cpu_p95 = frame_cpu_us[(frames*95)/100];
+        cpu_max = frame_cpu_us[frames-1];
+    }
+    getrusage(RUSAGE_SELF, &ru);
+
+    // write the report as a single line of json
+    fp = (params.report_path != NULL ? fopen(params.report_path, "a") : stdout);
+    if (fp == NULL) {
+        ERROR("failed to open %s, %s\n", params.report_path, strerror(errno));
+        fp = stdout;
+    }
+    fprintf(fp, "{\"app\":\"%s\", \"rc\":%d, \"timed_out\":%s, "
+                "\"init_us\":%ld, \"startup_us\":%ld, \"frames\":%d, "
+                "\"cpu_us_per_frame_avg\":%ld, \"cpu_us_per_frame_p50\":%ld, "
+                "\"cpu_us_per_frame_p95\":%ld, \"cpu_us_per_frame_max\":%ld, "
+                "\"wall_us_per_frame_avg\":%ld, "
+                "\"draw_calls\":%ld, \"draw_calls_per_frame\":%.1f, "
+                "\"peak_rss_kb\":%ld}\n",
+            params.app_name, app_rc, timed_out ? "true" : "false",
+            app_start_us - init_us, startup_us, frames,
+            frames ? frame_cpu_us_total / frames : 0, cpu_p50,
+            cpu_p95, cpu_max,
+            frames ? frame_wall_us_total / frames : 0,
+            draw_calls, frames ? (double)draw_calls / frames : 0.,
+            ru.ru_maxrss);
+    if (fp != stdout) {
+        fclose(fp);
+    } else {
+        fflush(stdout);
+    }
+
+    pthread_mutex_unlock(&report_mutex);
+}
+
+// -----------------  SCRIPTED INPUT  ---------------------
+
+static int read_script(char *path)
+{
+    FILE     *fp;
+    char      line[200], cmd[20];
+    int       line_num = 0, cnt;
+    script_t *x;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        ERROR("failed to open %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_num++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (max_script == MAX_SCRIPT) {
+            ERROR("%s: too many lines\n", path);
+            goto error;
+        }
+
+        x = &script[max_script];
+        memset(x, 0, sizeof(*x));
+        cnt = sscanf(line, "%d %19s %d %d %d %d", &x->frame, cmd, &x->v[0], &x->v[1], &x->v[2], &x->v[3]);
+        if (cnt < 2) {
+            ERROR("%s: invalid line %d\n", path, line_num);
+            goto error;
+        }
+
+        if (strcmp(cmd, "tap") == 0 && cnt == 4) {
+            x->cmd = SCRIPT_TAP;
+        } else if (strcmp(cmd, "swipe") == 0 && cnt == 6) {
+            x->cmd = SCRIPT_SWIPE;
+        } else if (strcmp(cmd, "motion") == 0 && cnt == 6) {
+            x->cmd = SCRIPT_MOTION;
+        } else if (strcmp(cmd, "key") == 0) {
+            char ch[20];
+            if (sscanf(line, "%*d %*s %19s", ch) != 1) {
+                ERROR("%s: invalid key, line %d\n", path, line_num);
+                goto error;
+            }
+            x->cmd = SCRIPT_KEY;
+            x->v[0] = (strlen(ch) == 1 ? ch[0] : atoi(ch));
+        } else if (strcmp(cmd, "quit") == 0) {
+            x->cmd = SCRIPT_QUIT;
+        } else {
+            ERROR("%s: invalid cmd '%s', line %d\n", path, cmd, line_num);
+            goto error;
+        }
+
+        if (max_script > 0 && x->frame < script[max_script-1].frame) {
+            ERROR("%s: frame numbers must not decrease, line %d\n", path, line_num);
+            goto error;
+        }
+        max_script++;
+    }
+
+    fclose(fp);
+    INFO("read %d script events from %s\n", max_script, path);
+    return 0;
+
+error:
+    fclose(fp);
+    return -1;
+}
+
+static void push_button(int x, int y, bool down)
+{
+    SDL_Event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (down ? SDL_EVENT_MOUSE_BUTTON_DOWN : SDL_EVENT_MOUSE_BUTTON_UP);
+    ev.button.button = SDL_BUTTON_LEFT;
+    ev.button.down = down;
+    ev.button.clicks = 1;
+    ev.button.x = x * scale;
+    ev.button.y = y * scale;
+    SDL_PushEvent(&ev);
+}
+
+static void push_script_events(int frame)
+{
+    SDL_Event ev;
+
+    while (script_idx < max_script && script[script_idx].frame <= frame) {
+        script_t *x = &script[script_idx++];
+
+        switch (x->cmd) {
+        case SCRIPT_TAP:
+            push_button(x->v[0], x->v[1], true);
+            push_button(x->v[0], x->v[1], false);
+            break;
+        case SCRIPT_SWIPE:
+            push_button(x->v[0], x->v[1], true);
+            push_button(x->v[2], x->v[3], false);
+            break;
+        case SCRIPT_MOTION:
+            memset(&ev, 0, sizeof(ev));
+            ev.type = SDL_EVENT_MOUSE_MOTION;
+            ev.motion.state = SDL_BUTTON_LMASK;
+            ev.motion.x = x->v[0] * scale;
+            ev.motion.y = x->v[1] * scale;
+            ev.motion.xrel = x->v[2] * scale;
+            ev.motion.yrel = x->v[3] * scale;
+            SDL_PushEvent(&ev);
+            break;
+        case SCRIPT_KEY:
+            memset(&ev, 0, sizeof(ev));
+            ev.type = SDL_EVENT_KEY_UP;
+            ev.key.key = x->v[0];
+            ev.key.scancode = SDL_GetScancodeFromKey(x->v[0], &ev.key.mod);
+            ev.key.down = false;
+            SDL_PushEvent(&ev);
+            break;
+        case SCRIPT_QUIT:
+            push_quit();
+            break;
+        }
+    }
+}
+
+static void push_quit(void)
+{
+    SDL_Event ev;
+
+    // the app thread and the watchdog may both push quit, it is pushed once
+    if (atomic_exchange(&quit_pushed, true)) {
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = SDL_EVENT_QUIT;
+    SDL_PushEvent(&ev);
+}
+
+// -----------------  SUPPORT  ----------------------------
+
+static long cpu_microsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return  ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// the watchdog requests the app to quit when max_secs have elapsed; and if the
+// app does not quit within QUIT_GRACE_SECS the report is written and ezapp exits
+static int watchdog_thread(void *cx)
+{
+    long end_us = app_start_us + (long)params.max_secs * SEC;
+
+    while (util_monotonic_microsec_timer() < end_us) {
+        if (report_done) {
+            return 0;
+        }
+        usleep(100000);
+    }
+
+    if (!quit_pushed) {
+        INFO("max_secs %d elapsed, requesting quit\n", params.max_secs);
+        timed_out = true;
+        push_quit();
+    }
+
+    end_us += QUIT_GRACE_SECS * SEC;
+    while (util_monotonic_microsec_timer() < end_us) {
+        if (report_done) {
+            return 0;
+        }
+        usleep(100000);
+    }
+
+    ERROR("app %s did not quit, exitting\n", params.app_name);
+    timed_out = true;
+    sdlx_bench_report(-1);
+    _exit(1);
+    return 0;
+}
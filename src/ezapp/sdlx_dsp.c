@@ -0,0 +1,796 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__ARM_NEON) && defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Audio DSP kernels, for 16 bit mono samples.
+//
+// Each kernel has a scalar version, and an SSE2 or NEON version; the vector
+// versions are selected at runtime when the cpu supports them. All of the
+// integer kernels use fixed point arithmetic that is defined so that the
+// vector versions produce bit-identical output to the scalar versions:
+// - gain:     Q8 gain, out = sat16((x * g + 128) >> 8)
+// - mix:      Q12 gains, out = sat16((sum(x * g) + 2048) >> 12)
+// - meter:    64 bit sum of squares, and min/max sample
+// - resample: polyphase windowed sinc, Q15 coefficients,
+//             out = sat16((sum(x * c) + 16384) >> 15)
+// The biquad filter is recursive in time, so a single mono stream can't be
+// vectorized; it is scalar on all cpus.
+//
+// 'ezapp -d' runs sdlx_dsp_test, which checks the selected kernels against
+// the scalar kernels and reports their throughput.
+
+//
+// defines
+//
+
+#define RS_NTAPS       32     // taps per phase, multiple of 8
+#define RS_MAX_PHASES  1024
+
+#define GAIN_Q   8
+#define MIX_Q    12
+#define COEF_Q   15
+
+//
+// typedefs
+//
+
+typedef struct {
+    char *name;
+    void (*gain)(short *dst, const short *src, int n, int g);
+    void (*meter)(const short *src, int n, int64_t *sum_sq, int *min, int *max);
+    void (*mix)(short *dst, const short **src, const short *g, int nsrc, int n);
+    int  (*resample)(sdlx_dsp_resampler_t *rs, const short *x, int nx, int *pos, short *out, int max_out);
+} kernels_t;
+
+struct sdlx_dsp_resampler {
+    int    in_rate;
+    int    out_rate;
+    int    L;             // phases, out_rate / gcd
+    int    M;             // input step, in_rate / gcd
+    int    phase;
+    short *coef;          // L * RS_NTAPS
+    short *x;             // history followed by the new input
+    int    nx;            // samples in x
+    int    alloc_x;
+};
+
+//
+// variables
+//
+
+static const kernels_t *kernels;
+static pthread_once_t   select_once = PTHREAD_ONCE_INIT;
+
+//
+// prototypes
+//
+
+static void select_kernels(void);
+
+// -----------------  COMMON  -----------------------------
+
+static inline short sat16(int v)
+{
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+static inline const kernels_t *get_kernels(void)
+{
+    pthread_once(&select_once, select_kernels);
+    return kernels;
+}
+
+// produces output samples while a full window of input is available;
+// pos is the index in x of the start of the window, and is advanced
+static inline int resample_loop(sdlx_dsp_resampler_t *rs, const short *x, int nx, int *pos,
+                                short *out, int max_out,
+                                int (*dot)(const short *x, const short *c))
+{
+    int n = 0, p = *pos, phase = rs->phase;
+    const int L = rs->L, M_int = rs->M / L, M_frac = rs->M % L;
+
+    while (n < max_out && p + RS_NTAPS <= nx) {
+        int acc = dot(x + p, rs->coef + phase * RS_NTAPS);
+        out[n++] = sat16((acc + (1 << (COEF_Q-1))) >> COEF_Q);
+        p += M_int;
+        phase += M_frac;
+        if (phase >= L) {
+            phase -= L;
+            p++;
+        }
+    }
+
+    *pos = p;
+    rs->phase = phase;
+    return n;
+}
+
+// -----------------  SCALAR KERNELS  ---------------------
+
+static void gain_scalar(short *dst, const short *src, int n, int g)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = sat16((src[i] * g + (1 << (GAIN_Q-1))) >> GAIN_Q);
+    }
+}
+
+static void meter_scalar(const short *src, int n, int64_t *sum_sq, int *min, int *max)
+{
+    int64_t sum = 0;
+    int     mn = 0, mx = 0;
+
+    for (int i = 0; i < n; i++) {
+        int x = src[i];
+        sum += x * x;
+        if (x < mn) mn = x;
+        if (x > mx) mx = x;
+    }
+
+    *sum_sq = sum;
+    *min = mn;
+    *max = mx;
+}
+
+static void mix_scalar(short *dst, const short **src, const short *g, int nsrc, int n)
+{
+    for (int i = 0; i < n; i++) {
+        int acc = 0;
+        for (int k = 0; k < nsrc; k++) {
+            acc += src[k][i] * g[k];
+        }
+        dst[i] = sat16((acc + (1 << (MIX_Q-1))) >> MIX_Q);
+    }
+}
+
+static inline int dot_scalar(const short *x, const short *c)
+{
+    int acc = 0;
+
+    for (int j = 0; j < RS_NTAPS; j++) {
+        acc += x[j] * c[j];
+    }
+    return acc;
+}
+
+static int resample_scalar(sdlx_dsp_resampler_t *rs, const short *x, int nx, int *pos, short *out, int max_out)
+{
+    return resample_loop(rs, x, nx, pos, out, max_out, dot_scalar);
+}
+
+static const kernels_t scalar_kernels = {
+    "scalar", gain_scalar, meter_scalar, mix_scalar, resample_scalar };
+
+// -----------------  SSE2 KERNELS  -----------------------
+
+#if defined(__SSE2__)
+
+static void gain_sse2(short *dst, const short *src, int n, int g)
+{
+    const __m128i vg  = _mm_set1_epi16(g);
+    const __m128i rnd = _mm_set1_epi32(1 << (GAIN_Q-1));
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x  = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_mullo_epi16(x, vg);
+        __m128i hi = _mm_mulhi_epi16(x, vg);
+        __m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), rnd), GAIN_Q);
+        __m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), rnd), GAIN_Q);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(p0, p1));
+    }
+    gain_scalar(dst+i, src+i, n-i, g);
+}
+
+static void meter_sse2(const short *src, int n, int64_t *sum_sq, int *min, int *max)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vsum = zero, vmin = zero, vmax = zero;
+    int64_t sum, tail_sum;
+    int     mn, mx, tail_min, tail_max, i;
+    short   tmp[8];
+    int64_t tmp64[2];
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        // each pair sum is at most 2^31, so it is exact when taken as unsigned
+        __m128i sq = _mm_madd_epi16(x, x);
+        vsum = _mm_add_epi64(vsum, _mm_unpacklo_epi32(sq, zero));
+        vsum = _mm_add_epi64(vsum, _mm_unpackhi_epi32(sq, zero));
+        vmin = _mm_min_epi16(vmin, x);
+        vmax = _mm_max_epi16(vmax, x);
+    }
+
+    _mm_storeu_si128((__m128i*)tmp64, vsum);
+    sum = tmp64[0] + tmp64[1];
+    mn = mx = 0;
+    _mm_storeu_si128((__m128i*)tmp, vmin);
+    for (int j = 0; j < 8; j++) if (tmp[j] < mn) mn = tmp[j];
+    _mm_storeu_si128((__m128i*)tmp, vmax);
+    for (int j = 0; j < 8; j++) if (tmp[j] > mx) mx = tmp[j];
+
+    meter_scalar(src+i, n-i, &tail_sum, &tail_min, &tail_max);
+    *sum_sq = sum + tail_sum;
+    *min = (tail_min < mn ? tail_min : mn);
+    *max = (tail_max > mx ? tail_max : mx);
+}
+
+static void mix_sse2(short *dst, const short **src, const short *g, int nsrc, int n)
+{
+    const __m128i rnd = _mm_set1_epi32(1 << (MIX_Q-1));
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        for (int k = 0; k < nsrc; k++) {
+            __m128i x  = _mm_loadu_si128((const __m128i*)(src[k] + i));
+            __m128i vg = _mm_set1_epi16(g[k]);
+            __m128i lo = _mm_mullo_epi16(x, vg);
+            __m128i hi = _mm_mulhi_epi16(x, vg);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(lo, hi));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(lo, hi));
+        }
+        acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, rnd), MIX_Q);
+        acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, rnd), MIX_Q);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(acc0, acc1));
+    }
+
+    if (i < n) {
+        const short *tail[SDLX_DSP_MAX_MIX];
+        for (int k = 0; k < nsrc; k++) tail[k] = src[k] + i;
+        mix_scalar(dst+i, tail, g, nsrc, n-i);
+    }
+}
+
+static inline int dot_sse2(const short *x, const short *c)
+{
+    __m128i acc = _mm_setzero_si128();
+
+    for (int j = 0; j < RS_NTAPS; j += 8) {
+        __m128i vx = _mm_loadu_si128((const __m128i*)(x + j));
+        __m128i vc = _mm_loadu_si128((const __m128i*)(c + j));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(vx, vc));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+static int resample_sse2(sdlx_dsp_resampler_t *rs, const short *x, int nx, int *pos, short *out, int max_out)
+{
+    return resample_loop(rs, x, nx, pos, out, max_out, dot_sse2);
+}
+
+static const kernels_t sse2_kernels = {
+    "sse2", gain_sse2, meter_sse2, mix_sse2, resample_sse2 };
+
+#endif
+
+// -----------------  NEON KERNELS  -----------------------
+
+#if defined(__ARM_NEON)
+
+static void gain_neon(short *dst, const short *src, int n, int g)
+{
+    const int16x4_t vg = vdup_n_s16(g);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        int16x8_t x  = vld1q_s16(src + i);
+        int32x4_t p0 = vmull_s16(vget_low_s16(x), vg);
+        int32x4_t p1 = vmull_s16(vget_high_s16(x), vg);
+        vst1q_s16(dst + i, vcombine_s16(vqrshrn_n_s32(p0, GAIN_Q), vqrshrn_n_s32(p1, GAIN_Q)));
+    }
+    gain_scalar(dst+i, src+i, n-i, g);
+}
+
+static void meter_neon(const short *src, int n, int64_t *sum_sq, int *min, int *max)
+{
+    int64x2_t vsum = vdupq_n_s64(0);
+    int16x8_t vmin = vdupq_n_s16(0);
+    int16x8_t vmax = vdupq_n_s16(0);
+    int64_t   tail_sum;
+    int       mn, mx, tail_min, tail_max, i;
+    short     tmp[8];
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+        vsum = vpadalq_s32(vsum, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        vsum = vpadalq_s32(vsum, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+        vmin = vminq_s16(vmin, x);
+        vmax = vmaxq_s16(vmax, x);
+    }
+
+    mn = mx = 0;
+    vst1q_s16(tmp, vmin);
+    for (int j = 0; j < 8; j++) if (tmp[j] < mn) mn = tmp[j];
+    vst1q_s16(tmp, vmax);
+    for (int j = 0; j < 8; j++) if (tmp[j] > mx) mx = tmp[j];
+
+    meter_scalar(src+i, n-i, &tail_sum, &tail_min, &tail_max);
+    *sum_sq = vgetq_lane_s64(vsum, 0) + vgetq_lane_s64(vsum, 1) + tail_sum;
+    *min = (tail_min < mn ? tail_min : mn);
+    *max = (tail_max > mx ? tail_max : mx);
+}
+
+static void mix_neon(short *dst, const short **src, const short *g, int nsrc, int n)
+{
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        int32x4_t acc0 = vdupq_n_s32(0);
+        int32x4_t acc1 = vdupq_n_s32(0);
+        for (int k = 0; k < nsrc; k++) {
+            int16x8_t x = vld1q_s16(src[k] + i);
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(x), g[k]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(x), g[k]);
+        }
+        vst1q_s16(dst + i, vcombine_s16(vqrshrn_n_s32(acc0, MIX_Q), vqrshrn_n_s32(acc1, MIX_Q)));
+    }
+
+    if (i < n) {
+        const short *tail[SDLX_DSP_MAX_MIX];
+        for (int k = 0; k < nsrc; k++) tail[k] = src[k] + i;
+        mix_scalar(dst+i, tail, g, nsrc, n-i);
+    }
+}
+
+static inline int dot_neon(const short *x, const short *c)
+{
+    int32x4_t acc = vdupq_n_s32(0);
+
+    for (int j = 0; j < RS_NTAPS; j += 8) {
+        int16x8_t vx = vld1q_s16(x + j);
+        int16x8_t vc = vld1q_s16(c + j);
+        acc = vmlal_s16(acc, vget_low_s16(vx), vget_low_s16(vc));
+        acc = vmlal_s16(acc, vget_high_s16(vx), vget_high_s16(vc));
+    }
+    return vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) +
+           vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+}
+
+static int resample_neon(sdlx_dsp_resampler_t *rs, const short *x, int nx, int *pos, short *out, int max_out)
+{
+    return resample_loop(rs, x, nx, pos, out, max_out, dot_neon);
+}
+
+static const kernels_t neon_kernels = {
+    "neon", gain_neon, meter_neon, mix_neon, resample_neon };
+
+#endif
+
+// -----------------  KERNEL SELECTION  -------------------
+
+static const kernels_t *simd_kernels(void)
+{
+#if defined(__SSE2__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        return &sse2_kernels;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    return &neon_kernels;
+#elif defined(__ARM_NEON)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON) {
+        return &neon_kernels;
+    }
+#endif
+    return NULL;
+}
+
+static void select_kernels(void)
+{
+    kernels = simd_kernels();
+    if (kernels == NULL) {
+        kernels = &scalar_kernels;
+    }
+    INFO("using %s kernels\n", kernels->name);
+}
+
+char *sdlx_dsp_kernels_name(void)
+{
+    return get_kernels()->name;
+}
+
+// -----------------  GAIN, METER, MIX  -------------------
+
+// gain is clamped to 0 .. 127, and is applied with 1/256 resolution
+void sdlx_dsp_gain(short *dst, short *src, int n, double gain)
+{
+    int g;
+
+    if (gain < 0) gain = 0;
+    if (gain > 127) gain = 127;
+    g = nearbyint(gain * (1 << GAIN_Q));
+
+    get_kernels()->gain(dst, src, n, g);
+}
+
+void sdlx_dsp_meter(short *src, int n, double *rms, int *peak)
+{
+    int64_t sum_sq;
+    int     min, max;
+
+    if (n <= 0) {
+        *rms = 0;
+        *peak = 0;
+        return;
+    }
+
+    get_kernels()->meter(src, n, &sum_sq, &min, &max);
+    *rms  = sqrt((double)sum_sq / n);
+    *peak = (-min > max ? -min : max);
+}
+
+// each gain is clamped to 0 .. 2, and is applied with 1/4096 resolution
+void sdlx_dsp_mix(short *dst, short **src, double *gain, int nsrc, int n)
+{
+    short g[SDLX_DSP_MAX_MIX];
+
+    if (nsrc > SDLX_DSP_MAX_MIX) {
+        ERROR("nsrc %d exceeds max %d\n", nsrc, SDLX_DSP_MAX_MIX);
+        nsrc = SDLX_DSP_MAX_MIX;
+    }
+    for (int k = 0; k < nsrc; k++) {
+        double x = gain[k];
+        if (x < 0) x = 0;
+        if (x > 2) x = 2;
+        g[k] = nearbyint(x * (1 << MIX_Q));
+    }
+
+    get_kernels()->mix(dst, (const short**)src, g, nsrc, n);
+}
+
+// -----------------  RESAMPLER  --------------------------
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double sinc(double x)
+{
+    return x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+}
+
+// creates a polyphase windowed sinc resampler; the filter cutoff is just
+// below the lower of the two nyquist frequencies, and the output is delayed
+// by RS_NTAPS/2 input samples
+sdlx_dsp_resampler_t *sdlx_dsp_resampler_create(int in_rate, int out_rate)
+{
+    sdlx_dsp_resampler_t *rs;
+    int    g, L, M;
+    double cutoff;
+
+    if (in_rate <= 0 || out_rate <= 0) {
+        ERROR("invalid rates %d %d\n", in_rate, out_rate);
+        return NULL;
+    }
+    g = gcd(in_rate, out_rate);
+    L = out_rate / g;
+    M = in_rate / g;
+    if (L > RS_MAX_PHASES) {
+        ERROR("unsupported ratio %d/%d\n", out_rate, in_rate);
+        return NULL;
+    }
+
+    rs = calloc(1, sizeof(sdlx_dsp_resampler_t));
+    if (rs == NULL) {
+        ERROR("failed to allocate resampler\n");
+        return NULL;
+    }
+    rs->in_rate  = in_rate;
+    rs->out_rate = out_rate;
+    rs->L        = L;
+    rs->M        = M;
+    rs->coef     = calloc(L * RS_NTAPS, sizeof(short));
+    if (rs->coef == NULL) {
+        ERROR("failed to allocate resampler coefficients\n");
+        free(rs);
+        return NULL;
+    }
+
+    // cutoff, relative to the input sample rate
+    cutoff = 0.5 * (out_rate < in_rate ? (double)out_rate / in_rate : 1) * 0.92;
+
+    // phase p interpolates at p/L of the way between the window's
+    // center samples; each phase is normalized to unity dc gain
+    for (int p = 0; p < L; p++) {
+        double h[RS_NTAPS], sum = 0;
+        for (int j = 0; j < RS_NTAPS; j++) {
+            double t = j - (RS_NTAPS/2 - 1) - (double)p / L;
+            double w = (t + RS_NTAPS/2) / RS_NTAPS;   // 0 .. 1 over the window
+            double blackman = 0.42 - 0.5 * cos(2*M_PI*w) + 0.08 * cos(4*M_PI*w);
+            h[j] = 2 * cutoff * sinc(2 * cutoff * t) * blackman;
+            sum += h[j];
+        }
+        for (int j = 0; j < RS_NTAPS; j++) {
+            rs->coef[p*RS_NTAPS + j] = nearbyint(h[j] / sum * 32767);
+        }
+    }
+
+    // start with a window of silence, so that output begins immediately
+    rs->nx = RS_NTAPS - 1;
+    rs->alloc_x = RS_NTAPS;
+    rs->x = calloc(rs->alloc_x, sizeof(short));
+    if (rs->x == NULL) {
+        ERROR("failed to allocate resampler buffer\n");
+        sdlx_dsp_resampler_destroy(rs);
+        return NULL;
+    }
+
+    return rs;
+}
+
+void sdlx_dsp_resampler_destroy(sdlx_dsp_resampler_t *rs)
+{
+    if (rs == NULL) {
+        return;
+    }
+    free(rs->coef);
+    free(rs->x);
+    free(rs);
+}
+
+// returns the number of output samples, which is about n_in * out_rate / in_rate;
+// out must hold sdlx_dsp_resample_max_out(rs, n_in) samples
+int sdlx_dsp_resample(sdlx_dsp_resampler_t *rs, short *in, int n_in, short *out)
+{
+    int pos = 0, n_out;
+
+    // append the input to the history
+    if (rs->nx + n_in > rs->alloc_x) {
+        int    alloc = rs->nx + n_in;
+        short *x = realloc(rs->x, alloc * sizeof(short));
+        if (x == NULL) {
+            ERROR("failed to allocate resampler buffer\n");
+            return -1;
+        }
+        rs->x = x;
+        rs->alloc_x = alloc;
+    }
+    memcpy(rs->x + rs->nx, in, n_in * sizeof(short));
+    rs->nx += n_in;
+
+    // produce output for every complete window, and keep the remainder
+    n_out = get_kernels()->resample(rs, rs->x, rs->nx, &pos, out, sdlx_dsp_resample_max_out(rs, n_in));
+    memmove(rs->x, rs->x + pos, (rs->nx - pos) * sizeof(short));
+    rs->nx -= pos;
+
+    return n_out;
+}
+
+int sdlx_dsp_resample_max_out(sdlx_dsp_resampler_t *rs, int n_in)
+{
+    return (long)(n_in + RS_NTAPS) * rs->L / rs->M + 1;
+}
+
+// -----------------  BIQUAD  -----------------------------
+
+// coefficients from the 'Audio EQ Cookbook' by Robert Bristow-Johnson
+void sdlx_dsp_biquad_init(sdlx_dsp_biquad_t *bq, int type, double freq, double q, int sample_rate)
+{
+    double w0    = 2 * M_PI * freq / sample_rate;
+    double alpha = sin(w0) / (2 * q);
+    double cosw0 = cos(w0);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (type) {
+    case SDLX_DSP_HIGHPASS:
+        b0 = (1 + cosw0) / 2; b1 = -(1 + cosw0); b2 = (1 + cosw0) / 2;
+        break;
+    case SDLX_DSP_BANDPASS:
+        b0 = alpha; b1 = 0; b2 = -alpha;
+        break;
+    case SDLX_DSP_NOTCH:
+        b0 = 1; b1 = -2 * cosw0; b2 = 1;
+        break;
+    case SDLX_DSP_LOWPASS:
+    default:
+        b0 = (1 - cosw0) / 2; b1 = 1 - cosw0; b2 = (1 - cosw0) / 2;
+        break;
+    }
+    a0 = 1 + alpha;
+    a1 = -2 * cosw0;
+    a2 = 1 - alpha;
+
+    bq->b0 = b0 / a0;
+    bq->b1 = b1 / a0;
+    bq->b2 = b2 / a0;
+    bq->a1 = a1 / a0;
+    bq->a2 = a2 / a0;
+    bq->z1 = 0;
+    bq->z2 = 0;
+}
+
+// transposed direct form II; dst may be the same as src
+void sdlx_dsp_biquad(sdlx_dsp_biquad_t *bq, short *dst, short *src, int n)
+{
+    float z1 = bq->z1, z2 = bq->z2;
+
+    for (int i = 0; i < n; i++) {
+        float x = src[i];
+        float y = bq->b0 * x + z1;
+        z1 = bq->b1 * x - bq->a1 * y + z2;
+        z2 = bq->b2 * x - bq->a2 * y;
+        dst[i] = sat16(lrintf(y));
+    }
+
+    bq->z1 = z1;
+    bq->z2 = z2;
+}
+
+// -----------------  TEST AND BENCHMARK  -----------------
+
+#define TEST_N      (48000 + 5)   // not a multiple of the vector width
+#define BENCH_SECS  0.25
+
+static void test_fill(short *buff, int n, unsigned int seed)
+{
+    // mostly loud noise, with runs of full scale samples to exercise saturation
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        buff[i] = (seed >> 8) & 0xffff;
+        if ((i / 1000) % 7 == 3) {
+            buff[i] = (buff[i] & 1) ? 32767 : -32768;
+        }
+    }
+}
+
+static int test_kernels(const kernels_t *k)
+{
+    short  *src[SDLX_DSP_MAX_MIX], *out1, *out2;
+    short   g[SDLX_DSP_MAX_MIX];
+    int64_t sum1, sum2;
+    int     min1, max1, min2, max2, n1, n2, pos1, pos2, errors = 0;
+    sdlx_dsp_resampler_t *rs;
+
+    static const int gains[] = { 0, 1, 128, 256, 300, 1280, 25600, 32767 };
+    static const int rates[][2] = { {48000,44100}, {44100,48000}, {8000,48000}, {48000,16000} };
+
+    for (int j = 0; j < SDLX_DSP_MAX_MIX; j++) {
+        src[j] = malloc(TEST_N * sizeof(short));
+        test_fill(src[j], TEST_N, j+1);
+    }
+    out1 = malloc(8 * TEST_N * sizeof(short));
+    out2 = malloc(8 * TEST_N * sizeof(short));
+
+    // gain
+    for (int j = 0; j < sizeof(gains)/sizeof(gains[0]); j++) {
+        scalar_kernels.gain(out1, src[0], TEST_N, gains[j]);
+        k->gain(out2, src[0], TEST_N, gains[j]);
+        if (memcmp(out1, out2, TEST_N * sizeof(short)) != 0) {
+            ERROR("%s gain mismatch, gain=%d\n", k->name, gains[j]);
+            errors++;
+        }
+    }
+
+    // meter, at each alignment of the start
+    for (int j = 0; j < 8; j++) {
+        scalar_kernels.meter(src[0]+j, TEST_N-j, &sum1, &min1, &max1);
+        k->meter(src[0]+j, TEST_N-j, &sum2, &min2, &max2);
+        if (sum1 != sum2 || min1 != min2 || max1 != max2) {
+            ERROR("%s meter mismatch, offset=%d\n", k->name, j);
+            errors++;
+        }
+    }
+
+    // mix, 1 to SDLX_DSP_MAX_MIX streams at the max gain
+    for (int nsrc = 1; nsrc <= SDLX_DSP_MAX_MIX; nsrc++) {
+        for (int j = 0; j < nsrc; j++) g[j] = (j == 0 ? 2 << MIX_Q : (j * 997) % (2 << MIX_Q));
+        scalar_kernels.mix(out1, (const short**)src, g, nsrc, TEST_N);
+        k->mix(out2, (const short**)src, g, nsrc, TEST_N);
+        if (memcmp(out1, out2, TEST_N * sizeof(short)) != 0) {
+            ERROR("%s mix mismatch, nsrc=%d\n", k->name, nsrc);
+            errors++;
+        }
+    }
+
+    // resample
+    for (int j = 0; j < sizeof(rates)/sizeof(rates[0]); j++) {
+        rs = sdlx_dsp_resampler_create(rates[j][0], rates[j][1]);
+        pos1 = pos2 = 0;
+        n1 = scalar_kernels.resample(rs, src[1], TEST_N, &pos1, out1, 8 * TEST_N);
+        rs->phase = 0;
+        n2 = k->resample(rs, src[1], TEST_N, &pos2, out2, 8 * TEST_N);
+        if (n1 != n2 || pos1 != pos2 || memcmp(out1, out2, n1 * sizeof(short)) != 0) {
+            ERROR("%s resample mismatch, %d to %d\n", k->name, rates[j][0], rates[j][1]);
+            errors++;
+        }
+        sdlx_dsp_resampler_destroy(rs);
+    }
+
+    for (int j = 0; j < SDLX_DSP_MAX_MIX; j++) {
+        free(src[j]);
+    }
+    free(out1);
+    free(out2);
+
+    return errors;
+}
+
+// returns millions of samples per second
+static double bench_kernel(const kernels_t *k, int which, short **src, short *out)
+{
+    static const short g[SDLX_DSP_MAX_MIX] = { 4096, 4096, 4096, 4096 };
+    sdlx_dsp_resampler_t *rs = NULL;
+    long    start, elapsed, samples = 0;
+    int64_t sum;
+    int     min, max, pos;
+
+    if (which == 3) {
+        rs = sdlx_dsp_resampler_create(44100, 48000);
+    }
+
+    start = util_monotonic_microsec_timer();
+    do {
+        for (int j = 0; j < 10; j++) {
+            switch (which) {
+            case 0: k->gain(out, src[0], TEST_N, 1280); break;
+            case 1: k->meter(src[0], TEST_N, &sum, &min, &max); break;
+            case 2: k->mix(out, (const short**)src, g, 4, TEST_N); break;
+            case 3: pos = 0; k->resample(rs, src[0], TEST_N, &pos, out, 2 * TEST_N); break;
+            }
+            samples += TEST_N;
+        }
+        elapsed = util_monotonic_microsec_timer() - start;
+    } while (elapsed < BENCH_SECS * 1000000);
+
+    sdlx_dsp_resampler_destroy(rs);
+    return (double)samples / elapsed;
+}
+
+// checks the selected kernels against the scalar kernels, and writes
+// their throughput as a single line of json; returns the number of errors
+int sdlx_dsp_test(void)
+{
+    static const char *names[] = { "gain", "meter", "mix4", "resample" };
+    const kernels_t   *k = get_kernels();
+    short             *src[SDLX_DSP_MAX_MIX], *out;
+    int                errors;
+
+    // bit exact tests
+    errors = (k != &scalar_kernels ? test_kernels(k) : 0);
+    INFO("%s kernels: %d errors\n", k->name, errors);
+
+    // benchmark
+    for (int j = 0; j < 4; j++) {
+        src[j] = malloc(TEST_N * sizeof(short));
+        test_fill(src[j], TEST_N, j+1);
+    }
+    out = malloc(2 * TEST_N * sizeof(short));
+
+    printf("{\"kernels\":\"%s\", \"errors\":%d", k->name, errors);
+    for (int which = 0; which < 4; which++) {
+        double s = bench_kernel(&scalar_kernels, which, src, out);
+        double v = (k != &scalar_kernels ? bench_kernel(k, which, src, out) : s);
+        printf(", \"%s_msps_scalar\":%.1f, \"%s_msps\":%.1f", names[which], s, names[which], v);
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    for (int j = 0; j < 4; j++) {
+        free(src[j]);
+    }
+    free(out);
+
+    return errors;
+}
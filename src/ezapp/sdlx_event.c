@@ -41,6 +41,7 @@ static bool         evid_keybd_registered;
 // prototypes
 //
 
+static void get_event(long timeout_us, sdlx_event_t *event);
 static void process_sdlx_event(SDL_Event *ev, sdlx_event_t *event);
 
 // xxx cleanup and sections needed
@@ -156,6 +157,19 @@ static int sdlx_event_quit_rcvd;  //xxx cleanup
 //    0:     don't wait
 //    usecs: timeout
 void sdlx_get_event(long timeout_us, sdlx_event_t *event)
+{
+    // when replaying a trace the recorded event is returned;
+    // otherwise get the event, and record it if recording is enabled
+    if (sdlx_trace_replaying()) {
+        sdlx_trace_replay_event(timeout_us, event);
+        return;
+    }
+
+    get_event(timeout_us, event);
+    sdlx_trace_record_event(event);
+}
+
+static void get_event(long timeout_us, sdlx_event_t *event)
 {
     SDL_Event ev;
     long waited = 0;
@@ -278,20 +292,10 @@ static void process_sdlx_event(SDL_Event *ev, sdlx_event_t *event)
             event->u.motion.yrel = ev->motion.yrel / scale;
         }
         break; }
-    case SDL_EVENT_SENSOR_UPDATE: {
-        SDL_SensorEvent *x = &ev->sensor;
-        // xxx why is step counter not working
-        // xxx cleanup
-        if (x->which == 14 || x->which == 15) { // xxx clean up these prints
-            // xxx long stepc = *(long*)x->data;
-            unsigned long stepc;
-            memcpy(&stepc, x->data, sizeof(stepc));
-            INFO("SENSOR: which=%d data=%f %f %f %f %f %f stepc=%ld timestamp=%ld\n",
-                 x->which,
-                 x->data[0], x->data[1], x->data[2], x->data[3], x->data[4], x->data[5],
-                 stepc, x->sensor_timestamp);
-        }
-        break; }
+    case SDL_EVENT_SENSOR_UPDATE:
+        // the samples are added to the sensor streams by the
+        // event watcher in sdlx_sensor.c
+        break;
 #if 0
     case SDL_EVENT_TEXT_INPUT: {
         SDL_TextInputEvent *x = &ev->text;
@@ -0,0 +1,538 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+#include <limits.h>
+
+// Sensor fusion, estimating the device orientation from the accelerometer,
+// gyroscope and magnetometer samples.
+//
+// The filter is Madgwick's gradient descent orientation filter: the gyroscope
+// rate is integrated, and the orientation is corrected toward the one in which
+// the measured gravity and magnetic field directions agree with the reference
+// ones, at a rate set by beta. The filter is initialized from the first
+// accelerometer and magnetometer samples, so it doesn't have to converge from
+// an arbitrary orientation.
+//
+// Orientations are quaternions that rotate device vectors to the earth frame;
+// the earth frame has x toward magnetic north, y west, and z up.
+//
+// The filter object has no dependence on SDL, so it can be run offline over
+// recorded samples; 'ezapp -u file' runs sdlx_fusion_test. The fusion thread
+// runs the filter on the device's sensor streams, for sdlx_sensor_get_orientation.
+
+//
+// defines
+//
+
+#define DEFAULT_BETA     0.1
+#define MAX_DT_US        200000   // larger gaps are not integrated
+
+#define FUSION_INTVL_US  10000    // fusion thread processing interval
+#define MAX_READ         256      // samples read per stream, per read
+
+#define TEST_OUTPUT_INTVL_US 100000   // sample time between test outputs
+
+#define RAD_TO_DEG (180 / M_PI)
+
+//
+// typedefs
+//
+
+struct sdlx_fusion {
+    double beta;
+    bool   initialized;
+    bool   have_gyro;
+    bool   have_mag;
+    long   timestamp_us;
+    double q[4];
+    double accel[3];
+    double mag[3];
+    bool   have_accel;
+};
+
+typedef struct {
+    int    type;
+    long   timestamp_us;
+    double values[3];
+} sample_t;
+
+//
+// variables
+//
+
+// fusion thread
+static pthread_mutex_t    mutex = PTHREAD_MUTEX_INITIALIZER;
+static int                fusion_users;
+static pthread_t          fusion_tid;
+static volatile bool      fusion_stop_req;
+static sdlx_orientation_t fusion_orientation;
+static bool               fusion_valid;
+
+//
+// prototypes
+//
+
+static void init_orientation(sdlx_fusion_t *f);
+static void madgwick_update(sdlx_fusion_t *f, double *g, double dt);
+static bool normalize(double *v, int n);
+static void *fusion_thread(void *cx);
+static int compare_samples(const void *a, const void *b);
+
+// -----------------  FILTER  ------------------------------
+
+sdlx_fusion_t *sdlx_fusion_create(double beta)
+{
+    sdlx_fusion_t *f;
+
+    f = calloc(1, sizeof(sdlx_fusion_t));
+    if (f == NULL) {
+        ERROR("failed to allocate fusion filter\n");
+        return NULL;
+    }
+    f->beta = (beta > 0 ? beta : DEFAULT_BETA);
+    f->q[0] = 1;
+    return f;
+}
+
+void sdlx_fusion_destroy(sdlx_fusion_t *f)
+{
+    free(f);
+}
+
+// the samples must be passed in timestamp order; the filter steps at each
+// gyroscope sample, or at each accelerometer sample if there is no gyroscope
+bool sdlx_fusion_sample(sdlx_fusion_t *f, int type, long timestamp_us, double *values)
+{
+    double gyro[3] = {0,0,0};
+    double dt;
+
+    switch (type) {
+    case ASENSOR_TYPE_ACCELEROMETER:
+        memcpy(f->accel, values, sizeof(f->accel));
+        f->have_accel = true;
+        if (f->have_gyro) {
+            return false;
+        }
+        break;
+    case ASENSOR_TYPE_MAGNETIC_FIELD:
+        // if the filter was initialized before the first magnetometer
+        // sample then initialize it again, to set the heading
+        if (!f->have_mag) {
+            f->initialized = false;
+        }
+        memcpy(f->mag, values, sizeof(f->mag));
+        f->have_mag = true;
+        return false;
+    case ASENSOR_TYPE_GYROSCOPE:
+        memcpy(gyro, values, sizeof(gyro));
+        f->have_gyro = true;
+        break;
+    default:
+        return false;
+    }
+
+    // the orientation can't be initialized until there is an accelerometer sample
+    if (!f->have_accel) {
+        return false;
+    }
+    if (!f->initialized) {
+        init_orientation(f);
+        f->initialized = true;
+        f->timestamp_us = timestamp_us;
+        return true;
+    }
+
+    // a gap, or a sample out of order, is not integrated
+    dt = (timestamp_us - f->timestamp_us) / 1e6;
+    if (dt > 0 && dt <= MAX_DT_US / 1e6) {
+        madgwick_update(f, gyro, dt);
+    }
+    if (timestamp_us > f->timestamp_us) {
+        f->timestamp_us = timestamp_us;
+    }
+    return true;
+}
+
+int sdlx_fusion_get(sdlx_fusion_t *f, sdlx_orientation_t *o)
+{
+    double q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+    double top_n, top_w;
+
+    memset(o, 0, sizeof(*o));
+    if (!f->initialized) {
+        return -1;
+    }
+
+    o->timestamp_us = f->timestamp_us;
+    memcpy(o->q, f->q, sizeof(o->q));
+
+    // the up direction in device axes is the third row of the rotation matrix
+    o->up[0] = 2 * (q1*q3 - q0*q2);
+    o->up[1] = 2 * (q0*q1 + q2*q3);
+    o->up[2] = q0*q0 - q1*q1 - q2*q2 + q3*q3;
+
+    // roll and pitch as sdlx_sensor_read_roll_pitch: positive roll when the right
+    // side of the device is below the left, positive pitch when the top points up
+    o->roll  = -asin(fmax(-1, fmin(1, o->up[0]))) * RAD_TO_DEG;
+    o->pitch =  asin(fmax(-1, fmin(1, o->up[1]))) * RAD_TO_DEG;
+
+    // heading is the direction, clockwise from magnetic north, that the
+    // top of the device (its y axis) points in the earth frame
+    top_n = 2 * (q1*q2 - q0*q3);
+    top_w = q0*q0 - q1*q1 + q2*q2 - q3*q3;
+    o->heading = atan2(-top_w, top_n) * RAD_TO_DEG;
+    if (o->heading < 0) {
+        o->heading += 360;
+    }
+
+    return 0;
+}
+
+// the orientation whose earth frame axes, expressed in device axes, are the rows
+// of R: up from the accelerometer, and north from the horizontal component of the
+// magnetic field; without a magnetometer, north is the direction the top points
+static void init_orientation(sdlx_fusion_t *f)
+{
+    double R[3][3], *n = R[0], *w = R[1], *u = R[2];
+    double e[3], t;
+
+    memcpy(u, f->accel, sizeof(f->accel));
+    normalize(u, 3);
+
+    if (f->have_mag) {
+        // east = mag x up
+        e[0] = f->mag[1]*u[2] - f->mag[2]*u[1];
+        e[1] = f->mag[2]*u[0] - f->mag[0]*u[2];
+        e[2] = f->mag[0]*u[1] - f->mag[1]*u[0];
+    }
+    if (!f->have_mag || !normalize(e, 3)) {
+        // east = top x up, with top = (0,1,0); if the device is vertical use x
+        e[0] = u[2]; e[1] = 0; e[2] = -u[0];
+        if (!normalize(e, 3)) {
+            e[0] = 1; e[1] = 0; e[2] = 0;
+        }
+    }
+
+    // north = up x east, and west = -east
+    n[0] = u[1]*e[2] - u[2]*e[1];
+    n[1] = u[2]*e[0] - u[0]*e[2];
+    n[2] = u[0]*e[1] - u[1]*e[0];
+    w[0] = -e[0]; w[1] = -e[1]; w[2] = -e[2];
+
+    // rotation matrix to quaternion, using the largest diagonal term for accuracy
+    t = R[0][0] + R[1][1] + R[2][2];
+    if (t > 0) {
+        double s = 2 * sqrt(1 + t);
+        f->q[0] = s / 4;
+        f->q[1] = (R[2][1] - R[1][2]) / s;
+        f->q[2] = (R[0][2] - R[2][0]) / s;
+        f->q[3] = (R[1][0] - R[0][1]) / s;
+    } else if (R[0][0] > R[1][1] && R[0][0] > R[2][2]) {
+        double s = 2 * sqrt(1 + R[0][0] - R[1][1] - R[2][2]);
+        f->q[0] = (R[2][1] - R[1][2]) / s;
+        f->q[1] = s / 4;
+        f->q[2] = (R[0][1] + R[1][0]) / s;
+        f->q[3] = (R[0][2] + R[2][0]) / s;
+    } else if (R[1][1] > R[2][2]) {
+        double s = 2 * sqrt(1 + R[1][1] - R[0][0] - R[2][2]);
+        f->q[0] = (R[0][2] - R[2][0]) / s;
+        f->q[1] = (R[0][1] + R[1][0]) / s;
+        f->q[2] = s / 4;
+        f->q[3] = (R[1][2] + R[2][1]) / s;
+    } else {
+        double s = 2 * sqrt(1 + R[2][2] - R[0][0] - R[1][1]);
+        f->q[0] = (R[1][0] - R[0][1]) / s;
+        f->q[1] = (R[0][2] + R[2][0]) / s;
+        f->q[2] = (R[1][2] + R[2][1]) / s;
+        f->q[3] = s / 4;
+    }
+    normalize(f->q, 4);
+}
+
+// one step of the filter: qdot = q * (0,g) / 2 - beta * gradient, where the gradient
+// is of the error between the measured and the predicted directions of gravity and,
+// when there is a magnetometer, of the magnetic field
+static void madgwick_update(sdlx_fusion_t *f, double *g, double dt)
+{
+    double q0 = f->q[0], q1 = f->q[1], q2 = f->q[2], q3 = f->q[3];
+    double qdot[4], s[4] = {0,0,0,0};
+    double a[3], m[3];
+    int    i;
+
+    // rate of change of the quaternion from the gyroscope
+    qdot[0] = 0.5 * (-q1*g[0] - q2*g[1] - q3*g[2]);
+    qdot[1] = 0.5 * ( q0*g[0] + q2*g[2] - q3*g[1]);
+    qdot[2] = 0.5 * ( q0*g[1] - q1*g[2] + q3*g[0]);
+    qdot[3] = 0.5 * ( q0*g[2] + q1*g[1] - q2*g[0]);
+
+    memcpy(a, f->accel, sizeof(a));
+    if (normalize(a, 3)) {
+        // gravity: error and jacobian transpose times error
+        double fg[3] = { 2*(q1*q3 - q0*q2) - a[0],
+                         2*(q0*q1 + q2*q3) - a[1],
+                         2*(0.5 - q1*q1 - q2*q2) - a[2] };
+        s[0] += -2*q2*fg[0] + 2*q1*fg[1];
+        s[1] +=  2*q3*fg[0] + 2*q0*fg[1] - 4*q1*fg[2];
+        s[2] += -2*q0*fg[0] + 2*q3*fg[1] - 4*q2*fg[2];
+        s[3] +=  2*q1*fg[0] + 2*q2*fg[1];
+
+        memcpy(m, f->mag, sizeof(m));
+        if (f->have_mag && normalize(m, 3)) {
+            // the reference field is the measured field rotated to the earth
+            // frame, with its horizontal component put on the x (north) axis
+            double hx = 2*m[0]*(0.5 - q2*q2 - q3*q3) + 2*m[1]*(q1*q2 - q0*q3) + 2*m[2]*(q1*q3 + q0*q2);
+            double hy = 2*m[0]*(q1*q2 + q0*q3) + 2*m[1]*(0.5 - q1*q1 - q3*q3) + 2*m[2]*(q2*q3 - q0*q1);
+            double bz = 2*m[0]*(q1*q3 - q0*q2) + 2*m[1]*(q0*q1 + q2*q3) + 2*m[2]*(0.5 - q1*q1 - q2*q2);
+            double bx = sqrt(hx*hx + hy*hy);
+            double fb[3] = { 2*bx*(0.5 - q2*q2 - q3*q3) + 2*bz*(q1*q3 - q0*q2) - m[0],
+                             2*bx*(q1*q2 - q0*q3) + 2*bz*(q0*q1 + q2*q3) - m[1],
+                             2*bx*(q0*q2 + q1*q3) + 2*bz*(0.5 - q1*q1 - q2*q2) - m[2] };
+            s[0] += -2*bz*q2*fb[0] + (-2*bx*q3 + 2*bz*q1)*fb[1] + 2*bx*q2*fb[2];
+            s[1] +=  2*bz*q3*fb[0] + ( 2*bx*q2 + 2*bz*q0)*fb[1] + (2*bx*q3 - 4*bz*q1)*fb[2];
+            s[2] += (-4*bx*q2 - 2*bz*q0)*fb[0] + (2*bx*q1 + 2*bz*q3)*fb[1] + (2*bx*q0 - 4*bz*q2)*fb[2];
+            s[3] += (-4*bx*q3 + 2*bz*q1)*fb[0] + (-2*bx*q0 + 2*bz*q2)*fb[1] + 2*bx*q1*fb[2];
+        }
+
+        if (normalize(s, 4)) {
+            for (i = 0; i < 4; i++) {
+                qdot[i] -= f->beta * s[i];
+            }
+        }
+    }
+
+    for (i = 0; i < 4; i++) {
+        f->q[i] += qdot[i] * dt;
+    }
+    normalize(f->q, 4);
+}
+
+static bool normalize(double *v, int n)
+{
+    double sum = 0;
+    int    i;
+
+    for (i = 0; i < n; i++) {
+        sum += v[i] * v[i];
+    }
+    if (sum == 0 || !isfinite(sum)) {
+        return false;
+    }
+    sum = 1 / sqrt(sum);
+    for (i = 0; i < n; i++) {
+        v[i] *= sum;
+    }
+    return true;
+}
+
+// -----------------  FUSION THREAD  -----------------------
+
+// the fusion thread is started by the first caller of sdlx_sensor_fusion_start,
+// and stopped when all callers have called sdlx_sensor_fusion_stop
+int sdlx_sensor_fusion_start(void)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&mutex);
+    if (fusion_users == 0) {
+        if (sdlx_sensor_find(ASENSOR_TYPE_ACCELEROMETER) == -1) {
+            rc = -1;
+            goto done;
+        }
+        fusion_stop_req = false;
+        fusion_valid = false;
+        if (pthread_create(&fusion_tid, NULL, fusion_thread, NULL) != 0) {
+            ERROR("failed to create fusion thread\n");
+            rc = -1;
+            goto done;
+        }
+    }
+    fusion_users++;
+
+done:
+    pthread_mutex_unlock(&mutex);
+    return rc;
+}
+
+void sdlx_sensor_fusion_stop(void)
+{
+    pthread_mutex_lock(&mutex);
+    if (fusion_users > 0 && --fusion_users == 0) {
+        fusion_stop_req = true;
+        pthread_mutex_unlock(&mutex);
+        pthread_join(fusion_tid, NULL);
+        return;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+int sdlx_sensor_get_orientation(sdlx_orientation_t *o)
+{
+    int rc;
+
+    pthread_mutex_lock(&mutex);
+    if (fusion_valid) {
+        *o = fusion_orientation;
+        rc = 0;
+    } else {
+        memset(o, 0, sizeof(*o));
+        rc = -1;
+    }
+    pthread_mutex_unlock(&mutex);
+    return rc;
+}
+
+static void *fusion_thread(void *cx)
+{
+    static const int types[3] = { ASENSOR_TYPE_ACCELEROMETER, ASENSOR_TYPE_GYROSCOPE, ASENSOR_TYPE_MAGNETIC_FIELD };
+
+    sdlx_fusion_t     *f;
+    sdlx_orientation_t o;
+    int                ids[3], i, j, n, max;
+    long               cursor[3];
+    long               ts[MAX_READ];
+    double             values[3*MAX_READ];
+    sample_t          *samples;
+    bool               updated;
+
+    f = sdlx_fusion_create(0);
+    samples = malloc(3 * MAX_READ * sizeof(sample_t));
+    if (f == NULL || samples == NULL) {
+        sdlx_fusion_destroy(f);
+        free(samples);
+        return NULL;
+    }
+
+    // the streams are read starting from their newest samples
+    for (i = 0; i < 3; i++) {
+        ids[i] = sdlx_sensor_find(types[i]);
+        cursor[i] = LONG_MAX;
+        if (ids[i] != -1) {
+            sdlx_sensor_stream_read(ids[i], &cursor[i], ts, values, 3, 0);
+        }
+    }
+    INFO("fusion started, accel=%d gyro=%d mag=%d\n", ids[0], ids[1], ids[2]);
+
+    while (!fusion_stop_req) {
+        usleep(FUSION_INTVL_US);
+
+        // get the new samples of each stream, and merge them in timestamp order
+        max = 0;
+        for (i = 0; i < 3; i++) {
+            if (ids[i] == -1) {
+                continue;
+            }
+            n = sdlx_sensor_stream_read(ids[i], &cursor[i], ts, values, 3, MAX_READ);
+            for (j = 0; j < n; j++) {
+                samples[max].type = types[i];
+                samples[max].timestamp_us = ts[j];
+                memcpy(samples[max].values, &values[3*j], 3 * sizeof(double));
+                max++;
+            }
+        }
+        qsort(samples, max, sizeof(sample_t), compare_samples);
+
+        // run the filter, and publish the result
+        updated = false;
+        for (i = 0; i < max; i++) {
+            updated |= sdlx_fusion_sample(f, samples[i].type, samples[i].timestamp_us, samples[i].values);
+        }
+        if (updated && sdlx_fusion_get(f, &o) == 0) {
+            pthread_mutex_lock(&mutex);
+            fusion_orientation = o;
+            fusion_valid = true;
+            pthread_mutex_unlock(&mutex);
+        }
+    }
+
+    INFO("fusion stopped\n");
+    sdlx_fusion_destroy(f);
+    free(samples);
+    return NULL;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    long ta = ((sample_t*)a)->timestamp_us;
+    long tb = ((sample_t*)b)->timestamp_us;
+
+    return (ta < tb ? -1 : ta > tb ? 1 : 0);
+}
+
+// -----------------  TEST  --------------------------------
+
+// runs the filter over a sensor sample file, printing the orientation as json
+// lines at 100 ms intervals of sample time; and then runs it again, untimed
+// by the output, to report the filter's throughput
+// the file has a sample per line: timestamp_us, ASENSOR_TYPE, and the values;
+// lines that don't begin with a sample, such as comments, are skipped
+int sdlx_fusion_test(char *path)
+{
+    FILE              *fp;
+    sdlx_fusion_t     *f;
+    sdlx_orientation_t o;
+    sample_t          *samples = NULL, *x;
+    char               line[1000];
+    long               next_output_us = 0, start_us, cpu_us;
+    int                i, max = 0, max_alloc = 0, num_updates = 0;
+
+    // read the samples
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: failed to open %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (max == max_alloc) {
+            max_alloc = (max_alloc ? 2 * max_alloc : 10000);
+            x = realloc(samples, max_alloc * sizeof(sample_t));
+            if (x == NULL) {
+                fprintf(stderr, "ERROR: out of memory reading %s\n", path);
+                fclose(fp);
+                free(samples);
+                return -1;
+            }
+            samples = x;
+        }
+        x = &samples[max];
+        memset(x, 0, sizeof(*x));
+        if (sscanf(line, "%ld %d %lf %lf %lf", 
+                   &x->timestamp_us, &x->type, &x->values[0], &x->values[1], &x->values[2]) >= 3) {
+            max++;
+        }
+    }
+    fclose(fp);
+
+    // run the filter, printing the orientation
+    f = sdlx_fusion_create(0);
+    for (i = 0; i < max; i++) {
+        if (!sdlx_fusion_sample(f, samples[i].type, samples[i].timestamp_us, samples[i].values)) {
+            continue;
+        }
+        num_updates++;
+        sdlx_fusion_get(f, &o);
+        if (o.timestamp_us >= next_output_us) {
+            printf("{\"timestamp_us\":%ld, \"q\":[%.5f,%.5f,%.5f,%.5f], "
+                   "\"roll\":%.2f, \"pitch\":%.2f, \"heading\":%.2f}\n",
+                   o.timestamp_us, o.q[0], o.q[1], o.q[2], o.q[3], o.roll, o.pitch, o.heading);
+            next_output_us = o.timestamp_us + TEST_OUTPUT_INTVL_US;
+        }
+    }
+    sdlx_fusion_destroy(f);
+
+    // run it again for the throughput
+    f = sdlx_fusion_create(0);
+    start_us = util_monotonic_microsec_timer();
+    for (i = 0; i < max; i++) {
+        sdlx_fusion_sample(f, samples[i].type, samples[i].timestamp_us, samples[i].values);
+    }
+    cpu_us = util_monotonic_microsec_timer() - start_us;
+    sdlx_fusion_destroy(f);
+
+    printf("{\"file\":\"%s\", \"samples\":%d, \"updates\":%d, \"ns_per_sample\":%.0f}\n",
+           path, max, num_updates, max ? cpu_us * 1000. / max : 0.);
+    free(samples);
+    return num_updates > 0 ? 0 : -1;
+}
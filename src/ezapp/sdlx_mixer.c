@@ -0,0 +1,1112 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+#include <SDL3/SDL.h>
+
+#include <stdatomic.h>
+
+// Audio mixer engine.
+//
+// A single playback stream is opened, with a callback that SDL calls from its
+// audio thread whenever the device needs more data. The callback mixes all of
+// the active voices, each with its own gain and pan, into 48000 stereo.
+//
+// A voice plays a sound. Sounds are either held in memory (raw files, mp3 files
+// decoded when loaded, and rendered tones), or are an mp3 stream. A stream has
+// a decoder thread, which decodes, resamples and seeks, filling the stream's
+// single producer / single consumer ring; since a stream is played by one voice
+// at a time, the ring is that voice's, and the callback only copies from it.
+// A seek of a stream is requested of its decoder thread, which publishes the
+// ring position where the data at the new position starts; until then, and
+// when the decoder falls behind, the voice is silent.
+//
+// Voices are controlled through a single producer / single consumer command
+// queue; the producer side is serialized by ctl_mutex, which the callback never
+// takes. So starting a voice costs a queue entry, and it begins at the next
+// callback. The slot state is the only other thing shared with the callback:
+//   FREE -> STARTING         control side, before queueing CMD_PLAY
+//   STARTING -> PLAYING      callback, on CMD_PLAY
+//   PLAYING -> DONE          callback, at end of sound or on CMD_STOP
+//   DONE -> FREE             control side, reap_voices releases the sound
+// A CMD_PLAY that can't be queued returns the slot to FREE.
+// Sounds are reference counted on the control side only, so a sound that is
+// freed while being played is released when its last voice is reaped.
+
+//
+// defines
+//
+
+#define SAMPLE_RATE      48000
+#define MIX_FRAMES       512
+#define CMDQ_LEN         64     // power of 2
+#define SYNC_TIMEOUT_US  200000
+
+#define VOICE_FREE       0
+#define VOICE_STARTING   1
+#define VOICE_PLAYING    2
+#define VOICE_DONE       3
+
+#define CMD_PLAY         1
+#define CMD_STOP         2
+#define CMD_SET          3
+#define CMD_PAUSE        4
+#define CMD_SEEK         5
+
+#define SOUND_MALLOC     1
+#define SOUND_MMAP       2
+#define SOUND_STREAM     3
+
+#define VOICE_ID(slot,gen)  ((gen) << 8 | (slot))
+#define VOICE_SLOT(id)      ((id) & 0xff)
+#define VOICE_GEN(id)       ((id) >> 8)
+
+#define MIN_TONE_FREQ    100
+#define MAX_TONE_FREQ    3000
+#define MAX_TONE_MS      30000
+#define MAX_SMOOTHER     (SAMPLE_RATE / 200)   // number of frames in 5 ms
+
+#define RING_FRAMES      16384  // power of 2, about 340 ms
+#define DECODER_POLL_NS  10000000
+
+//
+// typedefs
+//
+
+struct sdlx_sound {
+    int          type;
+    int          refcnt;        // control side only
+    int          channels;      // 1 or 2, interleaved
+    short       *data;          // SOUND_MALLOC or SOUND_MMAP
+    long         frames;
+    size_t       map_len;
+
+    // SOUND_STREAM, decoded by the decoder thread
+    sdlx_mp3_t           *mp3;
+    int                   mp3_rate;
+    sdlx_dsp_resampler_t *rs[2];
+    short                *pcm;       // decoded frame, interleaved
+    short                *ch_in[2];  // deinterleaved, at mp3_rate
+    short                *ch_out[2]; // resampled
+    short                *fifo;      // interleaved, at SAMPLE_RATE
+    int                   fifo_len;  // frames
+    int                   fifo_pos;
+
+    // SOUND_STREAM, the ring, interleaved at SAMPLE_RATE; wr is advanced by
+    // the decoder thread, rd by the callback; eof is set by the decoder
+    // thread once the last frames are in the ring
+    short                *ring;
+    atomic_uint           ring_wr;
+    atomic_uint           ring_rd;
+    atomic_bool           eof;
+    atomic_bool           loop;
+
+    // SOUND_STREAM, seeks: seek_req and seek_ms are set by the control side;
+    // the decoder thread publishes each seek it has done with a seqlock
+    atomic_uint           seek_req;
+    atomic_long           seek_ms;
+    atomic_uint           seek_seq;      // odd while being published
+    atomic_uint           seek_done;     // the seek_req that was done
+    atomic_uint           seek_wr;       // the ring position it starts at
+    atomic_long           seek_base_ms;  // and its position in the sound
+    unsigned int          seek_applied;  // callback only
+
+    // SOUND_STREAM, the decoder thread
+    pthread_t             dec_tid;
+    bool                  dec_started;
+    bool                  dec_quit;
+    pthread_mutex_t       dec_mutex;
+    pthread_cond_t        dec_cond;
+};
+
+typedef struct {
+    atomic_int    state;
+    int           gen;           // control side
+    sdlx_sound_t *snd;
+
+    // callback only
+    long          pos;           // frames, for sounds held in memory
+    long          played;        // frames played since start or seek
+    long          base_ms;       // position of the start or seek
+    bool          paused;
+    bool          loop;
+    float         gl, gr;
+
+    // published by the callback
+    atomic_int    pos_ms;
+    atomic_int    rms;
+    atomic_bool   paused_pub;
+} voice_t;
+
+typedef struct {
+    int   op;
+    int   slot;
+    float gl, gr;
+    long  arg;
+} cmd_t;
+
+//
+// variables
+//
+
+static SDL_AudioStream *stream;
+static pthread_mutex_t  ctl_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static voice_t          voices[SDLX_MIXER_MAX_VOICES];
+
+static cmd_t            cmdq[CMDQ_LEN];
+static atomic_uint      cmdq_head;   // advanced by the callback
+static atomic_uint      cmdq_tail;   // advanced by the control side
+
+static short           *sine_waves[MAX_TONE_FREQ+1];
+static int              sine_wave_len[MAX_TONE_FREQ+1];
+
+//
+// prototypes
+//
+
+static void mixer_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount);
+static void sound_release(sdlx_sound_t *snd);
+static void stream_request_seek(sdlx_sound_t *snd, long ms);
+static void *decoder_thread(void *cx);
+
+// -----------------  ENGINE START / QUIT  ----------------
+
+// called with ctl_mutex held
+static int engine_start(void)
+{
+    const SDL_AudioSpec spec = { SDL_AUDIO_S16, 2, SAMPLE_RATE };
+
+    if (stream != NULL) {
+        return 0;
+    }
+
+    stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, mixer_callback, NULL);
+    if (stream == NULL) {
+        ERROR("SDL_OpenAudioDeviceStream failed, %s\n", SDL_GetError());
+        return -1;
+    }
+    SDL_ResumeAudioStreamDevice(stream);
+
+    INFO("started, %s kernels\n", sdlx_dsp_kernels_name());
+    return 0;
+}
+
+void sdlx_mixer_quit(void)
+{
+    pthread_mutex_lock(&ctl_mutex);
+
+    // destroying the stream stops the callbacks
+    if (stream != NULL) {
+        SDL_DestroyAudioStream(stream);
+        stream = NULL;
+    }
+
+    // release the sounds held by voices, and discard queued commands
+    for (int i = 0; i < SDLX_MIXER_MAX_VOICES; i++) {
+        voice_t *v = &voices[i];
+        if (atomic_load(&v->state) != VOICE_FREE) {
+            sound_release(v->snd);
+            v->snd = NULL;
+            atomic_store(&v->state, VOICE_FREE);
+        }
+    }
+    atomic_store(&cmdq_head, atomic_load(&cmdq_tail));
+
+    pthread_mutex_unlock(&ctl_mutex);
+}
+
+// -----------------  COMMAND QUEUE  ----------------------
+
+// returns -1 if the command was dropped; called with ctl_mutex held
+static int push_cmd(int op, int slot, float gl, float gr, long arg)
+{
+    unsigned int tail = atomic_load_explicit(&cmdq_tail, memory_order_relaxed);
+    long         waited_us = 0;
+
+    // the queue is only full if the callback is not running
+    while (tail - atomic_load_explicit(&cmdq_head, memory_order_acquire) == CMDQ_LEN) {
+        if (waited_us >= SYNC_TIMEOUT_US) {
+            ERROR("command queue full, op=%d dropped\n", op);
+            return -1;
+        }
+        usleep(1000);
+        waited_us += 1000;
+    }
+
+    cmdq[tail % CMDQ_LEN] = (cmd_t){ op, slot, gl, gr, arg };
+    atomic_store_explicit(&cmdq_tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+// waits for the callback to process the queued commands
+void sdlx_mixer_sync(void)
+{
+    unsigned int tail = atomic_load(&cmdq_tail);
+    long         waited_us = 0;
+
+    if (stream == NULL) {
+        return;
+    }
+
+    while ((int)(tail - atomic_load(&cmdq_head)) > 0 && waited_us < SYNC_TIMEOUT_US) {
+        usleep(1000);
+        waited_us += 1000;
+    }
+}
+
+// -----------------  VOICES  -----------------------------
+
+// called with ctl_mutex held
+static void reap_voices(void)
+{
+    for (int i = 0; i < SDLX_MIXER_MAX_VOICES; i++) {
+        voice_t *v = &voices[i];
+        if (atomic_load_explicit(&v->state, memory_order_acquire) == VOICE_DONE) {
+            sound_release(v->snd);
+            v->snd = NULL;
+            atomic_store_explicit(&v->state, VOICE_FREE, memory_order_release);
+        }
+    }
+}
+
+// returns the slot, or -1 if id is not a current voice; called with ctl_mutex held
+static int voice_slot(int id)
+{
+    int slot = VOICE_SLOT(id);
+
+    if (id < 0 || slot >= SDLX_MIXER_MAX_VOICES ||
+        voices[slot].gen != VOICE_GEN(id) ||
+        atomic_load(&voices[slot].state) == VOICE_FREE)
+    {
+        return -1;
+    }
+    return slot;
+}
+
+// constant power pan, -1 is left and +1 is right
+static void gain_pan(double gain, double pan, float *gl, float *gr)
+{
+    if (gain < 0) gain = 0;
+    if (gain > 2) gain = 2;
+    if (pan < -1) pan = -1;
+    if (pan > 1) pan = 1;
+
+    *gl = gain * cos((pan + 1) * M_PI / 4) * M_SQRT2;
+    *gr = gain * sin((pan + 1) * M_PI / 4) * M_SQRT2;
+}
+
+// returns the voice id, or -1 on error
+int sdlx_voice_play(sdlx_sound_t *snd, double gain, double pan, bool loop)
+{
+    int   slot = -1;
+    float gl, gr;
+
+    if (snd == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&ctl_mutex);
+
+    if (engine_start() < 0) {
+        goto done;
+    }
+    reap_voices();
+
+    // a stream holds the decoder state, so it can only be played by one voice
+    if (snd->type == SOUND_STREAM && snd->refcnt > 1) {
+        ERROR("stream is already being played\n");
+        goto done;
+    }
+
+    // allocate a voice
+    for (int i = 0; i < SDLX_MIXER_MAX_VOICES; i++) {
+        if (atomic_load(&voices[i].state) == VOICE_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == -1) {
+        WARN("no free voice\n");
+        goto done;
+    }
+
+    voices[slot].gen = (voices[slot].gen + 1) & 0x7fffff;
+    voices[slot].snd = snd;
+    snd->refcnt++;
+    atomic_store(&voices[slot].state, VOICE_STARTING);
+
+    // a stream is played from the start
+    if (snd->type == SOUND_STREAM) {
+        atomic_store(&snd->loop, loop);
+        stream_request_seek(snd, 0);
+    }
+
+    // if the command can't be queued then the voice is not started
+    gain_pan(gain, pan, &gl, &gr);
+    if (push_cmd(CMD_PLAY, slot, gl, gr, loop) < 0) {
+        voices[slot].snd = NULL;
+        sound_release(snd);
+        atomic_store(&voices[slot].state, VOICE_FREE);
+        slot = -1;
+    }
+
+done:
+    pthread_mutex_unlock(&ctl_mutex);
+    return (slot >= 0 ? VOICE_ID(slot, voices[slot].gen) : -1);
+}
+
+// voice_cmd is used by the following to queue a command for a current voice
+static void voice_cmd(int id, int op, float gl, float gr, long arg)
+{
+    int slot;
+
+    pthread_mutex_lock(&ctl_mutex);
+    reap_voices();
+    slot = voice_slot(id);
+    if (slot >= 0) {
+        push_cmd(op, slot, gl, gr, arg);
+    }
+    pthread_mutex_unlock(&ctl_mutex);
+}
+
+void sdlx_voice_stop(int id)
+{
+    voice_cmd(id, CMD_STOP, 0, 0, 0);
+}
+
+void sdlx_voice_set(int id, double gain, double pan)
+{
+    float gl, gr;
+
+    gain_pan(gain, pan, &gl, &gr);
+    voice_cmd(id, CMD_SET, gl, gr, 0);
+}
+
+void sdlx_voice_pause(int id, bool pause)
+{
+    voice_cmd(id, CMD_PAUSE, 0, 0, pause);
+}
+
+// a stream's seek is done by its decoder thread, other sounds' by the callback
+void sdlx_voice_seek(int id, int ms)
+{
+    int slot;
+
+    pthread_mutex_lock(&ctl_mutex);
+    reap_voices();
+    slot = voice_slot(id);
+    if (slot >= 0) {
+        if (voices[slot].snd->type == SOUND_STREAM) {
+            stream_request_seek(voices[slot].snd, ms);
+        } else {
+            push_cmd(CMD_SEEK, slot, 0, 0, ms);
+        }
+    }
+    pthread_mutex_unlock(&ctl_mutex);
+}
+
+bool sdlx_voice_active(int id)
+{
+    bool active;
+
+    pthread_mutex_lock(&ctl_mutex);
+    reap_voices();
+    active = (voice_slot(id) >= 0);
+    pthread_mutex_unlock(&ctl_mutex);
+
+    return active;
+}
+
+// returns false if the voice has completed
+bool sdlx_voice_get_info(int id, sdlx_voice_info_t *info)
+{
+    int slot;
+
+    memset(info, 0, sizeof(sdlx_voice_info_t));
+
+    pthread_mutex_lock(&ctl_mutex);
+    reap_voices();
+    slot = voice_slot(id);
+    if (slot >= 0) {
+        voice_t *v = &voices[slot];
+        info->paused   = atomic_load(&v->paused_pub);
+        info->pos_ms   = atomic_load(&v->pos_ms);
+        info->total_ms = sdlx_sound_duration_ms(v->snd);
+        info->rms      = atomic_load(&v->rms);
+    }
+    pthread_mutex_unlock(&ctl_mutex);
+
+    return slot >= 0;
+}
+
+// -----------------  SOUNDS  -----------------------------
+
+static sdlx_sound_t *sound_alloc(int type, int channels)
+{
+    sdlx_sound_t *snd;
+
+    snd = calloc(1, sizeof(sdlx_sound_t));
+    if (snd == NULL) {
+        ERROR("failed to allocate sound\n");
+        return NULL;
+    }
+    snd->type     = type;
+    snd->refcnt   = 1;
+    snd->channels = channels;
+    return snd;
+}
+
+// called with ctl_mutex held
+static void sound_release(sdlx_sound_t *snd)
+{
+    if (snd == NULL || --snd->refcnt > 0) {
+        return;
+    }
+
+    switch (snd->type) {
+    case SOUND_MALLOC:
+        free(snd->data);
+        break;
+    case SOUND_MMAP:
+        munmap(snd->data, snd->map_len);
+        break;
+    case SOUND_STREAM:
+        if (snd->dec_started) {
+            pthread_mutex_lock(&snd->dec_mutex);
+            snd->dec_quit = true;
+            pthread_cond_signal(&snd->dec_cond);
+            pthread_mutex_unlock(&snd->dec_mutex);
+            pthread_join(snd->dec_tid, NULL);
+        }
+        pthread_mutex_destroy(&snd->dec_mutex);
+        pthread_cond_destroy(&snd->dec_cond);
+        free(snd->ring);
+        sdlx_mp3_close(snd->mp3);
+        for (int ch = 0; ch < 2; ch++) {
+            sdlx_dsp_resampler_destroy(snd->rs[ch]);
+            free(snd->ch_in[ch]);
+            free(snd->ch_out[ch]);
+        }
+        free(snd->pcm);
+        free(snd->fifo);
+        break;
+    }
+    free(snd);
+}
+
+void sdlx_sound_free(sdlx_sound_t *snd)
+{
+    pthread_mutex_lock(&ctl_mutex);
+    sound_release(snd);
+    pthread_mutex_unlock(&ctl_mutex);
+}
+
+int sdlx_sound_duration_ms(sdlx_sound_t *snd)
+{
+    int  sample_rate, channels;
+    long total_samples;
+
+    if (snd->type == SOUND_STREAM) {
+        sdlx_mp3_get_info(snd->mp3, &sample_rate, &channels, &total_samples);
+        return total_samples * 1000 / sample_rate;
+    }
+    return snd->frames * 1000 / SAMPLE_RATE;
+}
+
+// decodes an mp3 file into memory, resampled to SAMPLE_RATE
+static sdlx_sound_t *load_mp3(char *path)
+{
+    sdlx_mp3_t           *mp3;
+    sdlx_sound_t         *snd = NULL;
+    sdlx_dsp_resampler_t *rs[2] = { NULL, NULL };
+    int                   sample_rate, channels, n, ch;
+    long                  total_samples, alloc, frames = 0;
+    short                 pcm[SDLX_MP3_MAX_DECODE_SAMPLES * 2];
+    short                 ch_in[SDLX_MP3_MAX_DECODE_SAMPLES];
+    short                *ch_out = NULL;
+
+    mp3 = sdlx_mp3_open(path);
+    if (mp3 == NULL) {
+        return NULL;
+    }
+    sdlx_mp3_get_info(mp3, &sample_rate, &channels, &total_samples);
+
+    snd = sound_alloc(SOUND_MALLOC, channels);
+    if (snd == NULL) {
+        goto error;
+    }
+    alloc = (total_samples * SAMPLE_RATE / sample_rate + 2 * SDLX_MP3_MAX_DECODE_SAMPLES) * channels;
+    snd->data = malloc(alloc * sizeof(short));
+    if (snd->data == NULL) {
+        ERROR("failed to allocate %ld samples for '%s'\n", alloc, path);
+        goto error;
+    }
+
+    if (sample_rate != SAMPLE_RATE) {
+        for (ch = 0; ch < channels; ch++) {
+            rs[ch] = sdlx_dsp_resampler_create(sample_rate, SAMPLE_RATE);
+            if (rs[ch] == NULL) goto error;
+        }
+        ch_out = malloc(sdlx_dsp_resample_max_out(rs[0], SDLX_MP3_MAX_DECODE_SAMPLES) * sizeof(short));
+        if (ch_out == NULL) goto error;
+    }
+
+    while ((n = sdlx_mp3_decode(mp3, pcm)) > 0) {
+        int n_out = n;
+        if (sample_rate == SAMPLE_RATE) {
+            if ((frames + n) * channels > alloc) break;
+            memcpy(snd->data + frames * channels, pcm, n * channels * sizeof(short));
+        } else {
+            if ((frames + sdlx_dsp_resample_max_out(rs[0], n)) * channels > alloc) break;
+            for (ch = 0; ch < channels; ch++) {
+                for (int i = 0; i < n; i++) ch_in[i] = pcm[i*channels+ch];
+                n_out = sdlx_dsp_resample(rs[ch], ch_in, n, ch_out);
+                for (int i = 0; i < n_out; i++) snd->data[(frames+i)*channels+ch] = ch_out[i];
+            }
+        }
+        frames += n_out;
+    }
+    snd->frames = frames;
+
+    for (ch = 0; ch < 2; ch++) sdlx_dsp_resampler_destroy(rs[ch]);
+    free(ch_out);
+    sdlx_mp3_close(mp3);
+    return snd;
+
+error:
+    for (ch = 0; ch < 2; ch++) sdlx_dsp_resampler_destroy(rs[ch]);
+    free(ch_out);
+    sdlx_mp3_close(mp3);
+    sdlx_sound_free(snd);
+    return NULL;
+}
+
+// maps a raw file, 48000 mono S16
+static sdlx_sound_t *load_raw(char *path)
+{
+    sdlx_sound_t *snd;
+    struct stat   statbuf;
+    void         *data;
+    int           fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("failed to open '%s', %s\n", path, strerror(errno));
+        return NULL;
+    }
+    fstat(fd, &statbuf);
+    if (statbuf.st_size < 2) {
+        ERROR("'%s' is empty\n", path);
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ERROR("failed to map '%s', %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    snd = sound_alloc(SOUND_MMAP, 1);
+    if (snd == NULL) {
+        munmap(data, statbuf.st_size);
+        return NULL;
+    }
+    snd->data    = data;
+    snd->map_len = statbuf.st_size;
+    snd->frames  = statbuf.st_size / 2;
+    return snd;
+}
+
+static bool is_mp3(char *filename)
+{
+    int len = strlen(filename);
+
+    return len > 4 && strcasecmp(filename+len-4, ".mp3") == 0;
+}
+
+// loads a raw (48000 mono S16) or mp3 file into memory
+sdlx_sound_t *sdlx_sound_load(char *dir, char *filename)
+{
+    char path[200];
+
+    sprintf(path, "%s/%s", dir, filename);
+    return is_mp3(filename) ? load_mp3(path) : load_raw(path);
+}
+
+// opens an mp3 file that is decoded as it is played; this sound
+// can only be played by one voice at a time
+sdlx_sound_t *sdlx_sound_open_stream(char *path)
+{
+    sdlx_sound_t *snd;
+    sdlx_mp3_t   *mp3;
+    int           sample_rate, channels, max_out;
+    long          total_samples;
+
+    mp3 = sdlx_mp3_open(path);
+    if (mp3 == NULL) {
+        return NULL;
+    }
+    sdlx_mp3_get_info(mp3, &sample_rate, &channels, &total_samples);
+
+    snd = sound_alloc(SOUND_STREAM, channels);
+    if (snd == NULL) {
+        sdlx_mp3_close(mp3);
+        return NULL;
+    }
+    snd->mp3      = mp3;
+    snd->mp3_rate = sample_rate;
+    pthread_mutex_init(&snd->dec_mutex, NULL);
+    pthread_cond_init(&snd->dec_cond, NULL);
+
+    // all buffers are allocated here, rather than by the callback
+    max_out = SDLX_MP3_MAX_DECODE_SAMPLES;
+    if (sample_rate != SAMPLE_RATE) {
+        for (int ch = 0; ch < channels; ch++) {
+            snd->rs[ch]     = sdlx_dsp_resampler_create(sample_rate, SAMPLE_RATE);
+            snd->ch_in[ch]  = malloc(SDLX_MP3_MAX_DECODE_SAMPLES * sizeof(short));
+            if (snd->rs[ch] == NULL || snd->ch_in[ch] == NULL) goto error;
+            max_out = sdlx_dsp_resample_max_out(snd->rs[ch], SDLX_MP3_MAX_DECODE_SAMPLES);
+            snd->ch_out[ch] = malloc(max_out * sizeof(short));
+            if (snd->ch_out[ch] == NULL) goto error;
+        }
+    }
+    snd->pcm  = malloc(SDLX_MP3_MAX_DECODE_SAMPLES * channels * sizeof(short));
+    snd->fifo = malloc(max_out * channels * sizeof(short));
+    snd->ring = malloc(RING_FRAMES * channels * sizeof(short));
+    if (snd->pcm == NULL || snd->fifo == NULL || snd->ring == NULL) {
+        goto error;
+    }
+
+    // the decoder thread starts filling the ring
+    if (pthread_create(&snd->dec_tid, NULL, decoder_thread, snd) != 0) {
+        ERROR("failed to create decoder thread for '%s'\n", path);
+        sdlx_sound_free(snd);
+        return NULL;
+    }
+    snd->dec_started = true;
+
+    return snd;
+
+error:
+    ERROR("failed to allocate stream buffers for '%s'\n", path);
+    sdlx_sound_free(snd);
+    return NULL;
+}
+
+// renders a list of tones and gaps, terminated by an entry with intvl_ms 0;
+// the start and end of each tone are ramped to avoid clicks
+sdlx_sound_t *sdlx_sound_create_tones(sdlx_tone_t *tones)
+{
+    sdlx_sound_t *snd;
+    long          frames = 0, pos = 0;
+    int           i;
+
+    static double smoother[MAX_SMOOTHER];
+    static pthread_mutex_t tones_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    // determine the total length
+    for (i = 0; tones[i].intvl_ms > 0; i++) {
+        frames += (long)SAMPLE_RATE * (tones[i].intvl_ms < MAX_TONE_MS ? tones[i].intvl_ms : MAX_TONE_MS) / 1000;
+    }
+
+    snd = sound_alloc(SOUND_MALLOC, 1);
+    if (snd == NULL) {
+        return NULL;
+    }
+    snd->data = calloc(frames + 1, sizeof(short));
+    if (snd->data == NULL) {
+        ERROR("failed to allocate %ld frames\n", frames);
+        free(snd);
+        return NULL;
+    }
+    snd->frames = frames;
+
+    // the sine wave and smoother tables are shared, and created when first needed
+    pthread_mutex_lock(&tones_mutex);
+    if (smoother[MAX_SMOOTHER-1] == 0) {
+        // "equation for an s curve to smootly ramp up or down audio data"
+        // "plot 3x^2 - 2x^3"
+        for (i = 0; i < MAX_SMOOTHER; i++) {
+            double x = (double)i / MAX_SMOOTHER;
+            smoother[i] = 3 * x * x - 2 * x * x * x;
+        }
+    }
+
+    for (i = 0; tones[i].intvl_ms > 0; i++) {
+        int   freq = tones[i].freq;
+        long  n = (long)SAMPLE_RATE * (tones[i].intvl_ms < MAX_TONE_MS ? tones[i].intvl_ms : MAX_TONE_MS) / 1000;
+        short *p = snd->data + pos;
+
+        pos += n;
+        if (freq == 0) {
+            continue;  // gap
+        }
+        if (freq < MIN_TONE_FREQ) freq = MIN_TONE_FREQ;
+        if (freq > MAX_TONE_FREQ) freq = MAX_TONE_FREQ;
+
+        // one cycle of the sine wave, for this freq
+        if (sine_waves[freq] == NULL) {
+            int len = nearbyint((double)SAMPLE_RATE / freq);
+            short *sw = malloc(len * sizeof(short));
+            for (int j = 0; j < len; j++) {
+                sw[j] = 32767 * sin((2*M_PI) * ((double)j / len));
+            }
+            sine_wave_len[freq] = len;
+            sine_waves[freq] = sw;
+        }
+
+        // whole cycles of the sine wave, followed by silence
+        int len = sine_wave_len[freq];
+        long cycles = n / len;
+        for (long c = 0; c < cycles; c++) {
+            memcpy(p + c * len, sine_waves[freq], len * sizeof(short));
+        }
+
+        // ramp
+        if (cycles * len >= 3 * MAX_SMOOTHER) {
+            long end = cycles * len - 1;
+            for (int j = 0; j < MAX_SMOOTHER; j++) {
+                p[j]     *= smoother[j];
+                p[end-j] *= smoother[j];
+            }
+        }
+    }
+    pthread_mutex_unlock(&tones_mutex);
+
+    return snd;
+}
+
+// -----------------  STREAM DECODER  ---------------------
+
+// called with ctl_mutex held
+static void stream_request_seek(sdlx_sound_t *snd, long ms)
+{
+    atomic_store(&snd->seek_ms, ms);
+    pthread_mutex_lock(&snd->dec_mutex);
+    atomic_fetch_add(&snd->seek_req, 1);
+    pthread_cond_signal(&snd->dec_cond);
+    pthread_mutex_unlock(&snd->dec_mutex);
+}
+
+// decodes and resamples the next mp3 frame into the fifo; returns false at eof
+static bool stream_fill(sdlx_sound_t *snd)
+{
+    int n, ch, channels = snd->channels;
+
+    n = sdlx_mp3_decode(snd->mp3, snd->pcm);
+    if (n <= 0) {
+        return false;
+    }
+
+    if (snd->mp3_rate == SAMPLE_RATE) {
+        memcpy(snd->fifo, snd->pcm, n * channels * sizeof(short));
+        snd->fifo_len = n;
+    } else {
+        int n_out = 0;
+        for (ch = 0; ch < channels; ch++) {
+            for (int i = 0; i < n; i++) snd->ch_in[ch][i] = snd->pcm[i*channels+ch];
+            n_out = sdlx_dsp_resample(snd->rs[ch], snd->ch_in[ch], n, snd->ch_out[ch]);
+            for (int i = 0; i < n_out; i++) snd->fifo[i*channels+ch] = snd->ch_out[ch][i];
+        }
+        snd->fifo_len = n_out;
+    }
+    snd->fifo_pos = 0;
+
+    return true;
+}
+
+// does the latest requested seek, and publishes the ring position where the
+// data at the new position starts
+static void stream_seek(sdlx_sound_t *snd, unsigned int req)
+{
+    long pos, base_ms;
+
+    pos = sdlx_mp3_seek(snd->mp3, atomic_load(&snd->seek_ms));
+    base_ms = (pos >= 0 ? pos * 1000 / snd->mp3_rate : 0);
+    snd->fifo_pos = snd->fifo_len = 0;
+    atomic_store(&snd->eof, false);
+
+    atomic_fetch_add_explicit(&snd->seek_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&snd->seek_wr, atomic_load(&snd->ring_wr), memory_order_relaxed);
+    atomic_store_explicit(&snd->seek_base_ms, base_ms, memory_order_relaxed);
+    atomic_store_explicit(&snd->seek_done, req, memory_order_relaxed);
+    atomic_fetch_add_explicit(&snd->seek_seq, 1, memory_order_release);
+}
+
+// copies the fifo to the ring, as space allows; returns the frames copied
+static int stream_put(sdlx_sound_t *snd)
+{
+    unsigned int wr = atomic_load_explicit(&snd->ring_wr, memory_order_relaxed);
+    unsigned int rd = atomic_load_explicit(&snd->ring_rd, memory_order_acquire);
+    int          channels = snd->channels;
+    int          n, i, idx;
+
+    n = snd->fifo_len - snd->fifo_pos;
+    if (n > RING_FRAMES - (int)(wr - rd)) {
+        n = RING_FRAMES - (int)(wr - rd);
+    }
+    for (i = 0; i < n; i++) {
+        idx = (wr + i) & (RING_FRAMES - 1);
+        memcpy(snd->ring + idx * channels, snd->fifo + (snd->fifo_pos + i) * channels, channels * sizeof(short));
+    }
+    snd->fifo_pos += n;
+    atomic_store_explicit(&snd->ring_wr, wr + n, memory_order_release);
+    return n;
+}
+
+static void *decoder_thread(void *cx)
+{
+    sdlx_sound_t   *snd = cx;
+    unsigned int    req, done = 0;
+    bool            idle;
+    struct timespec ts;
+
+    while (true) {
+        // do the latest seek requested
+        req = atomic_load(&snd->seek_req);
+        if (req != done) {
+            stream_seek(snd, req);
+            done = req;
+        }
+
+        // decode the next frame when the fifo is empty, rewinding at the end
+        // of a looped stream, and copy the fifo to the ring
+        idle = false;
+        if (snd->fifo_pos == snd->fifo_len && !atomic_load(&snd->eof)) {
+            if (!stream_fill(snd)) {
+                if (atomic_load(&snd->loop)) {
+                    sdlx_mp3_seek(snd->mp3, 0);
+                    if (!stream_fill(snd)) atomic_store_explicit(&snd->eof, true, memory_order_release);
+                } else {
+                    atomic_store_explicit(&snd->eof, true, memory_order_release);
+                }
+            }
+        }
+        if (atomic_load(&snd->eof) || stream_put(snd) == 0) {
+            idle = true;
+        }
+
+        // wait, when the ring is full or at eof, for the callback to consume
+        // frames, or for a seek request
+        pthread_mutex_lock(&snd->dec_mutex);
+        if (snd->dec_quit) {
+            pthread_mutex_unlock(&snd->dec_mutex);
+            break;
+        }
+        if (idle && atomic_load(&snd->seek_req) == done) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += DECODER_POLL_NS;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&snd->dec_cond, &snd->dec_mutex, &ts);
+        }
+        pthread_mutex_unlock(&snd->dec_mutex);
+    }
+
+    return NULL;
+}
+
+// -----------------  CALLBACK  ---------------------------
+
+// applies a seek that the decoder thread has published; returns false while
+// a requested seek is not yet done
+static bool stream_apply_seek(voice_t *v)
+{
+    sdlx_sound_t *snd = v->snd;
+    unsigned int  seq, done, wr;
+    long          base_ms;
+
+    seq = atomic_load_explicit(&snd->seek_seq, memory_order_acquire);
+    if ((seq & 1) == 0) {
+        done    = atomic_load_explicit(&snd->seek_done, memory_order_relaxed);
+        wr      = atomic_load_explicit(&snd->seek_wr, memory_order_relaxed);
+        base_ms = atomic_load_explicit(&snd->seek_base_ms, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&snd->seek_seq, memory_order_relaxed) == seq && done != snd->seek_applied) {
+            // the frames before wr are from before the seek
+            atomic_store_explicit(&snd->ring_rd, wr, memory_order_release);
+            snd->seek_applied = done;
+            v->base_ms = base_ms;
+            v->played = 0;
+            atomic_store(&v->pos_ms, v->base_ms);
+        }
+    }
+
+    return snd->seek_applied == atomic_load(&snd->seek_req);
+}
+
+// returns the number of frames, up to max, at *p; 0 at the end of the sound,
+// and -1 while a stream's frames are not available
+static int voice_frames(voice_t *v, int max, short **p)
+{
+    sdlx_sound_t *snd = v->snd;
+    unsigned int  rd, wr;
+    int           n, idx;
+
+    if (snd->type != SOUND_STREAM) {
+        if (v->pos >= snd->frames && v->loop) {
+            v->pos = 0;
+        }
+        n = (snd->frames - v->pos < max ? snd->frames - v->pos : max);
+        *p = snd->data + v->pos * snd->channels;
+        return n;
+    }
+
+    if (!stream_apply_seek(v)) {
+        return -1;
+    }
+    rd = atomic_load_explicit(&snd->ring_rd, memory_order_relaxed);
+    wr = atomic_load_explicit(&snd->ring_wr, memory_order_acquire);
+    if (rd == wr) {
+        return (atomic_load_explicit(&snd->eof, memory_order_acquire) &&
+                rd == atomic_load_explicit(&snd->ring_wr, memory_order_acquire) ? 0 : -1);
+    }
+    idx = rd & (RING_FRAMES - 1);
+    n = wr - rd;
+    if (n > RING_FRAMES - idx) n = RING_FRAMES - idx;
+    if (n > max) n = max;
+    *p = snd->ring + idx * snd->channels;
+    return n;
+}
+
+// consumes the frames returned by voice_frames, once they have been mixed
+static void voice_advance(voice_t *v, int n)
+{
+    if (v->snd->type != SOUND_STREAM) {
+        v->pos += n;
+    } else {
+        atomic_fetch_add_explicit(&v->snd->ring_rd, n, memory_order_release);
+    }
+}
+
+static void process_cmds(void)
+{
+    unsigned int head = atomic_load_explicit(&cmdq_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&cmdq_tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+        cmd_t   *c = &cmdq[head % CMDQ_LEN];
+        voice_t *v = &voices[c->slot];
+
+        switch (c->op) {
+        case CMD_PLAY:
+            v->pos     = 0;
+            v->played  = 0;
+            v->base_ms = 0;
+            v->paused  = false;
+            v->loop    = c->arg;
+            v->gl      = c->gl;
+            v->gr      = c->gr;
+            atomic_store(&v->pos_ms, 0);
+            atomic_store(&v->rms, 0);
+            atomic_store(&v->paused_pub, false);
+            atomic_store_explicit(&v->state, VOICE_PLAYING, memory_order_release);
+            break;
+        case CMD_STOP:
+            if (atomic_load(&v->state) == VOICE_PLAYING) {
+                atomic_store_explicit(&v->state, VOICE_DONE, memory_order_release);
+            }
+            break;
+        case CMD_SET:
+            v->gl = c->gl;
+            v->gr = c->gr;
+            break;
+        case CMD_PAUSE:
+            v->paused = c->arg;
+            atomic_store(&v->paused_pub, v->paused);
+            break;
+        case CMD_SEEK:   // sounds held in memory
+            if (atomic_load(&v->state) != VOICE_PLAYING) {
+                break;
+            }
+            v->pos = (long)c->arg * SAMPLE_RATE / 1000;
+            if (v->pos > v->snd->frames) v->pos = v->snd->frames;
+            v->base_ms = v->pos * 1000 / SAMPLE_RATE;
+            v->played = 0;
+            atomic_store(&v->pos_ms, v->base_ms);
+            break;
+        }
+    }
+
+    atomic_store_explicit(&cmdq_head, head, memory_order_release);
+}
+
+// adds the voice to the stereo accumulator
+static void mix_voice(voice_t *v, float *acc, int frames)
+{
+    int    done = 0, n, peak;
+    double rms_sum = 0, rms;
+
+    while (done < frames) {
+        short *p;
+
+        // at the end the voice is done; and a stream that is seeking, or
+        // whose decoder is behind, is silent for the rest of this mix
+        n = voice_frames(v, frames - done, &p);
+        if (n <= 0) {
+            if (n == 0) {
+                atomic_store_explicit(&v->state, VOICE_DONE, memory_order_release);
+            }
+            break;
+        }
+
+        if (v->snd->channels == 1) {
+            for (int i = 0; i < n; i++) {
+                acc[2*(done+i)]   += p[i] * v->gl;
+                acc[2*(done+i)+1] += p[i] * v->gr;
+            }
+        } else {
+            for (int i = 0; i < n; i++) {
+                acc[2*(done+i)]   += p[2*i]   * v->gl;
+                acc[2*(done+i)+1] += p[2*i+1] * v->gr;
+            }
+        }
+
+        sdlx_dsp_meter(p, n * v->snd->channels, &rms, &peak);
+        voice_advance(v, n);
+        rms_sum += rms * rms * n;
+        done += n;
+    }
+
+    v->played += done;
+    atomic_store(&v->pos_ms, v->base_ms + v->played * 1000 / SAMPLE_RATE);
+    if (done > 0) {
+        atomic_store(&v->rms, sqrt(rms_sum / done));
+    }
+}
+
+static void mixer_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount)
+{
+    static float acc[2*MIX_FRAMES];
+    static short out[2*MIX_FRAMES];
+    int          frames = additional_amount / (2 * sizeof(short));
+
+    process_cmds();
+
+    while (frames > 0) {
+        int n = (frames < MIX_FRAMES ? frames : MIX_FRAMES);
+
+        memset(acc, 0, 2 * n * sizeof(float));
+        for (int i = 0; i < SDLX_MIXER_MAX_VOICES; i++) {
+            voice_t *v = &voices[i];
+            if (atomic_load_explicit(&v->state, memory_order_acquire) == VOICE_PLAYING && !v->paused) {
+                mix_voice(v, acc, n);
+            }
+        }
+
+        for (int i = 0; i < 2*n; i++) {
+            long x = lrintf(acc[i]);
+            out[i] = (x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+        }
+        SDL_PutAudioStreamData(stream, out, 2 * n * sizeof(short));
+
+        frames -= n;
+    }
+}
@@ -0,0 +1,571 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+#include <lame/lame.h>
+
+// Streaming mp3 decoder, using the mpglib decoder that is built into libmp3lame.
+//
+// The file is read through a small buffer, and decoded one mp3 frame at a time,
+// so memory use does not depend on the length of the file. Frame headers are
+// parsed here, rather than by mpglib, so that:
+// - the duration is obtained from the Xing/Info or VBRI header when present,
+//   or estimated from the bitrate, without decoding the file
+// - seek scans frame headers only; the file offset of every SEEK_INDEX_INTVL'th
+//   frame is saved in the seek index, so a later seek back is not a rescan;
+//   decoding is restarted SEEK_PREROLL_FRAMES ahead of the target so the bit
+//   reservoir is refilled, and the preroll output is discarded
+// - the encoder delay and padding from the LAME tag are trimmed, along with the
+//   mpglib decoder delay, so the decoded length matches the original audio
+
+//
+// defines
+//
+
+#define READ_BUFF_SIZE       8192
+#define MAX_FRAME_BYTES      2048
+#define SEEK_INDEX_INTVL     64
+#define SEEK_PREROLL_FRAMES  10
+#define DECODER_DELAY        529   // mpglib output lags the encoder input by this many samples
+#define MAX_FRAME_SAMPLES    1152
+#define MAX_DRAIN_SAMPLES    SDLX_MP3_MAX_DECODE_SAMPLES
+
+//
+// typedefs
+//
+
+typedef struct {
+    bool lsf;                // MPEG2 or MPEG2.5
+    int  sample_rate;
+    int  channels;
+    int  bitrate_kbps;
+    int  samples_per_frame;
+    int  frame_bytes;
+    int  side_info_bytes;
+} frame_hdr_t;
+
+struct sdlx_mp3 {
+    int            fd;
+    long           data_start;      // offset of first audio frame
+    long           data_end;        // excludes id3v1 tag
+    int            sample_rate;
+    int            channels;
+    int            samples_per_frame;
+    int            bitrate_kbps;    // of the first frame
+    long           total_samples;   // per channel, after trimming
+    bool           total_is_exact;  // from Xing/Info or VBRI header
+    int            skip_start;      // samples trimmed from start of decoded output
+    hip_t          hip;
+
+    // decode position
+    long           frame_off;       // file offset of the next frame to decode
+    long           frame_num;       // index of the next frame to decode
+    long           sample_pos;      // position of the next sample returned
+    long           raw_min;         // decoded samples prior to this are discarded
+
+    // seek index, file offset of every SEEK_INDEX_INTVL'th frame
+    long          *seek_index;
+    int            max_seek_index;
+    int            alloc_seek_index;
+
+    // read buffer
+    unsigned char  buff[READ_BUFF_SIZE];
+    long           buff_off;
+    int            buff_len;
+
+    short          pcm_l[MAX_DRAIN_SAMPLES];
+    short          pcm_r[MAX_DRAIN_SAMPLES];
+};
+
+//
+// variables
+//
+
+static const short bitrate_tbl[2][16] = {
+    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },  // MPEG1
+    { 0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160, 0 },  // MPEG2, 2.5
+};
+
+static const int sample_rate_tbl[3] = { 44100, 48000, 32000 };
+
+//
+// prototypes
+//
+
+static hip_t decoder_init(void);
+static unsigned char *read_bytes(sdlx_mp3_t *mp3, long off, int len);
+static long find_frame(sdlx_mp3_t *mp3, long off, frame_hdr_t *fh);
+static void read_vbr_header(sdlx_mp3_t *mp3, long off, frame_hdr_t *fh);
+static void add_seek_index(sdlx_mp3_t *mp3, long frame_num, long off);
+
+// -----------------  FRAME HEADER  -----------------------
+
+// only layer III is supported
+static bool parse_frame_hdr(unsigned char *p, frame_hdr_t *fh)
+{
+    int version, layer, bitrate_idx, sample_rate_idx, padding, mode;
+
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0) {
+        return false;
+    }
+
+    version         = (p[1] >> 3) & 3;   // 0 = MPEG2.5, 2 = MPEG2, 3 = MPEG1
+    layer           = (p[1] >> 1) & 3;   // 1 = layer III
+    bitrate_idx     = (p[2] >> 4) & 15;
+    sample_rate_idx = (p[2] >> 2) & 3;
+    padding         = (p[2] >> 1) & 1;
+    mode            = (p[3] >> 6) & 3;   // 3 = mono
+
+    if (version == 1 || layer != 1 || bitrate_idx == 0 || bitrate_idx == 15 || sample_rate_idx == 3) {
+        return false;
+    }
+
+    fh->lsf               = (version != 3);
+    fh->sample_rate       = sample_rate_tbl[sample_rate_idx] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    fh->channels          = (mode == 3 ? 1 : 2);
+    fh->bitrate_kbps      = bitrate_tbl[fh->lsf][bitrate_idx];
+    fh->samples_per_frame = (fh->lsf ? 576 : 1152);
+    fh->frame_bytes       = (fh->lsf ? 72 : 144) * 1000 * fh->bitrate_kbps / fh->sample_rate + padding;
+    fh->side_info_bytes   = (fh->lsf ? (fh->channels == 1 ? 9 : 17) : (fh->channels == 1 ? 17 : 32));
+
+    return true;
+}
+
+// -----------------  OPEN / CLOSE  -----------------------
+
+sdlx_mp3_t *sdlx_mp3_open(char *path)
+{
+    sdlx_mp3_t    *mp3;
+    struct stat    statbuf;
+    unsigned char *p;
+    frame_hdr_t    fh;
+    long           off;
+
+    mp3 = calloc(1, sizeof(sdlx_mp3_t));
+    if (mp3 == NULL) {
+        ERROR("failed to allocate mp3\n");
+        return NULL;
+    }
+    mp3->fd = -1;
+    mp3->buff_off = -1;
+
+    mp3->fd = open(path, O_RDONLY);
+    if (mp3->fd < 0) {
+        ERROR("failed to open '%s', %s\n", path, strerror(errno));
+        goto error;
+    }
+    fstat(mp3->fd, &statbuf);
+    mp3->data_end = statbuf.st_size;
+
+    // skip id3v2 tag at start of file, and exclude id3v1 tag at the end
+    p = read_bytes(mp3, 0, 10);
+    if (p != NULL && memcmp(p, "ID3", 3) == 0) {
+        mp3->data_start = 10 + ((p[6] & 0x7f) << 21 | (p[7] & 0x7f) << 14 |
+                                (p[8] & 0x7f) << 7  | (p[9] & 0x7f));
+        if (p[5] & 0x10) {
+            mp3->data_start += 10;
+        }
+    }
+    if (mp3->data_end >= 128 && (p = read_bytes(mp3, mp3->data_end - 128, 3)) != NULL &&
+        memcmp(p, "TAG", 3) == 0)
+    {
+        mp3->data_end -= 128;
+    }
+
+    // locate the first frame
+    off = find_frame(mp3, mp3->data_start, &fh);
+    if (off < 0) {
+        ERROR("'%s' is not an mp3 file\n", path);
+        goto error;
+    }
+    mp3->data_start        = off;
+    mp3->sample_rate       = fh.sample_rate;
+    mp3->channels          = fh.channels;
+    mp3->samples_per_frame = fh.samples_per_frame;
+    mp3->bitrate_kbps      = fh.bitrate_kbps;
+    mp3->skip_start        = DECODER_DELAY;
+
+    // if the first frame is a Xing/Info or VBRI header then use it for the
+    // duration, and skip it; otherwise estimate the duration from the bitrate
+    read_vbr_header(mp3, off, &fh);
+    if (!mp3->total_is_exact) {
+        mp3->total_samples = (double)(mp3->data_end - mp3->data_start) * 8 /
+                             (fh.bitrate_kbps * 1000) * mp3->sample_rate;
+    }
+
+    // init the decoder
+    mp3->hip = decoder_init();
+    if (mp3->hip == NULL) {
+        goto error;
+    }
+
+    // init decode position
+    mp3->frame_off  = mp3->data_start;
+    mp3->frame_num  = 0;
+    mp3->sample_pos = 0;
+    mp3->raw_min    = mp3->skip_start;
+    add_seek_index(mp3, 0, mp3->data_start);
+    if (mp3->max_seek_index == 0) {
+        goto error;
+    }
+
+    INFO("%s: sample_rate=%d channels=%d duration=%0.3f secs%s\n",
+         path, mp3->sample_rate, mp3->channels,
+         (double)mp3->total_samples / mp3->sample_rate,
+         mp3->total_is_exact ? "" : " (estimated)");
+
+    return mp3;
+
+error:
+    sdlx_mp3_close(mp3);
+    return NULL;
+}
+
+void sdlx_mp3_close(sdlx_mp3_t *mp3)
+{
+    if (mp3 == NULL) {
+        return;
+    }
+
+    if (mp3->hip != NULL) {
+        hip_decode_exit(mp3->hip);
+    }
+    if (mp3->fd >= 0) {
+        close(mp3->fd);
+    }
+    free(mp3->seek_index);
+    free(mp3);
+}
+
+void sdlx_mp3_get_info(sdlx_mp3_t *mp3, int *sample_rate, int *channels, long *total_samples)
+{
+    *sample_rate   = mp3->sample_rate;
+    *channels      = mp3->channels;
+    *total_samples = mp3->total_samples;
+}
+
+int sdlx_mp3_get_bitrate(sdlx_mp3_t *mp3)
+{
+    return mp3->bitrate_kbps;
+}
+
+// returns the duration in ms, or -1 if the file is not an mp3 file
+long sdlx_mp3_duration_ms(char *path)
+{
+    sdlx_mp3_t *mp3;
+    long        ms;
+
+    mp3 = sdlx_mp3_open(path);
+    if (mp3 == NULL) {
+        return -1;
+    }
+    ms = mp3->total_samples * 1000 / mp3->sample_rate;
+    sdlx_mp3_close(mp3);
+
+    return ms;
+}
+
+// -----------------  DECODE / SEEK  ----------------------
+
+// decodes the next frame to interleaved samples;
+// returns the number of samples per channel, 0 at end of file, or -1 on error
+int sdlx_mp3_decode(sdlx_mp3_t *mp3, short *pcm)
+{
+    frame_hdr_t    fh;
+    unsigned char *p;
+    long           off, raw_start, raw_end;
+    int            n, i, total, discard;
+
+    while (true) {
+        // if the total is known exactly, then don't return the encoder padding
+        if (mp3->total_is_exact && mp3->sample_pos >= mp3->total_samples) {
+            return 0;
+        }
+
+        // locate and read the next frame
+        off = find_frame(mp3, mp3->frame_off, &fh);
+        if (off < 0) {
+            return 0;
+        }
+        p = read_bytes(mp3, off, fh.frame_bytes);
+        if (p == NULL) {
+            return 0;
+        }
+        if (mp3->frame_num % SEEK_INDEX_INTVL == 0) {
+            add_seek_index(mp3, mp3->frame_num, off);
+        }
+        mp3->frame_off = off + fh.frame_bytes;
+        mp3->frame_num++;
+
+        // feed the frame to the decoder, and drain it; normally this outputs just
+        // this frame, but following a decoder init the output of the first frames
+        // can be dropped or delayed, so the output is placed so that it ends with
+        // this frame
+        total = 0;
+        n = hip_decode1(mp3->hip, p, fh.frame_bytes, mp3->pcm_l, mp3->pcm_r);
+        while (true) {
+            if (n < 0) {
+                ERROR("hip_decode1 failed, frame_num=%ld\n", mp3->frame_num-1);
+                return -1;
+            }
+            total += n;
+            if (total + MAX_FRAME_SAMPLES > MAX_DRAIN_SAMPLES) {
+                total = 0;
+            }
+            n = hip_decode1(mp3->hip, p, 0, mp3->pcm_l + total, mp3->pcm_r + total);
+            if (n == 0) {
+                break;
+            }
+        }
+        raw_end = mp3->frame_num * mp3->samples_per_frame;
+        raw_start = raw_end - total;
+
+        // discard samples that are trimmed or are seek preroll
+        discard = (raw_start < mp3->raw_min ? mp3->raw_min - raw_start : 0);
+        if (discard >= total) {
+            continue;
+        }
+        n = total - discard;
+        mp3->sample_pos = raw_start + discard - mp3->skip_start;
+        if (mp3->total_is_exact && mp3->sample_pos + n > mp3->total_samples) {
+            n = mp3->total_samples - mp3->sample_pos;
+        }
+        if (n <= 0) {
+            continue;
+        }
+
+        // return the interleaved samples
+        if (mp3->channels == 1) {
+            memcpy(pcm, mp3->pcm_l + discard, n * sizeof(short));
+        } else {
+            for (i = 0; i < n; i++) {
+                pcm[2*i]   = mp3->pcm_l[discard+i];
+                pcm[2*i+1] = mp3->pcm_r[discard+i];
+            }
+        }
+        mp3->sample_pos += n;
+        return n;
+    }
+}
+
+// returns the position, in samples per channel, following the seek; or -1 on error
+long sdlx_mp3_seek(sdlx_mp3_t *mp3, long ms)
+{
+    frame_hdr_t fh;
+    long        target, raw_target, target_frame, start_frame, frame_num, off;
+    int         idx;
+
+    // determine the target sample, and the frame that contains it
+    target = ms * mp3->sample_rate / 1000;
+    if (target < 0) target = 0;
+    if (mp3->total_is_exact && target > mp3->total_samples) target = mp3->total_samples;
+    raw_target = target + mp3->skip_start;
+    target_frame = raw_target / mp3->samples_per_frame;
+    start_frame = target_frame - SEEK_PREROLL_FRAMES;
+    if (start_frame < 0) start_frame = 0;
+
+    // starting from the closest seek index entry, scan frame headers
+    // to locate the start frame
+    idx = start_frame / SEEK_INDEX_INTVL;
+    if (idx >= mp3->max_seek_index) {
+        idx = mp3->max_seek_index - 1;
+    }
+    frame_num = (long)idx * SEEK_INDEX_INTVL;
+    off = mp3->seek_index[idx];
+    while (frame_num < start_frame) {
+        off = find_frame(mp3, off, &fh);
+        if (off < 0) {
+            break;
+        }
+        if (frame_num % SEEK_INDEX_INTVL == 0) {
+            add_seek_index(mp3, frame_num, off);
+        }
+        off += fh.frame_bytes;
+        frame_num++;
+    }
+    if (frame_num < start_frame) {
+        // the target is past the end of the file
+        off = mp3->data_end;
+        raw_target = frame_num * mp3->samples_per_frame;
+        target = (raw_target > mp3->skip_start ? raw_target - mp3->skip_start : 0);
+    }
+
+    // restart the decoder at the start frame; the decoded samples prior
+    // to the target are discarded
+    hip_decode_exit(mp3->hip);
+    mp3->hip = decoder_init();
+    if (mp3->hip == NULL) {
+        return -1;
+    }
+    mp3->frame_off  = off;
+    mp3->frame_num  = frame_num;
+    mp3->sample_pos = target;
+    mp3->raw_min    = raw_target;
+
+    return target;
+}
+
+// returns the position, in samples per channel, of the next sample to be decoded
+long sdlx_mp3_tell(sdlx_mp3_t *mp3)
+{
+    return mp3->sample_pos;
+}
+
+// -----------------  SUPPORT  ----------------------------
+
+static void decoder_report(const char *format, va_list ap)
+{
+}
+
+// mpglib reports errors for the seek preroll frames, that are expected;
+// so the mpglib reports are discarded, and errors are detected by return code
+static hip_t decoder_init(void)
+{
+    hip_t hip;
+
+    hip = hip_decode_init();
+    if (hip == NULL) {
+        ERROR("hip_decode_init failed\n");
+        return NULL;
+    }
+    hip_set_errorf(hip, decoder_report);
+    hip_set_debugf(hip, decoder_report);
+    hip_set_msgf(hip, decoder_report);
+
+    return hip;
+}
+
+// returns pointer to len bytes at file offset off, or NULL if not available
+static unsigned char *read_bytes(sdlx_mp3_t *mp3, long off, int len)
+{
+    int n;
+
+    if (off + len > mp3->data_end && mp3->data_end > 0 && off >= mp3->data_start) {
+        return NULL;
+    }
+
+    if (off < mp3->buff_off || off + len > mp3->buff_off + mp3->buff_len) {
+        n = pread(mp3->fd, mp3->buff, READ_BUFF_SIZE, off);
+        mp3->buff_off = off;
+        mp3->buff_len = (n > 0 ? n : 0);
+        if (len > mp3->buff_len) {
+            return NULL;
+        }
+    }
+
+    return mp3->buff + (off - mp3->buff_off);
+}
+
+// returns the offset of the first valid frame at or after off, or -1 if none;
+// when resyncing the following frame header must also be valid
+static long find_frame(sdlx_mp3_t *mp3, long off, frame_hdr_t *fh)
+{
+    unsigned char *p;
+    frame_hdr_t    next;
+    bool           resync = false;
+
+    for (; off + 4 <= mp3->data_end; off++, resync = true) {
+        if ((p = read_bytes(mp3, off, 4)) == NULL) {
+            return -1;
+        }
+        if (!parse_frame_hdr(p, fh) || fh->frame_bytes > MAX_FRAME_BYTES) {
+            continue;
+        }
+        if (mp3->sample_rate != 0 && fh->sample_rate != mp3->sample_rate) {
+            continue;
+        }
+        if (resync || mp3->sample_rate == 0) {
+            p = read_bytes(mp3, off + fh->frame_bytes, 4);
+            if (p != NULL && (!parse_frame_hdr(p, &next) || next.sample_rate != fh->sample_rate)) {
+                continue;
+            }
+            if (resync) {
+                WARN("resync at offset %ld\n", off);
+            }
+        }
+        return off;
+    }
+
+    return -1;
+}
+
+static inline unsigned int get_be32(unsigned char *p)
+{
+    return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// if the frame at off contains a Xing/Info or VBRI header then set total_samples
+// and skip the frame; and if there is a LAME tag, trim the encoder delay and padding
+static void read_vbr_header(sdlx_mp3_t *mp3, long off, frame_hdr_t *fh)
+{
+    unsigned char *p, *tag;
+    unsigned int   flags;
+    long           frames = -1;
+    int            enc_delay = 0, enc_padding = 0;
+
+    p = read_bytes(mp3, off, fh->frame_bytes);
+    if (p == NULL) {
+        return;
+    }
+
+    tag = p + 4 + fh->side_info_bytes;
+    if (4 + fh->side_info_bytes + 120 + 24 <= fh->frame_bytes &&
+        (memcmp(tag, "Xing", 4) == 0 || memcmp(tag, "Info", 4) == 0))
+    {
+        flags = get_be32(tag+4);
+        tag += 8;
+        if (flags & 1) {
+            frames = get_be32(tag);
+            tag += 4;
+        }
+        if (flags & 2) tag += 4;    // bytes
+        if (flags & 4) tag += 100;  // toc
+        if (flags & 8) tag += 4;    // quality
+        if (memcmp(tag, "LAME", 4) == 0 || memcmp(tag, "Lavc", 4) == 0 || memcmp(tag, "Lavf", 4) == 0) {
+            enc_delay   = (tag[21] << 4) | (tag[22] >> 4);
+            enc_padding = ((tag[22] & 0xf) << 8) | tag[23];
+        }
+    } else if (4 + 32 + 18 <= fh->frame_bytes && memcmp(p+4+32, "VBRI", 4) == 0) {
+        frames = get_be32(p+4+32+14);
+    } else {
+        return;
+    }
+
+    // the vbr header frame contains no audio
+    mp3->data_start = off + fh->frame_bytes;
+    if (frames <= 0) {
+        return;
+    }
+
+    // the decoded output is delayed by DECODER_DELAY, so it ends before the
+    // padding ends if the padding is shorter than DECODER_DELAY
+    mp3->skip_start = enc_delay + DECODER_DELAY;
+    mp3->total_samples = frames * fh->samples_per_frame - enc_delay -
+                         (enc_padding > DECODER_DELAY ? enc_padding : DECODER_DELAY);
+    if (mp3->total_samples < 0) {
+        mp3->total_samples = 0;
+    }
+    mp3->total_is_exact = true;
+}
+
+static void add_seek_index(sdlx_mp3_t *mp3, long frame_num, long off)
+{
+    if (frame_num / SEEK_INDEX_INTVL != mp3->max_seek_index) {
+        return;
+    }
+
+    // if the index can't grow then it stops here, the frames after it are
+    // found by scanning from its last entry
+    if (mp3->max_seek_index == mp3->alloc_seek_index) {
+        int   new_alloc = (mp3->alloc_seek_index == 0 ? 256 : 2 * mp3->alloc_seek_index);
+        long *new_index = realloc(mp3->seek_index, new_alloc * sizeof(long));
+        if (new_index == NULL) {
+            return;
+        }
+        mp3->seek_index = new_index;
+        mp3->alloc_seek_index = new_alloc;
+    }
+    mp3->seek_index[mp3->max_seek_index++] = off;
+}
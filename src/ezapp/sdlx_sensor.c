@@ -6,6 +6,16 @@
 
 #include <SDL3/SDL.h>
 
+#include <stdatomic.h>
+
+// The sensors are provided by a backend: SDL's sensors, or the playback of a
+// sensor trace file (sdlx_sensor_playback.c) for testing on Linux. The backend
+// fills sensor_info_tbl, opens sensors, reads their current values, and puts
+// the samples of the open sensors into their streams.
+//
+// While recording, every sample put into a stream is also written to the
+// record file, which can be played back by the playback backend.
+
 //
 // defines
 //
@@ -17,34 +27,141 @@
 
 #define ASENSOR_TYPE_STEP_COUNTER 19
 
+#define STREAM_LEN SDLX_SENSOR_STREAM_LEN
+
 //
 // typedefs
 //
 
+// a stream is a ring of the samples delivered for a sensor; 
+// the backend is the only producer
+typedef struct {
+    long   timestamp_us;
+    double values[SDLX_SENSOR_MAX_VALUES];
+} sample_t;
+
+typedef struct {
+    atomic_long head;        // number of samples added
+    atomic_long period_us;   // 0 to keep every sample, set by sdlx_sensor_set_rate
+    long        next_us;     // decimation, timestamp of the next sample to keep
+    sample_t    ring[STREAM_LEN];
+} stream_t;
+
 //
 // variables
 //
 
 static sdlx_sensor_info_t sensor_info_tbl[MAX_SENSOR_INFO];
 static int               max_sensor_info_tbl;
+static int               sensor_type[MAX_SENSOR_ID];  // indexed by id
 
-SDL_Sensor              *sensor[MAX_SENSOR_ID];  // indexed by id
+static bool               opened[MAX_SENSOR_ID];   // indexed by id
+static stream_t * _Atomic stream[MAX_SENSOR_ID];   // indexed by id, never freed
+static pthread_mutex_t    open_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static double first_step_count;
 
+// recording
+static FILE              *rec_fp;
+static pthread_mutex_t    rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// sdl backend
+static SDL_Sensor        *sensor[MAX_SENSOR_ID];  // indexed by id
+
 //
 // prototypes
 //
 
+static int sdl_init(sdlx_sensor_info_t *tbl, int max_tbl);
+static void sdl_quit(void);
+static int sdl_open(int id);
+static int sdl_read(int id, double *data, int num_values);
+static bool sensor_event_watcher(void *userdata, SDL_Event *event);
+
+static int open_sensor(int id);
+static void record_sample(int id, long timestamp_us, double *values, int num_values);
+static int read_raw(int id, double *data, int num_values);
+static int read_step_counter(double *step_count);
+static int read_accelerometer(double *ax, double *ay, double *az);
+static int read_roll_pitch(double *roll, double *pitch);
+static int read_mag_heading(double *mag_heading);
+static int read_pressure(double *millibars);
+static int read_temperature(double *degrees_c);
+static int read_humidity(double *percent);
+
+static sdlx_sensor_backend_t  sdl_backend = { "sdl", sdl_init, sdl_quit, sdl_open, sdl_read };
+static sdlx_sensor_backend_t *backend = &sdl_backend;
+
 // -----------------  INIT -------------------------------
 
+// must be called prior to sdlx_init
+void sdlx_sensor_set_backend(sdlx_sensor_backend_t *b)
+{
+    backend = (b != NULL ? b : &sdl_backend);
+}
+
 int sdlx_sensor_init(void)
+{
+    int    i, max;
+    double dummy, pressure;
+
+    INFO("initializing, %s backend\n", backend->name);
+
+    // the backend fills in sensor_info_tbl
+    max = backend->init(sensor_info_tbl, MAX_SENSOR_INFO);
+    if (max < 0) {
+        return -1;
+    }
+    max_sensor_info_tbl = max;
+
+    // print the info from sensor_info_tbl, and save the type of each id
+    memset(sensor_type, 0, sizeof(sensor_type));
+    for (i = 0; i < max_sensor_info_tbl; i++) {
+        INFO("%2d %2d %s\n",
+             sensor_info_tbl[i].id, 
+             sensor_info_tbl[i].type, 
+             sensor_info_tbl[i].name);
+        if (sensor_info_tbl[i].id >= 0 && sensor_info_tbl[i].id < MAX_SENSOR_ID) {
+            sensor_type[sensor_info_tbl[i].id] = sensor_info_tbl[i].type;
+        }
+    }
+
+    // xxx comment
+    read_temperature(&dummy);
+    read_humidity(&dummy);
+    read_pressure(&dummy);
+    read_step_counter(&dummy);
+    usleep(250000);
+    read_temperature(&dummy);
+    read_humidity(&dummy);
+    read_pressure(&pressure);
+    read_step_counter(&first_step_count);
+    INFO("first_step_count = %.0f pressure = %.0f\n", first_step_count, pressure);
+
+    // return success
+    INFO("success\n");
+    return 0;
+}
+
+void sdlx_sensor_quit(void)
+{
+    INFO("quitting\n");
+
+    // the backend closes the open sensors
+    sdlx_sensor_record_stop();
+    backend->quit();
+
+    pthread_mutex_lock(&open_mutex);
+    memset(opened, 0, sizeof(opened));
+    pthread_mutex_unlock(&open_mutex);
+}
+
+// -----------------  SDL BACKEND  -----------------------
+
+static int sdl_init(sdlx_sensor_info_t *tbl, int max_tbl)
 {
     int            i, max, num_sensors;
     SDL_SensorID  *ids;
-    double         dummy, pressure;
-
-    INFO("initializing\n");
 
     // initialize SDL sensor
     if (!SDL_InitSubSystem(SDL_INIT_SENSOR)) {
@@ -60,56 +177,115 @@ int sdlx_sensor_init(void)
     }
     INFO("num_sensors =%d\n", num_sensors);
 
-    // loop over returned list of sensor ids, and save info in sensor_info_tbl
+    // loop over returned list of sensor ids, and save info in tbl
     max = 0;
-    for (i = 0; i < num_sensors; i++) {
+    for (i = 0; i < num_sensors && max < max_tbl; i++) {
         // check if sensor is device private
         if (SDL_GetSensorNonPortableTypeForID(ids[i]) >= 65536) {
             continue;
         }
 
-        // save sensor id, type, non-portable-type, and name in sensor_info_tbl
-        sensor_info_tbl[max].id    = ids[i];
-        sensor_info_tbl[max].type  = SDL_GetSensorNonPortableTypeForID(ids[i]);
-        sensor_info_tbl[max].name  = (char*)SDL_GetSensorNameForID(ids[i]);
+        // save sensor id, type, non-portable-type, and name in tbl
+        tbl[max].id    = ids[i];
+        tbl[max].type  = SDL_GetSensorNonPortableTypeForID(ids[i]);
+        tbl[max].name  = (char*)SDL_GetSensorNameForID(ids[i]);
         max++;
     }
-    max_sensor_info_tbl = max;
-
-    // print the info from sensor_info_tbl
-    for (i = 0; i < max_sensor_info_tbl; i++) {
-        INFO("%2d %2d %s\n",
-             sensor_info_tbl[i].id, 
-             sensor_info_tbl[i].type, 
-             sensor_info_tbl[i].name);
-    }
 
     // free the list of ids
     SDL_free(ids);
 
-    // xxx comment
-    sdlx_sensor_read_temperature(&dummy);
-    sdlx_sensor_read_humidity(&dummy);
-    sdlx_sensor_read_pressure(&dummy);
-    sdlx_sensor_read_step_counter(&dummy);
-    usleep(250000);
-    sdlx_sensor_read_temperature(&dummy);
-    sdlx_sensor_read_humidity(&dummy);
-    sdlx_sensor_read_pressure(&pressure);
-    sdlx_sensor_read_step_counter(&first_step_count);
-    INFO("first_step_count = %.0f pressure = %.0f\n", first_step_count, pressure);
+    // the samples of the open sensors are put in their streams by the event watcher
+    SDL_AddEventWatch(sensor_event_watcher, NULL);
+    return max;
+}
 
-    // return success
-    INFO("success\n");
+static void sdl_quit(void)
+{
+    // remove the event watcher
+    SDL_RemoveEventWatch(sensor_event_watcher, NULL);
+
+    // quit SDL sensor, which closes the open sensors
+    SDL_QuitSubSystem(SDL_INIT_SENSOR);
+    memset(sensor, 0, sizeof(sensor));
+}
+
+static int sdl_open(int id)
+{
+    sensor[id] = SDL_OpenSensor(id);
+    if (sensor[id] == NULL) {
+        ERROR("failed to open sensor id %d, %s\n", id, SDL_GetError());
+        return -1;
+    }
     return 0;
 }
 
-void sdlx_sensor_quit(void)
+static int sdl_read(int id, double *data, int num_values)
 {
-    INFO("quitting\n");
+    int   i;
+    bool  succ;
+    float float_data[16];
 
-    // quit SDL sensor
-    SDL_QuitSubSystem(SDL_INIT_SENSOR);
+    // Note that the data are first obtained in float_data[], and 
+    // then converted to doubles for return in the data array.
+    // The reason for this is that picoc handles variables declared 
+    // float as doubles; they are both 8 bytes.
+
+    // get the sensor data, in float_data[]
+    succ = SDL_GetSensorData(sensor[id], float_data, num_values);
+    if (!succ) {
+        ERROR("SDL_GetSensorData failed for id %d, %s\n", id, SDL_GetError());
+        return -1;
+    }
+
+    // convert the float_data to double data, for return to caller
+    if (SDL_GetSensorNonPortableType(sensor[id]) != ASENSOR_TYPE_STEP_COUNTER) {
+        for (i = 0; i < num_values; i++) {
+            data[i] = float_data[i];
+        }
+    } else {
+        // the step_counter sensor is a special case, returning a 64 bit integer;
+        // refer to NDK ASensorEvent, which is included in the comment section
+        // at the end of this file
+        unsigned long step_count;
+        memcpy(&step_count, float_data, sizeof(step_count));
+        data[0] = step_count;
+    }
+
+    // success
+    return 0;
+}
+
+// SDL calls the event watcher with the sensor events serialized
+static bool sensor_event_watcher(void *userdata, SDL_Event *event)
+{
+    SDL_SensorEvent *ev = &event->sensor;
+    double           values[SDLX_SENSOR_MAX_VALUES];
+    long             ts;
+    int              i;
+
+    if (event->type != SDL_EVENT_SENSOR_UPDATE || ev->which >= MAX_SENSOR_ID) {
+        return true;
+    }
+
+    // the sensor timestamp is used when the driver provides it, it is
+    // the time the sample was taken rather than when it was delivered
+    ts = (ev->sensor_timestamp != 0 ? ev->sensor_timestamp : ev->timestamp) / 1000;
+
+    if (sensor_type[ev->which] != ASENSOR_TYPE_STEP_COUNTER) {
+        for (i = 0; i < SDLX_SENSOR_MAX_VALUES; i++) {
+            values[i] = ev->data[i];
+        }
+    } else {
+        // the step counter is a 64 bit integer, see sdl_read
+        unsigned long step_count;
+        memcpy(&step_count, ev->data, sizeof(step_count));
+        memset(values, 0, sizeof(values));
+        values[0] = step_count;
+    }
+
+    sdlx_sensor_stream_put(ev->which, ts, values, SDLX_SENSOR_MAX_VALUES);
+    return true;
 }
 
 // -----------  APIS AVAILABLE IN PICOC  --------------
@@ -140,72 +316,299 @@ int sdlx_sensor_find(int type)
     return sensor_info_tbl[i].id;
 }
 
-int sdlx_sensor_read_raw(int id, double *data, int num_values)
+// -----------------  OPEN SENSOR  -----------------------
+
+// opens the sensor if it is not already open; once open, the sensor's
+// samples are added to its stream
+static int open_sensor(int id)
 {
-    int   i;
-    bool  succ;
-    float float_data[16];
+    stream_t *s;
+    int       rc = 0;
+
+    pthread_mutex_lock(&open_mutex);
+
+    if (!opened[id]) {
+        // the stream is published before the sensor is opened, so that 
+        // the first samples delivered are not missed
+        if (atomic_load(&stream[id]) == NULL) {
+            s = calloc(1, sizeof(stream_t));
+            if (s == NULL) {
+                ERROR("failed to allocate stream for sensor id %d\n", id);
+                rc = -1;
+                goto done;
+            }
+            atomic_store(&stream[id], s);
+        }
 
-// xxx mutex
+        if (backend->open(id) != 0) {
+            rc = -1;
+            goto done;
+        }
+        opened[id] = true;
+    }
 
-    // Note that the data are first obtained in float_data[], and 
-    // then converted to doubles for return in the data array.
-    // The reason for this is that picoc handles variables declared 
-    // float as doubles; they are both 8 bytes.
+done:
+    pthread_mutex_unlock(&open_mutex);
+    return rc;
+}
 
-    // preset return data to 0
-    memset(data, 0, num_values * sizeof(double));
+// -----------------  STREAMS  ---------------------------
+
+// Each open sensor has a stream, a ring of the last SDLX_SENSOR_STREAM_LEN
+// samples that the backend delivered for it.
+//
+// The backend delivers the samples serialized, and so is the only producer;
+// it writes the sample in the ring and then advances head. Readers do not
+// lock; they copy the samples and then recheck head, discarding the copied
+// samples that may have been overwritten while they were being copied.
+//
+// SDL provides no way to set a sensor's hardware rate, so sdlx_sensor_set_rate
+// decimates the delivered samples instead.
+
+void sdlx_sensor_stream_put(int id, long timestamp_us, double *values, int num_values)
+{
+    stream_t *s;
+    sample_t *x;
+    long      head, period_us;
+
+    if (id < 0 || id >= MAX_SENSOR_ID ||
+        (s = atomic_load_explicit(&stream[id], memory_order_acquire)) == NULL)
+    {
+        return;
+    }
+    if (num_values > SDLX_SENSOR_MAX_VALUES) {
+        num_values = SDLX_SENSOR_MAX_VALUES;
+    }
+
+    // all of the delivered samples are recorded, prior to decimation
+    if (rec_fp != NULL) {
+        record_sample(id, timestamp_us, values, num_values);
+    }
+
+    // when a rate has been requested keep a sample per period, allowing
+    // an eighth of a period of jitter in the delivered timestamps
+    period_us = atomic_load_explicit(&s->period_us, memory_order_relaxed);
+    if (period_us > 0) {
+        if (timestamp_us < s->next_us - period_us / 8) {
+            return;
+        }
+        s->next_us += period_us;
+        if (s->next_us <= timestamp_us) {
+            s->next_us = timestamp_us + period_us;
+        }
+    }
+
+    // write the sample, and then publish it by advancing head; the fence orders
+    // this head store before the writes of the next sample, which is what 
+    // allows readers to detect overwritten samples
+    head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    x = &s->ring[head % STREAM_LEN];
+    x->timestamp_us = timestamp_us;
+    memset(x->values, 0, sizeof(x->values));
+    memcpy(x->values, values, num_values * sizeof(double));
+    atomic_store_explicit(&s->head, head + 1, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+}
+
+int sdlx_sensor_set_rate(int id, double rate_hz)
+{
+    stream_t *s;
 
-    // validate args
     if (id < 0 || id >= MAX_SENSOR_ID) {
         ERROR("id %d is out of range\n", id);
-        return -1;  
+        return -1;
     }
-    if (num_values < 1 || num_values > 16) {
-        ERROR("num_values %d is out of range\n", num_values);
+    if (rate_hz < 0) {
+        ERROR("invalid rate_hz %g\n", rate_hz);
+        return -1;
+    }
+    if (open_sensor(id) != 0) {
         return -1;
     }
 
-    // if not already open then call SDL_OpenSensor
-    if (sensor[id] == NULL) {
-        sensor[id] = SDL_OpenSensor(id);
-        if (sensor[id] == NULL) {
-            ERROR("failed to open sensor id %d, %s\n", id, SDL_GetError());
-            return -1;
+    s = atomic_load(&stream[id]);
+    atomic_store(&s->period_us, rate_hz > 0 ? (long)(1000000 / rate_hz) : 0);
+    return 0;
+}
+
+int sdlx_sensor_stream_read(int id, long *cursor, long *timestamp_us, double *values, 
+                            int num_values, int max_samples)
+{
+    stream_t *s;
+    sample_t *x;
+    long      head, first, valid;
+    int       i, j, n;
+
+    if (id < 0 || id >= MAX_SENSOR_ID) {
+        ERROR("id %d is out of range\n", id);
+        return -1;
+    }
+    if (num_values < 1 || num_values > SDLX_SENSOR_MAX_VALUES || max_samples < 0) {
+        ERROR("invalid args, num_values=%d max_samples=%d\n", num_values, max_samples);
+        return -1;
+    }
+    if (open_sensor(id) != 0) {
+        return -1;
+    }
+    s = atomic_load(&stream[id]);
+
+    // determine the samples to copy: those after *cursor that are still in 
+    // the ring, oldest first, and no more than max_samples
+    head = atomic_load_explicit(&s->head, memory_order_acquire);
+    first = *cursor;
+    if (first > head) first = head;
+    if (first < head - STREAM_LEN) first = head - STREAM_LEN;
+    if (first < 0) first = 0;
+    n = (head - first < max_samples ? head - first : max_samples);
+
+    // copy them
+    for (i = 0; i < n; i++) {
+        x = &s->ring[(first + i) % STREAM_LEN];
+        timestamp_us[i] = x->timestamp_us;
+        for (j = 0; j < num_values; j++) {
+            values[i*num_values+j] = x->values[j];
         }
     }
 
-    // get the sensor data, in float_data[]
-    succ = SDL_GetSensorData(sensor[id], float_data, num_values);
-    if (!succ) {
-        ERROR("SDL_GetSensorData failed for id %d, %s\n", id, SDL_GetError());
+    // recheck head; while the sample at head is being written the
+    // sample it replaces, and those before it, are not valid
+    atomic_thread_fence(memory_order_acquire);
+    valid = atomic_load_explicit(&s->head, memory_order_relaxed) + 1 - STREAM_LEN;
+    if (first < valid) {
+        int lost = (valid - first < n ? valid - first : n);
+        memmove(timestamp_us, timestamp_us + lost, (n - lost) * sizeof(long));
+        memmove(values, values + lost * num_values, (n - lost) * num_values * sizeof(double));
+        first += lost;
+        n -= lost;
+    }
+
+    // the cursor is advanced past the samples returned; samples 
+    // not yet returned are returned by the next call
+    *cursor = first + n;
+    return n;
+}
+
+// -----------------  RECORD  ----------------------------
+
+// The record file is a sensor trace: a 'sensor id type name' line for each
+// sensor in sensor_info_tbl, and then a 'timestamp_us type values' line for
+// each sample; this is also the format read by sdlx_fusion_test.
+//
+// Recording opens the sensors read by the sdlx_sensor_read_xxx routines, and
+// the gyroscope; samples of other sensors are recorded if they are opened.
+
+int sdlx_sensor_record_start(char *path)
+{
+    static int types[] = { ASENSOR_TYPE_ACCELEROMETER, ASENSOR_TYPE_GYROSCOPE,
+                           ASENSOR_TYPE_MAGNETIC_FIELD, ASENSOR_TYPE_PRESSURE,
+                           ASENSOR_TYPE_AMBIENT_TEMPERATURE, ASENSOR_TYPE_RELATIVE_HUMIDITY,
+                           ASENSOR_TYPE_STEP_COUNTER };
+    FILE *fp;
+    int   i, j;
+
+    // the recording is claimed before the file is created, so that a
+    // second start does not truncate the file being recorded
+    pthread_mutex_lock(&rec_mutex);
+    if (rec_fp != NULL) {
+        pthread_mutex_unlock(&rec_mutex);
+        ERROR("already recording\n");
         return -1;
     }
 
-    // convert the float_data to double data, for return to caller
-    if (SDL_GetSensorNonPortableType(sensor[id]) != ASENSOR_TYPE_STEP_COUNTER) {
-        for (i = 0; i < num_values; i++) {
-            data[i] = float_data[i];
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        pthread_mutex_unlock(&rec_mutex);
+        ERROR("failed to create %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+    fprintf(fp, "# ezapp sensor trace\n");
+    for (i = 0; i < max_sensor_info_tbl; i++) {
+        fprintf(fp, "sensor %d %d %s\n",
+                sensor_info_tbl[i].id, sensor_info_tbl[i].type, sensor_info_tbl[i].name);
+    }
+
+    rec_fp = fp;
+    pthread_mutex_unlock(&rec_mutex);
+
+    for (i = 0; i < sizeof(types)/sizeof(types[0]); i++) {
+        for (j = 0; j < max_sensor_info_tbl; j++) {
+            if (sensor_info_tbl[j].type == types[i]) {
+                open_sensor(sensor_info_tbl[j].id);
+                break;
+            }
         }
-    } else {
-        // the step_counter sensor is a special case, returning a 64 bit integer;
-        // refer to NDK ASensorEvent, which is included in the comment section
-        // at the end of this file
-        unsigned long step_count;
-        memcpy(&step_count, float_data, sizeof(step_count));
-        data[0] = step_count;
     }
 
-    // success
+    INFO("recording sensors to %s\n", path);
     return 0;
 }
 
+void sdlx_sensor_record_stop(void)
+{
+    pthread_mutex_lock(&rec_mutex);
+    if (rec_fp != NULL) {
+        fclose(rec_fp);
+        rec_fp = NULL;
+        INFO("recording stopped\n");
+    }
+    pthread_mutex_unlock(&rec_mutex);
+}
+
+static void record_sample(int id, long timestamp_us, double *values, int num_values)
+{
+    int i;
+
+    // trailing zero values are not written
+    while (num_values > 1 && values[num_values-1] == 0) {
+        num_values--;
+    }
+
+    pthread_mutex_lock(&rec_mutex);
+    if (rec_fp != NULL) {
+        fprintf(rec_fp, "%ld %d", timestamp_us, sensor_type[id]);
+        for (i = 0; i < num_values; i++) {
+            fprintf(rec_fp, " %.9g", values[i]);
+        }
+        fputc('\n', rec_fp);
+    }
+    pthread_mutex_unlock(&rec_mutex);
+}
+
+// -----------------  READ SENSORS  ----------------------
+
+// The sdlx_sensor_read_xxx routines, at the end of this file, call these
+// read_xxx routines; and support recording and replaying the values read.
+
+static int read_raw(int id, double *data, int num_values)
+{
+    // preset return data to 0
+    memset(data, 0, num_values * sizeof(double));
+
+    // validate args
+    if (id < 0 || id >= MAX_SENSOR_ID) {
+        ERROR("id %d is out of range\n", id);
+        return -1;  
+    }
+    if (num_values < 1 || num_values > 16) {
+        ERROR("num_values %d is out of range\n", num_values);
+        return -1;
+    }
+
+    // if not already open then open the sensor
+    if (open_sensor(id) != 0) {
+        return -1;
+    }
+
+    // get the sensor data from the backend
+    return backend->read(id, data, num_values);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - 
 
 #define RAD_TO_DEG (180 / M_PI)
 #define DEG_TO_RAD (M_PI / 180)
 
-int sdlx_sensor_read_step_counter(double *step_count)
+static int read_step_counter(double *step_count)
 {
     double data[3];
     
@@ -224,7 +627,7 @@ int sdlx_sensor_read_step_counter(double *step_count)
     }
 
     // read step counter sensor
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return step count sensor value minus first step count value read
     *step_count = data[0] - first_step_count;
@@ -235,7 +638,7 @@ int sdlx_sensor_read_step_counter(double *step_count)
 // y-axis: bottom to top
 // z-axis: perpendicular to the screen pointing to user
 // units: m/s^2
-int sdlx_sensor_read_accelerometer(double *ax, double *ay, double *az)
+static int read_accelerometer(double *ax, double *ay, double *az)
 {
     double data[3];
 
@@ -256,7 +659,7 @@ int sdlx_sensor_read_accelerometer(double *ax, double *ay, double *az)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return accelerometer values
     *ax = data[0];
@@ -267,7 +670,7 @@ int sdlx_sensor_read_accelerometer(double *ax, double *ay, double *az)
     return 0;
 }
 
-int sdlx_sensor_read_roll_pitch(double *roll, double *pitch)
+static int read_roll_pitch(double *roll, double *pitch)
 {
     double data[3];
     double ax, ay, az;
@@ -288,7 +691,7 @@ int sdlx_sensor_read_roll_pitch(double *roll, double *pitch)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return roll and pitch; 
     // - positive pitch means top of phone points upward
@@ -309,7 +712,7 @@ int sdlx_sensor_read_roll_pitch(double *roll, double *pitch)
     return 0;
 }
 
-int sdlx_sensor_read_mag_heading(double *mag_heading)
+static int read_mag_heading(double *mag_heading)
 {
     double data[3];
     double mx, my, mz;
@@ -331,13 +734,13 @@ int sdlx_sensor_read_mag_heading(double *mag_heading)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
     my = data[0];
     mx = data[1];
     mz = -data[2];
 
     // get roll and pitch
-    sdlx_sensor_read_roll_pitch(&roll, &pitch);
+    read_roll_pitch(&roll, &pitch);
     roll  *= -DEG_TO_RAD;
     pitch *= -DEG_TO_RAD;
 
@@ -363,7 +766,7 @@ int sdlx_sensor_read_mag_heading(double *mag_heading)
     return 0;
 }
 
-int sdlx_sensor_read_pressure(double *millibars)
+static int read_pressure(double *millibars)
 {
     double data[3];
 
@@ -382,7 +785,7 @@ int sdlx_sensor_read_pressure(double *millibars)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return pressure
     *millibars = data[0];
@@ -390,7 +793,7 @@ int sdlx_sensor_read_pressure(double *millibars)
 }
 
 // xxx not tested
-int sdlx_sensor_read_temperature(double *degrees_c)
+static int read_temperature(double *degrees_c)
 {
     double data[3];
 
@@ -409,7 +812,7 @@ int sdlx_sensor_read_temperature(double *degrees_c)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return temperature
     *degrees_c = data[0];
@@ -417,7 +820,7 @@ int sdlx_sensor_read_temperature(double *degrees_c)
 }
 
 // xxx not tested
-int sdlx_sensor_read_humidity(double *percent)
+static int read_humidity(double *percent)
 {
     double data[3];
 
@@ -436,13 +839,119 @@ int sdlx_sensor_read_humidity(double *percent)
     }
 
     // read raw sensor data
-    sdlx_sensor_read_raw(id, data, 3);
+    read_raw(id, data, 3);
 
     // return humidity
     *percent = data[0];
     return 0;
 }
 
+// -----------------  READ SENSORS WITH TRACE SUPPORT  ---
+
+// when replaying a trace the recorded values are returned; otherwise
+// the sensor is read, and the values are recorded if recording is enabled
+
+int sdlx_sensor_read_raw(int id, double *data, int num_values)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_RAW(id), data, num_values, &rc)) {
+        return rc;
+    }
+    rc = read_raw(id, data, num_values);
+    sdlx_trace_record_sensor(TRACE_SENSOR_RAW(id), rc, data, num_values);
+    return rc;
+}
+
+int sdlx_sensor_read_step_counter(double *step_count)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_STEP_COUNTER, step_count, 1, &rc)) {
+        return rc;
+    }
+    rc = read_step_counter(step_count);
+    sdlx_trace_record_sensor(TRACE_SENSOR_STEP_COUNTER, rc, step_count, 1);
+    return rc;
+}
+
+int sdlx_sensor_read_mag_heading(double *mag_heading)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_MAG_HEADING, mag_heading, 1, &rc)) {
+        return rc;
+    }
+    rc = read_mag_heading(mag_heading);
+    sdlx_trace_record_sensor(TRACE_SENSOR_MAG_HEADING, rc, mag_heading, 1);
+    return rc;
+}
+
+int sdlx_sensor_read_accelerometer(double *ax, double *ay, double *az)
+{
+    int    rc;
+    double v[3];
+
+    if (!sdlx_trace_replay_sensor(TRACE_SENSOR_ACCELEROMETER, v, 3, &rc)) {
+        rc = read_accelerometer(&v[0], &v[1], &v[2]);
+        sdlx_trace_record_sensor(TRACE_SENSOR_ACCELEROMETER, rc, v, 3);
+    }
+    *ax = v[0];
+    *ay = v[1];
+    *az = v[2];
+    return rc;
+}
+
+int sdlx_sensor_read_roll_pitch(double *roll, double *pitch)
+{
+    int    rc;
+    double v[2];
+
+    if (!sdlx_trace_replay_sensor(TRACE_SENSOR_ROLL_PITCH, v, 2, &rc)) {
+        rc = read_roll_pitch(&v[0], &v[1]);
+        sdlx_trace_record_sensor(TRACE_SENSOR_ROLL_PITCH, rc, v, 2);
+    }
+    *roll = v[0];
+    *pitch = v[1];
+    return rc;
+}
+
+int sdlx_sensor_read_pressure(double *millibars)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_PRESSURE, millibars, 1, &rc)) {
+        return rc;
+    }
+    rc = read_pressure(millibars);
+    sdlx_trace_record_sensor(TRACE_SENSOR_PRESSURE, rc, millibars, 1);
+    return rc;
+}
+
+int sdlx_sensor_read_temperature(double *degrees_c)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_TEMPERATURE, degrees_c, 1, &rc)) {
+        return rc;
+    }
+    rc = read_temperature(degrees_c);
+    sdlx_trace_record_sensor(TRACE_SENSOR_TEMPERATURE, rc, degrees_c, 1);
+    return rc;
+}
+
+int sdlx_sensor_read_humidity(double *percent)
+{
+    int rc;
+
+    if (sdlx_trace_replay_sensor(TRACE_SENSOR_HUMIDITY, percent, 1, &rc)) {
+        return rc;
+    }
+    rc = read_humidity(percent);
+    sdlx_trace_record_sensor(TRACE_SENSOR_HUMIDITY, rc, percent, 1);
+    return rc;
+}
+
 #if 0
 // -----------------  NOTES  --------------------
 
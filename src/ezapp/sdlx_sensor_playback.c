@@ -0,0 +1,374 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+// Sensor backend that plays back a sensor trace, so that the sensor apps can
+// be run, benchmarked and regression tested on Linux, where SDL has no sensors.
+// 'ezapp -S file [-x speed]' selects it.
+//
+// The trace is the file written by sdlx_sensor_record_start:
+//     # comment
+//     sensor <id> <type> <name>                 the sensors, in sensor_info_tbl
+//     <timestamp_us> <type> <values...>         a sample, up to 6 values
+// The samples of each type are played back as the first sensor of that type;
+// a trace without sensor lines, such as one written by hand, gets a sensor for
+// each type found in its samples.
+//
+// The playback thread delivers the samples of the open sensors to their streams
+// paced by the trace timestamps, divided by speed, and repeats the trace when
+// it reaches the end. The delivered timestamps keep the trace's spacing, offset
+// to start at the time playback started, and continue to increase when the
+// trace repeats; so speed changes how fast the samples arrive, and not what the
+// fusion filter or an app's rate computations see.
+
+//
+// defines
+//
+
+#define MAX_TBL        64
+#define MAX_ID         256
+#define MAX_SLEEP_US   10000
+#define MIN_PERIOD_US  1000
+
+//
+// typedefs
+//
+
+typedef struct {
+    long   timestamp_us;
+    int    seq;         // line order, so that sorting keeps equal timestamps in order
+    int    id;
+    int    num_values;
+    double values[SDLX_SENSOR_MAX_VALUES];
+} sample_t;
+
+//
+// variables
+//
+
+static char             *trace_path;
+static double            trace_speed;
+
+static sdlx_sensor_info_t tbl[MAX_TBL];
+static int               max_tbl;
+static sample_t         *samples;
+static int               max_samples;
+
+static pthread_mutex_t   mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool              opened[MAX_ID];
+static double            current[MAX_ID][SDLX_SENSOR_MAX_VALUES];
+
+static pthread_t         playback_tid;
+static bool              playback_running;
+static volatile bool     playback_stop_req;
+
+//
+// prototypes
+//
+
+static int playback_init(sdlx_sensor_info_t *info_tbl, int max_info_tbl);
+static void playback_quit(void);
+static int playback_open(int id);
+static int playback_read(int id, double *data, int num_values);
+
+static int load_trace(char *path);
+static int find_id(int type);
+static int sample_cmp(const void *a, const void *b);
+static void free_trace(void);
+static void *playback_thread(void *cx);
+
+static sdlx_sensor_backend_t playback_backend =
+    { "playback", playback_init, playback_quit, playback_open, playback_read };
+
+// -----------------  API  ---------------------------------
+
+int sdlx_sensor_playback_init(char *path, double speed)
+{
+    if (speed <= 0) {
+        ERROR("invalid speed %g\n", speed);
+        return -1;
+    }
+
+    trace_path = path;
+    trace_speed = speed;
+    sdlx_sensor_set_backend(&playback_backend);
+    return 0;
+}
+
+// -----------------  BACKEND  -----------------------------
+
+static int playback_init(sdlx_sensor_info_t *info_tbl, int max_info_tbl)
+{
+    int i;
+
+    if (load_trace(trace_path) != 0) {
+        free_trace();
+        return -1;
+    }
+    INFO("%s: %d sensors, %d samples, speed %g\n", trace_path, max_tbl, max_samples, trace_speed);
+
+    memset(opened, 0, sizeof(opened));
+    memset(current, 0, sizeof(current));
+
+    playback_stop_req = false;
+    if (max_samples > 0) {
+        if (pthread_create(&playback_tid, NULL, playback_thread, NULL) != 0) {
+            ERROR("failed to create playback thread\n");
+            free_trace();
+            return -1;
+        }
+        playback_running = true;
+    }
+
+    for (i = 0; i < max_tbl && i < max_info_tbl; i++) {
+        info_tbl[i] = tbl[i];
+    }
+    return i;
+}
+
+static void playback_quit(void)
+{
+    if (playback_running) {
+        playback_stop_req = true;
+        pthread_join(playback_tid, NULL);
+        playback_running = false;
+    }
+
+    pthread_mutex_lock(&mutex);
+    memset(opened, 0, sizeof(opened));
+    pthread_mutex_unlock(&mutex);
+
+    free_trace();
+}
+
+static int playback_open(int id)
+{
+    int i;
+
+    for (i = 0; i < max_tbl; i++) {
+        if (tbl[i].id == id) {
+            break;
+        }
+    }
+    if (i == max_tbl) {
+        ERROR("sensor id %d is not in %s\n", id, trace_path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&mutex);
+    opened[id] = true;
+    pthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+// returns the values of the last sample played back, zeros before the first
+static int playback_read(int id, double *data, int num_values)
+{
+    if (num_values > SDLX_SENSOR_MAX_VALUES) {
+        memset(data, 0, num_values * sizeof(double));
+        num_values = SDLX_SENSOR_MAX_VALUES;
+    }
+
+    pthread_mutex_lock(&mutex);
+    memcpy(data, current[id], num_values * sizeof(double));
+    pthread_mutex_unlock(&mutex);
+    return 0;
+}
+
+// -----------------  LOAD TRACE  --------------------------
+
+static int load_trace(char *path)
+{
+    FILE    *fp;
+    char     line[1000], name[200];
+    int      id, type, n, alloced=0;
+    long     ts;
+    double   v[SDLX_SENSOR_MAX_VALUES];
+    sample_t *x;
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        ERROR("failed to open %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        // sensor line
+        if (strncmp(line, "sensor ", 7) == 0) {
+            name[0] = '\0';
+            if (sscanf(line+7, "%d %d %199[^\n]", &id, &type, name) < 2 ||
+                id < 0 || id >= MAX_ID)
+            {
+                ERROR("%s: invalid line: %s", path, line);
+                continue;
+            }
+            if (max_tbl == MAX_TBL) {
+                continue;
+            }
+            tbl[max_tbl].id   = id;
+            tbl[max_tbl].type = type;
+            tbl[max_tbl].name = strdup(name);
+            max_tbl++;
+            continue;
+        }
+
+        // sample line, other lines are skipped
+        memset(v, 0, sizeof(v));
+        n = sscanf(line, "%ld %d %lf %lf %lf %lf %lf %lf",
+                   &ts, &type, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        if (n < 3) {
+            continue;
+        }
+        if ((id = find_id(type)) == -1) {
+            continue;
+        }
+
+        if (max_samples == alloced) {
+            alloced = (alloced == 0 ? 10000 : 2 * alloced);
+            x = realloc(samples, alloced * sizeof(sample_t));
+            if (x == NULL) {
+                ERROR("failed to allocate samples\n");
+                fclose(fp);
+                return -1;
+            }
+            samples = x;
+        }
+        x = &samples[max_samples];
+        x->timestamp_us = ts;
+        x->seq          = max_samples++;
+        x->id           = id;
+        x->num_values   = n - 2;
+        memcpy(x->values, v, sizeof(v));
+    }
+    fclose(fp);
+
+    // the samples are played back in timestamp order; a trace that is not
+    // in order, such as two traces joined, is sorted
+    qsort(samples, max_samples, sizeof(sample_t), sample_cmp);
+    return 0;
+}
+
+static int sample_cmp(const void *a, const void *b)
+{
+    const sample_t *sa = a, *sb = b;
+
+    if (sa->timestamp_us != sb->timestamp_us) {
+        return (sa->timestamp_us < sb->timestamp_us ? -1 : 1);
+    }
+    return sa->seq - sb->seq;
+}
+
+// returns the id of the first sensor of type; when the trace has no sensor
+// lines ahead of the first sample of type, a sensor is added for it
+static int find_id(int type)
+{
+    char name[100];
+    int  i, id;
+
+    for (i = 0; i < max_tbl; i++) {
+        if (tbl[i].type == type) {
+            return tbl[i].id;
+        }
+    }
+    if (max_tbl == MAX_TBL) {
+        return -1;
+    }
+
+    // the ids of added sensors follow the largest id in tbl
+    id = 1;
+    for (i = 0; i < max_tbl; i++) {
+        if (tbl[i].id >= id) {
+            id = tbl[i].id + 1;
+        }
+    }
+    if (id >= MAX_ID) {
+        return -1;
+    }
+
+    sprintf(name, "Playback Sensor type %d", type);
+    tbl[max_tbl].id   = id;
+    tbl[max_tbl].type = type;
+    tbl[max_tbl].name = strdup(name);
+    max_tbl++;
+    return id;
+}
+
+static void free_trace(void)
+{
+    int i;
+
+    for (i = 0; i < max_tbl; i++) {
+        free(tbl[i].name);
+    }
+    max_tbl = 0;
+    free(samples);
+    samples = NULL;
+    max_samples = 0;
+}
+
+// -----------------  PLAYBACK THREAD  ---------------------
+
+static void *playback_thread(void *cx)
+{
+    long      start_us, ts0, duration_us, period_us, offset_us, trace_us, sleep_us;
+    int       idx;
+    bool      is_open;
+    sample_t *x;
+
+    // the trace repeats after a gap of the mean sample period; the gap is
+    // at least MIN_PERIOD_US, so that a one sample trace, or a trace
+    // whose timestamps are equal, does not repeat without sleeping
+    ts0 = samples[0].timestamp_us;
+    duration_us = samples[max_samples-1].timestamp_us - ts0;
+    period_us = (max_samples > 1 ? duration_us / (max_samples - 1) : 0);
+    if (period_us < MIN_PERIOD_US) {
+        period_us = MIN_PERIOD_US;
+    }
+    duration_us += period_us;
+    if (duration_us < period_us) {
+        duration_us = period_us;
+    }
+
+    start_us = util_monotonic_microsec_timer();
+    offset_us = 0;
+    idx = 0;
+
+    while (!playback_stop_req) {
+        // the trace time reached by the elapsed time
+        trace_us = (util_monotonic_microsec_timer() - start_us) * trace_speed;
+
+        // deliver the samples up to trace_us
+        while (!playback_stop_req) {
+            x = &samples[idx];
+            if (offset_us + x->timestamp_us - ts0 > trace_us) {
+                break;
+            }
+
+            pthread_mutex_lock(&mutex);
+            memcpy(current[x->id], x->values, sizeof(x->values));
+            is_open = opened[x->id];
+            pthread_mutex_unlock(&mutex);
+
+            if (is_open) {
+                sdlx_sensor_stream_put(x->id, start_us + offset_us + x->timestamp_us - ts0,
+                                       x->values, x->num_values);
+            }
+
+            if (++idx == max_samples) {
+                idx = 0;
+                offset_us += duration_us;
+            }
+        }
+
+        // sleep until the next sample is due
+        sleep_us = (offset_us + samples[idx].timestamp_us - ts0 - trace_us) / trace_speed;
+        if (sleep_us < 0) {
+            sleep_us = 0;
+        }
+        usleep(sleep_us < MAX_SLEEP_US ? sleep_us + 1 : MAX_SLEEP_US);
+    }
+
+    return NULL;
+}
@@ -0,0 +1,285 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+// Streaming spectrogram of the audio capture.
+//
+// A spectrogram is attached to the capture when it is created. The record_thread
+// passes each block of scaled capture samples to sdlx_spectrogram_feed, which
+// computes a column of fft bin powers (in dB, relative to a full scale sine)
+// every hop samples, using a Hann window of fft_size samples. The columns are
+// kept in a ring of history columns, and are copied out by the reader; so a
+// display running at 60 fps needs hop <= sample_rate/60.
+//
+// The capture only runs while sdlx_audio_record is active; to analyze without
+// saving a file, call sdlx_audio_record with a NULL filename.
+
+//
+// defines
+//
+
+#define MAX_SPECTROGRAM  4
+#define MIN_DB           -120.
+
+//
+// typedefs
+//
+
+struct sdlx_spectrogram {
+    int          fft_size;
+    int          hop;
+    int          num_bins;
+    int          history;
+    int          sample_rate;
+
+    // used by the feed, in the record_thread
+    util_fftf_t *fft;
+    float       *window;
+    float       *frame;
+    float       *db;
+    short       *in;
+    int          in_len;
+
+    // columns ring, protected by mutex
+    pthread_mutex_t mutex;
+    float       *columns;
+    long         seq;           // number of columns produced
+};
+
+//
+// variables
+//
+
+static sdlx_spectrogram_t *attached[MAX_SPECTROGRAM];
+static pthread_mutex_t     attached_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// prototypes
+//
+
+static void compute_column(sdlx_spectrogram_t *sg);
+
+// -----------------  CREATE / DESTROY  --------------------
+
+sdlx_spectrogram_t *sdlx_spectrogram_create(int fft_size, int hop, int history)
+{
+    sdlx_spectrogram_t *sg;
+    int i, slot;
+
+    if (fft_size < 16 || hop < 1 || hop > fft_size || history < 1) {
+        ERROR("invalid args, fft_size=%d hop=%d history=%d\n", fft_size, hop, history);
+        return NULL;
+    }
+
+    sg = calloc(1, sizeof(sdlx_spectrogram_t));
+    if (sg == NULL) {
+        ERROR("failed to allocate spectrogram\n");
+        return NULL;
+    }
+    sg->fft_size    = fft_size;
+    sg->hop         = hop;
+    sg->num_bins    = fft_size/2 + 1;
+    sg->history     = history;
+    sg->sample_rate = SDLX_CAPTURE_SAMPLE_RATE;
+    pthread_mutex_init(&sg->mutex, NULL);
+
+    sg->fft     = util_fftf_create(fft_size);
+    sg->window  = malloc(fft_size * sizeof(float));
+    sg->frame   = malloc(fft_size * sizeof(float));
+    sg->db      = malloc(sg->num_bins * sizeof(float));
+    sg->in      = malloc(fft_size * sizeof(short));
+    sg->columns = malloc((long)history * sg->num_bins * sizeof(float));
+    if (!sg->fft || !sg->window || !sg->frame || !sg->db || !sg->in || !sg->columns) {
+        ERROR("failed to allocate spectrogram, fft_size=%d history=%d\n", fft_size, history);
+        goto error;
+    }
+
+    // the hann window is scaled so that a full scale sine is 0 dB; the
+    // sine's bin magnitude is fft_size/4 with a hann window
+    for (i = 0; i < fft_size; i++) {
+        sg->window[i] = (0.5 - 0.5 * cos(2 * M_PI * i / fft_size)) / 32768. / (fft_size / 4.);
+    }
+
+    // attach to the capture
+    pthread_mutex_lock(&attached_mutex);
+    for (slot = 0; slot < MAX_SPECTROGRAM; slot++) {
+        if (attached[slot] == NULL) {
+            attached[slot] = sg;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&attached_mutex);
+    if (slot == MAX_SPECTROGRAM) {
+        ERROR("too many spectrograms, max %d\n", MAX_SPECTROGRAM);
+        goto error;
+    }
+
+    return sg;
+
+error:
+    util_fftf_destroy(sg->fft);
+    free(sg->window);
+    free(sg->frame);
+    free(sg->db);
+    free(sg->in);
+    free(sg->columns);
+    free(sg);
+    return NULL;
+}
+
+void sdlx_spectrogram_destroy(sdlx_spectrogram_t *sg)
+{
+    int slot;
+
+    if (sg == NULL) {
+        return;
+    }
+
+    // detach, once this completes the feed no longer references sg
+    pthread_mutex_lock(&attached_mutex);
+    for (slot = 0; slot < MAX_SPECTROGRAM; slot++) {
+        if (attached[slot] == sg) {
+            attached[slot] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&attached_mutex);
+
+    util_fftf_destroy(sg->fft);
+    free(sg->window);
+    free(sg->frame);
+    free(sg->db);
+    free(sg->in);
+    free(sg->columns);
+    pthread_mutex_destroy(&sg->mutex);
+    free(sg);
+}
+
+// -----------------  FEED  --------------------------------
+
+// called by the record_thread with the capture samples
+void sdlx_spectrogram_feed(short *samples, int n)
+{
+    sdlx_spectrogram_t *sg;
+    int slot, i, cnt;
+
+    pthread_mutex_lock(&attached_mutex);
+    for (slot = 0; slot < MAX_SPECTROGRAM; slot++) {
+        if ((sg = attached[slot]) == NULL) {
+            continue;
+        }
+
+        // accumulate fft_size samples, compute a column, and then
+        // retain the last fft_size-hop samples for the next column
+        for (i = 0; i < n; i += cnt) {
+            cnt = sg->fft_size - sg->in_len;
+            if (cnt > n - i) cnt = n - i;
+            memcpy(sg->in + sg->in_len, samples + i, cnt * sizeof(short));
+            sg->in_len += cnt;
+
+            if (sg->in_len == sg->fft_size) {
+                compute_column(sg);
+                memmove(sg->in, sg->in + sg->hop, (sg->fft_size - sg->hop) * sizeof(short));
+                sg->in_len = sg->fft_size - sg->hop;
+            }
+        }
+    }
+    pthread_mutex_unlock(&attached_mutex);
+}
+
+static void compute_column(sdlx_spectrogram_t *sg)
+{
+    float *col;
+    int i;
+
+    for (i = 0; i < sg->fft_size; i++) {
+        sg->frame[i] = sg->in[i] * sg->window[i];
+    }
+    util_fftf_power_db(sg->fft, sg->frame, sg->db);
+
+    pthread_mutex_lock(&sg->mutex);
+    col = sg->columns + (sg->seq % sg->history) * sg->num_bins;
+    for (i = 0; i < sg->num_bins; i++) {
+        col[i] = (sg->db[i] > MIN_DB ? sg->db[i] : MIN_DB);
+    }
+    sg->seq++;
+    pthread_mutex_unlock(&sg->mutex);
+}
+
+// -----------------  READ  --------------------------------
+
+int sdlx_spectrogram_num_bins(sdlx_spectrogram_t *sg)
+{
+    return sg->num_bins;
+}
+
+double sdlx_spectrogram_bin_hz(sdlx_spectrogram_t *sg)
+{
+    return (double)sg->sample_rate / sg->fft_size;
+}
+
+int sdlx_spectrogram_read(sdlx_spectrogram_t *sg, long *seq, double *db, int max_cols)
+{
+    long first;
+    int  i, num_cols;
+    float *col;
+
+    // the columns after *seq are returned, oldest first; if more than
+    // max_cols (or history) are available then just the most recent are returned
+    pthread_mutex_lock(&sg->mutex);
+    first = *seq;
+    if (first < sg->seq - max_cols) first = sg->seq - max_cols;
+    if (first < sg->seq - sg->history) first = sg->seq - sg->history;
+    if (first < 0) first = 0;
+    num_cols = sg->seq - first;
+
+    for (; first < sg->seq; first++) {
+        col = sg->columns + (first % sg->history) * sg->num_bins;
+        for (i = 0; i < sg->num_bins; i++) {
+            *db++ = col[i];
+        }
+    }
+    *seq = sg->seq;
+    pthread_mutex_unlock(&sg->mutex);
+
+    return num_cols;
+}
+
+double sdlx_spectrogram_peak_hz(sdlx_spectrogram_t *sg, double min_hz, double max_hz, double *peak_db)
+{
+    float *col;
+    int    k, k_min, k_max, k_peak;
+    double bin_hz = sdlx_spectrogram_bin_hz(sg);
+    double a, b, c, offset, hz = 0;
+
+    // find the largest bin in the range of the most recent column, and
+    // refine its frequency by fitting a parabola through it and its neighbors
+    k_min = ceil(min_hz / bin_hz);
+    k_max = floor(max_hz / bin_hz);
+    if (k_min < 1) k_min = 1;
+    if (k_max > sg->num_bins - 2) k_max = sg->num_bins - 2;
+
+    pthread_mutex_lock(&sg->mutex);
+    if (sg->seq == 0 || k_min > k_max) {
+        pthread_mutex_unlock(&sg->mutex);
+        if (peak_db) *peak_db = MIN_DB;
+        return 0;
+    }
+
+    col = sg->columns + ((sg->seq - 1) % sg->history) * sg->num_bins;
+    k_peak = k_min;
+    for (k = k_min + 1; k <= k_max; k++) {
+        if (col[k] > col[k_peak]) k_peak = k;
+    }
+
+    a = col[k_peak-1];
+    b = col[k_peak];
+    c = col[k_peak+1];
+    offset = (a - 2*b + c != 0 ? 0.5 * (a - c) / (a - 2*b + c) : 0);
+    hz = (k_peak + offset) * bin_hz;
+    if (peak_db) *peak_db = b - 0.25 * (a - c) * offset;
+    pthread_mutex_unlock(&sg->mutex);
+
+    return hz;
+}
@@ -0,0 +1,455 @@
+#include <std_hdrs.h>
+
+#include <sdlx.h>
+#include <logging.h>
+#include <utils.h>
+
+// Record and replay of the sdlx_get_event result stream and of the values
+// returned by the sdlx_sensor_read_* routines.
+//
+// While replaying, sdlx_get_event and the sensor read routines return the
+// recorded values, and util_microsec_timer / util_get_real_time_microsec
+// return virtual time:
+// - at recorded speed, virtual time advances in real time from the start of
+//   the trace, and each event is returned at the time it was recorded
+// - in fast mode, virtual time advances only as records are replayed, so the
+//   app never waits
+// When the trace is exhausted, EVID_QUIT is returned.
+//
+// Trace file format, integers are little endian:
+//   header:  "EZTRACE1", int64 microsec_timer at start, int64 real_time at start
+//   records: u8 type, varint delta_us from the prior record, payload
+//     TRACE_REC_EVENT:  zigzag varint event_id, then for
+//                       EVID_MOTION 4 x float32 x,y,xrel,yrel, and for
+//                       EVID_KEYBD varint ch
+//     TRACE_REC_SENSOR: varint fn, zigzag varint rc, u8 n, n x float64 values
+
+//
+// defines
+//
+
+#define TRACE_MAGIC "EZTRACE1"
+
+#define TRACE_REC_EVENT   1
+#define TRACE_REC_SENSOR  2
+
+#define MAX_SENSOR_VALUES 16
+
+#define ONE_MS 1000
+
+//
+// typedefs
+//
+
+typedef struct {
+    long         us;          // time since start of trace
+    sdlx_event_t event;
+} trace_event_t;
+
+typedef struct {
+    long   us;
+    int    fn;
+    int    rc;
+    int    n;
+    double values[MAX_SENSOR_VALUES];
+} trace_sensor_t;
+
+//
+// variables
+//
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// recording
+static FILE           *rec_fp;
+static long            rec_start_us;
+static long            rec_last_us;
+
+// replaying
+static bool            replaying;
+static bool            replay_fast;
+static long            replay_start_us;      // real monotonic time at start of replay
+static long            replay_base_us;       // recorded microsec_timer at start of trace
+static long            replay_base_real_us;  // recorded real_time at start of trace
+static long            replay_virtual_us;    // virtual time since start of trace, in fast mode
+static trace_event_t  *replay_events;
+static int             max_replay_events;
+static int             replay_event_idx;
+static trace_sensor_t *replay_sensors;
+static int             max_replay_sensors;
+static int             replay_sensor_idx;
+
+//
+// prototypes
+//
+
+static void put_varint(unsigned long v);
+static void put_record_hdr(int type);
+static bool get_varint(unsigned char **p, unsigned char *end, unsigned long *v);
+static int parse_trace(unsigned char *data, int len);
+static long virtual_microsec_timer(void);
+static long virtual_real_time_microsec(void);
+static long virtual_us(void);
+
+static inline unsigned long zigzag_encode(long v) { return ((unsigned long)v << 1) ^ (unsigned long)(v >> 63); }
+static inline long zigzag_decode(unsigned long v) { return (long)(v >> 1) ^ -(long)(v & 1); }
+
+// -----------------  START / STOP  -----------------------
+
+int sdlx_trace_record_start(char *path)
+{
+    long real_us;
+
+    if (rec_fp != NULL || replaying) {
+        ERROR("trace already active\n");
+        return -1;
+    }
+
+    rec_fp = fopen(path, "w");
+    if (rec_fp == NULL) {
+        ERROR("failed to create %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    rec_start_us = util_monotonic_microsec_timer();
+    rec_last_us = rec_start_us;
+    real_us = util_get_real_time_microsec();
+    fwrite(TRACE_MAGIC, 1, 8, rec_fp);
+    fwrite(&rec_start_us, sizeof(long), 1, rec_fp);
+    fwrite(&real_us, sizeof(long), 1, rec_fp);
+
+    INFO("recording to %s\n", path);
+    return 0;
+}
+
+int sdlx_trace_replay_start(char *path, bool fast)
+{
+    unsigned char *data;
+    int            len;
+
+    if (rec_fp != NULL || replaying) {
+        ERROR("trace already active\n");
+        return -1;
+    }
+
+    data = util_read_file(path, NULL, &len);
+    if (data == NULL) {
+        return -1;
+    }
+    if (len < 24 || memcmp(data, TRACE_MAGIC, 8) != 0) {
+        ERROR("%s is not a trace file\n", path);
+        free(data);
+        return -1;
+    }
+    memcpy(&replay_base_us, data+8, sizeof(long));
+    memcpy(&replay_base_real_us, data+16, sizeof(long));
+
+    if (parse_trace(data+24, len-24) != 0) {
+        ERROR("%s is corrupt\n", path);
+        free(data);
+        return -1;
+    }
+    free(data);
+
+    INFO("replaying %s, %d events, %d sensor reads, %s\n",
+         path, max_replay_events, max_replay_sensors, fast ? "fast" : "recorded speed");
+
+    replay_fast = fast;
+    replay_start_us = util_monotonic_microsec_timer();
+    replay_virtual_us = 0;
+    replay_event_idx = 0;
+    replay_sensor_idx = 0;
+    replaying = true;
+
+    util_set_time_sources(virtual_microsec_timer, virtual_real_time_microsec);
+    return 0;
+}
+
+void sdlx_trace_stop(void)
+{
+    pthread_mutex_lock(&mutex);
+
+    if (rec_fp != NULL) {
+        fclose(rec_fp);
+        rec_fp = NULL;
+    }
+
+    if (replaying) {
+        util_set_time_sources(NULL, NULL);
+        replaying = false;
+        free(replay_events);
+        free(replay_sensors);
+        replay_events = NULL;
+        replay_sensors = NULL;
+        max_replay_events = 0;
+        max_replay_sensors = 0;
+    }
+
+    pthread_mutex_unlock(&mutex);
+}
+
+bool sdlx_trace_replaying(void)
+{
+    return replaying;
+}
+
+// -----------------  RECORD  -----------------------------
+
+void sdlx_trace_record_event(sdlx_event_t *event)
+{
+    if (rec_fp == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (rec_fp == NULL) {
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    put_record_hdr(TRACE_REC_EVENT);
+    put_varint(zigzag_encode(event->event_id));
+    if (event->event_id == EVID_MOTION) {
+        float f[4] = { event->u.motion.x, event->u.motion.y, event->u.motion.xrel, event->u.motion.yrel };
+        fwrite(f, sizeof(float), 4, rec_fp);
+    } else if (event->event_id == EVID_KEYBD) {
+        put_varint(event->u.keybd.ch);
+    }
+
+    pthread_mutex_unlock(&mutex);
+}
+
+void sdlx_trace_record_sensor(int fn, int rc, double *values, int n)
+{
+    if (rec_fp == NULL) {
+        return;
+    }
+
+    if (n > MAX_SENSOR_VALUES) {
+        n = MAX_SENSOR_VALUES;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (rec_fp == NULL) {
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    put_record_hdr(TRACE_REC_SENSOR);
+    put_varint(fn);
+    put_varint(zigzag_encode(rc));
+    fputc(n, rec_fp);
+    fwrite(values, sizeof(double), n, rec_fp);
+
+    pthread_mutex_unlock(&mutex);
+}
+
+static void put_record_hdr(int type)
+{
+    long now_us = util_monotonic_microsec_timer();
+
+    fputc(type, rec_fp);
+    put_varint(now_us - rec_last_us);
+    rec_last_us = now_us;
+}
+
+static void put_varint(unsigned long v)
+{
+    while (v >= 0x80) {
+        fputc((v & 0x7f) | 0x80, rec_fp);
+        v >>= 7;
+    }
+    fputc(v, rec_fp);
+}
+
+// -----------------  REPLAY  -----------------------------
+
+void sdlx_trace_replay_event(long timeout_us, sdlx_event_t *event)
+{
+    trace_event_t *x;
+
+    memset(event, 0, sizeof(*event));
+
+    // when the trace is exhausted, the app is requested to quit
+    pthread_mutex_lock(&mutex);
+    if (!replaying || replay_event_idx >= max_replay_events) {
+        pthread_mutex_unlock(&mutex);
+        event->event_id = EVID_QUIT;
+        return;
+    }
+    x = &replay_events[replay_event_idx++];
+    pthread_mutex_unlock(&mutex);
+
+    // at recorded speed, wait until the time the event was recorded;
+    // in fast mode, advance virtual time to the time the event was recorded
+    if (!replay_fast) {
+        while (util_monotonic_microsec_timer() - replay_start_us < x->us) {
+            usleep(ONE_MS);
+        }
+    } else if (x->us > replay_virtual_us) {
+        replay_virtual_us = x->us;
+    }
+
+    *event = x->event;
+}
+
+bool sdlx_trace_replay_sensor(int fn, double *values, int n, int *rc)
+{
+    trace_sensor_t *x = NULL;
+    int             i;
+
+    if (!replaying) {
+        return false;
+    }
+
+    // find the next recorded read of the same sensor routine;
+    // if none then the read returns error
+    pthread_mutex_lock(&mutex);
+    while (replay_sensor_idx < max_replay_sensors) {
+        trace_sensor_t *y = &replay_sensors[replay_sensor_idx++];
+        if (y->fn == fn) {
+            x = y;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (x == NULL) {
+        for (i = 0; i < n; i++) {
+            values[i] = INVALID_NUMBER;
+        }
+        *rc = -1;
+        return true;
+    }
+
+    for (i = 0; i < n; i++) {
+        values[i] = (i < x->n ? x->values[i] : INVALID_NUMBER);
+    }
+    *rc = x->rc;
+    if (replay_fast && x->us > replay_virtual_us) {
+        replay_virtual_us = x->us;
+    }
+    return true;
+}
+
+// the events and sensor reads are parsed into new arrays, which replace the
+// replay arrays only if the whole trace is parsed
+static int parse_trace(unsigned char *data, int len)
+{
+    unsigned char  *p = data, *end = data + len;
+    unsigned long   v;
+    long            us = 0;
+    int             type, rc = -1;
+    trace_event_t  *events = NULL, *ex;
+    trace_sensor_t *sensors = NULL, *sx;
+    int             max_events = 0, max_alloc_events = 0;
+    int             max_sensors = 0, max_alloc_sensors = 0;
+    void           *tmp;
+
+    while (p < end) {
+        type = *p++;
+        if (!get_varint(&p, end, &v)) goto done;
+        us += v;
+
+        if (type == TRACE_REC_EVENT) {
+            if (max_events == max_alloc_events) {
+                max_alloc_events = (max_alloc_events ? 2 * max_alloc_events : 1000);
+                tmp = realloc(events, max_alloc_events * sizeof(trace_event_t));
+                if (tmp == NULL) goto done;
+                events = tmp;
+            }
+            ex = &events[max_events];
+            memset(ex, 0, sizeof(*ex));
+            ex->us = us;
+            if (!get_varint(&p, end, &v)) goto done;
+            ex->event.event_id = zigzag_decode(v);
+            if (ex->event.event_id == EVID_MOTION) {
+                float f[4];
+                if (end - p < sizeof(f)) goto done;
+                memcpy(f, p, sizeof(f));
+                p += sizeof(f);
+                ex->event.u.motion.x = f[0];
+                ex->event.u.motion.y = f[1];
+                ex->event.u.motion.xrel = f[2];
+                ex->event.u.motion.yrel = f[3];
+            } else if (ex->event.event_id == EVID_KEYBD) {
+                if (!get_varint(&p, end, &v)) goto done;
+                ex->event.u.keybd.ch = v;
+            }
+            max_events++;
+        } else if (type == TRACE_REC_SENSOR) {
+            if (max_sensors == max_alloc_sensors) {
+                max_alloc_sensors = (max_alloc_sensors ? 2 * max_alloc_sensors : 1000);
+                tmp = realloc(sensors, max_alloc_sensors * sizeof(trace_sensor_t));
+                if (tmp == NULL) goto done;
+                sensors = tmp;
+            }
+            sx = &sensors[max_sensors];
+            sx->us = us;
+            if (!get_varint(&p, end, &v)) goto done;
+            sx->fn = v;
+            if (!get_varint(&p, end, &v)) goto done;
+            sx->rc = zigzag_decode(v);
+            if (p >= end) goto done;
+            sx->n = *p++;
+            if (sx->n > MAX_SENSOR_VALUES || end - p < sx->n * sizeof(double)) goto done;
+            memcpy(sx->values, p, sx->n * sizeof(double));
+            p += sx->n * sizeof(double);
+            max_sensors++;
+        } else {
+            goto done;
+        }
+    }
+
+    // the whole trace was parsed, replace the replay arrays
+    pthread_mutex_lock(&mutex);
+    free(replay_events);
+    free(replay_sensors);
+    replay_events = events;
+    replay_sensors = sensors;
+    max_replay_events = max_events;
+    max_replay_sensors = max_sensors;
+    pthread_mutex_unlock(&mutex);
+    events = NULL;
+    sensors = NULL;
+    rc = 0;
+
+done:
+    // cleanup and return
+    free(events);
+    free(sensors);
+    return rc;
+}
+
+static bool get_varint(unsigned char **p, unsigned char *end, unsigned long *v)
+{
+    int shift = 0;
+
+    *v = 0;
+    while (*p < end && shift < 64) {
+        unsigned char b = *(*p)++;
+        *v |= (unsigned long)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+// -----------------  VIRTUAL TIME  -----------------------
+
+static long virtual_us(void)
+{
+    return replay_fast ? replay_virtual_us : util_monotonic_microsec_timer() - replay_start_us;
+}
+
+static long virtual_microsec_timer(void)
+{
+    return replay_base_us + virtual_us();
+}
+
+static long virtual_real_time_microsec(void)
+{
+    return replay_base_real_us + virtual_us();
+}
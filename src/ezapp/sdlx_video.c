@@ -31,6 +31,9 @@
 #define ONE_MS 1000
 #define TEN_MS 10000
 
+#define MAX_PNG_TEXTURE_CACHE 64
+#define PNG_TEXTURE_BAND_ROWS 64
+
 //
 // typedefs
 //
@@ -60,6 +63,19 @@ double                  scale;
 static SDL_Renderer   * renderer;
 
 static TTF_Font        *font[MAX_FONT_PTSIZE];
+static void            *font_data;
+static size_t           font_data_len;
+static sdlx_print_state_t print_state;
+
+static sdlx_video_stats_t stats;
+
+static struct {
+    char         path[200];
+    long         mtime;
+    long         size;
+    SDL_Texture *texture;
+    int          refcnt;
+} png_texture_cache[MAX_PNG_TEXTURE_CACHE];
 
 static int              max_event;
 static bool             evid_swipe_right_registered;
@@ -72,6 +88,8 @@ static bool             evid_keybd_registered;
 //
 
 static void set_render_draw_color(int color);
+static int font_load(void);
+static TTF_Font *get_font(int ptsize);
 
 //
 // inline routines
@@ -131,16 +149,6 @@ bool event_watcher(void* userdata, SDL_Event* event)
     }
 #endif
 
-#if 0 //xxx make this a font routine
-        // debug code to print font info
-        for (int ptsize = MIN_FONT_PTSIZE; ptsize < MAX_FONT_PTSIZE; ptsize++) {
-            TTF_Font *f = TTF_OpenFont(FONT_FILE_PATH, ptsize);
-            TTF_SizeText(f, "X", &chw, &chh);
-            TTF_CloseFont(f);
-            INFO("font ptsize = %d  chw/chh = %d %d\n", ptsize, chw, chh);
-        }
-#endif
-
 int sdlx_video_init(void)
 {
     int    real_win_width, real_win_height;
@@ -195,6 +203,11 @@ int sdlx_video_init(void)
         return -1;
     }
 
+    // read the font file into memory
+    if (font_load() != 0) {
+        return -1;
+    }
+
     // init default fontsize, where DEFAULT_FONT is num chars across display;
     // and validate expected character size and columns
     sdlx_print_init(DEFAULT_FONT, COLOR_WHITE, COLOR_BLACK);
@@ -226,9 +239,15 @@ void sdlx_video_quit(void)
     for (i = MIN_FONT_PTSIZE; i < MAX_FONT_PTSIZE; i++) {
         if (font[i] != NULL) {
             TTF_CloseFont(font[i]);
+            font[i] = NULL;
         }
     }
     TTF_Quit();
+    SDL_free(font_data);
+    font_data = NULL;
+
+    // the renderer destroys its textures, so discard the png texture cache
+    memset(png_texture_cache, 0, sizeof(png_texture_cache));
 
     // destroy the renderer and window
     SDL_DestroyRenderer(renderer);
@@ -250,6 +269,11 @@ void sdlx_minimize_window(void)
     SDL_MinimizeWindow(window);
 }
 
+void sdlx_video_get_stats(sdlx_video_stats_t *stats_ret)
+{
+    *stats_ret = stats;
+}
+
 // ----------------- DISPLAY INIT / PRESENT ---------------
 
 void sdlx_display_init(int color)
@@ -264,11 +288,17 @@ void sdlx_display_init(int color)
 
     set_render_draw_color(color);
     SDL_RenderClear(renderer);
+    stats.draw_calls++;
 }
 
 void sdlx_display_present(void)
 {
     SDL_RenderPresent(renderer);
+    stats.frames++;
+
+    if (sdlx_bench_enabled()) {
+        sdlx_bench_frame();
+    }
 }
 
 // -----------------  COLORS  -----------------------------
@@ -357,9 +387,49 @@ static void set_render_draw_color(int color)
     SDL_SetRenderDrawColor(renderer, r, g, b, a);
 }
 
-// -----------------  RENDER TEXT  ------------------------
+// -----------------  FONTS  ------------------------------
 
-static sdlx_print_state_t print_state;
+// The font file is read into memory once, and each ptsize is opened from that
+// buffer.
+
+static int font_load(void)
+{
+    // read the font file into memory
+    font_data = SDL_LoadFile(FONT_FILE_PATH, &font_data_len);
+    if (font_data == NULL) {
+        ERROR("failed to read %s, %s\n", FONT_FILE_PATH, SDL_GetError());
+        return -1;
+    }
+
+    INFO("%s: len=%zd\n", FONT_FILE_PATH, font_data_len);
+    return 0;
+}
+
+// returns the font for ptsize, opening it from the in-memory font data if needed
+static TTF_Font *get_font(int ptsize)
+{
+    if (font[ptsize] == NULL) {
+        SDL_IOStream *io;
+
+        if (font_data == NULL) {
+            ERROR("font ptsize %d, not initialized\n", ptsize);
+            return NULL;
+        }
+        if ((io = SDL_IOFromConstMem(font_data, font_data_len)) == NULL) {
+            ERROR("SDL_IOFromConstMem failed, %s\n", SDL_GetError());
+            return NULL;
+        }
+        font[ptsize] = TTF_OpenFontIO(io, true, ptsize);
+        if (font[ptsize] == NULL) {
+            ERROR("TTF_OpenFontIO failed, ptsize=%d\n", ptsize);
+            return NULL;
+        }
+    }
+
+    return font[ptsize];
+}
+
+// -----------------  RENDER TEXT  ------------------------
 
 void sdlx_print_save(sdlx_print_state_t *save)
 {
@@ -394,15 +464,8 @@ void sdlx_print_init_numchars(double numchars)
     if (ptsize < MIN_FONT_PTSIZE) ptsize = MIN_FONT_PTSIZE;
     if (ptsize >= MAX_FONT_PTSIZE) ptsize = MAX_FONT_PTSIZE-1;
 
-    // if the requested font pointsize has not yet been opened
-    // then do so
-    if (font[ptsize] == NULL) {
-        font[ptsize] = TTF_OpenFont(FONT_FILE_PATH, ptsize);
-        if (font[ptsize] == NULL) {
-            ERROR("TTF_OpenFont failed, ptsize=%d\n", ptsize);
-            return;
-        }
-    }
+    // note: the font for this ptsize is not opened here, it is opened
+    //       from the in-memory font data when text is first rendered
 
     // save new point size and character width/height xxx comment
     sdlx_char_width  = rint(sdlx_win_width / numchars);  // xxx nearbyint
@@ -420,30 +483,31 @@ void sdlx_print_init(double numchars, int fg_color, int bg_color)
     sdlx_print_init_color(fg_color, bg_color);
 }
 
-static sdlx_loc_t *render_text(bool xy_is_ctr, int x, int y, char * str)
+// arg len: the length of str, or 0 if str is null terminated
+static sdlx_loc_t *render_text_len(bool xy_is_ctr, int x, int y, char * str, int len)
 {
     SDL_Surface *surface;
     SDL_Texture *texture;
     SDL_FRect     pos;
+    TTF_Font    * f;
     static sdlx_loc_t loc;
 
     //printf("xy_is_ctr = %d x=%d y=%d str='%s'\n", xy_is_ctr, x, y, str);
 
-    // if font not initialized then return error
-    if (font[print_state.ptsize] == NULL) {
-        ERROR("font ptsize %d, not initialized\n", print_state.ptsize);
+    // if zero len str then return
+    if (str[0] == '\0') {
         loc.x = x; loc.y = y; loc.w = 0; loc.h = 0;
         return &loc;
     }
 
-    // if zero len str then return
-    if (str[0] == '\0') {
+    // if font not available then return error
+    if ((f = get_font(print_state.ptsize)) == NULL) {
         loc.x = x; loc.y = y; loc.w = 0; loc.h = 0;
         return &loc;
     }
 
     // render the string to a surface xxx cleanup
-    surface = TTF_RenderText_Solid(font[print_state.ptsize], str, 0, 
+    surface = TTF_RenderText_Solid(f, str, len, 
                                          sdlx_color(print_state.fg_color));
                                          //sdlx_color(print_state.bg_color));
     if (surface == NULL) {
@@ -469,6 +533,7 @@ static sdlx_loc_t *render_text(bool xy_is_ctr, int x, int y, char * str)
     // create texture from the surface, and render the texture
     texture = SDL_CreateTextureFromSurface(renderer, surface);
     SDL_RenderTexture(renderer, texture, NULL, &pos);
+    stats.draw_calls++;
 
     // clean up
     SDL_DestroySurface(surface);
@@ -482,14 +547,22 @@ static sdlx_loc_t *render_text(bool xy_is_ctr, int x, int y, char * str)
     return &loc;
 }
 
+static sdlx_loc_t *render_text(bool xy_is_ctr, int x, int y, char * str)
+{
+    return render_text_len(xy_is_ctr, x, y, str, 0);
+}
+
 // note: each line may have embedded newline chars
 void sdlx_render_multiline_text(int y_top, int y_display_begin, int y_display_end, char **lines, int num_lines)
 {
-    int y = y_top;
-    int n = 0, k = 0, len;
-    char *ptr;
-    char str[200];
-
+    int   y = y_top;
+    int   n = 0, len;
+    char *str, *ptr;
+
+    // lines are rendered directly from the caller's buffers, without copying;
+    // lines above the display region are skipped without rendering;
+    // for large documents that are scrolled, use sdlx_text_view_t instead
+    str = (num_lines > 0 ? lines[0] : NULL);
     while (n < num_lines) {
         // if y pos of line is below the bottom of the
         // display region then break
@@ -497,31 +570,23 @@ void sdlx_render_multiline_text(int y_top, int y_display_begin, int y_display_en
             break;
         }
 
-        // extract str from the line currently being processed
-        ptr = strchr(&lines[n][k], '\n');
-        if (ptr) {
-            len = ptr - &lines[n][k];
-            memcpy(str, &lines[n][k], len);
-            str[len] = '\0';
-        } else {
-            strcpy(str, &lines[n][k]);
-            len = strlen(str);
-        }
-
-        // advance k and n
-        k += len;
-        if (lines[n][k] == '\n') {
-            k++;
-        }
-        if (lines[n][k] == '\0') {
-            k = 0;
-            n++;
-        }
+        // determine the len of the str being processed
+        ptr = strchr(str, '\n');
+        len = (ptr ? ptr - str : strlen(str));
 
         // if y loc of line is at or below the begining of the display
         // region then render the line
-        if (y >= y_display_begin && str[0] != '\0') {
-            render_text(false, 0, y, str);
+        if (y >= y_display_begin && len > 0) {
+            render_text_len(false, 0, y, str, len);
+        }
+
+        // advance to the next str
+        str += len;
+        if (*str == '\n') {
+            str++;
+        }
+        if (*str == '\0' && ++n < num_lines) {
+            str = lines[n];
         }
 
         // advance y for the next line
@@ -529,6 +594,191 @@ void sdlx_render_multiline_text(int y_top, int y_display_begin, int y_display_en
     }
 }
 
+// - - - - - - - - - - text view  - - - - - - - - - - - - - - -
+
+// A text view indexes the display lines of a document once, so that rendering
+// a scrolled view jumps directly to the first visible line. The textures of
+// the rendered lines are cached, and are destroyed when they are scrolled well
+// out of view, or when the font or color is changed.
+
+#define TEXT_VIEW_CACHE_MARGIN 2   // in units of number of visible lines
+
+typedef struct {
+    char        *str;
+    int          len;
+    SDL_Texture *texture;
+    float        w, h;
+} text_view_line_t;
+
+struct sdlx_text_view {
+    char             *text;           // copy of the caller's lines
+    text_view_line_t *line;
+    int               max_line;
+    int               ptsize;         // of the cached textures
+    int               fg_color;
+    int               cache_first;    // range of lines that may have cached textures
+    int               cache_last;
+};
+
+static void text_view_cache_flush(sdlx_text_view_t *tv, int first, int last)
+{
+    int i;
+
+    for (i = tv->cache_first; i <= tv->cache_last && i < tv->max_line; i++) {
+        if (i >= first && i <= last) {
+            continue;
+        }
+        if (tv->line[i].texture) {
+            SDL_DestroyTexture(tv->line[i].texture);
+            tv->line[i].texture = NULL;
+        }
+    }
+}
+
+// note: each line may have embedded newline chars
+sdlx_text_view_t *sdlx_text_view_create(char **lines, int num_lines)
+{
+    sdlx_text_view_t *tv;
+    int               i, total_len, max_alloc;
+    char             *p, *nl;
+
+    tv = calloc(1, sizeof(sdlx_text_view_t));
+    if (tv == NULL) {
+        return NULL;
+    }
+
+    // copy the caller's lines to a single buffer, with a newline
+    // terminating each, if not already; and count the display lines
+    total_len = 0;
+    for (i = 0; i < num_lines; i++) {
+        total_len += strlen(lines[i]) + 1;
+    }
+    tv->text = malloc(total_len + 1);
+    if (tv->text == NULL) {
+        free(tv);
+        return NULL;
+    }
+    p = tv->text;
+    max_alloc = 0;
+    for (i = 0; i < num_lines; i++) {
+        int len = strlen(lines[i]);
+        memcpy(p, lines[i], len);
+        p += len;
+        if (len == 0 || lines[i][len-1] != '\n') {
+            *p++ = '\n';
+        }
+    }
+    *p = '\0';
+    for (p = tv->text; *p; p++) {
+        if (*p == '\n') max_alloc++;
+    }
+
+    // index the start and length of each display line
+    tv->line = calloc(max_alloc ? max_alloc : 1, sizeof(text_view_line_t));
+    if (tv->line == NULL) {
+        free(tv->text);
+        free(tv);
+        return NULL;
+    }
+    for (p = tv->text; *p; p = nl + 1) {
+        nl = strchr(p, '\n');
+        tv->line[tv->max_line].str = p;
+        tv->line[tv->max_line].len = nl - p;
+        tv->max_line++;
+    }
+
+    tv->cache_first = 0;
+    tv->cache_last = -1;
+    return tv;
+}
+
+// returns the number of display lines
+int sdlx_text_view_num_lines(sdlx_text_view_t *tv)
+{
+    return tv->max_line;
+}
+
+// renders the display lines located between y_display_begin and y_display_end,
+// where y_top is the y location of the first line; using the current font and color
+void sdlx_text_view_render(sdlx_text_view_t *tv, int y_top, int y_display_begin, int y_display_end)
+{
+    int              first, last, margin, i, y;
+    TTF_Font        *f = get_font(print_state.ptsize);
+    SDL_FRect        pos;
+
+    if (f == NULL || sdlx_char_height <= 0) {
+        return;
+    }
+
+    // if the font or color have changed then discard all cached textures
+    if (tv->ptsize != print_state.ptsize || tv->fg_color != print_state.fg_color) {
+        text_view_cache_flush(tv, 0, -1);
+        tv->ptsize = print_state.ptsize;
+        tv->fg_color = print_state.fg_color;
+        tv->cache_first = 0;
+        tv->cache_last = -1;
+    }
+
+    // determine the range of lines that are visible
+    first = (y_top >= y_display_begin ? 0 : (y_display_begin - y_top + sdlx_char_height - 1) / sdlx_char_height);
+    last  = (y_display_end - sdlx_char_height - y_top) / sdlx_char_height;
+    if (last >= tv->max_line) {
+        last = tv->max_line - 1;
+    }
+    if (y_display_end - sdlx_char_height < y_top || first > last) {
+        return;
+    }
+
+    // discard cached textures that are well out of view
+    margin = TEXT_VIEW_CACHE_MARGIN * (last - first + 1);
+    text_view_cache_flush(tv, first - margin, last + margin);
+    tv->cache_first = (first - margin > 0 ? first - margin : 0);
+    tv->cache_last = last + margin;
+
+    // render the visible lines, creating their textures if not cached
+    for (i = first; i <= last; i++) {
+        text_view_line_t *x = &tv->line[i];
+
+        if (x->len == 0) {
+            continue;
+        }
+        if (x->texture == NULL) {
+            SDL_Surface *surface = TTF_RenderText_Solid(f, x->str, x->len, sdlx_color(print_state.fg_color));
+            if (surface == NULL) {
+                ERROR("TTF_RenderText_Solid returned NULL\n");
+                continue;
+            }
+            x->texture = SDL_CreateTextureFromSurface(renderer, surface);
+            x->w = surface->w;
+            x->h = surface->h;
+            SDL_DestroySurface(surface);
+            if (x->texture == NULL) {
+                continue;
+            }
+        }
+
+        y = y_top + i * sdlx_char_height;
+        pos.x = 0;
+        pos.y = y * scale;
+        pos.w = x->w;
+        pos.h = x->h;
+        SDL_RenderTexture(renderer, x->texture, NULL, &pos);
+        stats.draw_calls++;
+    }
+}
+
+void sdlx_text_view_destroy(sdlx_text_view_t *tv)
+{
+    if (tv == NULL) {
+        return;
+    }
+
+    text_view_cache_flush(tv, 0, -1);
+    free(tv->line);
+    free(tv->text);
+    free(tv);
+}
+
 sdlx_loc_t *sdlx_render_text(int x, int y, char * str)
 {
     return render_text(false, x, y, str);
@@ -579,6 +829,7 @@ void sdlx_render_rect(int x, int y, int w, int h, int line_width, int color)
 
     for (i = 0; i < line_width; i++) {
         SDL_RenderRect(renderer, &rect);
+        stats.draw_calls++;
         if (rect.w < 2 || rect.h < 2) {
             break;
         }
@@ -600,6 +851,7 @@ void sdlx_render_fill_rect(int x, int y, int w, int h, int color)
 
     set_render_draw_color(color);
     SDL_RenderFillRect(renderer, &rect);
+    stats.draw_calls++;
 }
 
 void sdlx_render_line(int x1, int y1, int x2, int y2, int color)
@@ -624,6 +876,7 @@ void sdlx_render_lines(sdlx_point_t *points, int count, int color)
     set_render_draw_color(color);
 
     SDL_RenderLines(renderer, scaled_points, count);
+    stats.draw_calls++;
 }
 
 // xxx change args to x_ctr_arg ..
@@ -665,6 +918,7 @@ void sdlx_render_circle(int x_ctr_arg, int y_ctr_arg, int radius, int line_width
             count++;
         }
         SDL_RenderLines(renderer, points, count);
+        stats.draw_calls++;
         count = 0;
 
         // reduce radius by 1
@@ -843,6 +1097,7 @@ void sdlx_render_points(sdlx_point_t *points, int count, int color, int point_si
 
             if (sdlx_points_count == MAX_SDL_POINTS) {
                 SDL_RenderPoints(renderer, sdlx_points, sdlx_points_count);
+                stats.draw_calls++;
                 sdlx_points_count = 0;
             }
         }
@@ -850,6 +1105,7 @@ void sdlx_render_points(sdlx_point_t *points, int count, int color, int point_si
 
     if (sdlx_points_count > 0) {
         SDL_RenderPoints(renderer, sdlx_points, sdlx_points_count);
+        stats.draw_calls++;
         sdlx_points_count = 0;
     }
 }
@@ -879,6 +1135,137 @@ sdlx_texture_t *sdlx_create_texture_from_pixels(unsigned char *pixels, int w, in
     return texture;
 }
 
+// png textures are cached, keyed by path, mtime and size; the cache entry is
+// reference counted and the texture is destroyed when the last reference is
+// released by sdlx_destroy_texture
+
+// returns the cached texture of the png, with a reference added; or NULL, and
+// the index of a free cache entry in *idx, -1 if the cache is full
+static SDL_Texture *png_texture_cache_find(char *path, long mtime, long size, int *idx)
+{
+    int i;
+
+    *idx = -1;
+    for (i = 0; i < MAX_PNG_TEXTURE_CACHE; i++) {
+        if (png_texture_cache[i].texture == NULL) {
+            if (*idx == -1) *idx = i;
+            continue;
+        }
+        if (strcmp(png_texture_cache[i].path, path) == 0 &&
+            png_texture_cache[i].mtime == mtime &&
+            png_texture_cache[i].size == size)
+        {
+            png_texture_cache[i].refcnt++;
+            return png_texture_cache[i].texture;
+        }
+    }
+    return NULL;
+}
+
+// add the texture to the cache; if the cache is full then the texture
+// is returned uncached
+static void png_texture_cache_add(int idx, char *path, long mtime, long size, SDL_Texture *texture)
+{
+    if (idx != -1) {
+        strcpy(png_texture_cache[idx].path, path);
+        png_texture_cache[idx].mtime = mtime;
+        png_texture_cache[idx].size = size;
+        png_texture_cache[idx].texture = texture;
+        png_texture_cache[idx].refcnt = 1;
+    } else {
+        WARN("png texture cache is full\n");
+    }
+}
+
+sdlx_texture_t *sdlx_create_texture_from_png_file(char *dir, char *filename)
+{
+    char            path[200];
+    long            mtime, size;
+    int             idx, w, h;
+    unsigned char  *pixels;
+    sdlx_texture_t *texture;
+
+    sprintf(path, "%s/%s", dir, filename);
+    mtime = util_file_mtime(dir, filename);
+    size = util_file_size(dir, filename);
+
+    // if this png's texture is cached then return it
+    texture = (sdlx_texture_t*)png_texture_cache_find(path, mtime, size, &idx);
+    if (texture != NULL) {
+        return texture;
+    }
+
+    // create the texture from the decoded png cache pixels
+    pixels = util_map_png_file(dir, filename, &w, &h);
+    if (pixels == NULL) {
+        ERROR("failed to read png file %s\n", path);
+        return NULL;
+    }
+    texture = sdlx_create_texture_from_pixels(pixels, w, h);
+    util_unmap_png_file(pixels, w, h);
+    if (texture == NULL) {
+        return NULL;
+    }
+
+    png_texture_cache_add(idx, path, mtime, size, (SDL_Texture*)texture);
+    return texture;
+}
+
+// util_read_png_file_rows callback: creates the streaming texture with the
+// first band of rows, and updates the texture with each band
+static int png_texture_rows_cb(void *cx, unsigned char *pixels, int y, int h, int w_image, int h_image)
+{
+    SDL_Texture **texture = cx;
+    SDL_Rect      rect = { 0, y, w_image, h };
+
+    if (*texture == NULL) {
+        *texture = SDL_CreateTexture(renderer,
+                                     SDL_PIXELFORMAT_ABGR8888,
+                                     SDL_TEXTUREACCESS_STREAMING,
+                                     w_image, h_image);
+        if (*texture == NULL) {
+            ERROR("failed to allocate texture %dx%d\n", w_image, h_image);
+            return -1;
+        }
+    }
+
+    SDL_UpdateTexture(*texture, &rect, pixels, w_image * BYTES_PER_PIXEL);
+    return 0;
+}
+
+// same as sdlx_create_texture_from_png_file, but the png is decoded a band of
+// rows at a time directly into the texture, without the decoded png cache;
+// for large pngs whose decoded pixels would need too much memory
+sdlx_texture_t *sdlx_create_texture_from_png_file_rows(char *dir, char *filename)
+{
+    char         path[200];
+    long         mtime, size;
+    int          idx;
+    SDL_Texture *texture;
+
+    sprintf(path, "%s/%s", dir, filename);
+    mtime = util_file_mtime(dir, filename);
+    size = util_file_size(dir, filename);
+
+    // if this png's texture is cached then return it
+    texture = png_texture_cache_find(path, mtime, size, &idx);
+    if (texture != NULL) {
+        return (sdlx_texture_t*)texture;
+    }
+
+    // decode the png into the texture
+    if (util_read_png_file_rows(dir, filename, PNG_TEXTURE_BAND_ROWS, png_texture_rows_cb, &texture) != 0) {
+        ERROR("failed to read png file %s\n", path);
+        if (texture != NULL) {
+            SDL_DestroyTexture(texture);
+        }
+        return NULL;
+    }
+
+    png_texture_cache_add(idx, path, mtime, size, texture);
+    return (sdlx_texture_t*)texture;
+}
+
 sdlx_texture_t *sdlx_create_filled_circle_texture(int radius, int color)
 {
     radius *= scale;
@@ -940,21 +1327,21 @@ sdlx_texture_t *sdlx_create_text_texture(char * str)
 {
     SDL_Surface * surface;
     SDL_Texture * texture;
+    TTF_Font    * f;
 
     if (str[0] == '\0') {
         return NULL;
     }
 
-    // if font not initialized then return error
-    if (font[print_state.ptsize] == NULL) {
-        ERROR("font ptsize %d, not initialized\n", print_state.ptsize);
+    // if font not available then return error
+    if ((f = get_font(print_state.ptsize)) == NULL) {
         return NULL;
     }
 
     // render the text to a surface,  xxx cleanup
     // create a texture from the surface
     // free the surface
-    surface = TTF_RenderText_Solid(font[print_state.ptsize], str, 0, 
+    surface = TTF_RenderText_Solid(f, str, 0, 
                                     sdlx_color(print_state.fg_color));
                                     //sdlx_color(print_state.bg_color));
     if (surface == NULL) {
@@ -989,6 +1376,7 @@ sdlx_loc_t *sdlx_render_texture(int x, int y, int w, int h, sdlx_texture_t *text
     dest.h = h * scale;
 
     SDL_RenderTextureRotated(renderer, (SDL_Texture*)texture, NULL, &dest, 0, NULL, false);
+    stats.draw_calls++;
 
     // return the display location where the text was rendered;
     loc.x = x;
@@ -1012,6 +1400,7 @@ void sdlx_render_texture_ex(int x, int y, int w, int h, double angle, sdlx_textu
     dest.h = h * scale;
 
     SDL_RenderTextureRotated(renderer, (SDL_Texture*)texture, NULL, &dest, angle, NULL, false);
+    stats.draw_calls++;
 }
 
 void sdlx_render_texture_ex2(int x, int y, int w, int h, double angle, int xctr, int yctr,
@@ -1033,14 +1422,29 @@ void sdlx_render_texture_ex2(int x, int y, int w, int h, double angle, int xctr,
     ctr.y = yctr * scale;
 
     SDL_RenderTextureRotated(renderer, (SDL_Texture*)texture, NULL, &dest, angle, &ctr, false);
+    stats.draw_calls++;
 }
 
 void sdlx_destroy_texture(sdlx_texture_t *texture)
 {
+    int i;
+
     if (texture == NULL) {
         return;
     }
 
+    // if this is a cached png texture then release a reference, and
+    // only destroy the texture when the last reference is released
+    for (i = 0; i < MAX_PNG_TEXTURE_CACHE; i++) {
+        if (png_texture_cache[i].texture == (SDL_Texture *)texture) {
+            if (--png_texture_cache[i].refcnt > 0) {
+                return;
+            }
+            png_texture_cache[i].texture = NULL;
+            break;
+        }
+    }
+
     SDL_DestroyTexture((SDL_Texture *)texture);
 }
 
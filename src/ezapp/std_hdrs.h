@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <limits.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -10,7 +10,26 @@
 
 // ----------------- TIME --------------------
 
+// when set, these provide virtual time; used by event trace replay
+static long (*microsec_timer_source)(void);
+static long (*real_time_microsec_source)(void);
+
+void util_set_time_sources(long (*microsec_timer)(void), long (*real_time_microsec)(void))
+{
+    microsec_timer_source = microsec_timer;
+    real_time_microsec_source = real_time_microsec;
+}
+
 long util_microsec_timer(void)
+{
+    if (microsec_timer_source != NULL) {
+        return microsec_timer_source();
+    }
+
+    return util_monotonic_microsec_timer();
+}
+
+long util_monotonic_microsec_timer(void)
 {
     struct timespec ts;
 
@@ -22,6 +41,10 @@ long util_get_real_time_microsec(void)
 {
     struct timespec ts;
 
+    if (real_time_microsec_source != NULL) {
+        return real_time_microsec_source();
+    }
+
     clock_gettime(CLOCK_REALTIME,&ts);
     return ((long)ts.tv_sec * 1000000) + ((long)ts.tv_nsec / 1000);
 }
@@ -83,25 +106,36 @@ static char *concat(char *s1, char *s2, char *result)
 
 // xxx maybe separating dir is too confusing
 // xxx maybe a concat util instead
+// the file is written to a temp file and renamed into place, so the old
+// inode is left intact for anything that has it mapped, such as a running
+// app's source (see PicocPlatformScanFile)
 int util_write_file(char *dir, char *fn, void *buf, int len)
 {
     int fd, ret;
-    char path[200];
+    char path[200], tmp_path[220];
 
     concat(dir, fn, path);
     INFO("writing file %s\n", path);
 
-    fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+    sprintf(tmp_path, "%s.%d.tmp", path, getpid());
+    fd = open(tmp_path, O_CREAT | O_TRUNC | O_WRONLY, 0666);
     if (fd < 0) {
         return -1;
     }
 
     ret = write(fd, buf, len);
     if (ret != len) {
+        close(fd);
+        unlink(tmp_path);
         return -1;
     }
-
     close(fd);
+
+    if (rename(tmp_path, path) != 0) {
+        ERROR("rename %s failed, %s\n", tmp_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
     return 0;
 }
 
@@ -351,17 +385,281 @@ void util_sync_file(void *addr, int len)
     }
 }
 
+// -----------------  FILE VIEW  -----------------------------
+
+// A file view maps a file read-only, in place of util_read_file's allocate and
+// read, so viewing a large file costs no copy; the pages are the page cache's.
+//
+// Views are refcounted, and are shared by file identity: viewing a file that
+// is already viewed, and has not changed since (same device, inode, size and
+// mtime), returns the same data with its refcount incremented. The mapping is
+// removed when util_view_release releases the last reference.
+//
+// As from util_read_file, the data is followed by a '\0'. The file is mapped
+// over an anonymous mapping that is a byte longer, so that byte is zero even
+// when the file's length is a multiple of the page size.
+
+typedef struct file_view_s {
+    struct file_view_s *next;
+    char               *data;
+    size_t              map_len;
+    int                 len;
+    int                 refcnt;
+    dev_t               dev;
+    ino_t               ino;
+    struct timespec     mtime;
+} file_view_t;
+
+static pthread_mutex_t view_mutex = PTHREAD_MUTEX_INITIALIZER;
+static file_view_t    *view_list;
+
+static file_view_t *view_find(struct stat *st)
+{
+    file_view_t *v;
+
+    for (v = view_list; v != NULL; v = v->next) {
+        if (v->dev == st->st_dev && v->ino == st->st_ino && v->len == st->st_size &&
+            v->mtime.tv_sec == st->st_mtim.tv_sec && v->mtime.tv_nsec == st->st_mtim.tv_nsec)
+        {
+            return v;
+        }
+    }
+    return NULL;
+}
+
+static void view_advise(void *addr, size_t len, int advice)
+{
+    if (advice & UTIL_VIEW_SEQUENTIAL) {
+        madvise(addr, len, MADV_SEQUENTIAL);
+    } else if (advice & UTIL_VIEW_RANDOM) {
+        madvise(addr, len, MADV_RANDOM);
+    }
+    if (advice & UTIL_VIEW_WILLNEED) {
+        madvise(addr, len, MADV_WILLNEED);
+    }
+}
+
+// returns NULL with errno set on error
+void *util_view_file(char *dir, char *fn, int advice, int *len_ret)
+{
+    char         path[200];
+    int          fd, save_errno;
+    struct stat  st;
+    file_view_t *v, *v2;
+    char        *addr;
+    size_t       map_len;
+
+    concat(dir, fn, path);
+    *len_ret = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0) {
+        goto error;
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size >= INT_MAX) {
+        errno = S_ISREG(st.st_mode) ? EFBIG : EINVAL;
+        goto error;
+    }
+
+    // an unchanged file already viewed shares the view
+    pthread_mutex_lock(&view_mutex);
+    v = view_find(&st);
+    if (v != NULL) {
+        v->refcnt++;
+        pthread_mutex_unlock(&view_mutex);
+        close(fd);
+        view_advise(v->data, v->len, advice);
+        *len_ret = v->len;
+        return v->data;
+    }
+    pthread_mutex_unlock(&view_mutex);
+
+    // map the file over a zeroed mapping a byte longer
+    map_len = (st.st_size + 1 + PAGE_SIZE2 - 1) & ~(PAGE_SIZE2-1);
+    addr = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        goto error;
+    }
+    if (st.st_size > 0 &&
+        mmap(addr, st.st_size, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        save_errno = errno;
+        munmap(addr, map_len);
+        errno = save_errno;
+        goto error;
+    }
+    close(fd);
+    view_advise(addr, st.st_size, advice);
+
+    v = calloc(1, sizeof(file_view_t));
+    if (v == NULL) {
+        munmap(addr, map_len);
+        errno = ENOMEM;
+        return NULL;
+    }
+    v->data    = addr;
+    v->map_len = map_len;
+    v->len     = st.st_size;
+    v->refcnt  = 1;
+    v->dev     = st.st_dev;
+    v->ino     = st.st_ino;
+    v->mtime   = st.st_mtim;
+
+    // another thread may have viewed the file meanwhile
+    pthread_mutex_lock(&view_mutex);
+    v2 = view_find(&st);
+    if (v2 != NULL) {
+        v2->refcnt++;
+        pthread_mutex_unlock(&view_mutex);
+        munmap(v->data, v->map_len);
+        free(v);
+        *len_ret = v2->len;
+        return v2->data;
+    }
+    v->next = view_list;
+    view_list = v;
+    pthread_mutex_unlock(&view_mutex);
+
+    *len_ret = v->len;
+    return v->data;
+
+error:
+    save_errno = errno;
+    close(fd);
+    errno = save_errno;
+    return NULL;
+}
+
+static file_view_t **view_find_data(void *data)
+{
+    file_view_t **pp;
+
+    for (pp = &view_list; *pp != NULL; pp = &(*pp)->next) {
+        if ((*pp)->data == data) {
+            return pp;
+        }
+    }
+    return NULL;
+}
+
+void util_view_retain(void *data)
+{
+    file_view_t **pp;
+
+    pthread_mutex_lock(&view_mutex);
+    if ((pp = view_find_data(data)) != NULL) {
+        (*pp)->refcnt++;
+    } else {
+        ERROR("%p is not a file view\n", data);
+    }
+    pthread_mutex_unlock(&view_mutex);
+}
+
+void util_view_release(void *data)
+{
+    file_view_t **pp, *v = NULL;
+
+    if (data == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&view_mutex);
+    if ((pp = view_find_data(data)) == NULL) {
+        ERROR("%p is not a file view\n", data);
+    } else if (--(*pp)->refcnt == 0) {
+        v = *pp;
+        *pp = v->next;
+    }
+    pthread_mutex_unlock(&view_mutex);
+
+    if (v != NULL) {
+        munmap(v->data, v->map_len);
+        free(v);
+    }
+}
+
+// changes the access pattern hint of a view
+void util_view_advise(void *data, int advice)
+{
+    file_view_t **pp;
+    void         *addr = NULL;
+    int           len = 0;
+
+    pthread_mutex_lock(&view_mutex);
+    if ((pp = view_find_data(data)) != NULL) {
+        addr = (*pp)->data;
+        len = (*pp)->len;
+    }
+    pthread_mutex_unlock(&view_mutex);
+
+    if (addr != NULL && len > 0) {
+        view_advise(addr, len, advice);
+    }
+}
+
 // -----------------  GET / SET PARAMS  ----------------------
 
-#define MAX_PARAMS 32
+// The params of each dir are read from the dir's params file the first time
+// they are accessed, and stay cached; each dir's params are hashed by name,
+// and listed in file order.
+//
+// A set updates the cache, and the dir's params file is rewritten later by
+// the params flush thread, so that a burst of sets is written once. The file
+// is written to params.tmp and then renamed, so a params file is never seen
+// partly written. util_flush_params writes the pending sets now.
+//
+// util_get_str_param copies the value into the caller's buffer, so a value
+// can be freed when it is replaced.
+
+#define PARAMS_DIR_HASH   32
+#define PARAMS_HASH       32
+#define FLUSH_DELAY_US    200000
+#define MAX_PARAM_HOOKS   8
+
+typedef struct param_s {
+    struct param_s *next_hash;
+    struct param_s *next;       // file order
+    char           *name;
+    char           *value;
+    double          number;     // value as a number, when number_valid
+    bool            number_valid;
+} param_t;
+
+typedef struct params_dir_s {
+    struct params_dir_s *next_hash;
+    char                *dir;
+    param_t             *hash[PARAMS_HASH];
+    param_t             *first;
+    param_t             *last;
+    bool                 dirty;
+} params_dir_t;
+
+typedef struct {
+    util_param_hook_t hook;
+    void             *cx;
+} param_hook_t;
+
+static params_dir_t   *params_dirs[PARAMS_DIR_HASH];
+static pthread_mutex_t params_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t params_flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  params_flush_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t  params_flush_thread_once = PTHREAD_ONCE_INIT;
+static int             params_dirty_cnt;
+static param_hook_t    param_hooks[MAX_PARAM_HOOKS];
+static int             max_param_hooks;
+
+static unsigned int params_hash(char *s)
+{
+    unsigned int h = 2166136261u;
 
-// xxx keep multiple copies for each data_dir
-static struct {
-    char *name;
-    char *value;
-} params[MAX_PARAMS];
-static int max_params;
-static char params_dir[100];
+    while (*s) {
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+    return h;
+}
 
 static void remove_trailing_newline(char *s)
 {
@@ -372,134 +670,296 @@ static void remove_trailing_newline(char *s)
     }
 }
 
-static void read_params_file(char *dir)
+static void set_param_value(param_t *p, char *value)
 {
-    char s[200], name[100], params_path[100];
-    int cnt, n;
-    FILE *fp;
+    char *end;
 
-    if (strcmp(dir, params_dir) == 0) {
-        return;
+    free(p->value);
+    p->value = strdup(value);
+
+    p->number = strtod(value, &end);
+    p->number_valid = (end != value);
+}
+
+static param_t *find_param(params_dir_t *pd, char *name)
+{
+    param_t *p;
+
+    for (p = pd->hash[params_hash(name) % PARAMS_HASH]; p; p = p->next_hash) {
+        if (strcmp(name, p->name) == 0) {
+            return p;
+        }
     }
-    strcpy(params_dir, dir);
+    return NULL;
+}
 
-    INFO("reading params file in dir '%s'\n", dir);
+static param_t *add_param(params_dir_t *pd, char *name, char *value)
+{
+    param_t *p;
+    int      h;
+
+    p = calloc(1, sizeof(param_t));
+    p->name = strdup(name);
+    set_param_value(p, value);
+
+    h = params_hash(name) % PARAMS_HASH;
+    p->next_hash = pd->hash[h];
+    pd->hash[h] = p;
+    if (pd->last) {
+        pd->last->next = p;
+    } else {
+        pd->first = p;
+    }
+    pd->last = p;
+    return p;
+}
 
-    memset(params, 0, sizeof(params));
-    max_params = 0;
+// the params file of a dir is read when it is first accessed;
+// caller must hold params_mutex
+static params_dir_t *get_params_dir(char *dir)
+{
+    char          s[200], name[100], params_path[300];
+    int           cnt, n, h;
+    FILE         *fp;
+    params_dir_t *pd;
+
+    h = params_hash(dir) % PARAMS_DIR_HASH;
+    for (pd = params_dirs[h]; pd; pd = pd->next_hash) {
+        if (strcmp(dir, pd->dir) == 0) {
+            return pd;
+        }
+    }
+
+    pd = calloc(1, sizeof(params_dir_t));
+    pd->dir = strdup(dir);
+    pd->next_hash = params_dirs[h];
+    params_dirs[h] = pd;
+
+    INFO("reading params file in dir '%s'\n", dir);
 
     sprintf(params_path, "%s/params", dir);
     fp = fopen(params_path, "r");
     if (fp == NULL) {
         INFO("params file does not exist\n");
-        return;
+        return pd;
     }
 
     while (fgets(s, sizeof(s), fp) != NULL) {
         remove_trailing_newline(s);
         n = 0;
-        cnt = sscanf(s, "%s = %n", name, &n);
+        cnt = sscanf(s, "%99s = %n", name, &n);
         if (cnt != 1 || n == 0) {
             ERROR("read_params_file '%s'\n", s);
-            fclose(fp);
-            return;
+            continue;
+        }
+        if (find_param(pd, name) == NULL) {
+            add_param(pd, name, s+n);
         }
-
-        // xxx is this a mem leak
-        params[max_params].name = strdup(name);
-        params[max_params].value = strdup(s+n);
-        max_params++;
     }
 
     fclose(fp);
+    return pd;
+}
 
-    INFO("max_params=%d\n", max_params);
-    for (int i = 0; i < max_params; i++) {
-        INFO("  %s = %s\n", params[i].name, params[i].value);
+// caller must hold params_mutex
+static void mark_dirty(params_dir_t *pd)
+{
+    if (!pd->dirty) {
+        pd->dirty = true;
+        params_dirty_cnt++;
+        pthread_cond_signal(&params_flush_cond);
     }
 }
 
-static void write_params_file(char *dir)
+static void write_params_file(char *dir, char *buff, int len)
 {
-    FILE *fp;
-    char params_path[100];
+    char tmp_path[300], params_path[300];
+    int  fd, rc;
+
+    sprintf(tmp_path, "%s/params.tmp", dir);
+    sprintf(params_path, "%s/params", dir);
 
-    if (strcmp(dir, params_dir) != 0) {
-        ERROR("write_params_file, dir=%s params_dir=%s\n", dir, params_dir);
+    fd = open(tmp_path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+    if (fd < 0) {
+        ERROR("write_params_file, open %s failed, %s\n", tmp_path, strerror(errno));
         return;
     }
+    rc = write(fd, buff, len);
+    if (rc != len || fdatasync(fd) != 0) {
+        ERROR("write_params_file, write %s failed, %s\n", tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return;
+    }
+    close(fd);
 
-    INFO("writing params file in dir '%s'\n", dir);
-    INFO("max_params=%d\n", max_params);
-    for (int i = 0; i < max_params; i++) {
-        INFO("  %s = %s\n", params[i].name, params[i].value);
+    if (rename(tmp_path, params_path) != 0) {
+        ERROR("write_params_file, rename to %s failed, %s\n", params_path, strerror(errno));
+        unlink(tmp_path);
     }
+}
 
-    sprintf(params_path, "%s/params", dir);
-    fp = fopen(params_path, "w");
-    if (fp == NULL) {
-        ERROR("write_params_file, fopen failed, %s\n", strerror(errno));
-        return;
+void util_flush_params(void)
+{
+    params_dir_t **dirty, *pd;
+    param_t       *p;
+    char          *buff;
+    int            h, i, len, max_dirty;
+
+    // params_flush_mutex serializes the writers of the params files
+    pthread_mutex_lock(&params_flush_mutex);
+
+    // snapshot the dirty dirs, holding params_mutex; the dirs are 
+    // never freed, so the snapshot remains valid after it is released
+    pthread_mutex_lock(&params_mutex);
+    dirty = malloc((params_dirty_cnt + 1) * sizeof(params_dir_t*));
+    max_dirty = 0;
+    for (h = 0; h < PARAMS_DIR_HASH; h++) {
+        for (pd = params_dirs[h]; pd; pd = pd->next_hash) {
+            if (pd->dirty) {
+                dirty[max_dirty++] = pd;
+            }
+        }
     }
+    pthread_mutex_unlock(&params_mutex);
+
+    for (i = 0; i < max_dirty; i++) {
+        // format the dir's params, holding params_mutex; 
+        // and write the file without it
+        pd = dirty[i];
+        pthread_mutex_lock(&params_mutex);
+        if (!pd->dirty) {
+            pthread_mutex_unlock(&params_mutex);
+            continue;
+        }
+        len = 0;
+        for (p = pd->first; p; p = p->next) {
+            len += strlen(p->name) + strlen(p->value) + 20;
+        }
+        buff = malloc(len + 1);
+        len = 0;
+        for (p = pd->first; p; p = p->next) {
+            len += sprintf(buff+len, "%-16s = %s\n", p->name, p->value);
+        }
+        pd->dirty = false;
+        params_dirty_cnt--;
+        pthread_mutex_unlock(&params_mutex);
 
-    for (int i = 0; i < max_params; i++) {
-        fprintf(fp, "%-16s = %s\n", params[i].name, params[i].value);
+        INFO("writing params file in dir '%s'\n", pd->dir);
+        write_params_file(pd->dir, buff, len);
+        free(buff);
     }
 
-    fclose(fp);
+    free(dirty);
+    pthread_mutex_unlock(&params_flush_mutex);
 }
 
-char *util_get_str_param(char *dir, char *name, char *default_value)
+static void *params_flush_thread(void *cx)
 {
-    int i;
+    pthread_mutex_lock(&params_mutex);
+    while (true) {
+        while (params_dirty_cnt == 0) {
+            pthread_cond_wait(&params_flush_cond, &params_mutex);
+        }
+        pthread_mutex_unlock(&params_mutex);
+
+        // the sets made while waiting are written together
+        usleep(FLUSH_DELAY_US);
+        util_flush_params();
+
+        pthread_mutex_lock(&params_mutex);
+    }
+    return NULL;
+}
+
+static void start_params_flush_thread(void)
+{
+    pthread_t tid;
+
+    pthread_create(&tid, NULL, params_flush_thread, NULL);
+    pthread_detach(tid);
+}
+
+// the hooks are called after a set changes a param's value,
+// on the thread that made the change
+static void call_param_hooks(char *dir, char *name, char *value)
+{
+    param_hook_t hooks[MAX_PARAM_HOOKS];
+    int          i, max;
+
+    pthread_mutex_lock(&params_mutex);
+    max = max_param_hooks;
+    memcpy(hooks, param_hooks, max * sizeof(param_hook_t));
+    pthread_mutex_unlock(&params_mutex);
 
-    // xxx locking needed
+    for (i = 0; i < max; i++) {
+        hooks[i].hook(dir, name, value, hooks[i].cx);
+    }
+}
 
-    // if haven't read the params file then do so
-    read_params_file(dir);
+int util_add_param_hook(util_param_hook_t hook, void *cx)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&params_mutex);
+    if (max_param_hooks == MAX_PARAM_HOOKS) {
+        ERROR("too many param hooks\n");
+        rc = -1;
+    } else {
+        param_hooks[max_param_hooks].hook = hook;
+        param_hooks[max_param_hooks].cx = cx;
+        max_param_hooks++;
+    }
+    pthread_mutex_unlock(&params_mutex);
+    return rc;
+}
+
+void util_remove_param_hook(util_param_hook_t hook, void *cx)
+{
+    int i;
 
-    // search for matching name
-    for (i = 0; i < max_params; i++) {
-        if (strcmp(name, params[i].name) == 0) {
+    pthread_mutex_lock(&params_mutex);
+    for (i = 0; i < max_param_hooks; i++) {
+        if (param_hooks[i].hook == hook && param_hooks[i].cx == cx) {
+            param_hooks[i] = param_hooks[--max_param_hooks];
             break;
         }
     }
+    pthread_mutex_unlock(&params_mutex);
+}
+
+char *util_get_str_param(char *dir, char *name, char *default_value, char *value, int max_value)
+{
+    params_dir_t *pd;
+    param_t      *p;
+
+    pthread_mutex_lock(&params_mutex);
 
     // if found then 
-    //   return value
+    //   copy value to caller's buffer
     // else
     //   add param, set to default value, and write file
     // endif
-    if (i < max_params) {
-        return params[i].value;
-    } else {
-        if (max_params >= MAX_PARAMS) {
-            ERROR("params tbl is full\n");
-            return default_value;
-        }
-        params[max_params].name = strdup(name);
-        params[max_params].value = strdup(default_value);
-        max_params++;
-        write_params_file(dir);
-        return default_value;
+    pd = get_params_dir(dir);
+    p = find_param(pd, name);
+    if (p == NULL) {
+        p = add_param(pd, name, default_value);
+        mark_dirty(pd);
     }
+    snprintf(value, max_value, "%s", p->value);
+
+    pthread_mutex_unlock(&params_mutex);
+
+    pthread_once(&params_flush_thread_once, start_params_flush_thread);
+    return value;
 }
 
 void util_set_str_param(char *dir, char *name, char *value)
 {
-    int i;
-
-    // xxx locking needed
+    params_dir_t *pd;
+    param_t      *p;
 
-    // if haven't read the params file then do so
-    read_params_file(dir);
-
-    // search for matching name
-    for (i = 0; i < max_params; i++) {
-        if (strcmp(name, params[i].name) == 0) {
-            break;
-        }
-    }
+    pthread_mutex_lock(&params_mutex);
 
     // if found then
     //   if no change then return
@@ -507,51 +967,49 @@ void util_set_str_param(char *dir, char *name, char *value)
     // else
     //   add param to the end
     // endif
-    if (i < max_params) {
-        if (strcmp(params[i].value, value) == 0) {
+    pd = get_params_dir(dir);
+    p = find_param(pd, name);
+    if (p != NULL) {
+        if (strcmp(p->value, value) == 0) {
+            pthread_mutex_unlock(&params_mutex);
             return;
         }
-        free(params[i].value);
-        params[i].value = strdup(value);
+        set_param_value(p, value);
     } else {
-        if (max_params >= MAX_PARAMS) {
-            ERROR("params tbl is full\n");
-            return;
-        }
-        params[max_params].name = strdup(name);
-        params[max_params].value = strdup(value);
-        max_params++;
+        add_param(pd, name, value);
     }
+    mark_dirty(pd);
+
+    pthread_mutex_unlock(&params_mutex);
 
-    // write the params file
-    write_params_file(dir);
+    pthread_once(&params_flush_thread_once, start_params_flush_thread);
+    call_param_hooks(dir, name, value);
 }
 
 double util_get_numeric_param(char *dir, char *name, double dflt_val)
 {
-    char   dflt_val_str[100];
-    char  *value_str;
-    double value;
-    int    cnt;
-
-    // create the default value string, and
-    // call util_get_str_param to get the value_str
-    sprintf(dflt_val_str, "%G", dflt_val);
-    value_str = util_get_str_param(dir, name, dflt_val_str);
-
-    // convert value_str, returned by util_get_str_param, to 'value'
-    cnt = sscanf(value_str, "%lf", &value);
-
-    // the conversion can fail if value_str is not a number,
-    // if the conversion fails then call util_set_numeric_param, and 
-    // return the default value
-    if (cnt != 1) {
-        util_set_numeric_param(dir, name, dflt_val);
-        return dflt_val;
+    char          dflt_val_str[100];
+    params_dir_t *pd;
+    param_t      *p;
+    double        value;
+
+    // the value is converted to a number when it is set, so the
+    // lookup of an existing param is just the hash lookup
+    pthread_mutex_lock(&params_mutex);
+    pd = get_params_dir(dir);
+    p = find_param(pd, name);
+    if (p != NULL && p->number_valid) {
+        value = p->number;
+        pthread_mutex_unlock(&params_mutex);
+        return value;
     }
+    pthread_mutex_unlock(&params_mutex);
 
-    // return the param value
-    return value;
+    // the param doesn't exist, or its value is not a number;
+    // set it to the default value, and return the default value
+    sprintf(dflt_val_str, "%G", dflt_val);
+    util_set_str_param(dir, name, dflt_val_str);
+    return dflt_val;
 }
 
 void util_set_numeric_param(char *dir, char *name, double value)
@@ -566,16 +1024,16 @@ void util_set_numeric_param(char *dir, char *name, double value)
 
 void util_print_params(char *dir)
 {
-    int i;
-
-    // xxx locking
-
-    read_params_file(dir);
-
-    INFO("max_params=%d\n", max_params);
-    for (i = 0; i < max_params; i++) {
-        INFO("  %s = %s\n", params[i].name, params[i].value);
+    params_dir_t *pd;
+    param_t      *p;
+
+    pthread_mutex_lock(&params_mutex);
+    pd = get_params_dir(dir);
+    INFO("params in dir '%s'\n", dir);
+    for (p = pd->first; p; p = p->next) {
+        INFO("  %s = %s\n", p->name, p->value);
     }
+    pthread_mutex_unlock(&params_mutex);
 }
 
 // -----------------  NETWORK  -------------------------------
@@ -633,122 +1091,947 @@ next:
 
 // ----------------- JSON --------------------
 
-void *util_json_parse(char *str, char **end_ptr)
+// Object member and array element lookups past the first JSON_INDEX_MIN
+// members use an index, built for the object or array when it is first
+// accessed that way; smaller objects and arrays are just searched. 
+//
+// util_json_parse parses into a cJSON arena, with the keys interned, so that
+// the tree is allocated in a few large blocks and freed by util_json_free in
+// one call. Each tree is a json_doc, on the json_doc list; the doc of an item
+// is the doc whose arena contains the item. The indexes of a tree's objects
+// and arrays are kept in its doc, keyed by the object's address, and are
+// freed with the doc. The parsed json is read-only, so an index never goes
+// stale.
+//
+// Key matching is case insensitive, as cJSON_GetObjectItem's; the first of
+// duplicate keys is found.
+
+#define JSON_INDEX_MIN       16
+#define JSON_MAX_QUERY_STEPS 32
+
+typedef struct json_index_s {
+    struct json_index_s *next;
+    cJSON               *item;     // object or array
+    int                  max;      // number of members
+    int                  mask;     // object: slots-1
+    cJSON              **slots;    // object: hash slots, array: the elements
+} json_index_t;
+
+typedef struct {
+    char        *key;      // NULL for an array index
+    int          index;
+    unsigned int hash;
+} json_step_t;
+
+struct util_json_query {
+    int         max_steps;
+    json_step_t steps[];
+};
+
+typedef struct json_doc_s {
+    struct json_doc_s *next;
+    cJSON             *root;
+    cJSON_Arena       *arena;
+    json_index_t     **index_tbl;
+    int                index_tbl_size;
+    int                index_cnt;
+} json_doc_t;
+
+static pthread_mutex_t json_doc_mutex = PTHREAD_MUTEX_INITIALIZER;
+static json_doc_t     *json_doc_list;
+
+static unsigned int json_key_hash(const char *s)
 {
-    if (str == NULL || end_ptr == NULL) {
-        return NULL;
+    unsigned int h = 2166136261u;
+    unsigned char c;
+
+    while ((c = *s++)) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h = (h ^ c) * 16777619u;
     }
+    return h;
+}
+
+static unsigned int json_ptr_hash(void *p)
+{
+    unsigned long x = (unsigned long)p;
 
-    return cJSON_ParseWithOpts(str, (const char **)end_ptr, 0);
+    x ^= x >> 17;
+    x *= 0xed5ad4bbUL;
+    x ^= x >> 11;
+    return x;
 }
 
-void util_json_free(void *json_root)
+static int json_count(cJSON *item)
 {
-    if (json_root == NULL) {
-        return;
+    cJSON *c;
+    int    n = 0;
+
+    for (c = item->child; c; c = c->next) {
+        n++;
     }
+    return n;
+}
 
-    cJSON_Delete((cJSON*)json_root);
+// returns the doc of item, or NULL if item is not in a tree parsed by
+// util_json_parse; the doc found is moved to the front of the list, as 
+// it is likely to be the doc of the next lookup;
+// caller must hold json_doc_mutex
+static json_doc_t *json_doc_find(cJSON *item)
+{
+    json_doc_t **pp, *doc;
+
+    for (pp = &json_doc_list; (doc = *pp) != NULL; pp = &doc->next) {
+        if (cJSON_ArenaContains(doc->arena, item)) {
+            *pp = doc->next;
+            doc->next = json_doc_list;
+            json_doc_list = doc;
+            return doc;
+        }
+    }
+    return NULL;
 }
 
-json_value_t *util_json_get_value(void *json_item, ...)
+// caller must hold json_doc_mutex
+static json_index_t *json_index_find(json_doc_t *doc, cJSON *item)
 {
-    cJSON              *item = (cJSON*)json_item;
-    va_list             ap;
-    char               *arg;
-    int                 cnt, array_idx;
-    static json_value_t value;
+    json_index_t *x;
 
-    memset(&value, 0, sizeof(value));
+    if (doc->index_cnt == 0) {
+        return NULL;
+    }
+    for (x = doc->index_tbl[json_ptr_hash(item) & (doc->index_tbl_size-1)]; x; x = x->next) {
+        if (x->item == item) {
+            return x;
+        }
+    }
+    return NULL;
+}
 
-    if (json_item == NULL) {
-        value.type = JSON_TYPE_UNDEFINED;
-        return &value;
+// returns NULL if out of memory, the caller then searches the item;
+// caller must hold json_doc_mutex
+static json_index_t *json_index_create(json_doc_t *doc, cJSON *item, int max)
+{
+    json_index_t *x, *next, **tbl;
+    cJSON        *c;
+    int           i, h, size;
+
+    // grow the doc's table when its load reaches 1
+    if (doc->index_cnt >= doc->index_tbl_size) {
+        size = (doc->index_tbl_size == 0 ? 64 : 2 * doc->index_tbl_size);
+        tbl = calloc(size, sizeof(json_index_t*));
+        if (tbl == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < doc->index_tbl_size; i++) {
+            for (x = doc->index_tbl[i]; x; x = next) {
+                next = x->next;
+                h = json_ptr_hash(x->item) & (size-1);
+                x->next = tbl[h];
+                tbl[h] = x;
+            }
+        }
+        free(doc->index_tbl);
+        doc->index_tbl = tbl;
+        doc->index_tbl_size = size;
     }
 
-    va_start(ap, json_item);
+    x = calloc(1, sizeof(json_index_t));
+    if (x == NULL) {
+        return NULL;
+    }
+    x->item = item;
+    x->max = max;
+
+    if (item->type == cJSON_Array) {
+        x->slots = malloc(max * sizeof(cJSON*));
+        if (x->slots == NULL) {
+            free(x);
+            return NULL;
+        }
+        for (i = 0, c = item->child; c; c = c->next) {
+            x->slots[i++] = c;
+        }
+    } else {
+        for (size = 16; size < 2 * max; size *= 2) ;
+        x->mask = size - 1;
+        x->slots = calloc(size, sizeof(cJSON*));
+        if (x->slots == NULL) {
+            free(x);
+            return NULL;
+        }
+        for (c = item->child; c; c = c->next) {
+            if (c->string == NULL) {
+                continue;
+            }
+            for (h = json_key_hash(c->string) & x->mask; x->slots[h]; h = (h+1) & x->mask) {
+                if (strcasecmp(x->slots[h]->string, c->string) == 0) {
+                    break;
+                }
+            }
+            if (x->slots[h] == NULL) {
+                x->slots[h] = c;
+            }
+        }
+    }
 
-    while ((arg = va_arg(ap, char*)) != NULL) {
-        cnt = sscanf(arg, "%d", &array_idx);
-        if (cnt == 0) {
-            item = cJSON_GetObjectItem(item, arg);
-        } else {
-            item = cJSON_GetArrayItem(item, array_idx);
+    h = json_ptr_hash(item) & (doc->index_tbl_size-1);
+    x->next = doc->index_tbl[h];
+    doc->index_tbl[h] = x;
+    doc->index_cnt++;
+    return x;
+}
+
+// returns the index of item, creating it if needed; or NULL if item is
+// not in a parsed tree, or out of memory;
+// caller must hold json_doc_mutex
+static json_index_t *json_index_get(cJSON *item)
+{
+    json_doc_t   *doc;
+    json_index_t *x;
+
+    doc = json_doc_find(item);
+    if (doc == NULL) {
+        return NULL;
+    }
+    x = json_index_find(doc, item);
+    if (x == NULL) {
+        x = json_index_create(doc, item, json_count(item));
+    }
+    return x;
+}
+
+static void json_doc_free(json_doc_t *doc)
+{
+    json_index_t *x, *next;
+    int           i;
+
+    for (i = 0; i < doc->index_tbl_size; i++) {
+        for (x = doc->index_tbl[i]; x; x = next) {
+            next = x->next;
+            free(x->slots);
+            free(x);
         }
-        if (item == NULL) {
+    }
+    free(doc->index_tbl);
+    cJSON_DeleteArena(doc->arena);
+    free(doc);
+}
+
+static cJSON *json_get_member(cJSON *item, const char *key, unsigned int hash)
+{
+    json_index_t *x;
+    cJSON        *c;
+    int           h, n;
+
+    if (item == NULL || item->type != cJSON_Object) {
+        return NULL;
+    }
+
+    // the first JSON_INDEX_MIN members are searched; this finds the key
+    // in an object too small to be indexed without taking the mutex
+    for (c = item->child, n = 0; c && n < JSON_INDEX_MIN; c = c->next, n++) {
+        if (c->string && strcasecmp(c->string, key) == 0) {
+            return c;
+        }
+    }
+    if (c == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&json_doc_mutex);
+    x = json_index_get(item);
+    if (x != NULL) {
+        for (h = hash & x->mask; (c = x->slots[h]); h = (h+1) & x->mask) {
+            if (strcasecmp(c->string, key) == 0) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&json_doc_mutex);
+        return c;
+    }
+    pthread_mutex_unlock(&json_doc_mutex);
+
+    for (c = item->child; c; c = c->next) {
+        if (c->string && strcasecmp(c->string, key) == 0) {
             break;
         }
     }
+    return c;
+}
 
-    va_end(ap);
+static cJSON *json_get_element(cJSON *item, int index)
+{
+    json_index_t *x;
+    cJSON        *c;
+    int           i;
+
+    if (item == NULL || item->type != cJSON_Array || index < 0) {
+        return NULL;
+    }
+
+    // the first JSON_INDEX_MIN elements are walked to
+    for (c = item->child, i = 0; c && i < JSON_INDEX_MIN; c = c->next, i++) {
+        if (i == index) {
+            return c;
+        }
+    }
+    if (c == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&json_doc_mutex);
+    x = json_index_get(item);
+    if (x != NULL) {
+        c = (index < x->max ? x->slots[index] : NULL);
+        pthread_mutex_unlock(&json_doc_mutex);
+        return c;
+    }
+    pthread_mutex_unlock(&json_doc_mutex);
+
+    for (; c && i < index; c = c->next) {
+        i++;
+    }
+    return c;
+}
+
+static void json_set_value(cJSON *item, json_value_t *value)
+{
+    memset(value, 0, sizeof(json_value_t));
 
     if (item == NULL) {
-        value.type = JSON_TYPE_UNDEFINED;
-        return &value;
+        value->type = JSON_TYPE_UNDEFINED;
+        return;
     }
 
     switch (item->type) {
     case cJSON_False:
     case cJSON_True:
-        value.type = JSON_TYPE_FLAG;
-        value.u.flag = (item->type == cJSON_True);
+        value->type = JSON_TYPE_FLAG;
+        value->u.flag = (item->type == cJSON_True);
         break;
     case cJSON_Number:
-        value.type = JSON_TYPE_NUMBER;
-        value.u.number = item->valuedouble;
+        value->type = JSON_TYPE_NUMBER;
+        value->u.number = item->valuedouble;
         break;
     case cJSON_String:
-        value.type = JSON_TYPE_STRING;
-        value.u.string = item->valuestring;
+        value->type = JSON_TYPE_STRING;
+        value->u.string = item->valuestring;
         break;
     case cJSON_Array:
-        value.type = JSON_TYPE_ARRAY;
-        value.u.array = item;
+        value->type = JSON_TYPE_ARRAY;
+        value->u.array = item;
         break;
     case cJSON_Object:
-        value.type = JSON_TYPE_OBJECT;
-        value.u.object = item;
+        value->type = JSON_TYPE_OBJECT;
+        value->u.object = item;
         break;
     default:
-        value.type = JSON_TYPE_UNDEFINED;
+        value->type = JSON_TYPE_UNDEFINED;
         break;
     }
+}
+
+// returns true if s is a non-empty string of digits
+static bool json_is_index(const char *s, int *index)
+{
+    const char *p;
+
+    for (p = s; *p >= '0' && *p <= '9'; p++) ;
+    if (p == s || *p != '\0') {
+        return false;
+    }
+    *index = atoi(s);
+    return true;
+}
+
+void *util_json_parse(char *str, char **end_ptr)
+{
+    size_t       len;
+    cJSON_Arena *arena;
+    cJSON       *root;
+    json_doc_t  *doc;
+
+    if (str == NULL || end_ptr == NULL) {
+        return NULL;
+    }
+
+    // the tree takes 3 to 4 times the length of the json text, and the arena
+    // doubles its block size as it grows
+    len = strlen(str);
+    arena = cJSON_CreateArena(len < 4096 ? 4096 : len, true);
+    doc = calloc(1, sizeof(json_doc_t));
+    if (arena == NULL || doc == NULL) {
+        cJSON_DeleteArena(arena);
+        free(doc);
+        return NULL;
+    }
+
+    root = cJSON_ParseWithArena(arena, str, len+1, (const char **)end_ptr, 0);
+    if (root == NULL) {
+        cJSON_DeleteArena(arena);
+        free(doc);
+        return NULL;
+    }
+
+    doc->root  = root;
+    doc->arena = arena;
+    pthread_mutex_lock(&json_doc_mutex);
+    doc->next = json_doc_list;
+    json_doc_list = doc;
+    pthread_mutex_unlock(&json_doc_mutex);
+
+    return root;
+}
+
+void util_json_free(void *json_root)
+{
+    json_doc_t **pp, *doc = NULL;
+
+    if (json_root == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&json_doc_mutex);
+    for (pp = &json_doc_list; *pp != NULL; pp = &(*pp)->next) {
+        if ((*pp)->root == json_root) {
+            doc = *pp;
+            *pp = doc->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&json_doc_mutex);
+
+    if (doc == NULL) {
+        ERROR("json_root %p was not returned by util_json_parse\n", json_root);
+        return;
+    }
+    json_doc_free(doc);
+}
+
+// the returned value is per thread, and is valid until the thread's next call
+json_value_t *util_json_get_value(void *json_item, ...)
+{
+    cJSON                    *item = (cJSON*)json_item;
+    va_list                   ap;
+    char                     *arg;
+    int                       array_idx;
+    static __thread json_value_t value;
+
+    va_start(ap, json_item);
 
+    while (item != NULL && (arg = va_arg(ap, char*)) != NULL) {
+        if (json_is_index(arg, &array_idx)) {
+            item = json_get_element(item, array_idx);
+        } else {
+            item = json_get_member(item, arg, json_key_hash(arg));
+        }
+    }
+
+    va_end(ap);
+
+    json_set_value(item, &value);
     return &value;
 }
 
+// path: keys separated by '.', and array indexes in brackets; 
+// for example "properties.periods[0].startTime"
+util_json_query_t *util_json_query_compile(char *path)
+{
+    util_json_query_t *q;
+    json_step_t        steps[JSON_MAX_QUERY_STEPS];
+    char              *p, *end;
+    int                i, n = 0, len;
+
+    p = path;
+    while (*p != '\0') {
+        if (n == JSON_MAX_QUERY_STEPS) {
+            ERROR("json query '%s' has too many steps\n", path);
+            goto error;
+        }
+        if (*p == '[') {
+            steps[n].key = NULL;
+            steps[n].index = strtol(p+1, &end, 10);
+            if (end == p+1 || *end != ']' || steps[n].index < 0) {
+                ERROR("json query '%s' invalid index\n", path);
+                goto error;
+            }
+            p = end + 1;
+        } else {
+            len = strcspn(p, ".[");
+            if (len == 0) {
+                ERROR("json query '%s' empty key\n", path);
+                goto error;
+            }
+            steps[n].key = strndup(p, len);
+            steps[n].hash = json_key_hash(steps[n].key);
+            p += len;
+        }
+        n++;
+        if (*p == '.') {
+            p++;
+            if (*p == '\0' || *p == '.' || *p == '[') {
+                ERROR("json query '%s' empty key\n", path);
+                goto error;
+            }
+        }
+    }
+
+    q = malloc(sizeof(util_json_query_t) + n * sizeof(json_step_t));
+    if (q == NULL) {
+        goto error;
+    }
+    q->max_steps = n;
+    memcpy(q->steps, steps, n * sizeof(json_step_t));
+    return q;
+
+error:
+    for (i = 0; i < n; i++) {
+        free(steps[i].key);
+    }
+    return NULL;
+}
+
+void util_json_query_free(util_json_query_t *q)
+{
+    int i;
+
+    if (q == NULL) {
+        return;
+    }
+    for (i = 0; i < q->max_steps; i++) {
+        free(q->steps[i].key);
+    }
+    free(q);
+}
+
+int util_json_query(void *json_item, util_json_query_t *q, json_value_t *value)
+{
+    cJSON *item = (cJSON*)json_item;
+    int    i;
+
+    for (i = 0; i < q->max_steps && item != NULL; i++) {
+        json_step_t *s = &q->steps[i];
+        item = (s->key != NULL ? json_get_member(item, s->key, s->hash)
+                               : json_get_element(item, s->index));
+    }
+
+    json_set_value(item, value);
+    return item != NULL ? 0 : -1;
+}
+
+int util_json_array_size(void *json_array)
+{
+    cJSON *item = (cJSON*)json_array;
+
+    return (item != NULL && item->type == cJSON_Array ? json_count(item) : 0);
+}
+
+void util_json_cursor_init(json_cursor_t *cursor, void *json_array)
+{
+    cJSON *item = (cJSON*)json_array;
+
+    cursor->next = (item != NULL && item->type == cJSON_Array ? item->child : NULL);
+    cursor->index = -1;
+}
+
+int util_json_cursor_next(json_cursor_t *cursor, json_value_t *value)
+{
+    cJSON *item = (cJSON*)cursor->next;
+
+    if (item == NULL) {
+        json_set_value(NULL, value);
+        return -1;
+    }
+    cursor->next = item->next;
+    cursor->index++;
+    json_set_value(item, value);
+    return 0;
+}
+
 // ----------------- PNG  --------------------
 
+// Decoded images are cached in PNG_CACHE_DIR as raw RGBA sidecar files, so that
+// a repeat read maps the pixels rather than inflating and unfiltering the png.
+// The sidecar file name is a hash of the png path, mtime and size; so a modified
+// png gets a new sidecar. The header is validated against the png stat.
+//
+// The cache is limited to PNG_CACHE_MAX_BYTES; after a sidecar is written the
+// least recently used sidecars are removed until the cache is within the limit.
+// A sidecar's mtime is its last use, it is updated when a mapped sidecar has
+// not been used for PNG_CACHE_TOUCH_SECS.
+
+#define PNG_CACHE_DIR          "png_cache"
+#define PNG_CACHE_MAGIC        "EZRGBA01"
+#define PNG_CACHE_HDR_SIZE     64
+#define PNG_CACHE_MAX_BYTES    (256L * 1024 * 1024)
+#define PNG_CACHE_TOUCH_SECS   3600
+#define PNG_CACHE_TMP_SECS     3600
+
+typedef struct {
+    char magic[8];
+    long mtime;      // png mtime, nanosecs
+    long size;       // png size
+    int  w;
+    int  h;
+    unsigned long path_hash;
+    char reserved[PNG_CACHE_HDR_SIZE - 40];
+} png_cache_hdr_t;
+
+_Static_assert(sizeof(png_cache_hdr_t) == PNG_CACHE_HDR_SIZE, "png_cache_hdr_t size");
+
+static unsigned long fnv1a_hash(unsigned long hash, void *data, int len)
+{
+    unsigned char *p = data;
+
+    while (len--) {
+        hash = (hash ^ *p++) * 0x100000001b3UL;
+    }
+    return hash;
+}
+
+static void png_cache_key(char *path, struct stat *statbuf, long *mtime, 
+                          unsigned long *path_hash, char *cache_path)
+{
+    unsigned long hash;
+
+    *mtime = statbuf->st_mtim.tv_sec * 1000000000L + statbuf->st_mtim.tv_nsec;
+    *path_hash = fnv1a_hash(0xcbf29ce484222325UL, path, strlen(path));
+
+    hash = *path_hash;
+    hash = fnv1a_hash(hash, mtime, sizeof(long));
+    hash = fnv1a_hash(hash, &statbuf->st_size, sizeof(statbuf->st_size));
+    sprintf(cache_path, "%s/%016lx.rgba", PNG_CACHE_DIR, hash);
+}
+
+typedef struct {
+    char   name[32];
+    time_t mtime;
+    long   size;
+} png_cache_ent_t;
+
+static int png_cache_ent_cmp(const void *a, const void *b)
+{
+    const png_cache_ent_t *ea = a, *eb = b;
+
+    return (ea->mtime < eb->mtime ? -1 : ea->mtime > eb->mtime ? 1 : 0);
+}
+
+// remove the least recently used sidecars until the cache is within
+// PNG_CACHE_MAX_BYTES, and temp files left by a process that died
+static void png_cache_trim(void)
+{
+    DIR             *dir;
+    struct dirent   *de;
+    struct stat      statbuf;
+    png_cache_ent_t *ents = NULL, *x;
+    int              max_ents = 0, alloced_ents = 0, i;
+    long             total = 0;
+    char             path[300];
+    time_t           now = time(NULL);
+
+    dir = opendir(PNG_CACHE_DIR);
+    if (dir == NULL) {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.' || strlen(de->d_name) >= sizeof(ents[0].name)) {
+            continue;
+        }
+        sprintf(path, "%s/%s", PNG_CACHE_DIR, de->d_name);
+        if (stat(path, &statbuf) != 0 || !S_ISREG(statbuf.st_mode)) {
+            continue;
+        }
+        if (strstr(de->d_name, ".tmp") != NULL) {
+            if (now - statbuf.st_mtime > PNG_CACHE_TMP_SECS) {
+                unlink(path);
+            }
+            continue;
+        }
+        if (max_ents == alloced_ents) {
+            alloced_ents = (alloced_ents ? 2 * alloced_ents : 64);
+            x = realloc(ents, alloced_ents * sizeof(png_cache_ent_t));
+            if (x == NULL) {
+                break;
+            }
+            ents = x;
+        }
+        x = &ents[max_ents++];
+        strcpy(x->name, de->d_name);
+        x->mtime = statbuf.st_mtime;
+        x->size = statbuf.st_size;
+        total += x->size;
+    }
+    closedir(dir);
+
+    if (total > PNG_CACHE_MAX_BYTES) {
+        qsort(ents, max_ents, sizeof(png_cache_ent_t), png_cache_ent_cmp);
+        for (i = 0; i < max_ents && total > PNG_CACHE_MAX_BYTES; i++) {
+            sprintf(path, "%s/%s", PNG_CACHE_DIR, ents[i].name);
+            INFO("removing %s from png cache\n", path);
+            if (unlink(path) == 0) {
+                total -= ents[i].size;
+            }
+        }
+    }
+
+    free(ents);
+}
+
+// write the sidecar to a temp file, and rename it into place
+static void png_cache_write(char *cache_path, png_cache_hdr_t *hdr, unsigned char *pixels)
+{
+    char   tmp_path[200];
+    int    fd;
+    size_t len = (size_t)hdr->w * hdr->h * 4;
+
+    mkdir(PNG_CACHE_DIR, 0777);
+
+    sprintf(tmp_path, "%s.%d.tmp", cache_path, getpid());
+    fd = open(tmp_path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+    if (fd < 0) {
+        ERROR("failed to create %s, %s\n", tmp_path, strerror(errno));
+        return;
+    }
+    if (write(fd, hdr, sizeof(*hdr)) != sizeof(*hdr) ||
+        write(fd, pixels, len) != len) 
+    {
+        ERROR("failed to write %s, %s\n", tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return;
+    }
+    close(fd);
+
+    if (rename(tmp_path, cache_path) != 0) {
+        ERROR("rename %s failed, %s\n", tmp_path, strerror(errno));
+        unlink(tmp_path);
+        return;
+    }
+
+    png_cache_trim();
+}
+
+// returns the mapped sidecar pixels, or NULL if the sidecar does not exist or is stale
+static unsigned char *png_cache_map(char *cache_path, long mtime, long size, 
+                                    unsigned long path_hash, int *w, int *h)
+{
+    int              fd;
+    struct stat      statbuf;
+    png_cache_hdr_t *hdr;
+
+    fd = open(cache_path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &statbuf) != 0 || statbuf.st_size < PNG_CACHE_HDR_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    hdr = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (hdr == MAP_FAILED) {
+        ERROR("mmap %s failed, %s\n", cache_path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    // update the sidecar's last use, for png_cache_trim
+    if (time(NULL) - statbuf.st_mtime > PNG_CACHE_TOUCH_SECS) {
+        futimens(fd, NULL);
+    }
+    close(fd);
+
+    if (memcmp(hdr->magic, PNG_CACHE_MAGIC, 8) != 0 ||
+        hdr->mtime != mtime || hdr->size != size || hdr->path_hash != path_hash ||
+        hdr->w <= 0 || hdr->h <= 0 ||
+        statbuf.st_size != PNG_CACHE_HDR_SIZE + (long)hdr->w * hdr->h * 4)
+    {
+        ERROR("%s is invalid\n", cache_path);
+        munmap(hdr, statbuf.st_size);
+        return NULL;
+    }
+
+    *w = hdr->w;
+    *h = hdr->h;
+    return (unsigned char*)hdr + PNG_CACHE_HDR_SIZE;
+}
+
+// returns the pixels in an anonymous mapping laid out as a sidecar,
+// or NULL if the mapping fails
+static unsigned char *png_anon_map(png_cache_hdr_t *hdr, unsigned char *pixels)
+{
+    size_t         len = (size_t)hdr->w * hdr->h * 4;
+    unsigned char *p;
+
+    p = mmap(NULL, PNG_CACHE_HDR_SIZE + len, PROT_READ|PROT_WRITE, 
+             MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        ERROR("mmap anonymous failed, %s\n", strerror(errno));
+        return NULL;
+    }
+    memcpy(p, hdr, PNG_CACHE_HDR_SIZE);
+    memcpy(p + PNG_CACHE_HDR_SIZE, pixels, len);
+    mprotect(p, PNG_CACHE_HDR_SIZE + len, PROT_READ);
+    return p + PNG_CACHE_HDR_SIZE;
+}
+
+unsigned char *util_map_png_file(char *dir, char *filename, int *w, int *h)
+{
+    char             path[200], cache_path[200];
+    struct stat      statbuf;
+    long             mtime;
+    unsigned long    path_hash;
+    unsigned char   *pixels, *mapped;
+    unsigned int     uw, uh;
+    png_cache_hdr_t  hdr;
+    int              rc;
+
+    concat(dir, filename, path);
+
+    if (stat(path, &statbuf) != 0) {
+        ERROR("stat %s failed, %s\n", path, strerror(errno));
+        return NULL;
+    }
+    png_cache_key(path, &statbuf, &mtime, &path_hash, cache_path);
+
+    // if the sidecar exists then return its mapped pixels
+    mapped = png_cache_map(cache_path, mtime, statbuf.st_size, path_hash, w, h);
+    if (mapped != NULL) {
+        return mapped;
+    }
+
+    // decode the png, write the sidecar, and map it; if the sidecar can't
+    // be written or mapped then the decoded pixels are returned in an
+    // anonymous mapping with the same layout, for util_unmap_png_file
+    INFO("decoding png file %s to %s\n", path, cache_path);
+    rc = lodepng_decode32_file(&pixels, &uw, &uh, path);
+    if (rc != 0) {
+        ERROR("lodepng_decode32_file %s failed, rc=%d\n", path, rc);
+        return NULL;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PNG_CACHE_MAGIC, 8);
+    hdr.mtime = mtime;
+    hdr.size = statbuf.st_size;
+    hdr.w = uw;
+    hdr.h = uh;
+    hdr.path_hash = path_hash;
+    png_cache_write(cache_path, &hdr, pixels);
+
+    mapped = png_cache_map(cache_path, mtime, statbuf.st_size, path_hash, w, h);
+    if (mapped == NULL) {
+        mapped = png_anon_map(&hdr, pixels);
+        *w = uw;
+        *h = uh;
+    }
+    free(pixels);
+
+    return mapped;
+}
+
+void util_unmap_png_file(unsigned char *pixels, int w, int h)
+{
+    if (pixels == NULL) {
+        return;
+    }
+
+    munmap(pixels - PNG_CACHE_HDR_SIZE, PNG_CACHE_HDR_SIZE + (size_t)w * h * 4);
+}
+
 int util_read_png_file(char *dir, char *filename, unsigned char **pixels, int *w, int *h)
 {
-    char path[200];
-    int rc;
+    char             path[200], cache_path[200];
+    struct stat      statbuf;
+    long             mtime;
+    unsigned long    path_hash;
+    unsigned char   *mapped;
+    png_cache_hdr_t  hdr;
+    int              rc;
 
     concat(dir, filename, path);
     INFO("reading png file %s\n", path);
 
+    if (stat(path, &statbuf) != 0) {
+        ERROR("stat %s failed, %s\n", path, strerror(errno));
+        return -1;
+    }
+    png_cache_key(path, &statbuf, &mtime, &path_hash, cache_path);
+
+    // if the decoded image is in the png cache then return a copy of it
+    mapped = png_cache_map(cache_path, mtime, statbuf.st_size, path_hash, w, h);
+    if (mapped != NULL) {
+        size_t len = (size_t)*w * *h * 4;
+        *pixels = malloc(len);
+        if (*pixels == NULL) {
+            ERROR("out of memory reading png file %s\n", path);
+            util_unmap_png_file(mapped, *w, *h);
+            return -1;
+        }
+        memcpy(*pixels, mapped, len);
+        util_unmap_png_file(mapped, *w, *h);
+        return 0;
+    }
+
     rc = lodepng_decode32_file(pixels, (unsigned int*)w, (unsigned int*)h, path); // xxx check this doent allocate pixels on err
     if (rc != 0) {
         ERROR("lodepng_decode32_file %s failed, rc=%d\n", path, rc);
         return -1;
     }
 
+    // add the decoded image to the png cache
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PNG_CACHE_MAGIC, 8);
+    hdr.mtime = mtime;
+    hdr.size = statbuf.st_size;
+    hdr.w = *w;
+    hdr.h = *h;
+    hdr.path_hash = path_hash;
+    png_cache_write(cache_path, &hdr, *pixels);
+
     return 0;
 }
 
-int util_write_png_file(char *dir, char *filename, unsigned char *pixels, int w, int h)
+// the row decoder does not use the png cache, its purpose is to avoid
+// holding the whole decoded image in memory
+
+typedef struct {
+    util_png_rows_cb_t cb;
+    void *cx;
+} png_rows_cx_t;
+
+static unsigned png_rows_cb(void *user, const unsigned char *rows, unsigned y, unsigned h,
+                            unsigned w_image, unsigned h_image)
 {
-    char path[200];
-    int rc;
+    png_rows_cx_t *prc = user;
+
+    return prc->cb(prc->cx, (unsigned char*)rows, y, h, w_image, h_image) != 0;
+}
+
+int util_read_png_file_rows(char *dir, char *filename, int band_h, util_png_rows_cb_t cb, void *cx)
+{
+    char          path[200];
+    unsigned int  w, h;
+    png_rows_cx_t prc = { cb, cx };
+    int           rc;
 
     concat(dir, filename, path);
-    INFO("writing png file %s\n", path);
+    INFO("reading png file %s, %d rows at a time\n", path, band_h);
 
-    rc = lodepng_encode32_file(path, pixels, w, h);
+    rc = lodepng_decode32_file_rows(&w, &h, path, band_h, png_rows_cb, &prc);
     if (rc != 0) {
-        ERROR("lodepng_encode32_file %s w=%d h=%d failed, rc=%d\n", path, w, h, rc);
+        ERROR("lodepng_decode32_file_rows %s failed, rc=%d\n", path, rc);
         return -1;
     }
 
     return 0;
 }
+
+// the parallel encoder is in utils_png.c
+int util_write_png_file(char *dir, char *filename, unsigned char *pixels, int w, int h)
+{
+    return util_write_png_file_ex(dir, filename, pixels, w, h, false, 0);
+}
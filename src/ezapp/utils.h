@@ -11,6 +11,13 @@ long util_microsec_timer(void);
 long util_get_real_time_microsec(void);
 char *util_time2str(char * str, long us, int gmt, int display_ms, int display_date);
 
+// not available in picoc:
+// - util_monotonic_microsec_timer is never virtualized
+// - util_set_time_sources virtualizes util_microsec_timer and
+//   util_get_real_time_microsec, NULL args restore real time
+long util_monotonic_microsec_timer(void);
+void util_set_time_sources(long (*microsec_timer)(void), long (*real_time_microsec)(void));
+
 // -----------------  FILE UTILS  ----------------------------
 
 int util_write_file(char *dir, char *fn, void *data, int len);
@@ -32,14 +39,106 @@ void *util_map_file(char *dir, char *file, int len, bool create_if_needed,
 void util_unmap_file(void *addr, int len);
 void util_sync_file(void *addr, int len);
 
+// -----------------  FILE VIEW  -----------------------------
+
+// util_view_file returns the contents of a file mapped read-only, followed by
+// a '\0', or NULL with errno set; the data must not be written. A view of a
+// file that is already viewed, and unchanged, is shared and refcounted; call
+// util_view_release when done. The advice is a hint of how the data will be
+// read, UTIL_VIEW_SEQUENTIAL or UTIL_VIEW_RANDOM, optionally or'ed with
+// UTIL_VIEW_WILLNEED to start reading it in.
+#define UTIL_VIEW_NORMAL     0
+#define UTIL_VIEW_SEQUENTIAL 1
+#define UTIL_VIEW_RANDOM     2
+#define UTIL_VIEW_WILLNEED   4
+void *util_view_file(char *dir, char *fn, int advice, int *len);
+void util_view_retain(void *data);
+void util_view_release(void *data);
+void util_view_advise(void *data, int advice);
+
+// -----------------  TIME SERIES  ---------------------------
+
+// an append-only store of fixed size records, in segment files in the
+// directory dir/name; each record starts with a long timestamp, in any unit,
+// and is appended in timestamp order
+// - a store is opened by one writer, and any number of read_only handles,
+//   which see the writer's appends
+// - the queries copy the records found to the records array, oldest first,
+//   and return the number copied
+// - the policy limits are applied when a segment fills, 0 disables a limit:
+//   segments older than max_age are deleted, and the oldest segments while
+//   the others hold max_records; segments older than downsample_age keep
+//   the first record of each downsample_interval
+typedef struct util_ts util_ts_t;
+util_ts_t *util_ts_open(char *dir, char *name, int record_size, int segment_records, bool read_only);
+void util_ts_close(util_ts_t *ts);
+void util_ts_set_policy(util_ts_t *ts, long max_age, long max_records,
+                        long downsample_age, long downsample_interval);
+int util_ts_append(util_ts_t *ts, void *record);
+int util_ts_sync(util_ts_t *ts);
+int util_ts_clear(util_ts_t *ts);
+long util_ts_count(util_ts_t *ts);
+int util_ts_query(util_ts_t *ts, long t_start, long t_end, void *records, int max);
+int util_ts_query_downsample(util_ts_t *ts, long t_start, long t_end, long interval,
+                             void *records, int max);
+int util_ts_latest(util_ts_t *ts, void *records, int max);
+
+// -----------------  KEY VALUE STORE  -----------------------
+
+// a store of keys, strings of up to 1024 chars, and values of any length, in
+// the log file dir/name and a sorted index in memory; puts, deletes and
+// batches are appended to the log, which is compacted when it is mostly
+// garbage; the store is opened by one handle, used by any number of threads
+// - with sync set each put, delete and commit waits for an fdatasync, else
+//   the store survives a program crash, and util_kv_sync makes it durable
+// - util_kv_get and util_kv_iter_next copy up to max bytes of the value, and
+//   return its length, or -1 if not found or at the end
+// - a batch's puts and deletes are committed atomically
+// - an iterator returns the keys >= start and < end, NULL for no limit, in
+//   order; it must be freed before the store is closed
+typedef struct util_kv util_kv_t;
+typedef struct util_kv_batch util_kv_batch_t;
+typedef struct util_kv_iter util_kv_iter_t;
+util_kv_t *util_kv_open(char *dir, char *name, bool sync);
+void util_kv_close(util_kv_t *kv);
+int util_kv_put(util_kv_t *kv, char *key, void *value, int len);
+int util_kv_get(util_kv_t *kv, char *key, void *value, int max);
+int util_kv_delete(util_kv_t *kv, char *key);
+long util_kv_count(util_kv_t *kv);
+int util_kv_sync(util_kv_t *kv);
+int util_kv_compact(util_kv_t *kv);
+util_kv_batch_t *util_kv_batch_create(void);
+void util_kv_batch_free(util_kv_batch_t *b);
+void util_kv_batch_put(util_kv_batch_t *b, char *key, void *value, int len);
+void util_kv_batch_delete(util_kv_batch_t *b, char *key);
+int util_kv_batch_commit(util_kv_t *kv, util_kv_batch_t *b);
+util_kv_iter_t *util_kv_iter_create(util_kv_t *kv, char *start, char *end);
+void util_kv_iter_free(util_kv_iter_t *it);
+int util_kv_iter_next(util_kv_iter_t *it, char **key, void *value, int max);
+
+// not available in picoc: benchmark a store in dir, printing json lines
+int util_kv_bench(char *dir);
+
 // -----------------  GET / SET PARAMS  ----------------------
 
-char *util_get_str_param(char *dir, char *name, char *default_value);
+char *util_get_str_param(char *dir, char *name, char *default_value, char *value, int max_value);
 void util_set_str_param(char *dir, char *name, char *value);
 double util_get_numeric_param(char *dir, char *name, double default_value);
 void util_set_numeric_param(char *dir, char *name, double value);
 void util_print_params(char *dir);
 
+// - util_get_str_param copies the value to the caller's buffer, truncating
+//   it to max_value-1 chars, and returns the buffer
+//
+// not available in picoc:
+// - sets are written to the params file by a thread, shortly after;
+//   util_flush_params writes them now
+// - a param hook is called after a set changes a param's value
+typedef void (*util_param_hook_t)(char *dir, char *name, char *value, void *cx);
+void util_flush_params(void);
+int util_add_param_hook(util_param_hook_t hook, void *cx);
+void util_remove_param_hook(util_param_hook_t hook, void *cx);
+
 // -----------------  NETWORK  -------------------------------
 
 char *util_get_ipaddr(void);
@@ -68,12 +167,123 @@ void *util_json_parse(char *str, char **end_ptr);
 void util_json_free(void *json_root);
 json_value_t *util_json_get_value(void *json_item, ...);
 
+// compiled queries: the path is compiled once, for example
+// "properties.periods[0].startTime", and the query is used with any item;
+// util_json_query returns -1 and sets value->type JSON_TYPE_UNDEFINED if
+// the path is not found
+// - a cursor iterates an array's elements, util_json_cursor_next returns -1
+//   after the last; cursor->index is the index of the element returned
+typedef struct util_json_query util_json_query_t;
+typedef struct {
+    void *next;
+    int   index;
+} json_cursor_t;
+util_json_query_t *util_json_query_compile(char *path);  // returns NULL if invalid
+void util_json_query_free(util_json_query_t *q);
+int util_json_query(void *json_item, util_json_query_t *q, json_value_t *value);
+int util_json_array_size(void *json_array);
+void util_json_cursor_init(json_cursor_t *cursor, void *json_array);
+int util_json_cursor_next(json_cursor_t *cursor, json_value_t *value);
+
+// streaming parser: util_json_stream_next returns the next event, without
+// building a tree; read from a file descriptor or file, or from memory such
+// as a util_map_file mapping
+// - event path is the item's path, for example "properties.periods[3].name",
+//   and key or index its member key or array index (NULL or -1 at the root,
+//   and for the END events); the strings are valid until the next call
+// - VALUE events have value.type JSON_TYPE_FLAG, NUMBER or STRING, or
+//   JSON_TYPE_UNDEFINED for null
+// - util_json_stream_skip, after a START event, skips the object or array
+// - util_json_path_match matches a path with a pattern, where "[*]" is any
+//   index and "*" is any key
+#define JSON_EVENT_ERROR        -1
+#define JSON_EVENT_END          0
+#define JSON_EVENT_OBJECT_START 1
+#define JSON_EVENT_OBJECT_END   2
+#define JSON_EVENT_ARRAY_START  3
+#define JSON_EVENT_ARRAY_END    4
+#define JSON_EVENT_VALUE        5
+typedef struct util_json_stream util_json_stream_t;
+typedef struct {
+    int           event;
+    int           depth;
+    char         *path;
+    char         *key;
+    int           index;
+    json_value_t  value;
+} json_event_t;
+util_json_stream_t *util_json_stream_open_fd(int fd);
+util_json_stream_t *util_json_stream_open_file(char *dir, char *file);
+util_json_stream_t *util_json_stream_open_mem(char *mem, int len);  // len -1: strlen
+void util_json_stream_close(util_json_stream_t *s);
+int util_json_stream_next(util_json_stream_t *s, json_event_t *ev);
+int util_json_stream_skip(util_json_stream_t *s);
+char *util_json_stream_error(util_json_stream_t *s);
+bool util_json_path_match(char *path, char *pattern);
+
 // ----------------- PNG  --------------------
 
 // these routines read/write 32-bit RGBA png files
 int util_read_png_file(char *dir, char *filename, unsigned char **pixels, int *w, int *h);
 int util_write_png_file(char *dir, char *filename, unsigned char *pixels, int w, int h);
 
+// util_write_png_file encodes the png in bands of rows, by a thread per cpu;
+// util_write_png_file_ex uses num_threads threads, 0 for one per cpu, and with
+// fast set compresses faster but less; util_write_png_file_async encodes and
+// writes in a background thread, for screenshots from sdlx_read_display_pixels,
+// and frees the pixels when done, which must have been malloced; dir may be
+// NULL when the file name is a path
+int util_write_png_file_ex(char *dir, char *filename, unsigned char *pixels, int w, int h,
+                           bool fast, int num_threads);
+int util_write_png_file_async(char *dir, char *filename, unsigned char *pixels, int w, int h, bool fast);
+
+// returns read-only pixels mapped from the decoded png cache, the png is
+// decoded and added to the cache if needed; use util_unmap_png_file when done
+unsigned char *util_map_png_file(char *dir, char *filename, int *w, int *h);
+void util_unmap_png_file(unsigned char *pixels, int w, int h);
+
+// decodes the png a band of band_h RGBA rows at a time, calling cb with each
+// band; y is the first row of the band and h the number of rows; the pixels
+// are only valid during the call, and cb returns nonzero to stop decoding;
+// memory use is bounded by the band, except interlaced pngs need about half
+// the image (not available in picoc)
+typedef int (*util_png_rows_cb_t)(void *cx, unsigned char *pixels, int y, int h, int w_image, int h_image);
+int util_read_png_file_rows(char *dir, char *filename, int band_h, util_png_rows_cb_t cb, void *cx);
+
+// -----------------  FFT  -----------------------------------
+
+// real input fft of n samples, any n; fastest when n has only factors 2, 3 and 5
+// - forward:  n samples in, n/2+1 complex bins out, as interleaved re,im
+// - inverse:  n/2+1 complex bins in, n samples out, scaled by 1/n
+// - power_db: n samples in, n/2+1 bin powers out, 10*log10(re^2+im^2)
+// a plan must be used by one thread at a time
+typedef struct util_fft util_fft_t;
+util_fft_t *util_fft_create(int n);
+void util_fft_destroy(util_fft_t *fft);
+int util_fft_size(util_fft_t *fft);
+void util_fft_forward(util_fft_t *fft, const double *in, double *out);
+void util_fft_inverse(util_fft_t *fft, const double *in, double *out);
+void util_fft_power_db(util_fft_t *fft, const double *in, double *db);
+
+// not available in picoc: single precision versions of the above
+typedef struct util_fftf util_fftf_t;
+util_fftf_t *util_fftf_create(int n);
+void util_fftf_destroy(util_fftf_t *fft);
+int util_fftf_size(util_fftf_t *fft);
+void util_fftf_forward(util_fftf_t *fft, const float *in, float *out);
+void util_fftf_inverse(util_fftf_t *fft, const float *in, float *out);
+void util_fftf_power_db(util_fftf_t *fft, const float *in, float *db);
+
+// -----------------  MP3 TRANSCODE  -------------------------
+
+// encodes a raw file of 16 bit samples (interleaved when stereo), such as a
+// recording by sdlx_audio_record, to a cbr mp3 file with a Xing/LAME header;
+// the input is split into segments that are encoded in parallel by
+// num_threads threads, 0 for one per cpu; dir may be NULL when the file
+// names are paths
+int util_mp3_transcode(char *dir, char *raw_fn, char *mp3_fn, int sample_rate, int channels,
+                       int bitrate_kbps, int num_threads);
+
 // -----------------  CALL ANDROID JAVA  ---------------------
 
 void util_get_location(double *latitude, double *longitude, double *altitude);
@@ -0,0 +1,516 @@
+// This file is derived from KISS FFT (kiss_fft.c and kiss_fftr.c),
+// https://github.com/mborgerding/kissfft, under the following license.
+//
+// Copyright (c) 2003-2010, Mark Borgerding. All rights reserved.
+//
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef FFT_T
+
+#include <std_hdrs.h>
+
+#include <utils.h>
+#include <logging.h>
+
+// Real input FFT, for any length n; adapted from KISS FFT, see above.
+//
+// The complex FFT is a recursive mixed radix decimation in time, with
+// butterflies for radix 2, 3, 4 and 5, and a generic butterfly for other
+// prime factors; so lengths that are a product of small primes are fast.
+//
+// For even n, the n real samples are transformed as an n/2 point complex FFT
+// of the even/odd sample pairs, followed by a split step; for odd n a full
+// n point complex FFT is used.
+//
+// This file is compiled twice, by including itself at the end of this section:
+// with FFT_T double for the util_fft_xxx routines, and FFT_T float for the
+// util_fftf_xxx routines. The twiddles are always computed in double.
+//
+// A plan holds scratch buffers, so it must be used by one thread at a time.
+
+//
+// defines
+//
+
+#define MAX_FACTORS 32
+
+//
+// prototypes
+//
+
+static int fft_factor(int n, int *factors);
+
+// -----------------  FACTOR  ------------------------------
+
+// factors n into pairs of (radix, remaining length), preferring radix 4,
+// then 2, 3, 5 and larger primes; returns the number of pairs
+static int fft_factor(int n, int *factors)
+{
+    int p = 4, num = 0;
+    double floor_sqrt = floor(sqrt((double)n));
+
+    do {
+        while (n % p) {
+            switch (p) {
+            case 4:  p = 2; break;
+            case 2:  p = 3; break;
+            default: p += 2; break;
+            }
+            if (p > floor_sqrt) {
+                p = n;
+            }
+        }
+        n /= p;
+        factors[2*num]   = p;
+        factors[2*num+1] = n;
+        num++;
+    } while (n > 1 && num < MAX_FACTORS);
+
+    return num;
+}
+
+// -----------------  DOUBLE AND FLOAT VERSIONS  -------------
+
+#define FFT_T        double
+#define FFT_PLAN     util_fft
+#define FFT_NAME(x)  util_fft_##x
+#define FFT_CPX      fft_cpx_t
+#define FFT_FN(x)    fft_##x
+#include "utils_fft.c"
+#undef FFT_T
+#undef FFT_PLAN
+#undef FFT_NAME
+#undef FFT_CPX
+#undef FFT_FN
+
+#define FFT_T        float
+#define FFT_PLAN     util_fftf
+#define FFT_NAME(x)  util_fftf_##x
+#define FFT_CPX      fftf_cpx_t
+#define FFT_FN(x)    fftf_##x
+#include "utils_fft.c"
+
+#else  // FFT_T
+
+typedef struct {
+    FFT_T r;
+    FFT_T i;
+} FFT_CPX;
+
+struct FFT_PLAN {
+    int      n;              // number of real samples
+    int      nc;             // complex fft length, n/2 when n is even, else n
+    int      factors[2*MAX_FACTORS];
+    int      max_radix;
+    FFT_CPX *tw;             // nc twiddles, exp(-2*pi*i*k/nc)
+    FFT_CPX *super_tw;       // nc/2 split twiddles, when n is even
+    FFT_CPX *tmp;            // nc scratch
+    FFT_CPX *tmp2;           // nc+1 scratch
+    FFT_CPX *scratch;        // max_radix scratch, for the generic butterfly
+};
+
+// -----------------  BUTTERFLIES  -------------------------
+
+static inline FFT_CPX FFT_FN(mul)(FFT_CPX a, FFT_CPX b)
+{
+    FFT_CPX c = { a.r*b.r - a.i*b.i, a.r*b.i + a.i*b.r };
+    return c;
+}
+
+static void FFT_FN(bfly2)(FFT_CPX *F, int fstride, struct FFT_PLAN *st, int m)
+{
+    FFT_CPX *F2 = F + m, *tw = st->tw, t;
+    int u;
+
+    for (u = 0; u < m; u++) {
+        t = FFT_FN(mul)(F2[u], tw[u*fstride]);
+        F2[u].r = F[u].r - t.r;
+        F2[u].i = F[u].i - t.i;
+        F[u].r += t.r;
+        F[u].i += t.i;
+    }
+}
+
+static void FFT_FN(bfly3)(FFT_CPX *F, int fstride, struct FFT_PLAN *st, int m)
+{
+    FFT_CPX *tw1 = st->tw, *tw2 = st->tw, s0, s1, s2, s3;
+    FFT_T    epi3_i = st->tw[fstride*m].i;
+    int      k = m, m2 = 2*m;
+
+    do {
+        s1 = FFT_FN(mul)(F[m], *tw1);
+        s2 = FFT_FN(mul)(F[m2], *tw2);
+        s3.r = s1.r + s2.r;  s3.i = s1.i + s2.i;
+        s0.r = s1.r - s2.r;  s0.i = s1.i - s2.i;
+        tw1 += fstride;
+        tw2 += 2*fstride;
+
+        F[m].r = F[0].r - s3.r * (FFT_T)0.5;
+        F[m].i = F[0].i - s3.i * (FFT_T)0.5;
+        s0.r *= epi3_i;
+        s0.i *= epi3_i;
+        F[0].r += s3.r;
+        F[0].i += s3.i;
+
+        F[m2].r = F[m].r + s0.i;
+        F[m2].i = F[m].i - s0.r;
+        F[m].r -= s0.i;
+        F[m].i += s0.r;
+        F++;
+    } while (--k);
+}
+
+static void FFT_FN(bfly4)(FFT_CPX *F, int fstride, struct FFT_PLAN *st, int m)
+{
+    FFT_CPX *tw1 = st->tw, *tw2 = st->tw, *tw3 = st->tw, s0, s1, s2, s3, s4, s5;
+    int      k = m, m2 = 2*m, m3 = 3*m;
+
+    do {
+        s0 = FFT_FN(mul)(F[m], *tw1);
+        s1 = FFT_FN(mul)(F[m2], *tw2);
+        s2 = FFT_FN(mul)(F[m3], *tw3);
+
+        s5.r = F[0].r - s1.r;  s5.i = F[0].i - s1.i;
+        F[0].r += s1.r;        F[0].i += s1.i;
+        s3.r = s0.r + s2.r;    s3.i = s0.i + s2.i;
+        s4.r = s0.r - s2.r;    s4.i = s0.i - s2.i;
+        F[m2].r = F[0].r - s3.r;
+        F[m2].i = F[0].i - s3.i;
+        tw1 += fstride;
+        tw2 += 2*fstride;
+        tw3 += 3*fstride;
+        F[0].r += s3.r;
+        F[0].i += s3.i;
+
+        F[m].r  = s5.r + s4.i;
+        F[m].i  = s5.i - s4.r;
+        F[m3].r = s5.r - s4.i;
+        F[m3].i = s5.i + s4.r;
+        F++;
+    } while (--k);
+}
+
+static void FFT_FN(bfly5)(FFT_CPX *F, int fstride, struct FFT_PLAN *st, int m)
+{
+    FFT_CPX *F0 = F, *F1 = F+m, *F2 = F+2*m, *F3 = F+3*m, *F4 = F+4*m;
+    FFT_CPX *tw = st->tw, ya = tw[fstride*m], yb = tw[fstride*2*m];
+    FFT_CPX  s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12;
+    int      u;
+
+    for (u = 0; u < m; u++) {
+        s0 = *F0;
+        s1 = FFT_FN(mul)(*F1, tw[u*fstride]);
+        s2 = FFT_FN(mul)(*F2, tw[2*u*fstride]);
+        s3 = FFT_FN(mul)(*F3, tw[3*u*fstride]);
+        s4 = FFT_FN(mul)(*F4, tw[4*u*fstride]);
+
+        s7.r  = s1.r + s4.r;  s7.i  = s1.i + s4.i;
+        s10.r = s1.r - s4.r;  s10.i = s1.i - s4.i;
+        s8.r  = s2.r + s3.r;  s8.i  = s2.i + s3.i;
+        s9.r  = s2.r - s3.r;  s9.i  = s2.i - s3.i;
+
+        F0->r += s7.r + s8.r;
+        F0->i += s7.i + s8.i;
+
+        s5.r = s0.r + s7.r*ya.r + s8.r*yb.r;
+        s5.i = s0.i + s7.i*ya.r + s8.i*yb.r;
+        s6.r =  s10.i*ya.i + s9.i*yb.i;
+        s6.i = -s10.r*ya.i - s9.r*yb.i;
+        F1->r = s5.r - s6.r;  F1->i = s5.i - s6.i;
+        F4->r = s5.r + s6.r;  F4->i = s5.i + s6.i;
+
+        s11.r = s0.r + s7.r*yb.r + s8.r*ya.r;
+        s11.i = s0.i + s7.i*yb.r + s8.i*ya.r;
+        s12.r = -s10.i*yb.i + s9.i*ya.i;
+        s12.i =  s10.r*yb.i - s9.r*ya.i;
+        F2->r = s11.r + s12.r;  F2->i = s11.i + s12.i;
+        F3->r = s11.r - s12.r;  F3->i = s11.i - s12.i;
+
+        F0++; F1++; F2++; F3++; F4++;
+    }
+}
+
+static void FFT_FN(bfly_generic)(FFT_CPX *F, int fstride, struct FFT_PLAN *st, int m, int p)
+{
+    FFT_CPX *tw = st->tw, *scratch = st->scratch, t;
+    int      u, k, q, q1, twidx, nc = st->nc;
+
+    for (u = 0; u < m; u++) {
+        k = u;
+        for (q1 = 0; q1 < p; q1++) {
+            scratch[q1] = F[k];
+            k += m;
+        }
+
+        k = u;
+        for (q1 = 0; q1 < p; q1++) {
+            twidx = 0;
+            F[k] = scratch[0];
+            for (q = 1; q < p; q++) {
+                twidx += fstride * k;
+                if (twidx >= nc) twidx -= nc;
+                t = FFT_FN(mul)(scratch[q], tw[twidx]);
+                F[k].r += t.r;
+                F[k].i += t.i;
+            }
+            k += m;
+        }
+    }
+}
+
+// -----------------  COMPLEX FFT  -------------------------
+
+static void FFT_FN(work)(FFT_CPX *Fout, const FFT_CPX *f, int fstride, int *factors, struct FFT_PLAN *st)
+{
+    FFT_CPX *Fout_beg = Fout;
+    int      p = factors[0], m = factors[1];
+    FFT_CPX *Fout_end = Fout + p*m;
+
+    if (m == 1) {
+        do {
+            *Fout = *f;
+            f += fstride;
+        } while (++Fout != Fout_end);
+    } else {
+        do {
+            FFT_FN(work)(Fout, f, fstride*p, factors+2, st);
+            f += fstride;
+        } while ((Fout += m) != Fout_end);
+    }
+
+    Fout = Fout_beg;
+    switch (p) {
+    case 2:  FFT_FN(bfly2)(Fout, fstride, st, m); break;
+    case 3:  FFT_FN(bfly3)(Fout, fstride, st, m); break;
+    case 4:  FFT_FN(bfly4)(Fout, fstride, st, m); break;
+    case 5:  FFT_FN(bfly5)(Fout, fstride, st, m); break;
+    default: FFT_FN(bfly_generic)(Fout, fstride, st, m, p); break;
+    }
+}
+
+// forward complex fft of nc points; in and out must not overlap
+static void FFT_FN(complex)(struct FFT_PLAN *st, const FFT_CPX *in, FFT_CPX *out)
+{
+    FFT_FN(work)(out, in, 1, st->factors, st);
+}
+
+// -----------------  CREATE / DESTROY  --------------------
+
+struct FFT_PLAN *FFT_NAME(create)(int n)
+{
+    struct FFT_PLAN *st;
+    int i, num_factors, nc;
+    double phase;
+
+    if (n < 2) {
+        ERROR("invalid fft length %d\n", n);
+        return NULL;
+    }
+    nc = (n % 2 == 0 ? n/2 : n);
+
+    st = calloc(1, sizeof(struct FFT_PLAN));
+    if (st == NULL) {
+        ERROR("failed to allocate fft plan\n");
+        return NULL;
+    }
+    st->n  = n;
+    st->nc = nc;
+
+    // factor the complex fft length, and find the largest radix
+    num_factors = fft_factor(nc, st->factors);
+    for (i = 0; i < num_factors; i++) {
+        if (st->factors[2*i] > st->max_radix) {
+            st->max_radix = st->factors[2*i];
+        }
+    }
+
+    st->tw       = malloc(nc * sizeof(FFT_CPX));
+    st->super_tw = malloc((nc/2+1) * sizeof(FFT_CPX));
+    st->tmp      = malloc(nc * sizeof(FFT_CPX));
+    st->tmp2     = malloc((nc+1) * sizeof(FFT_CPX));
+    st->scratch  = malloc(st->max_radix * sizeof(FFT_CPX));
+    if (!st->tw || !st->super_tw || !st->tmp || !st->tmp2 || !st->scratch) {
+        ERROR("failed to allocate fft plan, n=%d\n", n);
+        FFT_NAME(destroy)(st);
+        return NULL;
+    }
+
+    // twiddles
+    for (i = 0; i < nc; i++) {
+        phase = -2 * M_PI * i / nc;
+        st->tw[i].r = cos(phase);
+        st->tw[i].i = sin(phase);
+    }
+    for (i = 0; i < nc/2+1; i++) {
+        phase = -M_PI * ((double)(i+1) / nc + 0.5);
+        st->super_tw[i].r = cos(phase);
+        st->super_tw[i].i = sin(phase);
+    }
+
+    return st;
+}
+
+void FFT_NAME(destroy)(struct FFT_PLAN *st)
+{
+    if (st == NULL) {
+        return;
+    }
+
+    free(st->tw);
+    free(st->super_tw);
+    free(st->tmp);
+    free(st->tmp2);
+    free(st->scratch);
+    free(st);
+}
+
+int FFT_NAME(size)(struct FFT_PLAN *st)
+{
+    return st->n;
+}
+
+// -----------------  REAL FFT  ----------------------------
+
+void FFT_NAME(forward)(struct FFT_PLAN *st, const FFT_T *in, FFT_T *out)
+{
+    FFT_CPX *fout = (FFT_CPX*)out;
+    int      k, nc = st->nc;
+
+    // odd length: complex fft of the real samples
+    if (st->n % 2) {
+        for (k = 0; k < nc; k++) {
+            st->tmp2[k].r = in[k];
+            st->tmp2[k].i = 0;
+        }
+        FFT_FN(complex)(st, st->tmp2, st->tmp);
+        memcpy(fout, st->tmp, (nc/2+1) * sizeof(FFT_CPX));
+        return;
+    }
+
+    // even length: the even and odd samples are the real and imaginary
+    // parts of an nc point complex fft, which is then split into the
+    // nc+1 bins of the real fft
+    FFT_FN(complex)(st, (const FFT_CPX*)in, st->tmp);
+
+    FFT_CPX tdc = st->tmp[0];
+    fout[0].r  = tdc.r + tdc.i;
+    fout[0].i  = 0;
+    fout[nc].r = tdc.r - tdc.i;
+    fout[nc].i = 0;
+
+    for (k = 1; k <= nc/2; k++) {
+        FFT_CPX fpk, fpnk, f1k, f2k, tw;
+
+        fpk    = st->tmp[k];
+        fpnk.r =  st->tmp[nc-k].r;
+        fpnk.i = -st->tmp[nc-k].i;
+
+        f1k.r = fpk.r + fpnk.r;  f1k.i = fpk.i + fpnk.i;
+        f2k.r = fpk.r - fpnk.r;  f2k.i = fpk.i - fpnk.i;
+        tw = FFT_FN(mul)(f2k, st->super_tw[k-1]);
+
+        fout[k].r    =  (f1k.r + tw.r) * (FFT_T)0.5;
+        fout[k].i    =  (f1k.i + tw.i) * (FFT_T)0.5;
+        fout[nc-k].r =  (f1k.r - tw.r) * (FFT_T)0.5;
+        fout[nc-k].i = -(f1k.i - tw.i) * (FFT_T)0.5;
+    }
+}
+
+void FFT_NAME(inverse)(struct FFT_PLAN *st, const FFT_T *in, FFT_T *out)
+{
+    const FFT_CPX *fin = (const FFT_CPX*)in;
+    FFT_T          scale = (FFT_T)1.0 / st->n;
+    int            k, nc = st->nc;
+
+    // the inverse is computed as conj(fft(conj(x))), and scaled by 1/n so
+    // that inverse(forward(x)) returns x
+
+    // odd length: rebuild the conjugate symmetric spectrum
+    if (st->n % 2) {
+        for (k = 0; k <= nc/2; k++) {
+            st->tmp2[k].r =  fin[k].r;
+            st->tmp2[k].i = -fin[k].i;
+        }
+        for (k = 1; k <= nc/2; k++) {
+            st->tmp2[nc-k].r = fin[k].r;
+            st->tmp2[nc-k].i = fin[k].i;
+        }
+        FFT_FN(complex)(st, st->tmp2, st->tmp);
+        for (k = 0; k < nc; k++) {
+            out[k] = st->tmp[k].r * scale;
+        }
+        return;
+    }
+
+    // even length: undo the split, then an nc point complex inverse fft
+    // gives the even and odd samples
+    st->tmp2[0].r =   fin[0].r + fin[nc].r;
+    st->tmp2[0].i = -(fin[0].r - fin[nc].r);
+
+    for (k = 1; k <= nc/2; k++) {
+        FFT_CPX fk, fnkc, fek, t, fok;
+
+        fk     = fin[k];
+        fnkc.r =  fin[nc-k].r;
+        fnkc.i = -fin[nc-k].i;
+
+        fek.r = fk.r + fnkc.r;  fek.i = fk.i + fnkc.i;
+        t.r   = fk.r - fnkc.r;  t.i   = fk.i - fnkc.i;
+        // conjugate of the split twiddle
+        FFT_CPX stw = { st->super_tw[k-1].r, -st->super_tw[k-1].i };
+        fok = FFT_FN(mul)(t, stw);
+
+        st->tmp2[k].r    =   fek.r + fok.r;
+        st->tmp2[k].i    = -(fek.i + fok.i);
+        st->tmp2[nc-k].r =   fek.r - fok.r;
+        st->tmp2[nc-k].i =   fek.i - fok.i;
+    }
+
+    FFT_FN(complex)(st, st->tmp2, st->tmp);
+    for (k = 0; k < nc; k++) {
+        out[2*k]   =  st->tmp[k].r * scale;
+        out[2*k+1] = -st->tmp[k].i * scale;
+    }
+}
+
+void FFT_NAME(power_db)(struct FFT_PLAN *st, const FFT_T *in, FFT_T *db)
+{
+    FFT_T *cpx = (FFT_T*)st->tmp2;
+    int    k, num_bins = st->n/2 + 1;
+
+    // the forward fft output is placed in tmp2, which has room for the
+    // n/2+1 bins, and is only used as the input staging buffer when n is odd
+    FFT_NAME(forward)(st, in, cpx);
+    for (k = 0; k < num_bins; k++) {
+        FFT_T re = cpx[2*k], im = cpx[2*k+1];
+        db[k] = 10 * log10(re*re + im*im + (FFT_T)1e-30);
+    }
+}
+
+#endif  // FFT_T
@@ -0,0 +1,733 @@
+#include <std_hdrs.h>
+
+#include <utils.h>
+#include <logging.h>
+
+// Streaming (pull) json parser.
+//
+// util_json_stream_next returns the document's events in order: the start and
+// end of each object and array, and each flag, number, string and null value.
+// Each event has the item's path, in the form util_json_query_compile takes,
+// for example "properties.periods[3].temperature", its key or array index, and
+// its depth. Nothing is kept of the items already returned, so the memory used
+// is the read buffer, the path, and the longest key and string; a large
+// document can be read in a single pass, stopping as soon as the wanted fields
+// have been found.
+//
+// The document is read incrementally from a file descriptor, or is a buffer in
+// memory, such as a util_map_file mapping, which is parsed in place.
+
+//
+// defines
+//
+
+#define READ_BUF_SIZE     65536
+#define MAX_DEPTH         64
+#define MAX_PATH          1024
+#define MAX_STRING        (16*1024*1024)
+
+#define ST_VALUE          0   // a value: the root, an object member or an array element
+#define ST_FIRST_KEY      1   // after '{': a key or '}'
+#define ST_KEY            2   // after ',' in an object: a key
+#define ST_FIRST_ELEMENT  3   // after '[': a value or ']'
+#define ST_NEXT           4   // after a member or element: ',' or the container's end
+#define ST_DONE           5   // after the root value
+#define ST_ERROR          6
+
+#define EVENT_NONE        -2  // last_event before the first event
+
+//
+// typedefs
+//
+
+typedef struct {
+    char type;        // '{' or '['
+    int  index;       // array: index of the next element
+    int  path_len;    // length of the container's path
+} level_t;
+
+typedef struct {
+    char *s;
+    int   len;
+    int   alloced;
+} strbuf_t;
+
+struct util_json_stream {
+    int       fd;            // -1 when parsing memory
+    bool      close_fd;
+    char     *buf;           // the read buffer, or the memory being parsed
+    int       buf_len;
+    int       buf_pos;
+    long      buf_offset;    // document offset of buf[0]
+    bool      eof;
+
+    int       state;
+    int       depth;
+    level_t   stack[MAX_DEPTH];
+    char      path[MAX_PATH];
+    int       path_len;
+
+    strbuf_t  key;           // the current member's key
+    strbuf_t  str;           // the current string value, or number text
+
+    int       last_event;
+    char      errmsg[200];
+};
+
+//
+// prototypes
+//
+
+static util_json_stream_t *stream_alloc(int fd, bool close_fd, char *mem, int mem_len);
+static int fill(util_json_stream_t *s);
+static int skip_ws(util_json_stream_t *s);
+static int stream_error(util_json_stream_t *s, json_event_t *ev, char *fmt, ...)
+    __attribute__ ((format (printf, 3, 4)));
+static int end_error(util_json_stream_t *s, json_event_t *ev, int c, char *expected);
+
+static int read_string(util_json_stream_t *s, strbuf_t *sb);
+static int read_literal(util_json_stream_t *s, json_event_t *ev);
+static int read_number(util_json_stream_t *s, json_event_t *ev);
+static int strbuf_append(strbuf_t *sb, char *p, int n);
+
+static void set_item_path(util_json_stream_t *s, json_event_t *ev);
+static int start_value(util_json_stream_t *s, json_event_t *ev, int c);
+static int end_container(util_json_stream_t *s, json_event_t *ev);
+
+// -----------------  OPEN / CLOSE  ------------------------
+
+util_json_stream_t *util_json_stream_open_fd(int fd)
+{
+    if (fd < 0) {
+        return NULL;
+    }
+    return stream_alloc(fd, false, NULL, 0);
+}
+
+util_json_stream_t *util_json_stream_open_file(char *dir, char *file)
+{
+    char path[1000];
+    int  fd;
+    util_json_stream_t *s;
+
+    sprintf(path, "%s/%s", dir, file);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("failed to open %s, %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    s = stream_alloc(fd, true, NULL, 0);
+    if (s == NULL) {
+        close(fd);
+    }
+    return s;
+}
+
+// the memory must remain valid until the stream is closed; if len is
+// less than 0 then the memory is a null terminated string
+util_json_stream_t *util_json_stream_open_mem(char *mem, int len)
+{
+    if (mem == NULL) {
+        return NULL;
+    }
+    return stream_alloc(-1, false, mem, len < 0 ? strlen(mem) : len);
+}
+
+void util_json_stream_close(util_json_stream_t *s)
+{
+    if (s == NULL) {
+        return;
+    }
+
+    if (s->close_fd) {
+        close(s->fd);
+    }
+    if (s->fd >= 0) {
+        free(s->buf);
+    }
+    free(s->key.s);
+    free(s->str.s);
+    free(s);
+}
+
+char *util_json_stream_error(util_json_stream_t *s)
+{
+    return s->errmsg;
+}
+
+static util_json_stream_t *stream_alloc(int fd, bool close_fd, char *mem, int mem_len)
+{
+    util_json_stream_t *s;
+
+    s = calloc(1, sizeof(util_json_stream_t));
+    if (s == NULL) {
+        return NULL;
+    }
+
+    s->fd = fd;
+    s->close_fd = close_fd;
+    if (fd >= 0) {
+        s->buf = malloc(READ_BUF_SIZE);
+        if (s->buf == NULL) {
+            free(s);
+            return NULL;
+        }
+    } else {
+        s->buf = mem;
+        s->buf_len = mem_len;
+        s->eof = true;
+    }
+    s->state = ST_VALUE;
+    s->last_event = EVENT_NONE;
+    return s;
+}
+
+// -----------------  NEXT EVENT  --------------------------
+
+// returns ev->event; the strings in ev are valid until the next call
+int util_json_stream_next(util_json_stream_t *s, json_event_t *ev)
+{
+    int c;
+
+    memset(ev, 0, sizeof(json_event_t));
+    ev->index = -1;
+
+    while (true) {
+        switch (s->state) {
+        case ST_VALUE:
+            if ((c = skip_ws(s)) < 0) {
+                return end_error(s, ev, c, s->last_event == EVENT_NONE ? "a document" : "a value");
+            }
+            return s->last_event = start_value(s, ev, c);
+
+        case ST_FIRST_KEY:
+        case ST_KEY:
+            if ((c = skip_ws(s)) < 0) {
+                return end_error(s, ev, c, "a key");
+            }
+            if (c == '}' && s->state == ST_FIRST_KEY) {
+                s->buf_pos++;
+                return s->last_event = end_container(s, ev);
+            }
+            if (c != '"') {
+                return stream_error(s, ev, "expected a key");
+            }
+            s->buf_pos++;
+            if (read_string(s, &s->key) < 0) {
+                return stream_error(s, ev, "%s", s->errmsg);
+            }
+            if ((c = skip_ws(s)) != ':') {
+                return stream_error(s, ev, "expected ':'");
+            }
+            s->buf_pos++;
+            s->state = ST_VALUE;
+            break;
+
+        case ST_FIRST_ELEMENT:
+            if ((c = skip_ws(s)) < 0) {
+                return end_error(s, ev, c, "a value or ']'");
+            }
+            if (c == ']') {
+                s->buf_pos++;
+                return s->last_event = end_container(s, ev);
+            }
+            s->state = ST_VALUE;
+            break;
+
+        case ST_NEXT:
+            if ((c = skip_ws(s)) < 0) {
+                return end_error(s, ev, c, s->stack[s->depth-1].type == '{' ? "',' or '}'" : "',' or ']'");
+            }
+            s->buf_pos++;
+            if (c == ',') {
+                s->state = (s->stack[s->depth-1].type == '{' ? ST_KEY : ST_VALUE);
+                break;
+            }
+            if ((c == '}' && s->stack[s->depth-1].type == '{') ||
+                (c == ']' && s->stack[s->depth-1].type == '['))
+            {
+                return s->last_event = end_container(s, ev);
+            }
+            s->buf_pos--;
+            return stream_error(s, ev, "expected ',' or '%c'",
+                                s->stack[s->depth-1].type == '{' ? '}' : ']');
+
+        case ST_DONE:
+            // anything following the root value is ignored
+            ev->event = JSON_EVENT_END;
+            return s->last_event = JSON_EVENT_END;
+
+        case ST_ERROR:
+        default:
+            ev->event = JSON_EVENT_ERROR;
+            return JSON_EVENT_ERROR;
+        }
+    }
+}
+
+// after an OBJECT_START or ARRAY_START event, skips to the end of that object
+// or array; the next event follows it; returns -1 on error
+int util_json_stream_skip(util_json_stream_t *s)
+{
+    json_event_t ev;
+    int          depth;
+
+    if (s->last_event != JSON_EVENT_OBJECT_START && s->last_event != JSON_EVENT_ARRAY_START) {
+        return 0;
+    }
+
+    depth = s->depth;
+    while (s->depth >= depth) {
+        if (util_json_stream_next(s, &ev) == JSON_EVENT_ERROR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// a value's start: returns a VALUE event for a flag, number, string or null,
+// or pushes the object or array and returns its START event
+static int start_value(util_json_stream_t *s, json_event_t *ev, int c)
+{
+    level_t *l;
+
+    set_item_path(s, ev);
+
+    if (c == '{' || c == '[') {
+        s->buf_pos++;
+        if (s->depth == MAX_DEPTH) {
+            return stream_error(s, ev, "nested too deep");
+        }
+        l = &s->stack[s->depth++];
+        l->type = c;
+        l->index = 0;
+        l->path_len = s->path_len;
+        s->state = (c == '{' ? ST_FIRST_KEY : ST_FIRST_ELEMENT);
+        ev->event = (c == '{' ? JSON_EVENT_OBJECT_START : JSON_EVENT_ARRAY_START);
+        ev->value.type = (c == '{' ? JSON_TYPE_OBJECT : JSON_TYPE_ARRAY);
+        return ev->event;
+    }
+
+    if (c == '"') {
+        s->buf_pos++;
+        if (read_string(s, &s->str) < 0) {
+            return stream_error(s, ev, "%s", s->errmsg);
+        }
+        ev->value.type = JSON_TYPE_STRING;
+        ev->value.u.string = s->str.s;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        if (read_number(s, ev) < 0) {
+            return stream_error(s, ev, "invalid number");
+        }
+    } else {
+        if (read_literal(s, ev) < 0) {
+            return stream_error(s, ev, "invalid value");
+        }
+    }
+
+    s->state = (s->depth == 0 ? ST_DONE : ST_NEXT);
+    ev->event = JSON_EVENT_VALUE;
+    return JSON_EVENT_VALUE;
+}
+
+static int end_container(util_json_stream_t *s, json_event_t *ev)
+{
+    level_t *l = &s->stack[--s->depth];
+
+    s->path_len = l->path_len;
+    s->path[s->path_len] = '\0';
+    ev->event = (l->type == '{' ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END);
+    ev->depth = s->depth;
+    ev->path = s->path;
+    s->state = (s->depth == 0 ? ST_DONE : ST_NEXT);
+    return ev->event;
+}
+
+// sets the path, key, index and depth of the item starting: the member
+// s->key of an object, the next element of an array, or the root; a path too
+// long for the buffer is truncated
+static void set_item_path(util_json_stream_t *s, json_event_t *ev)
+{
+    level_t *l;
+    char    *p, *end, digits[12];
+    int      n, i;
+
+    ev->depth = s->depth;
+    ev->path = s->path;
+    if (s->depth == 0) {
+        s->path_len = 0;
+        s->path[0] = '\0';
+        return;
+    }
+
+    l = &s->stack[s->depth-1];
+    p = s->path + l->path_len;
+    end = s->path + MAX_PATH - 1;
+    if (l->type == '{') {
+        ev->key = s->key.s;
+        if (l->path_len && p < end) {
+            *p++ = '.';
+        }
+        n = s->key.len;
+        if (n > end - p) {
+            n = end - p;
+        }
+        memcpy(p, s->key.s, n);
+        p += n;
+    } else {
+        ev->index = i = l->index++;
+        n = 0;
+        do {
+            digits[n++] = '0' + i % 10;
+            i /= 10;
+        } while (i);
+        if (n + 2 <= end - p) {
+            *p++ = '[';
+            while (n) {
+                *p++ = digits[--n];
+            }
+            *p++ = ']';
+        }
+    }
+    *p = '\0';
+    s->path_len = p - s->path;
+}
+
+static int stream_error(util_json_stream_t *s, json_event_t *ev, char *fmt, ...)
+{
+    va_list ap;
+    char    msg[150];
+
+    if (s->state != ST_ERROR) {
+        va_start(ap, fmt);
+        vsnprintf(msg, sizeof(msg), fmt, ap);
+        va_end(ap);
+        snprintf(s->errmsg, sizeof(s->errmsg), "offset %ld: %s", s->buf_offset + s->buf_pos, msg);
+        s->state = ST_ERROR;
+    }
+
+    ev->event = JSON_EVENT_ERROR;
+    s->last_event = JSON_EVENT_ERROR;
+    return JSON_EVENT_ERROR;
+}
+
+// c is -1 at the end of the document, -2 after a read error
+static int end_error(util_json_stream_t *s, json_event_t *ev, int c, char *expected)
+{
+    if (c == -2) {
+        return stream_error(s, ev, "%s", s->errmsg);
+    }
+    return stream_error(s, ev, "unexpected end, expected %s", expected);
+}
+
+// -----------------  READING  -----------------------------
+
+// returns the number of bytes available at buf_pos, 0 at the end, -2 on a
+// read error
+static int fill(util_json_stream_t *s)
+{
+    int n;
+
+    if (s->buf_pos < s->buf_len) {
+        return s->buf_len - s->buf_pos;
+    }
+    if (s->eof) {
+        return 0;
+    }
+
+    s->buf_offset += s->buf_len;
+    s->buf_pos = 0;
+    s->buf_len = 0;
+    do {
+        n = read(s->fd, s->buf, READ_BUF_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        snprintf(s->errmsg, sizeof(s->errmsg), "read failed, %s", strerror(errno));
+        s->eof = true;
+        return -2;
+    }
+    if (n == 0) {
+        s->eof = true;
+        return 0;
+    }
+    s->buf_len = n;
+    return n;
+}
+
+// returns the next non white space char, without consuming it, or -1 at the
+// end, or -2 on a read error
+static int skip_ws(util_json_stream_t *s)
+{
+    int c, n;
+
+    while (true) {
+        if ((n = fill(s)) <= 0) {
+            return n == 0 ? -1 : -2;
+        }
+        for (; s->buf_pos < s->buf_len; s->buf_pos++) {
+            c = (unsigned char)s->buf[s->buf_pos];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                return c;
+            }
+        }
+    }
+}
+
+static int strbuf_append(strbuf_t *sb, char *p, int n)
+{
+    char *x;
+    int   alloced;
+
+    if (sb->len + n + 1 > sb->alloced) {
+        if (sb->len + n + 1 > MAX_STRING) {
+            return -1;
+        }
+        alloced = (sb->alloced ? sb->alloced : 256);
+        while (alloced < sb->len + n + 1) {
+            alloced *= 2;
+        }
+        x = realloc(sb->s, alloced);
+        if (x == NULL) {
+            return -1;
+        }
+        sb->s = x;
+        sb->alloced = alloced;
+    }
+    memcpy(sb->s + sb->len, p, n);
+    sb->len += n;
+    sb->s[sb->len] = '\0';
+    return 0;
+}
+
+static int get_char(util_json_stream_t *s)
+{
+    if (fill(s) <= 0) {
+        return -1;
+    }
+    return (unsigned char)s->buf[s->buf_pos++];
+}
+
+static int get_hex4(util_json_stream_t *s)
+{
+    int i, c, v = 0;
+
+    for (i = 0; i < 4; i++) {
+        c = get_char(s);
+        if (c >= '0' && c <= '9') {
+            v = (v << 4) | (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            v = (v << 4) | (c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            v = (v << 4) | (c - 'A' + 10);
+        } else {
+            return -1;
+        }
+    }
+    return v;
+}
+
+// reads a string, following its opening quote, into sb; the escapes are
+// decoded and \u escapes are converted to utf-8
+static int read_string(util_json_stream_t *s, strbuf_t *sb)
+{
+    char *p, *start, *end, utf8[4];
+    int   c, cp, lo, n;
+
+    sb->len = 0;
+    if (strbuf_append(sb, "", 0) < 0) {
+        goto nomem;
+    }
+
+    while (true) {
+        if ((n = fill(s)) <= 0) {
+            if (n == 0) {
+                strcpy(s->errmsg, "unterminated string");
+            }
+            return -1;
+        }
+
+        // copy the chars up to a quote or backslash
+        start = s->buf + s->buf_pos;
+        end = s->buf + s->buf_len;
+        for (p = start; p < end && *p != '"' && *p != '\\'; p++) {
+            if ((unsigned char)*p < 0x20) {
+                s->buf_pos += p - start;
+                strcpy(s->errmsg, "control char in string");
+                return -1;
+            }
+        }
+        if (strbuf_append(sb, start, p - start) < 0) {
+            goto nomem;
+        }
+        s->buf_pos += p - start;
+        if (p == end) {
+            continue;
+        }
+
+        s->buf_pos++;
+        if (*p == '"') {
+            return 0;
+        }
+
+        // escape
+        c = get_char(s);
+        switch (c) {
+        case '"': case '\\': case '/':
+            utf8[0] = c; n = 1; break;
+        case 'b': utf8[0] = '\b'; n = 1; break;
+        case 'f': utf8[0] = '\f'; n = 1; break;
+        case 'n': utf8[0] = '\n'; n = 1; break;
+        case 'r': utf8[0] = '\r'; n = 1; break;
+        case 't': utf8[0] = '\t'; n = 1; break;
+        case 'u':
+            if ((cp = get_hex4(s)) < 0) {
+                strcpy(s->errmsg, "invalid \\u escape");
+                return -1;
+            }
+            if (cp >= 0xdc00 && cp <= 0xdfff) {
+                strcpy(s->errmsg, "invalid utf-16 surrogate");
+                return -1;
+            }
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                if (get_char(s) != '\\' || get_char(s) != 'u' ||
+                    (lo = get_hex4(s)) < 0xdc00 || lo > 0xdfff)
+                {
+                    strcpy(s->errmsg, "invalid utf-16 surrogate pair");
+                    return -1;
+                }
+                cp = 0x10000 + (((cp & 0x3ff) << 10) | (lo & 0x3ff));
+            }
+            if (cp < 0x80) {
+                utf8[0] = cp; n = 1;
+            } else if (cp < 0x800) {
+                utf8[0] = 0xc0 | (cp >> 6);
+                utf8[1] = 0x80 | (cp & 0x3f); n = 2;
+            } else if (cp < 0x10000) {
+                utf8[0] = 0xe0 | (cp >> 12);
+                utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+                utf8[2] = 0x80 | (cp & 0x3f); n = 3;
+            } else {
+                utf8[0] = 0xf0 | (cp >> 18);
+                utf8[1] = 0x80 | ((cp >> 12) & 0x3f);
+                utf8[2] = 0x80 | ((cp >> 6) & 0x3f);
+                utf8[3] = 0x80 | (cp & 0x3f); n = 4;
+            }
+            break;
+        default:
+            strcpy(s->errmsg, "invalid escape in string");
+            return -1;
+        }
+        if (strbuf_append(sb, utf8, n) < 0) {
+            goto nomem;
+        }
+    }
+
+nomem:
+    strcpy(s->errmsg, "string too long");
+    return -1;
+}
+
+static int read_number(util_json_stream_t *s, json_event_t *ev)
+{
+    char *start, *end, *p;
+    int   n;
+
+    s->str.len = 0;
+    while (true) {
+        if ((n = fill(s)) <= 0) {
+            break;
+        }
+        start = s->buf + s->buf_pos;
+        end = start + n;
+        for (p = start; p < end; p++) {
+            if (!((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' ||
+                  *p == '.' || *p == 'e' || *p == 'E'))
+            {
+                break;
+            }
+        }
+        if (strbuf_append(&s->str, start, p - start) < 0) {
+            return -1;
+        }
+        s->buf_pos += p - start;
+        if (p < end) {
+            break;
+        }
+    }
+    if (s->str.len == 0) {
+        return -1;
+    }
+
+    ev->value.type = JSON_TYPE_NUMBER;
+    ev->value.u.number = strtod(s->str.s, &p);
+    return (*p == '\0') ? 0 : -1;
+}
+
+// true, false or null; a null value has type JSON_TYPE_UNDEFINED, as it does
+// from util_json_get_value
+static int read_literal(util_json_stream_t *s, json_event_t *ev)
+{
+    char word[8];
+    int  c, n = 0;
+
+    while (n < (int)sizeof(word) - 1) {
+        if (fill(s) <= 0) {
+            break;
+        }
+        c = (unsigned char)s->buf[s->buf_pos];
+        if (c < 'a' || c > 'z') {
+            break;
+        }
+        word[n++] = c;
+        s->buf_pos++;
+    }
+    word[n] = '\0';
+
+    if (strcmp(word, "true") == 0 || strcmp(word, "false") == 0) {
+        ev->value.type = JSON_TYPE_FLAG;
+        ev->value.u.flag = (word[0] == 't');
+    } else if (strcmp(word, "null") == 0) {
+        ev->value.type = JSON_TYPE_UNDEFINED;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// -----------------  PATH MATCH  --------------------------
+
+// returns true if path matches pattern; in the pattern "[*]" matches any
+// array index, and a key of "*" matches any key, for example
+// "properties.periods[*].temperature"
+bool util_json_path_match(char *path, char *pattern)
+{
+    while (*pattern) {
+        if (pattern[0] == '[' && pattern[1] == '*' && pattern[2] == ']') {
+            if (*path != '[') {
+                return false;
+            }
+            path = strchr(path, ']');
+            if (path == NULL) {
+                return false;
+            }
+            path++;
+            pattern += 3;
+        } else if (pattern[0] == '*' &&
+                   (pattern[1] == '\0' || pattern[1] == '.' || pattern[1] == '['))
+        {
+            if (*path == '\0' || *path == '.' || *path == '[') {
+                return false;
+            }
+            path += strcspn(path, ".[");
+            pattern++;
+        } else {
+            if (*path != *pattern) {
+                return false;
+            }
+            path++;
+            pattern++;
+        }
+    }
+    return *path == '\0';
+}
@@ -0,0 +1,1128 @@
+#include <std_hdrs.h>
+#include <sys/file.h>
+#include <sys/uio.h>
+
+#include <utils.h>
+#include <logging.h>
+
+// Key value store.
+//
+// A store is a log file, dir/name, of records, each a batch of put and delete
+// ops, and a sorted index of the live keys kept in memory, a skip list whose
+// nodes hold the offset and length of the key's value in the log. A get looks
+// up the key and reads the value from the log; puts and deletes, and the ops
+// of a batch, are appended to the log as one record with a single write and
+// then applied to the index.
+//
+// Each record has a checksum of its ops. When a store is opened the log is
+// read and its ops applied to a new index, stopping at the first record that
+// is short or fails its checksum, which is the record being written when the
+// program or system crashed; the log is truncated there. So a batch is
+// applied entirely, or not at all. When the store is opened with sync true
+// each write is followed by an fdatasync, otherwise the writes are in the
+// page cache, which survives a program crash, until util_kv_sync.
+//
+// Puts of a key that exists, and deletes, leave garbage in the log. When the
+// garbage is more than COMPACT_MIN_GARBAGE, and more than the live data, the
+// log is compacted: the live keys and values are written in key order to
+// dir/name.tmp, which is synced and renamed to the log. A crash during a
+// compaction leaves the old log in place. Compaction is done by the put or
+// commit that triggers it, holding the store's mutex.
+//
+// The store is opened by one handle at a time, which may be used by any
+// number of threads; the log is locked with flock.
+
+//
+// defines
+//
+
+#define KV_MAGIC              0x564b5a45   // "EZKV"
+#define KV_VERSION            1
+#define MAX_KEY_LEN           1024
+#define MAX_RECORD_LEN        (256*1024*1024)
+#define MAX_LEVEL             20
+#define COMPACT_MIN_GARBAGE   (1024*1024)
+#define COMPACT_CHUNK         (256*1024)
+
+#define OP_PUT                1
+#define OP_DELETE             2
+
+#define OP_SIZE(key_len,value_len)  ((long)sizeof(op_hdr_t) + (key_len) + (value_len))
+
+//
+// typedefs
+//
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} file_hdr_t;
+
+typedef struct {
+    uint32_t check;               // checksum of the rest of the header and the ops
+    uint32_t len;                 // length of the ops that follow
+    uint32_t count;               // number of ops
+    uint32_t pad;
+} rec_hdr_t;
+
+typedef struct {
+    uint8_t  op;
+    uint8_t  pad[3];
+    uint32_t key_len;
+    uint32_t value_len;           // followed by the key, and the value of an OP_PUT
+} op_hdr_t;
+
+typedef struct node {
+    long         offset;          // of the value in the log
+    int          value_len;
+    int          key_len;
+    int          level;
+    char        *key;
+    struct node *next[];          // followed by the key and its '\0'
+} node_t;
+
+struct util_kv_batch {
+    char *data;                   // the ops, as written to the log
+    int   len;
+    int   alloced;
+    int   count;
+    bool  failed;                 // an op was invalid, or could not be added
+};
+
+struct util_kv {
+    pthread_mutex_t mutex;
+    char            dir[300];
+    char            path[300];
+    char            tmp_path[310];
+    int             fd;
+    bool            sync;
+    long            log_size;
+    long            live_bytes;   // size of the live keys' put ops
+    long            count;
+    long            gen;          // incremented when a node is added or removed
+    node_t         *head;
+    int             level;
+    uint32_t        rand;
+    util_kv_batch_t scratch;      // the op of a util_kv_put or util_kv_delete
+};
+
+struct util_kv_iter {
+    util_kv_t *kv;
+    char      *start;
+    char      *end;
+    bool       started;
+    node_t    *node;              // the node returned last, valid while gen is unchanged
+    long       gen;
+    char       key[MAX_KEY_LEN+1];
+};
+
+//
+// prototypes
+//
+
+static int load(util_kv_t *kv);
+static int commit(util_kv_t *kv, util_kv_batch_t *b);
+static int write_record(int fd, util_kv_batch_t *b, long *size);
+static int apply_ops(util_kv_t *kv, char *ops, int len, int count, long offset);
+static void maybe_compact(util_kv_t *kv);
+static int compact(util_kv_t *kv);
+static int sync_dir(util_kv_t *kv);
+
+static int add_op(util_kv_batch_t *b, int op, char *key, int key_len, void *value, int value_len);
+static bool valid_key(char *key);
+static uint32_t record_check(rec_hdr_t *hdr, char *ops);
+
+static node_t *find_ge(util_kv_t *kv, char *key, int key_len, bool gt, node_t **update);
+static void index_put(util_kv_t *kv, char *key, int key_len, long offset, int value_len);
+static void index_delete(util_kv_t *kv, char *key, int key_len);
+static int key_cmp(node_t *n, char *key, int key_len);
+static int random_level(util_kv_t *kv);
+
+// -----------------  OPEN / CLOSE  ------------------------
+
+util_kv_t *util_kv_open(char *dir, char *name, bool sync)
+{
+    util_kv_t *kv;
+
+    kv = calloc(1, sizeof(util_kv_t));
+    if (kv == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&kv->mutex, NULL);
+    snprintf(kv->dir, sizeof(kv->dir), "%s", dir);
+    snprintf(kv->path, sizeof(kv->path), "%s/%s", dir, name);
+    snprintf(kv->tmp_path, sizeof(kv->tmp_path), "%s.tmp", kv->path);
+    kv->sync = sync;
+    kv->rand = 0x9e3779b9;
+    kv->fd   = -1;
+
+    kv->head = calloc(1, sizeof(node_t) + MAX_LEVEL * sizeof(node_t*));
+    if (kv->head == NULL) {
+        util_kv_close(kv);
+        return NULL;
+    }
+    kv->head->level = MAX_LEVEL;
+    kv->level = 1;
+
+    // open and lock the log; if a compaction by another handle replaced 
+    // the log after it was opened then the replaced log was locked, so the
+    // log is opened again
+    while (true) {
+        struct stat fd_st, path_st;
+
+        kv->fd = open(kv->path, O_RDWR | O_CREAT | O_APPEND, 0666);
+        if (kv->fd < 0) {
+            ERROR("failed to open %s, %s\n", kv->path, strerror(errno));
+            util_kv_close(kv);
+            return NULL;
+        }
+        if (flock(kv->fd, LOCK_EX | LOCK_NB) < 0) {
+            ERROR("%s is in use, %s\n", kv->path, strerror(errno));
+            close(kv->fd);
+            kv->fd = -1;
+            util_kv_close(kv);
+            return NULL;
+        }
+        if (fstat(kv->fd, &fd_st) == 0 && stat(kv->path, &path_st) == 0 &&
+            fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino)
+        {
+            break;
+        }
+        close(kv->fd);
+        kv->fd = -1;
+    }
+
+    // a tmp file is left by a compaction that did not complete; it is
+    // removed while holding the lock, so it is not the tmp file of a 
+    // compaction in progress by another handle
+    unlink(kv->tmp_path);
+
+    if (load(kv) < 0) {
+        util_kv_close(kv);
+        return NULL;
+    }
+    maybe_compact(kv);
+
+    INFO("opened %s, %ld keys, %ld log bytes\n", kv->path, kv->count, kv->log_size);
+    return kv;
+}
+
+void util_kv_close(util_kv_t *kv)
+{
+    node_t *n, *next;
+
+    if (kv == NULL) {
+        return;
+    }
+
+    if (kv->fd >= 0) {
+        if (fdatasync(kv->fd) < 0) {
+            ERROR("failed to sync %s, %s\n", kv->path, strerror(errno));
+        }
+        close(kv->fd);
+    }
+    if (kv->head) {
+        for (n = kv->head->next[0]; n != NULL; n = next) {
+            next = n->next[0];
+            free(n);
+        }
+        free(kv->head);
+    }
+    free(kv->scratch.data);
+    pthread_mutex_destroy(&kv->mutex);
+    free(kv);
+}
+
+// reads the log, applying its records to the index, and truncates the log
+// after the last valid record
+static int load(util_kv_t *kv)
+{
+    struct stat st;
+    file_hdr_t  fhdr;
+    rec_hdr_t   hdr;
+    char       *map;
+    long        off;
+
+    if (fstat(kv->fd, &st) < 0) {
+        ERROR("failed to stat %s, %s\n", kv->path, strerror(errno));
+        return -1;
+    }
+
+    // a new log, or one whose header was being written, gets a header
+    if (st.st_size < (long)sizeof(file_hdr_t)) {
+        fhdr.magic   = KV_MAGIC;
+        fhdr.version = KV_VERSION;
+        if (ftruncate(kv->fd, 0) < 0 ||
+            write(kv->fd, &fhdr, sizeof(fhdr)) != sizeof(fhdr) ||
+            fdatasync(kv->fd) < 0 ||
+            sync_dir(kv) < 0)
+        {
+            ERROR("failed to init %s, %s\n", kv->path, strerror(errno));
+            return -1;
+        }
+        kv->log_size = sizeof(fhdr);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, kv->fd, 0);
+    if (map == MAP_FAILED) {
+        ERROR("failed to map %s, %s\n", kv->path, strerror(errno));
+        return -1;
+    }
+    memcpy(&fhdr, map, sizeof(fhdr));
+    if (fhdr.magic != KV_MAGIC || fhdr.version != KV_VERSION) {
+        ERROR("%s is not a key value store, magic 0x%x version %d\n",
+              kv->path, fhdr.magic, fhdr.version);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    off = sizeof(fhdr);
+    while (off + (long)sizeof(hdr) <= st.st_size) {
+        memcpy(&hdr, map + off, sizeof(hdr));
+        if (hdr.len > st.st_size - off - sizeof(hdr) ||
+            record_check(&hdr, map + off + sizeof(hdr)) != hdr.check ||
+            apply_ops(kv, map + off + sizeof(hdr), hdr.len, hdr.count, off + sizeof(hdr)) < 0)
+        {
+            break;
+        }
+        off += sizeof(hdr) + hdr.len;
+    }
+    munmap(map, st.st_size);
+
+    if (off < st.st_size) {
+        WARN("%s: dropping %ld bytes, of a partly written record, at offset %ld\n",
+             kv->path, st.st_size - off, off);
+        if (ftruncate(kv->fd, off) < 0 || fdatasync(kv->fd) < 0) {
+            ERROR("failed to truncate %s, %s\n", kv->path, strerror(errno));
+            return -1;
+        }
+    }
+    kv->log_size = off;
+    return 0;
+}
+
+// -----------------  PUT / GET / DELETE  ------------------
+
+// the value is len bytes, it need not be a string
+int util_kv_put(util_kv_t *kv, char *key, void *value, int len)
+{
+    int rc;
+
+    pthread_mutex_lock(&kv->mutex);
+    util_kv_batch_put(&kv->scratch, key, value, len);
+    rc = commit(kv, &kv->scratch);
+    pthread_mutex_unlock(&kv->mutex);
+    return rc;
+}
+
+// copies up to max bytes of the key's value to value, and returns the value's
+// length, which may be more than max, or -1 if the key is not found
+int util_kv_get(util_kv_t *kv, char *key, void *value, int max)
+{
+    node_t *n;
+    int     len, copy;
+
+    if (!valid_key(key)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&kv->mutex);
+    n = find_ge(kv, key, strlen(key), false, NULL);
+    if (n == NULL || key_cmp(n, key, strlen(key)) != 0) {
+        pthread_mutex_unlock(&kv->mutex);
+        return -1;
+    }
+    len = n->value_len;
+    copy = (len < max ? len : max);
+    if (copy > 0 && pread(kv->fd, value, copy, n->offset) != copy) {
+        ERROR("failed to read %s, %s\n", kv->path, strerror(errno));
+        len = -1;
+    }
+    pthread_mutex_unlock(&kv->mutex);
+    return len;
+}
+
+// deleting a key that does not exist is not an error
+int util_kv_delete(util_kv_t *kv, char *key)
+{
+    int rc;
+
+    pthread_mutex_lock(&kv->mutex);
+    util_kv_batch_delete(&kv->scratch, key);
+    rc = commit(kv, &kv->scratch);
+    pthread_mutex_unlock(&kv->mutex);
+    return rc;
+}
+
+long util_kv_count(util_kv_t *kv)
+{
+    long count;
+
+    pthread_mutex_lock(&kv->mutex);
+    count = kv->count;
+    pthread_mutex_unlock(&kv->mutex);
+    return count;
+}
+
+int util_kv_sync(util_kv_t *kv)
+{
+    int rc;
+
+    pthread_mutex_lock(&kv->mutex);
+    rc = fdatasync(kv->fd);
+    if (rc < 0) {
+        ERROR("failed to sync %s, %s\n", kv->path, strerror(errno));
+    }
+    pthread_mutex_unlock(&kv->mutex);
+    return rc;
+}
+
+int util_kv_compact(util_kv_t *kv)
+{
+    int rc;
+
+    pthread_mutex_lock(&kv->mutex);
+    rc = compact(kv);
+    pthread_mutex_unlock(&kv->mutex);
+    return rc;
+}
+
+// -----------------  BATCHES  -----------------------------
+
+util_kv_batch_t *util_kv_batch_create(void)
+{
+    return calloc(1, sizeof(util_kv_batch_t));
+}
+
+void util_kv_batch_free(util_kv_batch_t *b)
+{
+    if (b == NULL) {
+        return;
+    }
+    free(b->data);
+    free(b);
+}
+
+void util_kv_batch_put(util_kv_batch_t *b, char *key, void *value, int len)
+{
+    if (!valid_key(key) || len < 0 || (value == NULL && len > 0)) {
+        ERROR("invalid put, key '%.40s' len %d\n", key ? key : "(null)", len);
+        b->failed = true;
+        return;
+    }
+    if (add_op(b, OP_PUT, key, strlen(key), value, len) < 0) {
+        b->failed = true;
+    }
+}
+
+void util_kv_batch_delete(util_kv_batch_t *b, char *key)
+{
+    if (!valid_key(key)) {
+        ERROR("invalid delete, key '%.40s'\n", key ? key : "(null)");
+        b->failed = true;
+        return;
+    }
+    if (add_op(b, OP_DELETE, key, strlen(key), NULL, 0) < 0) {
+        b->failed = true;
+    }
+}
+
+// the batch's ops are written as one record, so after a crash either all or
+// none of them are in the store; the batch is emptied, and can be reused
+int util_kv_batch_commit(util_kv_t *kv, util_kv_batch_t *b)
+{
+    int rc;
+
+    pthread_mutex_lock(&kv->mutex);
+    rc = commit(kv, b);
+    pthread_mutex_unlock(&kv->mutex);
+    return rc;
+}
+
+// appends the batch to the log and applies it to the index; called with the
+// mutex held
+static int commit(util_kv_t *kv, util_kv_batch_t *b)
+{
+    long offset, size;
+    int  rc = 0;
+
+    if (b->failed) {
+        ERROR("%s: batch has an invalid op, not committed\n", kv->path);
+        rc = -1;
+        goto done;
+    }
+    if (b->count == 0) {
+        goto done;
+    }
+
+    size = kv->log_size;
+    if (write_record(kv->fd, b, &size) < 0) {
+        ERROR("failed to write %s, %s\n", kv->path, strerror(errno));
+        // remove a partly written record, so the next follows the valid ones
+        if (ftruncate(kv->fd, kv->log_size) < 0) {
+            ERROR("failed to truncate %s, %s\n", kv->path, strerror(errno));
+        }
+        rc = -1;
+        goto done;
+    }
+    offset = kv->log_size + sizeof(rec_hdr_t);
+    kv->log_size = size;
+
+    // the ops are applied even if the sync fails, they are in the log
+    apply_ops(kv, b->data, b->len, b->count, offset);
+    if (kv->sync && fdatasync(kv->fd) < 0) {
+        ERROR("failed to sync %s, %s\n", kv->path, strerror(errno));
+        rc = -1;
+    }
+
+    maybe_compact(kv);
+
+done:
+    b->len    = 0;
+    b->count  = 0;
+    b->failed = false;
+    return rc;
+}
+
+// writes the batch's ops as a record at the end of the file, and adds the
+// record's length to size
+static int write_record(int fd, util_kv_batch_t *b, long *size)
+{
+    rec_hdr_t    hdr;
+    struct iovec iov[2];
+    ssize_t      len;
+
+    hdr.len   = b->len;
+    hdr.count = b->count;
+    hdr.pad   = 0;
+    hdr.check = record_check(&hdr, b->data);
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(hdr);
+    iov[1].iov_base = b->data;
+    iov[1].iov_len  = b->len;
+    len = writev(fd, iov, 2);
+    if (len != (ssize_t)(sizeof(hdr) + b->len)) {
+        if (len >= 0) {
+            errno = ENOSPC;
+        }
+        return -1;
+    }
+
+    *size += len;
+    return 0;
+}
+
+// applies a record's ops to the index, offset is the ops' offset in the log;
+// the ops are checked first, so that none are applied if one is invalid
+static int apply_ops(util_kv_t *kv, char *ops, int len, int count, long offset)
+{
+    op_hdr_t op;
+    int      i, pos;
+
+    for (pos = 0, i = 0; i < count; i++) {
+        if (pos + (int)sizeof(op) > len) {
+            return -1;
+        }
+        memcpy(&op, ops + pos, sizeof(op));
+        if ((op.op != OP_PUT && op.op != OP_DELETE) ||
+            op.key_len == 0 || op.key_len > MAX_KEY_LEN ||
+            (op.op == OP_DELETE && op.value_len != 0) ||
+            OP_SIZE(op.key_len, op.value_len) > len - pos)
+        {
+            return -1;
+        }
+        pos += OP_SIZE(op.key_len, op.value_len);
+    }
+    if (pos != len) {
+        return -1;
+    }
+
+    for (pos = 0, i = 0; i < count; i++) {
+        memcpy(&op, ops + pos, sizeof(op));
+        if (op.op == OP_PUT) {
+            index_put(kv, ops + pos + sizeof(op), op.key_len,
+                      offset + pos + sizeof(op) + op.key_len, op.value_len);
+        } else {
+            index_delete(kv, ops + pos + sizeof(op), op.key_len);
+        }
+        pos += OP_SIZE(op.key_len, op.value_len);
+    }
+    return 0;
+}
+
+// appends an op to the batch; returns the offset of its value in the batch
+static int add_op(util_kv_batch_t *b, int op, char *key, int key_len, void *value, int value_len)
+{
+    op_hdr_t hdr;
+    long     need;
+    int      pos;
+
+    need = b->len + OP_SIZE(key_len, value_len);
+    if (need > MAX_RECORD_LEN) {
+        ERROR("batch too large, %ld bytes\n", need);
+        return -1;
+    }
+    if (need > b->alloced) {
+        long  alloced = (b->alloced ? 2L * b->alloced : 4096);
+        char *data;
+
+        while (alloced < need) {
+            alloced *= 2;
+        }
+        data = realloc(b->data, alloced);
+        if (data == NULL) {
+            ERROR("failed to allocate batch, %ld bytes\n", alloced);
+            return -1;
+        }
+        b->data = data;
+        b->alloced = alloced;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.op        = op;
+    hdr.key_len   = key_len;
+    hdr.value_len = value_len;
+    pos = b->len;
+    memcpy(b->data + pos, &hdr, sizeof(hdr));
+    pos += sizeof(hdr);
+    memcpy(b->data + pos, key, key_len);
+    pos += key_len;
+    if (value != NULL) {
+        memcpy(b->data + pos, value, value_len);
+    }
+    b->len = need;
+    b->count++;
+    return pos;
+}
+
+static bool valid_key(char *key)
+{
+    size_t len;
+
+    if (key == NULL) {
+        return false;
+    }
+    len = strlen(key);
+    return len > 0 && len <= MAX_KEY_LEN;
+}
+
+// FNV-1a, over 8 byte words, of the record header after the check, and the ops
+static uint32_t record_check(rec_hdr_t *hdr, char *ops)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    uint64_t w;
+    uint32_t i;
+
+    w = ((uint64_t)hdr->len << 32) | hdr->count;
+    h = (h ^ w) * 0x100000001b3ULL;
+    for (i = 0; i + 8 <= hdr->len; i += 8) {
+        memcpy(&w, ops + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+    }
+    for (; i < hdr->len; i++) {
+        h = (h ^ (uint8_t)ops[i]) * 0x100000001b3ULL;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+// -----------------  COMPACTION  --------------------------
+
+static void maybe_compact(util_kv_t *kv)
+{
+    long garbage = kv->log_size - sizeof(file_hdr_t) - kv->live_bytes;
+
+    if (garbage > COMPACT_MIN_GARBAGE && garbage > kv->live_bytes) {
+        compact(kv);
+    }
+}
+
+// writes the live keys and values to a new log, and replaces the log with it;
+// called with the mutex held
+static int compact(util_kv_t *kv)
+{
+    util_kv_batch_t chunk;
+    file_hdr_t      fhdr;
+    node_t         *n, *first;
+    long           *offsets = NULL;
+    long            size, old_size, i, first_idx, rec_offset;
+    long            start_us = util_monotonic_microsec_timer();
+    int             fd, pos;
+
+    memset(&chunk, 0, sizeof(chunk));
+    old_size = kv->log_size;
+
+    fd = open(kv->tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0666);
+    if (fd < 0) {
+        ERROR("failed to create %s, %s\n", kv->tmp_path, strerror(errno));
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        ERROR("failed to lock %s, %s\n", kv->tmp_path, strerror(errno));
+        goto error;
+    }
+    fhdr.magic   = KV_MAGIC;
+    fhdr.version = KV_VERSION;
+    if (write(fd, &fhdr, sizeof(fhdr)) != sizeof(fhdr)) {
+        ERROR("failed to write %s, %s\n", kv->tmp_path, strerror(errno));
+        goto error;
+    }
+    size = sizeof(fhdr);
+
+    // write the live keys in records of about COMPACT_CHUNK bytes; offsets
+    // holds each value's offset in its record's ops, and then in the new log
+    offsets = malloc((kv->count + 1) * sizeof(long));
+    if (offsets == NULL) {
+        goto error;
+    }
+    i = first_idx = 0;
+    n = first = kv->head->next[0];
+    while (true) {
+        if (chunk.count > 0 &&
+            (n == NULL || chunk.len + OP_SIZE(n->key_len, n->value_len) > COMPACT_CHUNK))
+        {
+            rec_offset = size + sizeof(rec_hdr_t);
+            if (write_record(fd, &chunk, &size) < 0) {
+                ERROR("failed to write %s, %s\n", kv->tmp_path, strerror(errno));
+                goto error;
+            }
+            for (; first_idx < i; first_idx++) {
+                offsets[first_idx] += rec_offset;
+            }
+            chunk.len = chunk.count = 0;
+        }
+        if (n == NULL) {
+            break;
+        }
+
+        pos = add_op(&chunk, OP_PUT, n->key, n->key_len, NULL, n->value_len);
+        if (pos < 0) {
+            goto error;
+        }
+        if (n->value_len > 0 && pread(kv->fd, chunk.data + pos, n->value_len, n->offset) != n->value_len) {
+            ERROR("failed to read %s, %s\n", kv->path, strerror(errno));
+            goto error;
+        }
+        offsets[i++] = pos;
+        n = n->next[0];
+    }
+
+    // make the new log durable before it replaces the old
+    if (fdatasync(fd) < 0 || rename(kv->tmp_path, kv->path) < 0) {
+        ERROR("failed to replace %s, %s\n", kv->path, strerror(errno));
+        goto error;
+    }
+    if (sync_dir(kv) < 0) {
+        ERROR("failed to sync dir %s, %s\n", kv->dir, strerror(errno));
+    }
+
+    close(kv->fd);
+    kv->fd = fd;
+    kv->log_size = size;
+    for (i = 0, n = first; n != NULL; n = n->next[0]) {
+        n->offset = offsets[i++];
+    }
+
+    free(offsets);
+    free(chunk.data);
+    INFO("compacted %s, %ld keys, %ld bytes to %ld, %ld ms\n",
+         kv->path, kv->count, old_size, size, (util_monotonic_microsec_timer() - start_us) / 1000);
+    return 0;
+
+error:
+    close(fd);
+    unlink(kv->tmp_path);
+    free(offsets);
+    free(chunk.data);
+    return -1;
+}
+
+static int sync_dir(util_kv_t *kv)
+{
+    int fd, rc;
+
+    fd = open(kv->dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return -1;
+    }
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+// -----------------  RANGE ITERATION  ---------------------
+
+// iterates the keys >= start and < end, in order; start or end may be NULL
+// for no limit, and both NULL iterates all keys. Keys put while iterating
+// are returned if they follow the key returned last.
+util_kv_iter_t *util_kv_iter_create(util_kv_t *kv, char *start, char *end)
+{
+    util_kv_iter_t *it;
+
+    it = calloc(1, sizeof(util_kv_iter_t));
+    if (it == NULL) {
+        return NULL;
+    }
+    it->kv    = kv;
+    it->start = (start ? strdup(start) : NULL);
+    it->end   = (end ? strdup(end) : NULL);
+    return it;
+}
+
+void util_kv_iter_free(util_kv_iter_t *it)
+{
+    if (it == NULL) {
+        return;
+    }
+    free(it->start);
+    free(it->end);
+    free(it);
+}
+
+// returns the next key, and copies up to max bytes of its value, as
+// util_kv_get does; returns -1 after the last key. The key is valid until the
+// next call.
+int util_kv_iter_next(util_kv_iter_t *it, char **key, void *value, int max)
+{
+    util_kv_t *kv = it->kv;
+    node_t    *n;
+    int        len, copy;
+
+    pthread_mutex_lock(&kv->mutex);
+
+    // the next node follows the node returned last, unless nodes have been
+    // added or removed since, when the key returned last is looked up
+    if (!it->started) {
+        n = (it->start ? find_ge(kv, it->start, strlen(it->start), false, NULL) : kv->head->next[0]);
+        it->started = true;
+    } else if (it->node == NULL) {
+        n = NULL;
+    } else if (it->gen == kv->gen) {
+        n = it->node->next[0];
+    } else {
+        n = find_ge(kv, it->key, strlen(it->key), true, NULL);
+    }
+    if (n != NULL && it->end != NULL && key_cmp(n, it->end, strlen(it->end)) >= 0) {
+        n = NULL;
+    }
+    it->node = n;
+    it->gen  = kv->gen;
+    if (n == NULL) {
+        pthread_mutex_unlock(&kv->mutex);
+        return -1;
+    }
+
+    memcpy(it->key, n->key, n->key_len + 1);
+    len = n->value_len;
+    copy = (len < max ? len : max);
+    if (copy > 0 && pread(kv->fd, value, copy, n->offset) != copy) {
+        ERROR("failed to read %s, %s\n", kv->path, strerror(errno));
+    }
+    pthread_mutex_unlock(&kv->mutex);
+
+    *key = it->key;
+    return len;
+}
+
+// -----------------  INDEX  -------------------------------
+
+// returns the first node whose key is >= key, or > key when gt is set; update,
+// if not NULL, is set to the nodes preceding it at each level
+static node_t *find_ge(util_kv_t *kv, char *key, int key_len, bool gt, node_t **update)
+{
+    node_t *x = kv->head;
+    int     lvl, cmp;
+
+    for (lvl = kv->level - 1; lvl >= 0; lvl--) {
+        while (x->next[lvl] != NULL) {
+            cmp = key_cmp(x->next[lvl], key, key_len);
+            if (cmp > 0 || (cmp == 0 && !gt)) {
+                break;
+            }
+            x = x->next[lvl];
+        }
+        if (update) {
+            update[lvl] = x;
+        }
+    }
+    return x->next[0];
+}
+
+static void index_put(util_kv_t *kv, char *key, int key_len, long offset, int value_len)
+{
+    node_t *update[MAX_LEVEL], *n;
+    int     lvl, level;
+
+    n = find_ge(kv, key, key_len, false, update);
+    if (n != NULL && key_cmp(n, key, key_len) == 0) {
+        kv->live_bytes += value_len - n->value_len;
+        n->offset    = offset;
+        n->value_len = value_len;
+        return;
+    }
+
+    level = random_level(kv);
+    n = malloc(sizeof(node_t) + level * sizeof(node_t*) + key_len + 1);
+    if (n == NULL) {
+        // the index can't be left out of step with the log
+        ERROR("failed to allocate index node\n");
+        abort();
+    }
+    n->offset    = offset;
+    n->value_len = value_len;
+    n->key_len   = key_len;
+    n->level     = level;
+    n->key       = (char*)&n->next[level];
+    memcpy(n->key, key, key_len);
+    n->key[key_len] = '\0';
+
+    if (level > kv->level) {
+        for (lvl = kv->level; lvl < level; lvl++) {
+            update[lvl] = kv->head;
+        }
+        kv->level = level;
+    }
+    for (lvl = 0; lvl < level; lvl++) {
+        n->next[lvl] = update[lvl]->next[lvl];
+        update[lvl]->next[lvl] = n;
+    }
+
+    kv->live_bytes += OP_SIZE(key_len, value_len);
+    kv->count++;
+    kv->gen++;
+}
+
+static void index_delete(util_kv_t *kv, char *key, int key_len)
+{
+    node_t *update[MAX_LEVEL], *n;
+    int     lvl;
+
+    n = find_ge(kv, key, key_len, false, update);
+    if (n == NULL || key_cmp(n, key, key_len) != 0) {
+        return;
+    }
+
+    for (lvl = 0; lvl < n->level; lvl++) {
+        update[lvl]->next[lvl] = n->next[lvl];
+    }
+    while (kv->level > 1 && kv->head->next[kv->level-1] == NULL) {
+        kv->level--;
+    }
+
+    kv->live_bytes -= OP_SIZE(n->key_len, n->value_len);
+    kv->count--;
+    kv->gen++;
+    free(n);
+}
+
+// compares as strcmp does, the key need not be '\0' terminated
+static int key_cmp(node_t *n, char *key, int key_len)
+{
+    int cmp;
+
+    cmp = memcmp(n->key, key, (n->key_len < key_len ? n->key_len : key_len));
+    return (cmp != 0 ? cmp : n->key_len - key_len);
+}
+
+// levels with probability 1/4 each, using xorshift32
+static int random_level(util_kv_t *kv)
+{
+    int level = 1;
+
+    while (level < MAX_LEVEL) {
+        kv->rand ^= kv->rand << 13;
+        kv->rand ^= kv->rand >> 17;
+        kv->rand ^= kv->rand << 5;
+        if ((kv->rand & 3) != 0) {
+            break;
+        }
+        level++;
+    }
+    return level;
+}
+
+// -----------------  BENCHMARK  ---------------------------
+
+#define BENCH_KEYS        200000
+#define BENCH_VALUE_LEN   100
+#define BENCH_BATCH       100
+#define BENCH_SYNC_OPS    500
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(long*)a, y = *(long*)b;
+
+    return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static void bench_key(char *key, int i)
+{
+    // the keys are put in a scrambled order
+    sprintf(key, "key.%08x", (uint32_t)i * 2654435761U);
+}
+
+static void bench_value(char *value, int i, int version)
+{
+    memset(value, 'a' + version % 26, BENCH_VALUE_LEN);
+    sprintf(value, "%d.%d", i, version);
+}
+
+static double ops_per_sec(long ops, long us)
+{
+    return (us > 0 ? ops * 1e6 / us : 0);
+}
+
+// benchmarks a store in dir, and prints one json line per test: puts, gets,
+// a range scan, batches, compaction and reopening, with the log in the page
+// cache; then puts and batches with an fdatasync each, with the puts' latency
+int util_kv_bench(char *dir)
+{
+    util_kv_t       *kv;
+    util_kv_batch_t *b;
+    util_kv_iter_t  *it;
+    char             key[64], value[BENCH_VALUE_LEN], expect[BENCH_VALUE_LEN], *k, last[64];
+    long             t, us, log_size, lat[BENCH_SYNC_OPS];
+    int              i, j, n, errors = 0;
+
+    util_delete_file(dir, "kvbench");
+    kv = util_kv_open(dir, "kvbench", false);
+    if (kv == NULL) {
+        return -1;
+    }
+
+    // puts
+    t = util_monotonic_microsec_timer();
+    for (i = 0; i < BENCH_KEYS; i++) {
+        bench_key(key, i);
+        bench_value(value, i, 0);
+        if (util_kv_put(kv, key, value, BENCH_VALUE_LEN) < 0) {
+            errors++;
+        }
+    }
+    us = util_monotonic_microsec_timer() - t;
+    printf("{\"kv\":\"put\", \"ops\":%d, \"ops_per_sec\":%.0f}\n", BENCH_KEYS, ops_per_sec(BENCH_KEYS, us));
+
+    // gets, in another order, checking the values
+    t = util_monotonic_microsec_timer();
+    for (i = 0; i < BENCH_KEYS; i++) {
+        j = (int)(((long)i * 7919) % BENCH_KEYS);
+        bench_key(key, j);
+        bench_value(expect, j, 0);
+        if (util_kv_get(kv, key, value, sizeof(value)) != BENCH_VALUE_LEN ||
+            memcmp(value, expect, BENCH_VALUE_LEN) != 0)
+        {
+            errors++;
+        }
+    }
+    us = util_monotonic_microsec_timer() - t;
+    printf("{\"kv\":\"get\", \"ops\":%d, \"ops_per_sec\":%.0f}\n", BENCH_KEYS, ops_per_sec(BENCH_KEYS, us));
+
+    // range scan of all keys, checking the order
+    t = util_monotonic_microsec_timer();
+    it = util_kv_iter_create(kv, NULL, NULL);
+    last[0] = '\0';
+    n = 0;
+    while (util_kv_iter_next(it, &k, value, sizeof(value)) >= 0) {
+        if (strcmp(k, last) <= 0) {
+            errors++;
+        }
+        strcpy(last, k);
+        n++;
+    }
+    util_kv_iter_free(it);
+    us = util_monotonic_microsec_timer() - t;
+    if (n != BENCH_KEYS) {
+        errors++;
+    }
+    printf("{\"kv\":\"scan\", \"ops\":%d, \"ops_per_sec\":%.0f}\n", n, ops_per_sec(n, us));
+
+    // batches that overwrite all keys, twice
+    b = util_kv_batch_create();
+    t = util_monotonic_microsec_timer();
+    for (j = 1; j <= 2; j++) {
+        for (i = 0; i < BENCH_KEYS; i++) {
+            bench_key(key, i);
+            bench_value(value, i, j);
+            util_kv_batch_put(b, key, value, BENCH_VALUE_LEN);
+            if ((i + 1) % BENCH_BATCH == 0 && util_kv_batch_commit(kv, b) < 0) {
+                errors++;
+            }
+        }
+    }
+    us = util_monotonic_microsec_timer() - t;
+    printf("{\"kv\":\"batch_put\", \"batch\":%d, \"ops\":%d, \"ops_per_sec\":%.0f}\n",
+           BENCH_BATCH, 2 * BENCH_KEYS, ops_per_sec(2 * BENCH_KEYS, us));
+
+    // compaction, the batches leave the log a third live, unless compaction
+    // was triggered by the puts
+    log_size = kv->log_size;
+    t = util_monotonic_microsec_timer();
+    if (util_kv_compact(kv) < 0) {
+        errors++;
+    }
+    us = util_monotonic_microsec_timer() - t;
+    printf("{\"kv\":\"compact\", \"keys\":%ld, \"log_bytes_before\":%ld, \"log_bytes_after\":%ld, \"ms\":%.1f}\n",
+           util_kv_count(kv), log_size, kv->log_size, us / 1000.);
+
+    // reopen, reading the log
+    util_kv_close(kv);
+    t = util_monotonic_microsec_timer();
+    kv = util_kv_open(dir, "kvbench", true);
+    us = util_monotonic_microsec_timer() - t;
+    if (kv == NULL) {
+        util_kv_batch_free(b);
+        return -1;
+    }
+    if (util_kv_count(kv) != BENCH_KEYS) {
+        errors++;
+    }
+    bench_key(key, 12345);
+    bench_value(expect, 12345, 2);
+    if (util_kv_get(kv, key, value, sizeof(value)) != BENCH_VALUE_LEN || memcmp(value, expect, BENCH_VALUE_LEN) != 0) {
+        errors++;
+    }
+    printf("{\"kv\":\"open\", \"keys\":%ld, \"ms\":%.1f}\n", util_kv_count(kv), us / 1000.);
+
+    // puts with an fdatasync each, and their latency
+    for (i = 0; i < BENCH_SYNC_OPS; i++) {
+        bench_key(key, i);
+        bench_value(value, i, 3);
+        t = util_monotonic_microsec_timer();
+        if (util_kv_put(kv, key, value, BENCH_VALUE_LEN) < 0) {
+            errors++;
+        }
+        lat[i] = util_monotonic_microsec_timer() - t;
+    }
+    for (us = 0, i = 0; i < BENCH_SYNC_OPS; i++) {
+        us += lat[i];
+    }
+    qsort(lat, BENCH_SYNC_OPS, sizeof(long), cmp_long);
+    printf("{\"kv\":\"put_sync\", \"ops\":%d, \"ops_per_sec\":%.0f, \"p50_us\":%ld, \"p99_us\":%ld, \"max_us\":%ld}\n",
+           BENCH_SYNC_OPS, ops_per_sec(BENCH_SYNC_OPS, us),
+           lat[BENCH_SYNC_OPS/2], lat[BENCH_SYNC_OPS*99/100], lat[BENCH_SYNC_OPS-1]);
+
+    // batches with an fdatasync each
+    t = util_monotonic_microsec_timer();
+    for (i = 0; i < BENCH_SYNC_OPS * BENCH_BATCH; i++) {
+        bench_key(key, i);
+        bench_value(value, i, 4);
+        util_kv_batch_put(b, key, value, BENCH_VALUE_LEN);
+        if ((i + 1) % BENCH_BATCH == 0 && util_kv_batch_commit(kv, b) < 0) {
+            errors++;
+        }
+    }
+    us = util_monotonic_microsec_timer() - t;
+    printf("{\"kv\":\"batch_put_sync\", \"batch\":%d, \"ops\":%d, \"ops_per_sec\":%.0f}\n",
+           BENCH_BATCH, BENCH_SYNC_OPS * BENCH_BATCH, ops_per_sec(BENCH_SYNC_OPS * BENCH_BATCH, us));
+
+    util_kv_batch_free(b);
+    util_kv_close(kv);
+    util_delete_file(dir, "kvbench");
+
+    if (errors) {
+        ERROR("kv bench: %d errors\n", errors);
+        return -1;
+    }
+    return 0;
+}
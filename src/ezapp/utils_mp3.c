@@ -0,0 +1,512 @@
+#include <std_hdrs.h>
+
+#include <utils.h>
+#include <logging.h>
+
+#include <lame/lame.h>
+
+// Parallel transcoding of raw recordings to mp3.
+//
+// The input is split at mp3 frame boundaries into segments, which are encoded
+// by a pool of threads, each segment with its own lame encoder; the segments'
+// frames are then concatenated in order. To make the seams inaudible:
+// - each segment's encoder starts SEG_PREROLL_FRAMES before the segment, so
+//   that its psychoacoustic model and mdct have the preceding audio; these
+//   preroll frames are discarded
+// - the encoder is fed SEG_POSTROLL_FRAMES past the end of the segment, so the
+//   last frames have the audio that follows for the encoder's lookahead
+// - the bit reservoir is not used by the preroll frames, so the first kept
+//   frame has main_data_begin 0, and doesn't depend on the discarded frames
+//
+// The first segment's encoder writes the Xing/LAME header frame; it is then
+// updated with the frame count, byte count, seek table, padding and crcs of
+// the whole stream.
+//
+// A single segment is used when num_threads is 1, or when lame resamples by
+// a ratio that doesn't map each output frame to a whole number of input
+// samples; the output is then the same as from a single encoder.
+
+//
+// defines
+//
+
+#define SEG_PREROLL_FRAMES   8
+#define SEG_POSTROLL_FRAMES  4
+#define SEG_MIN_FRAMES       200   // about 5 secs at 48000
+#define SEGS_PER_THREAD      4     // so the threads finish at about the same time
+#define MAX_THREADS          64
+
+#define ENC_BLOCK_SAMPLES    4096
+#define MAX_TAG_LEN          2048
+
+// offsets in the header frame, from the start of the "Xing" or "Info" id
+#define TAG_FRAMES           8
+#define TAG_BYTES            12
+#define TAG_TOC              16
+#define TAG_DELAY_PADDING    141
+#define TAG_MUSIC_LENGTH     148
+#define TAG_MUSIC_CRC        152
+#define TAG_CRC              154
+
+//
+// typedefs
+//
+
+typedef struct {
+    unsigned char *data;        // the segment's kept mp3 frames
+    long           len;
+    int            frames;
+} segment_t;
+
+typedef struct {
+    // input
+    short         *pcm;
+    long           total_samples;   // per channel
+    int            channels;
+    int            in_sample_rate;
+    int            out_sample_rate;
+    int            bitrate_kbps;
+
+    // segmentation
+    int            frame_samples;   // input samples per mp3 frame
+    int            seg_frames;
+    int            num_segs;
+    segment_t     *segs;
+
+    // from the first and last segments' encoders
+    unsigned char  tag[MAX_TAG_LEN];
+    int            tag_len;
+    int            padding;
+
+    // work queue
+    pthread_mutex_t mutex;
+    int            next_seg;
+    bool           error;
+} transcode_t;
+
+//
+// prototypes
+//
+
+static lame_global_flags *transcode_lame_init(transcode_t *tc, int out_sample_rate, bool write_tag, int holdoff);
+static void *transcode_thread(void *cx);
+static int encode_segment(transcode_t *tc, int k);
+static int frame_len(unsigned char *p, long avail);
+static void update_tag(transcode_t *tc, long stream_len);
+static unsigned short crc16(unsigned short crc, unsigned char *p, long n);
+static void put_i4(unsigned char *p, unsigned int v);
+static void put_i2(unsigned char *p, unsigned int v);
+
+// -----------------  TRANSCODE  ---------------------------
+
+int util_mp3_transcode(char *dir, char *raw_fn, char *mp3_fn, int sample_rate, int channels,
+                       int bitrate_kbps, int num_threads)
+{
+    transcode_t       *tc;
+    lame_global_flags *gfp;
+    pthread_t          threads[MAX_THREADS];
+    char               path[200];
+    struct stat        statbuf;
+    void              *addr = MAP_FAILED;
+    long               file_len = 0, total_frames, stream_len;
+    int                fd, i, rc = -1, out_frame_samples;
+
+    // map the raw input file
+    sprintf(path, "%s%s%s", (dir ? dir : ""), (dir ? "/" : ""), raw_fn);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("failed to open '%s', %s\n", path, strerror(errno));
+        return -1;
+    }
+    fstat(fd, &statbuf);
+    file_len = statbuf.st_size;
+    if (channels < 1 || channels > 2 || file_len < 2 * channels) {
+        ERROR("invalid input '%s', channels=%d len=%ld\n", path, channels, file_len);
+        close(fd);
+        return -1;
+    }
+    addr = mmap(NULL, file_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        ERROR("failed to map '%s', %s\n", path, strerror(errno));
+        return -1;
+    }
+    madvise(addr, file_len, MADV_SEQUENTIAL);
+
+    tc = calloc(1, sizeof(transcode_t));
+    if (tc == NULL) {
+        ERROR("failed to allocate transcode\n");
+        munmap(addr, file_len);
+        return -1;
+    }
+    tc->pcm             = addr;
+    tc->total_samples   = file_len / (2 * channels);
+    tc->channels        = channels;
+    tc->in_sample_rate  = sample_rate;
+    tc->bitrate_kbps    = bitrate_kbps;
+    pthread_mutex_init(&tc->mutex, NULL);
+
+    // let lame choose the output sample rate for the bitrate, and
+    // get the mp3 frame size
+    gfp = transcode_lame_init(tc, 0, false, 0);
+    if (gfp == NULL) {
+        goto done;
+    }
+    tc->out_sample_rate = lame_get_out_samplerate(gfp);
+    out_frame_samples = lame_get_framesize(gfp);
+    lame_close(gfp);
+
+    // determine the number of threads and segments
+    if (num_threads <= 0) {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    if ((long)out_frame_samples * tc->in_sample_rate % tc->out_sample_rate == 0) {
+        tc->frame_samples = (long)out_frame_samples * tc->in_sample_rate / tc->out_sample_rate;
+        total_frames = (tc->total_samples + tc->frame_samples - 1) / tc->frame_samples;
+        tc->seg_frames = (total_frames + num_threads * SEGS_PER_THREAD - 1) / (num_threads * SEGS_PER_THREAD);
+        if (tc->seg_frames < SEG_MIN_FRAMES) tc->seg_frames = SEG_MIN_FRAMES;
+        if (num_threads == 1) tc->seg_frames = total_frames;
+        tc->num_segs = (total_frames + tc->seg_frames - 1) / tc->seg_frames;
+    } else {
+        tc->frame_samples = 0;
+        tc->num_segs = 1;
+    }
+    if (num_threads > tc->num_segs) {
+        num_threads = tc->num_segs;
+    }
+    INFO("'%s': %ld samples, %d segments, %d threads\n", path, tc->total_samples, tc->num_segs, num_threads);
+
+    tc->segs = calloc(tc->num_segs, sizeof(segment_t));
+    if (tc->segs == NULL) {
+        ERROR("failed to allocate segments\n");
+        goto done;
+    }
+
+    // encode the segments
+    for (i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, transcode_thread, tc);
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (tc->error) {
+        goto done;
+    }
+
+    // update the header frame for the whole stream, unless it came from the
+    // only encoder; and write it followed by the segments' frames
+    if (tc->num_segs > 1) {
+        stream_len = tc->tag_len;
+        for (i = 0; i < tc->num_segs; i++) {
+            stream_len += tc->segs[i].len;
+        }
+        update_tag(tc, stream_len);
+    }
+
+    sprintf(path, "%s%s%s", (dir ? dir : ""), (dir ? "/" : ""), mp3_fn);
+    fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0) {
+        ERROR("failed to create '%s', %s\n", path, strerror(errno));
+        goto done;
+    }
+    if (write(fd, tc->tag, tc->tag_len) != tc->tag_len) {
+        ERROR("failed to write '%s', %s\n", path, strerror(errno));
+        close(fd);
+        goto done;
+    }
+    for (i = 0; i < tc->num_segs; i++) {
+        if (write(fd, tc->segs[i].data, tc->segs[i].len) != tc->segs[i].len) {
+            ERROR("failed to write '%s', %s\n", path, strerror(errno));
+            close(fd);
+            goto done;
+        }
+    }
+    close(fd);
+    rc = 0;
+
+done:
+    // cleanup and return
+    if (tc->segs != NULL) {
+        for (i = 0; i < tc->num_segs; i++) {
+            free(tc->segs[i].data);
+        }
+        free(tc->segs);
+    }
+    pthread_mutex_destroy(&tc->mutex);
+    free(tc);
+    munmap(addr, file_len);
+    return rc;
+}
+
+static lame_global_flags *transcode_lame_init(transcode_t *tc, int out_sample_rate, bool write_tag, int holdoff)
+{
+    lame_global_flags *gfp;
+
+    gfp = lame_init();
+    if (gfp == NULL) {
+        ERROR("lame_init failed\n");
+        return NULL;
+    }
+
+    lame_set_num_channels(gfp, tc->channels);
+    lame_set_in_samplerate(gfp, tc->in_sample_rate);
+    lame_set_out_samplerate(gfp, out_sample_rate);
+    lame_set_brate(gfp, tc->bitrate_kbps);
+    lame_set_mode(gfp, tc->channels == 1 ? MONO : JOINT_STEREO);
+    lame_set_quality(gfp, 2);   // 2=high  5 = medium  7=low
+    lame_set_bWriteVbrTag(gfp, write_tag);
+    lame_set_reservoir_holdoff(gfp, holdoff);
+
+    if (lame_init_params(gfp) == -1) {
+        ERROR("lame_init_params failed, bitrate=%d sample_rate=%d\n", tc->bitrate_kbps, tc->in_sample_rate);
+        lame_close(gfp);
+        return NULL;
+    }
+
+    return gfp;
+}
+
+static void *transcode_thread(void *cx)
+{
+    transcode_t *tc = cx;
+    int k;
+
+    while (true) {
+        pthread_mutex_lock(&tc->mutex);
+        k = (tc->error ? tc->num_segs : tc->next_seg++);
+        pthread_mutex_unlock(&tc->mutex);
+        if (k >= tc->num_segs) {
+            break;
+        }
+
+        if (encode_segment(tc, k) < 0) {
+            pthread_mutex_lock(&tc->mutex);
+            tc->error = true;
+            pthread_mutex_unlock(&tc->mutex);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// - - - - - - - - -  ENCODE SEGMENT  - - - - - - - - - - -
+
+static int encode_segment(transcode_t *tc, int k)
+{
+    segment_t         *seg = &tc->segs[k];
+    lame_global_flags *gfp;
+    bool               first = (k == 0);
+    bool               last  = (k == tc->num_segs - 1);
+    int                preroll = (first ? 0 : SEG_PREROLL_FRAMES);
+    long               start, end, i, n, len, max_len, off;
+    int                skip, keep, cnt, frames;
+    unsigned char     *buf, *tmp;
+
+    // the range of input samples to encode: from the preroll before the
+    // segment, to the postroll after it, or to the end of the input
+    if (tc->num_segs == 1) {
+        start = 0;
+        end = tc->total_samples;
+    } else {
+        start = ((long)k * tc->seg_frames - preroll) * tc->frame_samples;
+        end = ((long)(k + 1) * tc->seg_frames + SEG_POSTROLL_FRAMES) * tc->frame_samples;
+        if (last || end > tc->total_samples) end = tc->total_samples;
+    }
+
+    gfp = transcode_lame_init(tc, tc->out_sample_rate, first, preroll);
+    if (gfp == NULL) {
+        return -1;
+    }
+
+    // encode, the output buffer is grown as needed
+    max_len = (end - start) * tc->bitrate_kbps * 125L / tc->in_sample_rate + 65536;
+    buf = malloc(max_len);
+    len = 0;
+    for (i = start; buf != NULL && i < end; i += n) {
+        n = (end - i < ENC_BLOCK_SAMPLES ? end - i : ENC_BLOCK_SAMPLES);
+        if (max_len - len < ENC_BLOCK_SAMPLES * 5 / 4 + 7200) {
+            max_len *= 2;
+            tmp = realloc(buf, max_len);
+            if (tmp == NULL) break;
+            buf = tmp;
+        }
+        if (tc->channels == 1) {
+            cnt = lame_encode_buffer(gfp, tc->pcm + i, NULL, n, buf + len, max_len - len);
+        } else {
+            cnt = lame_encode_buffer_interleaved(gfp, tc->pcm + 2 * i, n, buf + len, max_len - len);
+        }
+        if (cnt < 0) {
+            ERROR("lame_encode_buffer failed, segment %d, rc=%d\n", k, cnt);
+            goto error;
+        }
+        len += cnt;
+    }
+    if (buf == NULL || i < end || max_len - len < 7200) {
+        ERROR("failed to allocate output buffer, segment %d\n", k);
+        goto error;
+    }
+    cnt = lame_encode_flush(gfp, buf + len, max_len - len);
+    if (cnt < 0) {
+        ERROR("lame_encode_flush failed, segment %d, rc=%d\n", k, cnt);
+        goto error;
+    }
+    len += cnt;
+
+    // the first segment's encoder provides the header frame, and
+    // the last segment's encoder provides the padding
+    if (first) {
+        tc->tag_len = lame_get_lametag_frame(gfp, tc->tag, sizeof(tc->tag));
+        if (tc->tag_len <= 0 || tc->tag_len > MAX_TAG_LEN) {
+            ERROR("failed to get header frame\n");
+            goto error;
+        }
+    }
+    if (last) {
+        tc->padding = lame_get_encoder_padding(gfp);
+    }
+
+    // keep the segment's frames, skipping the header frame and the preroll
+    // frames, and the postroll frames unless this is the last segment
+    skip = preroll + (first ? 1 : 0);
+    keep = (last ? len : tc->seg_frames);
+    off = 0;
+    for (frames = 0; frames < skip && (n = frame_len(buf + off, len - off)) > 0; frames++) {
+        off += n;
+    }
+    seg->data = buf;
+    seg->len = 0;
+    seg->frames = 0;
+    while (seg->frames < keep && (n = frame_len(buf + off + seg->len, len - off - seg->len)) > 0) {
+        seg->len += n;
+        seg->frames++;
+    }
+    if (frames != skip || (!last && seg->frames != keep) || (last && off + seg->len != len)) {
+        ERROR("unexpected frames in segment %d, skipped=%d kept=%d\n", k, frames, seg->frames);
+        seg->data = NULL;
+        goto error;
+    }
+    memmove(buf, buf + off, seg->len);
+
+    lame_close(gfp);
+    return 0;
+
+error:
+    free(buf);
+    lame_close(gfp);
+    return -1;
+}
+
+// returns the length of the layer 3 frame at p, or -1
+static int frame_len(unsigned char *p, long avail)
+{
+    static const int kbps_tbl[2][16] = {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },   // mpeg 1
+        { 0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160, 0 } }; // mpeg 2 and 2.5
+    static const int rate_tbl[4] = { 44100, 48000, 32000, 0 };
+    int version, layer, kbps, rate, padding;
+
+    if (avail < 4 || p[0] != 0xff || (p[1] & 0xe0) != 0xe0) {
+        return -1;
+    }
+    version = (p[1] >> 3) & 3;   // 3=mpeg1  2=mpeg2  0=mpeg2.5
+    layer   = (p[1] >> 1) & 3;   // 1=layer3
+    kbps    = kbps_tbl[version != 3][p[2] >> 4];
+    rate    = rate_tbl[(p[2] >> 2) & 3] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    padding = (p[2] >> 1) & 1;
+    if (version == 1 || layer != 1 || kbps == 0 || rate == 0) {
+        return -1;
+    }
+
+    return (version == 3 ? 144000 : 72000) * kbps / rate + padding;
+}
+
+// - - - - - - - - -  HEADER FRAME  - - - - - - - - - - - -
+
+static void update_tag(transcode_t *tc, long stream_len)
+{
+    unsigned char *t = NULL, *p;
+    unsigned short crc = 0;
+    long total_frames = 0, frame, offset, audio_len = stream_len - tc->tag_len;
+    int i, k, n;
+
+    for (i = 0; i < 64; i++) {
+        if (memcmp(tc->tag + i, "Info", 4) == 0 || memcmp(tc->tag + i, "Xing", 4) == 0) {
+            t = tc->tag + i;
+            break;
+        }
+    }
+    if (t == NULL) {
+        ERROR("header frame id not found\n");
+        return;
+    }
+
+    for (k = 0; k < tc->num_segs; k++) {
+        total_frames += tc->segs[k].frames;
+    }
+
+    // the seek table has the byte position, scaled to 0..255, of each percent
+    // of the frames; and the music crc is of all the frames
+    k = 0;
+    frame = 0;
+    offset = 0;
+    p = tc->segs[0].data;
+    for (i = 0; i < 100; i++) {
+        long target = total_frames * i / 100;
+        while (frame < target) {
+            n = frame_len(p, tc->segs[k].data + tc->segs[k].len - p);
+            if (n < 0) {
+                k++;
+                p = tc->segs[k].data;
+                continue;
+            }
+            p += n;
+            offset += n;
+            frame++;
+        }
+        n = 256 * offset / audio_len;
+        t[TAG_TOC + i] = (n > 255 ? 255 : n);
+    }
+    for (k = 0; k < tc->num_segs; k++) {
+        crc = crc16(crc, tc->segs[k].data, tc->segs[k].len);
+    }
+
+    put_i4(t + TAG_FRAMES, total_frames);
+    put_i4(t + TAG_BYTES, stream_len);
+    t[TAG_DELAY_PADDING + 1] = (t[TAG_DELAY_PADDING + 1] & 0xf0) | ((tc->padding >> 8) & 0x0f);
+    t[TAG_DELAY_PADDING + 2] = tc->padding & 0xff;
+    put_i4(t + TAG_MUSIC_LENGTH, stream_len);
+    put_i2(t + TAG_MUSIC_CRC, crc);
+    put_i2(t + TAG_CRC, crc16(0, tc->tag, t + TAG_CRC - tc->tag));
+}
+
+// crc-16 as used by the LAME header, polynomial 0x8005 bit reversed
+static unsigned short crc16(unsigned short crc, unsigned char *p, long n)
+{
+    int i;
+
+    while (n-- > 0) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 1 ? (crc >> 1) ^ 0xa001 : crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void put_i4(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void put_i2(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
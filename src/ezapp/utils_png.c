@@ -0,0 +1,604 @@
+#include <std_hdrs.h>
+
+#include <utils.h>
+#include <logging.h>
+
+#include <lodepng/lodepng.h>
+
+// Parallel encoding of 32-bit RGBA png files, such as screenshots.
+//
+// The image is split into bands of rows, which are filtered, and then
+// deflated, by a pool of threads. Each band is deflated by lodepng_deflate_part
+// with the end of the previous band's filtered rows as its history, and all
+// but the last band end with a sync flush; so the bands' deflate data join to
+// form the single zlib stream of the png, which is compressed about as well
+// as by a single thread.
+//
+// Each band's deflate data is written as its own IDAT chunk, whose crc is
+// computed by the band's thread. The zlib header is at the start of the first
+// band's chunk, and the adler32 of the stream, combined from the adler32s of
+// the bands, is in a final 4 byte IDAT chunk.
+//
+// Filters are chosen as lodepng does by default: for each row, the filter with
+// the minimum sum of the absolute values of the filtered bytes. In fast mode
+// one filter is chosen for each band, from a sample of its rows, and deflate
+// uses a smaller window and no lazy matching.
+//
+// An image that is fully opaque, as screenshots are, is written as RGB.
+
+//
+// defines
+//
+
+#define BAND_MIN_ROWS        16
+#define BANDS_PER_THREAD     4     // so the threads finish at about the same time
+#define MAX_THREADS          64
+
+#define FAST_SAMPLE_ROWS     8     // rows sampled to choose a band's filter
+#define FAST_WINDOWSIZE      512
+#define FAST_NICEMATCH       32
+
+#define NUM_FILTERS          5
+
+#define ADLER_BASE           65521
+#define ADLER_NMAX           5552  // max bytes before the sums can overflow
+
+//
+// typedefs
+//
+
+typedef struct {
+    unsigned char *idat;        // the band's IDAT chunk
+    size_t         idat_len;
+    unsigned int   adler;       // adler32 of the band's filtered rows
+} band_t;
+
+typedef struct png_encode_s {
+    // input
+    unsigned char *pixels;
+    int            w;
+    int            h;
+    bool           fast;
+
+    // output format
+    int            bpp;             // 3 if the image is opaque, else 4
+    size_t         line_len;        // filter type byte and the row's bytes
+
+    // bands
+    unsigned char *filtered;        // all the filtered rows
+    int            band_rows;
+    int            num_bands;
+    band_t        *bands;
+    LodePNGCompressSettings settings;
+
+    // work queue
+    int          (*proc)(struct png_encode_s *pe, int k);
+    pthread_mutex_t mutex;
+    int            next_band;
+    bool           error;
+} png_encode_t;
+
+typedef struct {
+    char           path[200];
+    unsigned char *pixels;
+    int            w;
+    int            h;
+    bool           fast;
+} write_async_t;
+
+//
+// prototypes
+//
+
+static void run_threads(png_encode_t *pe, int num_threads, int (*proc)(png_encode_t *pe, int k));
+static void *encode_thread(void *cx);
+static int filter_band(png_encode_t *pe, int k);
+static int deflate_band(png_encode_t *pe, int k);
+static unsigned char *get_row(png_encode_t *pe, int y, unsigned char *buf);
+static void filter_row(unsigned char *out, unsigned char *row, unsigned char *prev, int len, int bpp, int type);
+static unsigned long filter_cost(unsigned char *out, int len);
+static bool is_opaque(unsigned char *pixels, int w, int h);
+static unsigned int adler32(unsigned int adler, unsigned char *p, size_t n);
+static unsigned int adler32_combine(unsigned int adler1, unsigned int adler2, size_t len2);
+static int write_all(int fd, unsigned char *p, size_t len);
+static void *write_async_thread(void *cx);
+static void put_u32(unsigned char *p, unsigned int v);
+
+//
+// variables
+//
+
+static unsigned int tmp_seq;    // makes the temp file names unique
+
+// -----------------  ENCODE  ------------------------------
+
+int util_write_png_file_ex(char *dir, char *filename, unsigned char *pixels, int w, int h,
+                           bool fast, int num_threads)
+{
+    png_encode_t  *pe;
+    char           path[200], tmp_path[260];
+    unsigned char  ihdr[13], adler[4];
+    unsigned char *head = NULL, *tail = NULL;
+    size_t         head_len = 0, tail_len = 0;
+    unsigned int   stream_adler;
+    int            fd, i, rc = -1;
+
+    sprintf(path, "%s%s%s", (dir ? dir : ""), (dir ? "/" : ""), filename);
+    if (w <= 0 || h <= 0) {
+        ERROR("invalid image size for '%s', w=%d h=%d\n", path, w, h);
+        return -1;
+    }
+
+    pe = calloc(1, sizeof(png_encode_t));
+    if (pe == NULL) {
+        ERROR("failed to allocate png encode\n");
+        return -1;
+    }
+    pe->pixels   = pixels;
+    pe->w        = w;
+    pe->h        = h;
+    pe->fast     = fast;
+    pe->bpp      = (is_opaque(pixels, w, h) ? 3 : 4);
+    pe->line_len = 1 + (size_t)w * pe->bpp;
+    pthread_mutex_init(&pe->mutex, NULL);
+
+    lodepng_compress_settings_init(&pe->settings);
+    if (fast) {
+        pe->settings.windowsize   = FAST_WINDOWSIZE;
+        pe->settings.nicematch    = FAST_NICEMATCH;
+        pe->settings.lazymatching = 0;
+    }
+
+    // determine the number of threads and bands
+    if (num_threads <= 0) {
+        num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    pe->band_rows = (h + num_threads * BANDS_PER_THREAD - 1) / (num_threads * BANDS_PER_THREAD);
+    if (pe->band_rows < BAND_MIN_ROWS) pe->band_rows = BAND_MIN_ROWS;
+    if (num_threads == 1) pe->band_rows = h;
+    pe->num_bands = (h + pe->band_rows - 1) / pe->band_rows;
+    if (num_threads > pe->num_bands) {
+        num_threads = pe->num_bands;
+    }
+    INFO("writing png file %s, %dx%d %s%s, %d bands, %d threads\n",
+         path, w, h, (pe->bpp == 3 ? "RGB" : "RGBA"), (fast ? " fast" : ""), pe->num_bands, num_threads);
+
+    pe->filtered = malloc(pe->line_len * h);
+    pe->bands = calloc(pe->num_bands, sizeof(band_t));
+    if (pe->filtered == NULL || pe->bands == NULL) {
+        ERROR("failed to allocate %dx%d png encode buffers\n", w, h);
+        goto done;
+    }
+
+    // filter all of the bands, and then deflate them; the deflate of a band
+    // needs the end of the previous band's filtered rows
+    run_threads(pe, num_threads, filter_band);
+    if (!pe->error) {
+        run_threads(pe, num_threads, deflate_band);
+    }
+    if (pe->error) {
+        goto done;
+    }
+
+    // the png signature and IHDR chunk precede the bands' IDAT chunks; and
+    // the stream's adler32 IDAT chunk and the IEND chunk follow them
+    head = malloc(8);
+    if (head == NULL) {
+        ERROR("failed to allocate png header\n");
+        goto done;
+    }
+    memcpy(head, "\x89PNG\r\n\x1a\n", 8);
+    head_len = 8;
+    put_u32(ihdr+0, w);
+    put_u32(ihdr+4, h);
+    ihdr[8]  = 8;                         // bit depth
+    ihdr[9]  = (pe->bpp == 3 ? 2 : 6);    // color type, RGB or RGBA
+    ihdr[10] = 0;                         // compression method
+    ihdr[11] = 0;                         // filter method
+    ihdr[12] = 0;                         // interlace method
+
+    stream_adler = pe->bands[0].adler;
+    for (i = 1; i < pe->num_bands; i++) {
+        size_t band_len = (size_t)((i == pe->num_bands-1) ? h - i * pe->band_rows : pe->band_rows) * pe->line_len;
+        stream_adler = adler32_combine(stream_adler, pe->bands[i].adler, band_len);
+    }
+    put_u32(adler, stream_adler);
+
+    if (lodepng_chunk_create(&head, &head_len, sizeof(ihdr), "IHDR", ihdr) != 0 ||
+        lodepng_chunk_create(&tail, &tail_len, sizeof(adler), "IDAT", adler) != 0 ||
+        lodepng_chunk_create(&tail, &tail_len, 0, "IEND", NULL) != 0)
+    {
+        ERROR("failed to create png chunks\n");
+        goto done;
+    }
+
+    // write to a temp file that is renamed when complete, so that a reader
+    // never sees a partially written png; the temp file name is unique, so
+    // that concurrent writes of the same png do not write the same temp file
+    sprintf(tmp_path, "%s.%d.%u.tmp", path, getpid(), 
+            __atomic_fetch_add(&tmp_seq, 1, __ATOMIC_RELAXED));
+    fd = open(tmp_path, O_WRONLY|O_CREAT|O_EXCL, 0666);
+    if (fd < 0) {
+        ERROR("failed to create '%s', %s\n", tmp_path, strerror(errno));
+        goto done;
+    }
+    rc = write_all(fd, head, head_len);
+    for (i = 0; rc == 0 && i < pe->num_bands; i++) {
+        rc = write_all(fd, pe->bands[i].idat, pe->bands[i].idat_len);
+    }
+    if (rc == 0) {
+        rc = write_all(fd, tail, tail_len);
+    }
+    close(fd);
+    if (rc == 0 && rename(tmp_path, path) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        ERROR("failed to write '%s', %s\n", path, strerror(errno));
+        unlink(tmp_path);
+    }
+
+done:
+    // cleanup and return
+    if (pe->bands != NULL) {
+        for (i = 0; i < pe->num_bands; i++) {
+            free(pe->bands[i].idat);
+        }
+        free(pe->bands);
+    }
+    free(pe->filtered);
+    free(head);
+    free(tail);
+    pthread_mutex_destroy(&pe->mutex);
+    free(pe);
+    return rc;
+}
+
+// the calling thread also encodes bands, so all bands are encoded
+// even if none of the threads can be created
+static void run_threads(png_encode_t *pe, int num_threads, int (*proc)(png_encode_t *pe, int k))
+{
+    pthread_t threads[MAX_THREADS];
+    int       i, max_threads = 0;
+
+    pe->proc = proc;
+    pe->next_band = 0;
+    for (i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[max_threads], NULL, encode_thread, pe) != 0) {
+            WARN("pthread_create failed, using %d threads\n", max_threads+1);
+            break;
+        }
+        max_threads++;
+    }
+    encode_thread(pe);
+    for (i = 0; i < max_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void *encode_thread(void *cx)
+{
+    png_encode_t *pe = cx;
+    int k;
+
+    while (true) {
+        pthread_mutex_lock(&pe->mutex);
+        k = (pe->error ? pe->num_bands : pe->next_band++);
+        pthread_mutex_unlock(&pe->mutex);
+        if (k >= pe->num_bands) {
+            break;
+        }
+
+        if (pe->proc(pe, k) < 0) {
+            pthread_mutex_lock(&pe->mutex);
+            pe->error = true;
+            pthread_mutex_unlock(&pe->mutex);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// - - - - - - - - -  FILTER BAND - - - - - - - - - - - - -
+
+static int filter_band(png_encode_t *pe, int k)
+{
+    int            y_start = k * pe->band_rows;
+    int            y_end   = (k == pe->num_bands-1 ? pe->h : y_start + pe->band_rows);
+    int            len     = pe->line_len - 1;
+    unsigned char *buf, *row_buf[2], *attempt[NUM_FILTERS], *row, *prev, *out;
+    unsigned long  cost, best_cost, costs[NUM_FILTERS];
+    int            y, t, best, step;
+
+    // buffers for 2 rows converted to RGB, a zero row, and the filter attempts
+    buf = calloc(3 + NUM_FILTERS, pe->line_len);
+    if (buf == NULL) {
+        ERROR("failed to allocate filter buffers, band %d\n", k);
+        return -1;
+    }
+    row_buf[0] = buf;
+    row_buf[1] = buf + pe->line_len;
+    for (t = 0; t < NUM_FILTERS; t++) {
+        attempt[t] = buf + (3 + t) * pe->line_len;
+    }
+
+    // in fast mode, choose the band's filter from a sample of its rows
+    best = -1;
+    if (pe->fast) {
+        memset(costs, 0, sizeof(costs));
+        step = (y_end - y_start + FAST_SAMPLE_ROWS - 1) / FAST_SAMPLE_ROWS;
+        for (y = y_start; y < y_end; y += step) {
+            row = get_row(pe, y, row_buf[0]);
+            prev = (y > 0 ? get_row(pe, y-1, row_buf[1]) : buf + 2 * pe->line_len);
+            for (t = 0; t < NUM_FILTERS; t++) {
+                filter_row(attempt[t], row, prev, len, pe->bpp, t);
+                costs[t] += filter_cost(attempt[t], len);
+            }
+        }
+        best = 0;
+        for (t = 1; t < NUM_FILTERS; t++) {
+            if (costs[t] < costs[best]) best = t;
+        }
+    }
+
+    // filter the rows, choosing each row's filter unless in fast mode; the
+    // converted rows alternate between the row buffers, starting with the first
+    prev = (y_start > 0 ? get_row(pe, y_start-1, row_buf[1]) : buf + 2 * pe->line_len);
+    for (y = y_start; y < y_end; y++) {
+        row = get_row(pe, y, row_buf[(y - y_start) & 1]);
+        out = pe->filtered + (size_t)y * pe->line_len;
+        if (best >= 0) {
+            filter_row(out, row, prev, len, pe->bpp, best);
+        } else {
+            best_cost = ULONG_MAX;
+            for (t = 0; t < NUM_FILTERS; t++) {
+                filter_row(attempt[t], row, prev, len, pe->bpp, t);
+                cost = filter_cost(attempt[t], len);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    memcpy(out, attempt[t], pe->line_len);
+                }
+            }
+        }
+        prev = row;
+    }
+
+    free(buf);
+    return 0;
+}
+
+// returns row y of the image, converted to RGB in buf if the image is opaque
+static unsigned char *get_row(png_encode_t *pe, int y, unsigned char *buf)
+{
+    unsigned char *p = pe->pixels + (size_t)y * pe->w * 4;
+    int x;
+
+    if (pe->bpp == 4) {
+        return p;
+    }
+    for (x = 0; x < pe->w; x++) {
+        buf[3*x+0] = p[4*x+0];
+        buf[3*x+1] = p[4*x+1];
+        buf[3*x+2] = p[4*x+2];
+    }
+    return buf;
+}
+
+// out gets the filter type followed by the len filtered bytes of the row
+static void filter_row(unsigned char *out, unsigned char *row, unsigned char *prev, int len, int bpp, int type)
+{
+    int i, a, b, c, p, pa, pb, pc;
+
+    *out++ = type;
+    switch (type) {
+    case 0:  // none
+        memcpy(out, row, len);
+        break;
+    case 1:  // sub
+        memcpy(out, row, bpp);
+        for (i = bpp; i < len; i++) out[i] = row[i] - row[i-bpp];
+        break;
+    case 2:  // up
+        for (i = 0; i < len; i++) out[i] = row[i] - prev[i];
+        break;
+    case 3:  // average
+        for (i = 0; i < bpp; i++) out[i] = row[i] - (prev[i] >> 1);
+        for (i = bpp; i < len; i++) out[i] = row[i] - ((row[i-bpp] + prev[i]) >> 1);
+        break;
+    case 4:  // paeth
+        for (i = 0; i < len; i++) {
+            a = (i >= bpp ? row[i-bpp] : 0);
+            b = prev[i];
+            c = (i >= bpp ? prev[i-bpp] : 0);
+            p = a + b - c;
+            pa = abs(p - a);
+            pb = abs(p - b);
+            pc = abs(p - c);
+            out[i] = row[i] - (pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+        }
+        break;
+    }
+}
+
+// the sum of the absolute values of the filtered bytes, as signed bytes
+static unsigned long filter_cost(unsigned char *out, int len)
+{
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 1; i <= len; i++) {
+        sum += (out[i] < 128 ? out[i] : 256 - out[i]);
+    }
+    return sum;
+}
+
+static bool is_opaque(unsigned char *pixels, int w, int h)
+{
+    size_t i, n = (size_t)w * h * 4;
+
+    for (i = 3; i < n; i += 4) {
+        if (pixels[i] != 255) return false;
+    }
+    return true;
+}
+
+// - - - - - - - - -  DEFLATE BAND  - - - - - - - - - - - -
+
+static int deflate_band(png_encode_t *pe, int k)
+{
+    band_t        *band = &pe->bands[k];
+    bool           first = (k == 0);
+    bool           last  = (k == pe->num_bands - 1);
+    size_t         start = (size_t)k * pe->band_rows * pe->line_len;
+    size_t         end   = (last ? (size_t)pe->h * pe->line_len : start + pe->band_rows * pe->line_len);
+    unsigned char *out;
+    size_t         out_len;
+    int            rc;
+
+    // the chunk starts with its length and type, which are filled in below,
+    // and the first band's chunk starts with the zlib header: deflate with a
+    // 32K window, and no preset dictionary
+    out_len = (first ? 10 : 8);
+    out = malloc(out_len);
+    if (out == NULL) {
+        ERROR("failed to allocate chunk, band %d\n", k);
+        return -1;
+    }
+    if (first) {
+        out[8] = 0x78;
+        out[9] = 0x01;
+    }
+
+    // deflate the band, with the filtered rows before it as history
+    rc = lodepng_deflate_part(&out, &out_len, pe->filtered, start, end, last, &pe->settings);
+    if (rc == 0) {
+        unsigned char *tmp = realloc(out, out_len + 4);
+        if (tmp == NULL) rc = 83;
+        else out = tmp;
+    }
+    if (rc != 0) {
+        ERROR("lodepng_deflate_part failed, band %d, %s\n", k, lodepng_error_text(rc));
+        free(out);
+        return -1;
+    }
+
+    // complete the chunk, its crc follows the data
+    put_u32(out, out_len - 8);
+    memcpy(out+4, "IDAT", 4);
+    lodepng_chunk_generate_crc(out);
+
+    band->idat = out;
+    band->idat_len = out_len + 4;
+    band->adler = adler32(1, pe->filtered + start, end - start);
+    return 0;
+}
+
+// - - - - - - - - -  ADLER32 - - - - - - - - - - - - - - -
+
+static unsigned int adler32(unsigned int adler, unsigned char *p, size_t n)
+{
+    unsigned int s1 = adler & 0xffff;
+    unsigned int s2 = adler >> 16;
+    size_t cnt;
+
+    while (n > 0) {
+        cnt = (n > ADLER_NMAX ? ADLER_NMAX : n);
+        n -= cnt;
+        while (cnt-- > 0) {
+            s1 += *p++;
+            s2 += s1;
+        }
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+    return (s2 << 16) | s1;
+}
+
+// returns the adler32 of the concatenation of two buffers, from their adler32s
+// and the length of the second, as zlib's adler32_combine
+static unsigned int adler32_combine(unsigned int adler1, unsigned int adler2, size_t len2)
+{
+    unsigned int rem = len2 % ADLER_BASE;
+    unsigned int s1 = adler1 & 0xffff;
+    unsigned int s2 = (unsigned int)(((unsigned long)rem * s1) % ADLER_BASE);
+
+    s1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+    s2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if (s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if (s1 >= ADLER_BASE) s1 -= ADLER_BASE;
+    if (s2 >= 2 * ADLER_BASE) s2 -= 2 * ADLER_BASE;
+    if (s2 >= ADLER_BASE) s2 -= ADLER_BASE;
+    return (s2 << 16) | s1;
+}
+
+// - - - - - - - - -  WRITE - - - - - - - - - - - - - - - -
+
+static int write_all(int fd, unsigned char *p, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int util_write_png_file_async(char *dir, char *filename, unsigned char *pixels, int w, int h, bool fast)
+{
+    write_async_t *wa;
+    pthread_t      tid;
+
+    wa = calloc(1, sizeof(write_async_t));
+    if (wa == NULL) {
+        ERROR("failed to allocate async png write\n");
+        free(pixels);
+        return -1;
+    }
+    sprintf(wa->path, "%s%s%s", (dir ? dir : ""), (dir ? "/" : ""), filename);
+    wa->pixels = pixels;
+    wa->w      = w;
+    wa->h      = h;
+    wa->fast   = fast;
+
+    if (pthread_create(&tid, NULL, write_async_thread, wa) != 0) {
+        ERROR("failed to create async png write thread\n");
+        free(pixels);
+        free(wa);
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+static void *write_async_thread(void *cx)
+{
+    write_async_t *wa = cx;
+    int num_threads;
+
+    // leave a cpu for the render thread
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (num_threads < 1) num_threads = 1;
+
+    util_write_png_file_ex(NULL, wa->path, wa->pixels, wa->w, wa->h, wa->fast, num_threads);
+
+    free(wa->pixels);
+    free(wa);
+    return NULL;
+}
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
@@ -0,0 +1,921 @@
+#include <std_hdrs.h>
+
+#include <utils.h>
+#include <logging.h>
+
+// Time series store.
+//
+// A store is a directory of segment files, seg_<segno>, each a header followed
+// by a fixed number of fixed size record slots, mapped shared. Records are
+// appended in timestamp order, the timestamp being a long at the start of
+// each record, in whatever unit the caller uses. So the records are sorted,
+// and a time range is found by a binary search over the segments' first
+// timestamps and then within a segment; the segments are the index.
+//
+// An append writes the record and its trailer, a checksum of the record and
+// its slot, and then increments the segment header's count, so a reader, in
+// this or another process, never sees a partly written record. Full segments
+// are synced when the next segment is started; util_ts_sync syncs the records
+// appended since. When a store is opened for writing, the last segment's
+// records are checked, and the count is set to the valid records that
+// precede the first invalid one; this recovers the records written before a
+// crash whose count update was lost, and drops a torn record.
+//
+// The policy, set by util_ts_set_policy, is applied when a segment is
+// started:
+// - segments older than downsample_age are rewritten keeping the first record
+//   of each downsample_interval
+// - segments older than max_age are deleted, and the oldest segments are
+//   deleted while the other segments hold at least max_records
+//
+// A store opened read only follows the writer: the segments' counts are read
+// from the shared mappings, and the directory is rescanned when its mtime
+// changes, that is when the writer starts, rewrites or deletes a segment.
+
+//
+// defines
+//
+
+#define SEG_MAGIC             0x53544d45   // "EMTS"
+#define SEG_VERSION           1
+#define SEG_HDR_SIZE          64
+#define DEFAULT_SEG_BYTES     (1024*1024)
+#define MIN_SEG_RECORDS       64
+#define MAX_RECORD_SIZE       65536
+
+#define TS(seg,i)             (*(long*)((seg)->base + SEG_HDR_SIZE + (long)(i) * (seg)->slot_size))
+#define SLOT(seg,i)           ((seg)->base + SEG_HDR_SIZE + (long)(i) * (seg)->slot_size)
+
+//
+// typedefs
+//
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t slot_size;           // record_size plus the trailer, rounded up to 8
+    uint32_t capacity;
+    uint32_t count;               // records appended, updated after the record
+    int64_t  downsample_interval; // non zero if the segment has been downsampled
+    int64_t  created_ns;          // distinguishes a segment from one it replaced
+    char     pad[SEG_HDR_SIZE-40];
+} seg_hdr_t;
+
+typedef struct {
+    uint32_t check;               // checksum of the record, segno and index
+    uint32_t pad;
+} trailer_t;
+
+typedef struct {
+    long       segno;
+    ino_t      ino;
+    char      *base;
+    size_t     map_len;
+    seg_hdr_t *hdr;
+    int        slot_size;
+    int        capacity;
+    int        synced;            // records synced, writer only
+} segment_t;
+
+struct util_ts {
+    pthread_mutex_t mutex;
+    char            path[300];
+    bool            read_only;
+    int             record_size;
+    int             slot_size;
+    int             seg_records;
+
+    segment_t      *segs;
+    int             max_segs;
+    int             alloced_segs;
+    struct timespec dir_mtime;
+
+    long            max_age;
+    long            max_records;
+    long            downsample_age;
+    long            downsample_interval;
+};
+
+//
+// prototypes
+//
+
+static int scan_segments(util_ts_t *ts);
+static int map_segment(util_ts_t *ts, long segno, segment_t *seg);
+static void unmap_segment(segment_t *seg);
+static int new_segment(util_ts_t *ts);
+static void recover_tail(util_ts_t *ts);
+static void refresh(util_ts_t *ts);
+static void apply_policy(util_ts_t *ts);
+static int downsample_segment(util_ts_t *ts, segment_t *seg, long interval);
+static void delete_segment(util_ts_t *ts, int idx);
+static void drop_segment(util_ts_t *ts, int idx);
+
+static uint32_t slot_check(segment_t *seg, int idx, int record_size);
+static int seg_count(segment_t *seg);
+static long lower_bound(util_ts_t *ts, long t, int *seg_idx);
+static int copy_range(util_ts_t *ts, int s, long i, long t_end, long interval, void *records, int max);
+
+// -----------------  OPEN / CLOSE  ------------------------
+
+// segment_records is the number of records in each segment file, 0 for about
+// 1MB segments; a store that exists keeps its segments' size
+util_ts_t *util_ts_open(char *dir, char *name, int record_size, int segment_records, bool read_only)
+{
+    util_ts_t *ts;
+
+    if (record_size < (int)sizeof(long) || record_size > MAX_RECORD_SIZE) {
+        ERROR("invalid record_size %d\n", record_size);
+        return NULL;
+    }
+
+    ts = calloc(1, sizeof(util_ts_t));
+    if (ts == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&ts->mutex, NULL);
+    snprintf(ts->path, sizeof(ts->path), "%s/%s", dir, name);
+    ts->read_only   = read_only;
+    ts->record_size = record_size;
+    ts->slot_size   = (record_size + sizeof(trailer_t) + 7) & ~7;
+    ts->seg_records = (segment_records > 0 ? segment_records :
+                       (DEFAULT_SEG_BYTES - SEG_HDR_SIZE) / ts->slot_size);
+    if (ts->seg_records < MIN_SEG_RECORDS) {
+        ts->seg_records = MIN_SEG_RECORDS;
+    }
+
+    // a reader opens a store that does not exist yet as empty, and finds its
+    // segments when the writer creates them
+    if (!read_only && mkdir(ts->path, 0777) < 0 && errno != EEXIST) {
+        ERROR("failed to create %s, %s\n", ts->path, strerror(errno));
+        free(ts);
+        return NULL;
+    }
+
+    if (scan_segments(ts) < 0) {
+        util_ts_close(ts);
+        return NULL;
+    }
+    if (!read_only) {
+        recover_tail(ts);
+    }
+
+    // the segments that are started keep the size of the existing ones
+    if (ts->max_segs > 0) {
+        ts->seg_records = ts->segs[ts->max_segs-1].capacity;
+    }
+
+    INFO("opened %s, %d segments, %ld records\n", ts->path, ts->max_segs, util_ts_count(ts));
+    return ts;
+}
+
+void util_ts_close(util_ts_t *ts)
+{
+    int i;
+
+    if (ts == NULL) {
+        return;
+    }
+
+    if (!ts->read_only) {
+        util_ts_sync(ts);
+    }
+    for (i = 0; i < ts->max_segs; i++) {
+        unmap_segment(&ts->segs[i]);
+    }
+    free(ts->segs);
+    pthread_mutex_destroy(&ts->mutex);
+    free(ts);
+}
+
+// 0 disables a limit; the ages and interval are in the timestamps' unit
+void util_ts_set_policy(util_ts_t *ts, long max_age, long max_records,
+                        long downsample_age, long downsample_interval)
+{
+    pthread_mutex_lock(&ts->mutex);
+    ts->max_age             = max_age;
+    ts->max_records         = max_records;
+    ts->downsample_age      = downsample_age;
+    ts->downsample_interval = downsample_interval;
+    pthread_mutex_unlock(&ts->mutex);
+}
+
+// -----------------  APPEND  ------------------------------
+
+// the record starts with its timestamp, which must not be less than the
+// timestamp of the last record; returns -1 on error
+int util_ts_append(util_ts_t *ts, void *record)
+{
+    segment_t *seg;
+    long       t = *(long*)record;
+    int        i, n, rc = -1;
+    trailer_t *trailer;
+
+    if (ts->read_only) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&ts->mutex);
+
+    // the timestamps must be in order; the last record is in the last
+    // segment that is not empty, the segment after it may have just started
+    for (i = ts->max_segs-1; i >= 0; i--) {
+        seg = &ts->segs[i];
+        n = seg->hdr->count;
+        if (n == 0) {
+            continue;
+        }
+        if (t < TS(seg, n-1)) {
+            ERROR("%s: timestamp %ld is before the last %ld\n", ts->path, t, TS(seg, n-1));
+            goto done;
+        }
+        break;
+    }
+
+    // start a segment if there is none, or the last is full
+    if (ts->max_segs == 0 || ts->segs[ts->max_segs-1].hdr->count == ts->segs[ts->max_segs-1].capacity) {
+        if (new_segment(ts) < 0) {
+            goto done;
+        }
+    }
+
+    // write the record and its trailer, and then the count
+    seg = &ts->segs[ts->max_segs-1];
+    n = seg->hdr->count;
+    memcpy(SLOT(seg, n), record, ts->record_size);
+    trailer = (trailer_t*)(SLOT(seg, n) + seg->slot_size - sizeof(trailer_t));
+    trailer->check = slot_check(seg, n, ts->record_size);
+    __atomic_store_n(&seg->hdr->count, n+1, __ATOMIC_RELEASE);
+    rc = 0;
+
+done:
+    pthread_mutex_unlock(&ts->mutex);
+    return rc;
+}
+
+// syncs the records appended since the last sync
+int util_ts_sync(util_ts_t *ts)
+{
+    segment_t *seg;
+    long       start, end, page = getpagesize();
+    int        rc = 0;
+
+    pthread_mutex_lock(&ts->mutex);
+    if (!ts->read_only && ts->max_segs > 0) {
+        seg = &ts->segs[ts->max_segs-1];
+        if (seg->synced < (int)seg->hdr->count) {
+            start = (SEG_HDR_SIZE + (long)seg->synced * seg->slot_size) & ~(page-1);
+            end = SEG_HDR_SIZE + (long)seg->hdr->count * seg->slot_size;
+            // the records, and then the header with the count
+            rc = msync(seg->base + start, end - start, MS_SYNC);
+            if (rc == 0 && start != 0) {
+                rc = msync(seg->base, SEG_HDR_SIZE, MS_SYNC);
+            }
+            if (rc == 0) {
+                seg->synced = seg->hdr->count;
+            } else {
+                ERROR("%s: msync failed, %s\n", ts->path, strerror(errno));
+            }
+        }
+    }
+    pthread_mutex_unlock(&ts->mutex);
+    return rc;
+}
+
+// deletes all the records
+int util_ts_clear(util_ts_t *ts)
+{
+    if (ts->read_only) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&ts->mutex);
+    while (ts->max_segs > 0) {
+        delete_segment(ts, 0);
+    }
+    pthread_mutex_unlock(&ts->mutex);
+    return 0;
+}
+
+// -----------------  QUERY  -------------------------------
+
+long util_ts_count(util_ts_t *ts)
+{
+    long count = 0;
+    int  i;
+
+    pthread_mutex_lock(&ts->mutex);
+    refresh(ts);
+    for (i = 0; i < ts->max_segs; i++) {
+        count += seg_count(&ts->segs[i]);
+    }
+    pthread_mutex_unlock(&ts->mutex);
+    return count;
+}
+
+// copies the records with t_start <= timestamp <= t_end, oldest first, up to
+// max; returns the number copied
+int util_ts_query(util_ts_t *ts, long t_start, long t_end, void *records, int max)
+{
+    return util_ts_query_downsample(ts, t_start, t_end, 0, records, max);
+}
+
+// as util_ts_query, but copies only the first record of each interval,
+// starting at t_start
+int util_ts_query_downsample(util_ts_t *ts, long t_start, long t_end, long interval,
+                             void *records, int max)
+{
+    long i;
+    int  s, n = 0;
+
+    if (max <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ts->mutex);
+    refresh(ts);
+    i = lower_bound(ts, t_start, &s);
+    if (i >= 0) {
+        n = copy_range(ts, s, i, t_end, interval, records, max);
+    }
+    pthread_mutex_unlock(&ts->mutex);
+    return n;
+}
+
+// copies the most recent records, up to max, oldest first; returns the
+// number copied
+int util_ts_latest(util_ts_t *ts, void *records, int max)
+{
+    int  s, n = 0, cnt;
+    long i = 0;
+
+    if (max <= 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ts->mutex);
+    refresh(ts);
+
+    // find the segment and index of the first record to copy
+    for (s = ts->max_segs-1; s >= 0; s--) {
+        cnt = seg_count(&ts->segs[s]);
+        if (n + cnt >= max) {
+            i = cnt - (max - n);
+            break;
+        }
+        n += cnt;
+    }
+    if (s < 0) {
+        s = 0;
+        i = 0;
+    }
+
+    n = (ts->max_segs > 0 ? copy_range(ts, s, i, LONG_MAX, 0, records, max) : 0);
+    pthread_mutex_unlock(&ts->mutex);
+    return n;
+}
+
+// returns the index in segment *seg_idx of the first record with timestamp
+// >= t, or -1 if there is none
+static long lower_bound(util_ts_t *ts, long t, int *seg_idx)
+{
+    int  lo, hi, mid, s, cnt;
+    segment_t *seg;
+
+    // the last segment whose first timestamp is < t; the record may be in it,
+    // or be the first of the next
+    lo = 0;
+    hi = ts->max_segs;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (seg_count(&ts->segs[mid]) > 0 && TS(&ts->segs[mid], 0) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    s = (lo > 0 ? lo - 1 : 0);
+
+    for (; s < ts->max_segs; s++) {
+        seg = &ts->segs[s];
+        cnt = seg_count(seg);
+        lo = 0;
+        hi = cnt;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (TS(seg, mid) < t) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < cnt) {
+            *seg_idx = s;
+            return lo;
+        }
+    }
+    return -1;
+}
+
+static int copy_range(util_ts_t *ts, int s, long i, long t_end, long interval, void *records, int max)
+{
+    segment_t *seg;
+    char      *dst = records;
+    long       t, next_t;
+    int        n = 0, cnt, s2;
+
+    while (n < max && s < ts->max_segs) {
+        seg = &ts->segs[s];
+        cnt = seg_count(seg);
+        if (i >= cnt) {
+            s++;
+            i = 0;
+            continue;
+        }
+
+        t = TS(seg, i);
+        if (t > t_end) {
+            break;
+        }
+        memcpy(dst, SLOT(seg, i), ts->record_size);
+        dst += ts->record_size;
+        n++;
+
+        if (interval <= 0) {
+            i++;
+            continue;
+        }
+
+        // skip to the first record of the next interval
+        next_t = t + interval;
+        if (next_t < t) {
+            break;
+        }
+        i = lower_bound(ts, next_t, &s2);
+        if (i < 0) {
+            break;
+        }
+        s = s2;
+    }
+    return n;
+}
+
+static int seg_count(segment_t *seg)
+{
+    int count = __atomic_load_n(&seg->hdr->count, __ATOMIC_ACQUIRE);
+
+    return count <= seg->capacity ? count : seg->capacity;
+}
+
+// -----------------  SEGMENTS  ----------------------------
+
+static int segno_cmp(const void *a, const void *b)
+{
+    long x = *(long*)a, y = *(long*)b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// returns the created_ns in a segment file's header, or -1
+static int64_t segment_created_ns(char *path)
+{
+    seg_hdr_t hdr;
+    int       fd;
+    bool      ok;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ok = (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr));
+    close(fd);
+    return ok ? hdr.created_ns : -1;
+}
+
+// maps the directory's segments, in segno order, keeping the segments that
+// are already mapped and unchanged
+static int scan_segments(util_ts_t *ts)
+{
+    DIR           *dir;
+    struct dirent *de;
+    struct stat    st;
+    long          *segnos = NULL, segno, *x;
+    int            max_segnos = 0, alloced = 0, i, j;
+    segment_t     *segs;
+    char           path[400];
+
+    if (stat(ts->path, &st) < 0) {
+        // a reader's store that does not exist yet
+        return ts->read_only ? 0 : -1;
+    }
+    ts->dir_mtime = st.st_mtim;
+
+    dir = opendir(ts->path);
+    if (dir == NULL) {
+        ERROR("failed to open %s, %s\n", ts->path, strerror(errno));
+        return -1;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (sscanf(de->d_name, "seg_%ld", &segno) != 1) {
+            continue;
+        }
+        if (max_segnos == alloced) {
+            alloced = (alloced ? 2 * alloced : 64);
+            x = realloc(segnos, alloced * sizeof(long));
+            if (x == NULL) {
+                closedir(dir);
+                free(segnos);
+                return -1;
+            }
+            segnos = x;
+        }
+        segnos[max_segnos++] = segno;
+    }
+    closedir(dir);
+    if (max_segnos > 0) {
+        qsort(segnos, max_segnos, sizeof(long), segno_cmp);
+    }
+
+    segs = calloc(max_segnos + 1, sizeof(segment_t));
+    if (segs == NULL) {
+        free(segnos);
+        return -1;
+    }
+
+    // keep the mapped segments whose file is unchanged, map the others
+    j = 0;
+    for (i = 0; i < max_segnos; i++) {
+        while (j < ts->max_segs && ts->segs[j].segno < segnos[i]) {
+            unmap_segment(&ts->segs[j++]);
+        }
+        if (j < ts->max_segs && ts->segs[j].segno == segnos[i]) {
+            sprintf(path, "%s/seg_%010ld", ts->path, segnos[i]);
+            if (stat(path, &st) == 0 && st.st_ino == ts->segs[j].ino &&
+                segment_created_ns(path) == ts->segs[j].hdr->created_ns)
+            {
+                segs[i] = ts->segs[j++];
+                continue;
+            }
+            unmap_segment(&ts->segs[j++]);
+        }
+        if (map_segment(ts, segnos[i], &segs[i]) < 0) {
+            // a segment that is not valid is left out
+            segs[i].base = NULL;
+        }
+    }
+    while (j < ts->max_segs) {
+        unmap_segment(&ts->segs[j++]);
+    }
+
+    // remove the segments that failed to map
+    for (i = j = 0; i < max_segnos; i++) {
+        if (segs[i].base != NULL) {
+            segs[j++] = segs[i];
+        }
+    }
+
+    free(ts->segs);
+    ts->segs = segs;
+    ts->max_segs = j;
+    ts->alloced_segs = max_segnos + 1;
+    free(segnos);
+    return 0;
+}
+
+// a reader rescans the directory when the writer has changed it
+static void refresh(util_ts_t *ts)
+{
+    struct stat st;
+
+    if (!ts->read_only) {
+        return;
+    }
+    if (stat(ts->path, &st) < 0) {
+        return;
+    }
+    if (st.st_mtim.tv_sec != ts->dir_mtime.tv_sec || st.st_mtim.tv_nsec != ts->dir_mtime.tv_nsec) {
+        scan_segments(ts);
+    }
+}
+
+static int map_segment(util_ts_t *ts, long segno, segment_t *seg)
+{
+    char        path[400];
+    int         fd;
+    struct stat st;
+    seg_hdr_t   hdr;
+
+    sprintf(path, "%s/seg_%010ld", ts->path, segno);
+    fd = open(path, ts->read_only ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
+        ERROR("failed to open %s, %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < SEG_HDR_SIZE ||
+        pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+    {
+        ERROR("failed to read %s header\n", path);
+        close(fd);
+        return -1;
+    }
+    if (hdr.magic != SEG_MAGIC || hdr.version != SEG_VERSION ||
+        hdr.record_size != ts->record_size || hdr.slot_size != ts->slot_size ||
+        st.st_size < SEG_HDR_SIZE + (long)hdr.capacity * hdr.slot_size)
+    {
+        ERROR("%s: invalid segment, or record_size is not %d\n", path, ts->record_size);
+        close(fd);
+        return -1;
+    }
+
+    memset(seg, 0, sizeof(segment_t));
+    seg->segno     = segno;
+    seg->ino       = st.st_ino;
+    seg->map_len   = SEG_HDR_SIZE + (size_t)hdr.capacity * hdr.slot_size;
+    seg->slot_size = hdr.slot_size;
+    seg->capacity  = hdr.capacity;
+    seg->base = mmap(NULL, seg->map_len, ts->read_only ? PROT_READ : PROT_READ|PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg->base == MAP_FAILED) {
+        ERROR("mmap %s failed, %s\n", path, strerror(errno));
+        seg->base = NULL;
+        return -1;
+    }
+    seg->hdr = (seg_hdr_t*)seg->base;
+    seg->synced = seg->hdr->count;
+    return 0;
+}
+
+static void unmap_segment(segment_t *seg)
+{
+    if (seg->base != NULL) {
+        munmap(seg->base, seg->map_len);
+        seg->base = NULL;
+    }
+}
+
+// syncs the last segment, and starts a new one; the policy is then applied
+static int new_segment(util_ts_t *ts)
+{
+    char       path[400], tmp_path[400];
+    int        fd;
+    long       segno;
+    struct timespec now;
+    size_t     len;
+    seg_hdr_t  hdr;
+    segment_t *x;
+
+    if (ts->max_segs > 0) {
+        x = &ts->segs[ts->max_segs-1];
+        msync(x->base, x->map_len, MS_SYNC);
+        x->synced = x->hdr->count;
+    }
+
+    if (ts->max_segs == ts->alloced_segs) {
+        x = realloc(ts->segs, (ts->alloced_segs + 16) * sizeof(segment_t));
+        if (x == NULL) {
+            return -1;
+        }
+        ts->segs = x;
+        ts->alloced_segs += 16;
+    }
+
+    // the segment is initialized as a tmp file, and renamed, so that a reader
+    // does not find it before it is valid
+    segno = (ts->max_segs > 0 ? ts->segs[ts->max_segs-1].segno + 1 : 0);
+    sprintf(path, "%s/seg_%010ld", ts->path, segno);
+    sprintf(tmp_path, "%s/tmp_%010ld", ts->path, segno);
+    fd = open(tmp_path, O_CREAT|O_TRUNC|O_RDWR, 0666);
+    if (fd < 0) {
+        ERROR("failed to create %s, %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic       = SEG_MAGIC;
+    hdr.version     = SEG_VERSION;
+    hdr.record_size = ts->record_size;
+    hdr.slot_size   = ts->slot_size;
+    hdr.capacity    = ts->seg_records;
+    clock_gettime(CLOCK_REALTIME, &now);
+    hdr.created_ns  = now.tv_sec * 1000000000L + now.tv_nsec;
+    len = SEG_HDR_SIZE + (size_t)hdr.capacity * hdr.slot_size;
+    if (ftruncate(fd, len) < 0 || pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || fsync(fd) < 0) {
+        ERROR("failed to initialize %s, %s\n", tmp_path, strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, path) < 0) {
+        ERROR("failed to rename %s, %s\n", tmp_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+
+    if (map_segment(ts, segno, &ts->segs[ts->max_segs]) < 0) {
+        unlink(path);
+        return -1;
+    }
+    ts->max_segs++;
+
+    apply_policy(ts);
+    return 0;
+}
+
+// sets the last segment's count to the number of valid records preceding
+// the first that is not
+static void recover_tail(util_ts_t *ts)
+{
+    segment_t *seg;
+    trailer_t *trailer;
+    int        i;
+
+    if (ts->max_segs == 0) {
+        return;
+    }
+
+    seg = &ts->segs[ts->max_segs-1];
+    for (i = 0; i < seg->capacity; i++) {
+        trailer = (trailer_t*)(SLOT(seg, i) + seg->slot_size - sizeof(trailer_t));
+        if (trailer->check != slot_check(seg, i, ts->record_size) ||
+            (i > 0 && TS(seg, i) < TS(seg, i-1)))
+        {
+            break;
+        }
+    }
+
+    if (i != (int)seg->hdr->count) {
+        WARN("%s: recovered segment %ld count %d, was %d\n",
+             ts->path, seg->segno, i, seg->hdr->count);
+        seg->hdr->count = i;
+        msync(seg->base, seg->map_len, MS_SYNC);
+    }
+    seg->synced = i;
+}
+
+static uint32_t slot_check(segment_t *seg, int idx, int record_size)
+{
+    unsigned char *p = (unsigned char*)SLOT(seg, idx);
+    uint32_t       h = 2166136261u;
+    int            i;
+
+    // the slot's position is included, so a zeroed or stale slot is not valid
+    h = (h ^ (uint32_t)seg->segno) * 16777619u;
+    h = (h ^ (uint32_t)idx) * 16777619u;
+    for (i = 0; i < record_size; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h ? h : 1;
+}
+
+// -----------------  POLICY  ------------------------------
+
+static void apply_policy(util_ts_t *ts)
+{
+    segment_t *seg;
+    long       newest, total;
+    int        i;
+
+    // the newest timestamp is in the segment before the one just started
+    if (ts->max_segs < 2) {
+        return;
+    }
+    seg = &ts->segs[ts->max_segs-2];
+    if (seg->hdr->count == 0) {
+        return;
+    }
+    newest = TS(seg, seg->hdr->count-1);
+
+    // delete the segments older than max_age, and the oldest segments while
+    // the others hold max_records
+    if (ts->max_age > 0) {
+        while (ts->max_segs > 1 && ts->segs[0].hdr->count > 0 &&
+               TS(&ts->segs[0], ts->segs[0].hdr->count-1) < newest - ts->max_age)
+        {
+            delete_segment(ts, 0);
+        }
+    }
+    if (ts->max_records > 0) {
+        total = 0;
+        for (i = 0; i < ts->max_segs; i++) {
+            total += ts->segs[i].hdr->count;
+        }
+        while (ts->max_segs > 1 && total - ts->segs[0].hdr->count >= ts->max_records) {
+            total -= ts->segs[0].hdr->count;
+            delete_segment(ts, 0);
+        }
+    }
+
+    // downsample the full segments older than downsample_age
+    if (ts->downsample_age > 0 && ts->downsample_interval > 0) {
+        for (i = 0; i < ts->max_segs - 1; i++) {
+            seg = &ts->segs[i];
+            if (seg->hdr->count == 0 ||
+                seg->hdr->downsample_interval >= ts->downsample_interval ||
+                TS(seg, seg->hdr->count-1) >= newest - ts->downsample_age)
+            {
+                continue;
+            }
+            if (downsample_segment(ts, seg, ts->downsample_interval) < 0) {
+                break;
+            }
+        }
+    }
+}
+
+// rewrites a segment keeping the first record of each interval; the new file
+// replaces the segment by rename, so a reader's mapping stays valid
+static int downsample_segment(util_ts_t *ts, segment_t *seg, long interval)
+{
+    int        idx = seg - ts->segs;
+    char       path[400], tmp_path[400];
+    int        fd, i, n, count = seg->hdr->count;
+    long       next_t;
+    char      *buf;
+    size_t     len;
+    seg_hdr_t *hdr;
+    segment_t  new_seg;
+    trailer_t *trailer;
+
+    // the records are built in memory, in a buffer sized for all of them
+    len = SEG_HDR_SIZE + (size_t)count * seg->slot_size;
+    buf = calloc(1, len);
+    if (buf == NULL) {
+        return -1;
+    }
+    memset(&new_seg, 0, sizeof(new_seg));
+    new_seg.segno     = seg->segno;
+    new_seg.base      = buf;
+    new_seg.slot_size = seg->slot_size;
+
+    n = 0;
+    next_t = LONG_MIN;
+    for (i = 0; i < count; i++) {
+        if (TS(seg, i) < next_t) {
+            continue;
+        }
+        next_t = TS(seg, i) + interval;
+        memcpy(SLOT(&new_seg, n), SLOT(seg, i), ts->record_size);
+        trailer = (trailer_t*)(SLOT(&new_seg, n) + seg->slot_size - sizeof(trailer_t));
+        trailer->check = slot_check(&new_seg, n, ts->record_size);
+        n++;
+    }
+
+    hdr = (seg_hdr_t*)buf;
+    *hdr = *seg->hdr;
+    hdr->capacity = n;
+    hdr->count = n;
+    hdr->downsample_interval = interval;
+    len = SEG_HDR_SIZE + (size_t)n * seg->slot_size;
+
+    sprintf(path, "%s/seg_%010ld", ts->path, seg->segno);
+    sprintf(tmp_path, "%s/tmp_%010ld", ts->path, seg->segno);
+    fd = open(tmp_path, O_CREAT|O_TRUNC|O_WRONLY, 0666);
+    if (fd < 0 || write(fd, buf, len) != (ssize_t)len || fsync(fd) < 0) {
+        ERROR("failed to write %s, %s\n", tmp_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(tmp_path);
+        free(buf);
+        return -1;
+    }
+    close(fd);
+    free(buf);
+
+    if (rename(tmp_path, path) < 0) {
+        ERROR("failed to rename %s, %s\n", tmp_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+
+    unmap_segment(seg);
+    if (map_segment(ts, new_seg.segno, seg) < 0) {
+        // the segment is left out until the store is reopened
+        drop_segment(ts, idx);
+        return -1;
+    }
+    INFO("%s: downsampled segment %ld from %d to %d records\n", ts->path, seg->segno, count, n);
+    return 0;
+}
+
+static void delete_segment(util_ts_t *ts, int idx)
+{
+    char path[400];
+
+    sprintf(path, "%s/seg_%010ld", ts->path, ts->segs[idx].segno);
+    if (unlink(path) < 0) {
+        ERROR("failed to delete %s, %s\n", path, strerror(errno));
+    }
+    drop_segment(ts, idx);
+}
+
+// removes a segment from the handle, leaving the file
+static void drop_segment(util_ts_t *ts, int idx)
+{
+    unmap_segment(&ts->segs[idx]);
+    memmove(&ts->segs[idx], &ts->segs[idx+1], (ts->max_segs - idx - 1) * sizeof(segment_t));
+    ts->max_segs--;
+}
@@ -123,7 +123,8 @@ typedef enum preset_mode_e {
 typedef enum asm_optimizations_e {
     MMX = 1,
     AMD_3DNOW = 2,
-    SSE = 3
+    SSE = 3,
+    NEON = 4
 } asm_optimizations;
 
 
@@ -400,6 +401,12 @@ int CDECL lame_get_strict_ISO(const lame_global_flags *);
 int CDECL lame_set_disable_reservoir(lame_global_flags *, int);
 int CDECL lame_get_disable_reservoir(const lame_global_flags *);
 
+/* don't use the bit reservoir in the first n frames, so that frame n has
+   main_data_begin = 0 and can follow the frames of another encoder, for
+   encoding a stream in segments. default=0 */
+int CDECL lame_set_reservoir_holdoff(lame_global_flags *, int);
+int CDECL lame_get_reservoir_holdoff(const lame_global_flags *);
+
 /* select a different "best quantization" function. default=0  */
 int CDECL lame_set_quant_comp(lame_global_flags *, int);
 int CDECL lame_get_quant_comp(const lame_global_flags *);
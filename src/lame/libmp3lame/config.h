@@ -125,7 +125,7 @@
 #define HAVE_MEMORY_H 1
 
 /* build with mpglib support */
-//#define HAVE_MPGLIB 1   // EZAPP commented this out
+#define HAVE_MPGLIB 1   // EZAPP enabled, mpglib is used for mp3 playback
 
 /* have nasm */
 /* #undef HAVE_NASM */
@@ -201,6 +201,12 @@
 /* Define to 1 if you have the <xmmintrin.h> header file. */
 //#define HAVE_XMMINTRIN_H 1   // EZAPP commented this out
 
+/* Define to 1 to use the NEON intrinsics in vector/neon_quantize_sub.c,
+   they need the AArch64 double precision lanes */
+#if defined(__aarch64__) && defined(__ARM_NEON)   // EZAPP added
+#define HAVE_ARM_NEON_H 1
+#endif
+
 /* Define as const if the declaration of iconv() needs const. */
 #define ICONV_CONST 
 
@@ -325,5 +325,10 @@ init_fft(lame_internal_flags * const gfc)
     gfc->fft_fht = fht_SSE2;
 #endif
 #endif
+#ifdef HAVE_ARM_NEON_H
+    if (gfc->CPU_features.NEON) {
+        gfc->fft_fht = fht_NEON;
+    }
+#endif
 #endif
 }
@@ -578,6 +578,11 @@ lame_init_params(lame_global_flags * gfp)
         gfc->CPU_features.SSE2 = 0;
     }
 
+    if (gfp->asm_optimizations.neon)
+        gfc->CPU_features.NEON = has_NEON();
+    else
+        gfc->CPU_features.NEON = 0;
+
 
     if (NULL == gfc->ATH)
         gfc->ATH = calloc(1, sizeof(ATH_t));
@@ -823,6 +828,7 @@ lame_init_params(lame_global_flags * gfp)
 #endif
 
     cfg->disable_reservoir = gfp->disable_reservoir;
+    cfg->reservoir_holdoff = gfp->reservoir_holdoff;
     cfg->lowpassfreq = gfp->lowpassfreq;
     cfg->highpassfreq = gfp->highpassfreq;
     cfg->samplerate_in = gfp->samplerate_in;
@@ -1334,7 +1340,8 @@ lame_print_config(const lame_global_flags * gfp)
     MSGF(gfc, "warning: alpha versions should be used for testing only\n");
 #endif
     if (gfc->CPU_features.MMX
-        || gfc->CPU_features.AMD_3DNow || gfc->CPU_features.SSE || gfc->CPU_features.SSE2) {
+        || gfc->CPU_features.AMD_3DNow || gfc->CPU_features.SSE || gfc->CPU_features.SSE2
+        || gfc->CPU_features.NEON) {
         char    text[256] = { 0 };
         int     fft_asm_used = 0;
 #ifdef HAVE_NASM
@@ -1371,6 +1378,9 @@ lame_print_config(const lame_global_flags * gfp)
         if (gfc->CPU_features.SSE2) {
             concatSep(text, ", ", (fft_asm_used == 3) ? "SSE2 (ASM used)" : "SSE2");
         }
+        if (gfc->CPU_features.NEON) {
+            concatSep(text, ", ", "NEON (ASM used)");
+        }
         MSGF(gfc, "CPU features: %s\n", text);
     }
 
@@ -2403,6 +2413,7 @@ lame_init_old(lame_global_flags * gfp)
     gfp->asm_optimizations.mmx = 1;
     gfp->asm_optimizations.amd3dnow = 1;
     gfp->asm_optimizations.sse = 1;
+    gfp->asm_optimizations.neon = 1;
 
     gfp->preset = 0;
 
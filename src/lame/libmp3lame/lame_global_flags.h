@@ -89,6 +89,7 @@ struct lame_global_struct {
     int     strict_ISO;      /* enforce ISO spec as much as possible   */
 
     int     disable_reservoir; /* use bit reservoir?                     */
+    int     reservoir_holdoff; /* frames that don't use the reservoir    */
 
     /* quantization/noise shaping */
     int     quant_comp;
@@ -175,6 +176,7 @@ struct lame_global_struct {
         int     mmx;
         int     amd3dnow;
         int     sse;
+        int     neon;
 
     } asm_optimizations;
 };
@@ -37,7 +37,7 @@
 #include "bitstream.h"
 #include "vbrquantize.h"
 #include "quantize.h"
-#ifdef HAVE_XMMINTRIN_H
+#if defined(HAVE_XMMINTRIN_H) || defined(HAVE_ARM_NEON_H)
 #include "vector/lame_intrin.h"
 #endif
 
@@ -98,6 +98,10 @@ init_xrpow_core_init(lame_internal_flags * const gfc)
     if (gfc->CPU_features.SSE)
         gfc->init_xrpow_core = init_xrpow_core_sse;
 #endif
+#if defined(HAVE_ARM_NEON_H)
+    if (gfc->CPU_features.NEON)
+        gfc->init_xrpow_core = init_xrpow_core_neon;
+#endif
 #ifndef HAVE_NASM
 #ifdef MIN_ARCH_SSE
     gfc->init_xrpow_core = init_xrpow_core_sse;
@@ -145,6 +145,10 @@ ResvFrameBegin(lame_internal_flags * gfc, int *mean_bits)
         esv->ResvMax = resvLimit;
     if (esv->ResvMax < 0 || cfg->disable_reservoir)
         esv->ResvMax = 0;
+    /* during the holdoff the reservoir is drained at the end of each
+       frame, so the first frame after it has main_data_begin = 0 */
+    if (gfc->ov_enc.frame_number < cfg->reservoir_holdoff)
+        esv->ResvMax = 0;
     
     fullFrameBits = meanBits * cfg->mode_gr + Min(esv->ResvSize, esv->ResvMax);
 
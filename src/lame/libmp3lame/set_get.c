@@ -958,6 +958,29 @@ lame_get_disable_reservoir(const lame_global_flags * gfp)
     return 0;
 }
 
+/* Don't use the bit reservoir in the first n frames. */
+int
+lame_set_reservoir_holdoff(lame_global_flags * gfp, int reservoir_holdoff)
+{
+    if (is_lame_global_flags_valid(gfp)) {
+        /* default = 0 */
+        if (0 > reservoir_holdoff)
+            return -1;
+        gfp->reservoir_holdoff = reservoir_holdoff;
+        return 0;
+    }
+    return -1;
+}
+
+int
+lame_get_reservoir_holdoff(const lame_global_flags * gfp)
+{
+    if (is_lame_global_flags_valid(gfp)) {
+        return gfp->reservoir_holdoff;
+    }
+    return 0;
+}
+
 
 
 
@@ -2185,6 +2208,10 @@ lame_set_asm_optimizations(lame_global_flags * gfp, int optim, int mode)
                 gfp->asm_optimizations.sse = mode;
                 return optim;
             }
+        case NEON:{
+                gfp->asm_optimizations.neon = mode;
+                return optim;
+            }
         default:
             return optim;
         }
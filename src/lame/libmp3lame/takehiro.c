@@ -33,6 +33,9 @@
 #include "util.h"
 #include "quantize_pvt.h"
 #include "tables.h"
+#ifdef HAVE_ARM_NEON_H
+#include "vector/lame_intrin.h"
+#endif
 
 
 static const struct {
@@ -279,7 +282,8 @@ quantize_lines_xrpow(unsigned int l, FLOAT istep, const FLOAT * xr, int *ix)
  *********************************************************************/
 
 static void
-quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_info,
+quantize_xrpow(lame_internal_flags const *const gfc,
+               const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_info,
                calc_noise_data const *prev_noise)
 {
     /* quantize on xr^(3/4) instead of xr */
@@ -324,11 +328,11 @@ quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_
             /* do not recompute this part,
                but compute accumulated lines */
             if (accumulate) {
-                quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
+                gfc->quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
                 accumulate = 0;
             }
             if (accumulate01) {
-                quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
+                gfc->quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
                 accumulate01 = 0;
             }
         }
@@ -363,7 +367,7 @@ quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_
                 prev_noise->step[sfb] > 0 && step >= prev_noise->step[sfb]) {
 
                 if (accumulate) {
-                    quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
+                    gfc->quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
                     accumulate = 0;
                     acc_iData = iData;
                     acc_xp = xp;
@@ -372,7 +376,7 @@ quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_
             }
             else {
                 if (accumulate01) {
-                    quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
+                    gfc->quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
                     accumulate01 = 0;
                     acc_iData = iData;
                     acc_xp = xp;
@@ -385,11 +389,11 @@ quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_
                  *  may happen due to "prev_data_use" optimization 
                  */
                 if (accumulate01) {
-                    quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
+                    gfc->quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
                     accumulate01 = 0;
                 }
                 if (accumulate) {
-                    quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
+                    gfc->quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
                     accumulate = 0;
                 }
 
@@ -403,11 +407,11 @@ quantize_xrpow(const FLOAT * xp, int *pi, FLOAT istep, gr_info const *const cod_
         }
     }
     if (accumulate) {   /*last data part */
-        quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
+        gfc->quantize_lines_xrpow(accumulate, istep, acc_xp, acc_iData);
         accumulate = 0;
     }
     if (accumulate01) { /*last data part */
-        quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
+        gfc->quantize_lines_xrpow_01(accumulate01, istep, acc_xp, acc_iData);
         accumulate01 = 0;
     }
 
@@ -615,13 +619,11 @@ static count_fnc count_fncs[] =
 , &count_bit_noESC_from3
 };
 
-static int
-choose_table_nonMMX(const int *ix, const int *const end, int *const _s)
+static inline int
+choose_table_max(const int *ix, const int *const end, int *const _s, unsigned int max)
 {
     unsigned int* s = (unsigned int*)_s;
-    unsigned int  max;
     int     choice, choice2;
-    max = ix_max(ix, end);
 
     if (max <= 15) {
       return count_fncs[max](ix, end, max, s);
@@ -646,6 +648,20 @@ choose_table_nonMMX(const int *ix, const int *const end, int *const _s)
     return count_bit_ESC(ix, end, choice, choice2, s);
 }
 
+static int
+choose_table_nonMMX(const int *ix, const int *const end, int *const s)
+{
+    return choose_table_max(ix, end, s, ix_max(ix, end));
+}
+
+#ifdef HAVE_ARM_NEON_H
+static int
+choose_table_NEON(const int *ix, const int *const end, int *const s)
+{
+    return choose_table_max(ix, end, s, ix_max_neon(ix, end));
+}
+#endif
+
 
 
 /*************************************************************************/
@@ -776,7 +792,7 @@ count_bits(lame_internal_flags const *const gfc,
     if (gi->xrpow_max > w)
         return LARGE_BITS;
 
-    quantize_xrpow(xr, ix, IPOW20(gi->global_gain), gi, prev_noise);
+    quantize_xrpow(gfc, xr, ix, IPOW20(gi->global_gain), gi, prev_noise);
 
     if (gfc->sv_qnt.substep_shaping & 2) {
         int     sfb, j = 0;
@@ -1337,12 +1353,23 @@ huffman_init(lame_internal_flags * const gfc)
     int     i;
 
     gfc->choose_table = choose_table_nonMMX;
+    gfc->quantize_lines_xrpow = quantize_lines_xrpow;
+    gfc->quantize_lines_xrpow_01 = quantize_lines_xrpow_01;
 
 #ifdef MMX_choose_table
     if (gfc->CPU_features.MMX) {
         gfc->choose_table = choose_table_MMX;
     }
 #endif
+#ifdef HAVE_ARM_NEON_H
+    if (gfc->CPU_features.NEON) {
+        gfc->choose_table = choose_table_NEON;
+#ifdef TAKEHIRO_IEEE754_HACK
+        gfc->quantize_lines_xrpow = quantize_lines_xrpow_neon;
+#endif
+        gfc->quantize_lines_xrpow_01 = quantize_lines_xrpow_01_neon;
+    }
+#endif
 
     for (i = 2; i <= 576; i += 2) {
         int     scfb_anz = 0, bv_index;
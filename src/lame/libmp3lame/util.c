@@ -821,6 +821,16 @@ has_SSE2(void)
 #endif
 }
 
+int
+has_NEON(void)
+{
+#if defined(HAVE_ARM_NEON_H)
+    return 1;           /* NEON is part of the AArch64 base architecture */
+#else
+    return 0;
+#endif
+}
+
 void
 disable_FPE(void)
 {
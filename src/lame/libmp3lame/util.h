@@ -413,6 +413,7 @@ extern  "C" {
         int     decode_on_the_fly; /* decode on the fly? default=0                */
         int     analysis;
         int     disable_reservoir;
+        int     reservoir_holdoff;
         int     buffer_constraint;  /* enforce ISO spec as much as possible   */
         int     free_format;
         int     write_lame_tag; /* add Xing VBR tag?                           */
@@ -520,7 +521,8 @@ extern  "C" {
             unsigned int AMD_3DNow:1; /* K6-2, K6-III, Athlon      */
             unsigned int SSE:1; /* Pentium III, Pentium 4    */
             unsigned int SSE2:1; /* Pentium 4, K8             */
-            unsigned int _unused:28;
+            unsigned int NEON:1; /* ARMv8-A                   */
+            unsigned int _unused:27;
         } CPU_features;
 
 
@@ -539,6 +541,8 @@ extern  "C" {
         /* functions to replace with CPU feature optimized versions in takehiro.c */
         int     (*choose_table) (const int *ix, const int *const end, int *const s);
         void    (*fft_fht) (FLOAT *, int);
+        void    (*quantize_lines_xrpow) (unsigned int l, FLOAT istep, const FLOAT * xp, int *pi);
+        void    (*quantize_lines_xrpow_01) (unsigned int l, FLOAT istep, const FLOAT * xr, int *ix);
         void    (*init_xrpow_core) (gr_info * const cod_info, FLOAT xrpow[576], int upper,
                                     FLOAT * sum);
 
@@ -592,6 +596,7 @@ extern  "C" {
     extern int has_3DNow(void);
     extern int has_SSE(void);
     extern int has_SSE2(void);
+    extern int has_NEON(void);
 
 
 
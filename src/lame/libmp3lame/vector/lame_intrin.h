@@ -30,4 +30,21 @@ init_xrpow_core_sse(gr_info * const cod_info, FLOAT xrpow[576], int upper, FLOAT
 void
 fht_SSE2(FLOAT* , int);
 
+#ifdef HAVE_ARM_NEON_H
+void
+init_xrpow_core_neon(gr_info * const cod_info, FLOAT xrpow[576], int upper, FLOAT * sum);
+
+void
+fht_NEON(FLOAT* , int);
+
+void
+quantize_lines_xrpow_neon(unsigned int l, FLOAT istep, const FLOAT * xp, int *pi);
+
+void
+quantize_lines_xrpow_01_neon(unsigned int l, FLOAT istep, const FLOAT * xr, int *ix);
+
+int
+ix_max_neon(const int *ix, const int *end);
+#endif
+
 #endif
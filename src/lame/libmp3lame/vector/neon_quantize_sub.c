@@ -0,0 +1,308 @@
+/*
+ * MP3 quantization, ARM NEON intrinsics functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.     See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * These produce the same output as the C versions they replace:
+ *  - where the C code computes in double, so do these, using the AArch64
+ *    float64x2 lanes; that is why they are only built for AArch64
+ *  - sums are accumulated in the same order as the C code
+ *  - the library is built with -ffp-contract=off, so that neither the C
+ *    code nor these are changed by fused multiply-adds
+ */
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "lame.h"
+#include "machine.h"
+#include "encoder.h"
+#include "util.h"
+#include "quantize_pvt.h"
+#include "lame_intrin.h"
+
+
+
+#ifdef HAVE_ARM_NEON_H
+
+#include <arm_neon.h>
+
+#define TRI_SIZE (5-1)  /* 1024 =  4**5 */
+static const FLOAT costab[TRI_SIZE * 2] = {
+    9.238795325112867e-01, 3.826834323650898e-01,
+    9.951847266721969e-01, 9.801714032956060e-02,
+    9.996988186962042e-01, 2.454122852291229e-02,
+    9.999811752826011e-01, 6.135884649154475e-03
+};
+
+
+
+/* xrpow = sqrt(|xr| * sqrt(|xr|)), computed in double as init_xrpow_core_c does */
+static inline float32x4_t
+xrpow4(float32x4_t a)
+{
+    float64x2_t lo = vcvt_f64_f32(vget_low_f32(a));
+    float64x2_t hi = vcvt_high_f64_f32(a);
+
+    lo = vsqrtq_f64(vmulq_f64(lo, vsqrtq_f64(lo)));
+    hi = vsqrtq_f64(vmulq_f64(hi, vsqrtq_f64(hi)));
+    return vcvt_high_f32_f64(vcvt_f32_f64(lo), hi);
+}
+
+void
+init_xrpow_core_neon(gr_info * const cod_info, FLOAT xrpow[576], int upper, FLOAT * sum)
+{
+    int     i;
+    int const n = upper + 1;
+    int const n4 = n & ~3;
+    FLOAT   tmp_sum = 0;
+    FLOAT   tmp_max = 0;
+    float32x4_t vec_max = vdupq_n_f32(0);
+
+    for (i = 0; i < n4; i += 4) {
+        float32x4_t const a = vabsq_f32(vld1q_f32(&cod_info->xr[i]));
+        float32x4_t const r = xrpow4(a);
+
+        vst1q_f32(&xrpow[i], r);
+        vec_max = vmaxq_f32(vec_max, r);
+
+        /* the sum is accumulated in the same order as the C version */
+        tmp_sum += vgetq_lane_f32(a, 0);
+        tmp_sum += vgetq_lane_f32(a, 1);
+        tmp_sum += vgetq_lane_f32(a, 2);
+        tmp_sum += vgetq_lane_f32(a, 3);
+    }
+    tmp_max = vmaxvq_f32(vec_max);
+
+    for (; i < n; ++i) {
+        FLOAT const tmp = fabs(cod_info->xr[i]);
+        tmp_sum += tmp;
+        xrpow[i] = sqrt(tmp * sqrt(tmp));
+        if (xrpow[i] > tmp_max)
+            tmp_max = xrpow[i];
+    }
+
+    *sum = tmp_sum;
+    if (tmp_max > cod_info->xrpow_max)
+        cod_info->xrpow_max = tmp_max;
+}
+
+
+
+/* the same lane arrangement as fht_SSE2, so each output is computed
+   by the same operations as in fht() */
+void
+fht_NEON(FLOAT * fz, int n)
+{
+    const FLOAT *tri = costab;
+    int     k4;
+    FLOAT  *fi, *gi;
+    FLOAT const *fn;
+
+    n <<= 1;            /* to get BLKSIZE, because of 3DNow! ASM routine */
+    fn = fz + n;
+    k4 = 4;
+    do {
+        FLOAT   s1, c1;
+        int     i, k1, k2, k3, kx;
+        kx = k4 >> 1;
+        k1 = k4;
+        k2 = k4 << 1;
+        k3 = k2 + k1;
+        k4 = k2 << 1;
+        fi = fz;
+        gi = fi + kx;
+        do {
+            FLOAT   f0, f1, f2, f3;
+            f1 = fi[0] - fi[k1];
+            f0 = fi[0] + fi[k1];
+            f3 = fi[k2] - fi[k3];
+            f2 = fi[k2] + fi[k3];
+            fi[k2] = f0 - f2;
+            fi[0] = f0 + f2;
+            fi[k3] = f1 - f3;
+            fi[k1] = f1 + f3;
+            f1 = gi[0] - gi[k1];
+            f0 = gi[0] + gi[k1];
+            f3 = SQRT2 * gi[k3];
+            f2 = SQRT2 * gi[k2];
+            gi[k2] = f0 - f2;
+            gi[0] = f0 + f2;
+            gi[k3] = f1 - f3;
+            gi[k1] = f1 + f3;
+            gi += k4;
+            fi += k4;
+        } while (fi < fn);
+        c1 = tri[0];
+        s1 = tri[1];
+        for (i = 1; i < kx; i++) {
+            FLOAT   c2, s2, s1_2 = s1 + s1;
+            c2 = 1 - s1_2 * s1;
+            s2 = s1_2 * c1;
+            fi = fz + i;
+            gi = fz + k1 - i;
+            {
+                FLOAT const c1_v[4] = { -c1, c1, c1, c1 };
+                FLOAT const s1_v[4] = { s1, -s1, s1, s1 };
+                FLOAT const c2_v[4] = { c2, c2, -c2, -c2 };
+                float32x4_t const v_c1 = vld1q_f32(c1_v);
+                float32x4_t const v_s1 = vld1q_f32(s1_v);
+                float32x4_t const v_c2 = vld1q_f32(c2_v);
+                float32x4_t const v_s2 = vdupq_n_f32(s2);
+
+                do {
+                    float32x4_t p, q, r;
+                    FLOAT   t[4];
+
+                    t[0] = fi[k1]; t[1] = fi[k3]; t[2] = gi[k1]; t[3] = gi[k3];
+                    q = vld1q_f32(t);                   /* Q := {fi_k1,fi_k3,gi_k1,gi_k3} */
+                    p = vmulq_f32(v_s2, q);             /* P := s2 * Q */
+                    q = vmulq_f32(v_c2, q);             /* Q := c2 * Q */
+                    q = vextq_f32(q, q, 2);             /* Q := {-c2*gi_k1,-c2*gi_k3,c2*fi_k1,c2*fi_k3} */
+                    p = vaddq_f32(p, q);
+
+                    t[0] = gi[0]; t[1] = gi[k2]; t[2] = fi[0]; t[3] = fi[k2];
+                    r = vld1q_f32(t);                   /* R := {gi_0,gi_k2,fi_0,fi_k2} */
+                    q = vsubq_f32(r, p);                /* Q := {gi_0-p0,gi_k2-p1,fi_0-p2,fi_k2-p3} */
+                    r = vaddq_f32(r, p);                /* R := {gi_0+p0,gi_k2+p1,fi_0+p2,fi_k2+p3} */
+                    p = vtrn1q_f32(q, r);               /* P := {q0,r0,q2,r2} */
+                    q = vuzp2q_f32(q, r);               /* Q := {q1,q3,r1,r3} */
+                    r = vmulq_f32(v_c1, q);
+                    q = vmulq_f32(v_s1, q);
+                    q = vrev64q_f32(q);
+                    q = vextq_f32(q, q, 2);             /* Q := {q3,q2,q1,q0} */
+                    q = vaddq_f32(q, r);
+
+                    vst1q_f32(t, vsubq_f32(p, q));
+                    gi[k3] = t[0]; gi[k2] = t[1]; fi[k3] = t[2]; fi[k2] = t[3];
+                    vst1q_f32(t, vaddq_f32(p, q));
+                    gi[k1] = t[0]; gi[0] = t[1]; fi[k1] = t[2]; fi[0] = t[3];
+
+                    gi += k4;
+                    fi += k4;
+                } while (fi < fn);
+            }
+            c2 = c1;
+            c1 = c2 * tri[0] - s1 * tri[1];
+            s1 = c2 * tri[1] + s1 * tri[0];
+        }
+        tri += 2;
+    } while (k4 < n);
+}
+
+
+
+#ifdef TAKEHIRO_IEEE754_HACK
+
+#define MAGIC_FLOAT (65536*(128))
+#define MAGIC_INT 0x4b000000
+
+/* the IEEE754 hack of quantize_lines_xrpow in takehiro.c: the additions
+   are in double, and the results are rounded to float, as there */
+void
+quantize_lines_xrpow_neon(unsigned int l, FLOAT istep, const FLOAT * xp, int *pi)
+{
+    float32x4_t const v_istep = vdupq_n_f32(istep);
+    float64x2_t const v_magic_float = vdupq_n_f64(MAGIC_FLOAT);
+    int32x4_t const v_magic_int = vdupq_n_s32(MAGIC_INT);
+    unsigned int i;
+
+    assert(l > 0);
+
+    for (i = 0; i + 4 <= l; i += 4) {
+        float32x4_t x = vmulq_f32(v_istep, vld1q_f32(xp + i));
+        float64x2_t lo = vaddq_f64(vcvt_f64_f32(vget_low_f32(x)), v_magic_float);
+        float64x2_t hi = vaddq_f64(vcvt_high_f64_f32(x), v_magic_float);
+        int32x4_t idx;
+        FLOAT   adj[4];
+
+        idx = vsubq_s32(vreinterpretq_s32_f32(vcvt_high_f32_f64(vcvt_f32_f64(lo), hi)), v_magic_int);
+        adj[0] = adj43asm[vgetq_lane_s32(idx, 0)];
+        adj[1] = adj43asm[vgetq_lane_s32(idx, 1)];
+        adj[2] = adj43asm[vgetq_lane_s32(idx, 2)];
+        adj[3] = adj43asm[vgetq_lane_s32(idx, 3)];
+        x = vld1q_f32(adj);
+
+        lo = vaddq_f64(lo, vcvt_f64_f32(vget_low_f32(x)));
+        hi = vaddq_f64(hi, vcvt_high_f64_f32(x));
+        vst1q_s32(pi + i,
+                  vsubq_s32(vreinterpretq_s32_f32(vcvt_high_f32_f64(vcvt_f32_f64(lo), hi)), v_magic_int));
+    }
+
+    for (; i < l; i++) {
+        double  x0 = istep * xp[i];
+        union {
+            float   f;
+            int     i;
+        } fi;
+
+        x0 += MAGIC_FLOAT;
+        fi.f = x0;
+        fi.f = x0 + adj43asm[fi.i - MAGIC_INT];
+        pi[i] = fi.i - MAGIC_INT;
+    }
+}
+
+#endif
+
+
+
+void
+quantize_lines_xrpow_01_neon(unsigned int l, FLOAT istep, const FLOAT * xr, int *ix)
+{
+    const FLOAT compareval0 = (1.0f - 0.4054f) / istep;
+    float32x4_t const v_compareval0 = vdupq_n_f32(compareval0);
+    uint32x4_t const v_one = vdupq_n_u32(1);
+    unsigned int i;
+
+    assert(l > 0);
+    assert(l % 2 == 0);
+
+    for (i = 0; i + 4 <= l; i += 4) {
+        uint32x4_t const lt = vcgtq_f32(v_compareval0, vld1q_f32(xr + i));
+        vst1q_s32(ix + i, vreinterpretq_s32_u32(vbicq_u32(v_one, lt)));
+    }
+    for (; i < l; i++) {
+        ix[i] = (compareval0 > xr[i]) ? 0 : 1;
+    }
+}
+
+
+
+int
+ix_max_neon(const int *ix, const int *end)
+{
+    int32x4_t vec_max = vdupq_n_s32(0);
+    int     max1 = 0;
+
+    while (ix + 4 <= end) {
+        vec_max = vmaxq_s32(vec_max, vld1q_s32(ix));
+        ix += 4;
+    }
+    max1 = vmaxvq_s32(vec_max);
+    while (ix < end) {
+        if (max1 < *ix)
+            max1 = *ix;
+        ix++;
+    }
+    return max1;
+}
+
+#endif	/* HAVE_ARM_NEON_H */
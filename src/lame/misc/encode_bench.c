@@ -0,0 +1,207 @@
+/*
+ *      encode_bench.c
+ *
+ *      Encodes a fixed, generated PCM corpus with each of a few encoder
+ *      configurations, and prints one json line per configuration with the
+ *      real-time factor (seconds of audio encoded per second of cpu time).
+ *
+ *      Each configuration is encoded with the SIMD kernels enabled and with
+ *      them disabled; the two mp3 streams must be identical.
+ *
+ *      usage: encode_bench [secs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "lame.h"
+
+#define SAMPLE_RATE  48000
+#define DEFAULT_SECS 30
+#define BLOCK        4096
+
+typedef struct {
+    const char *name;
+    int     channels;
+    int     kbps;
+    int     quality;
+} config_t;
+
+/* mono 64 kbps is what the recorder and the playback capture use */
+static const config_t configs[] = {
+    {"mono_64k", 1, 64, 5},
+    {"mono_128k", 1, 128, 5},
+    {"stereo_128k", 2, 128, 5},
+    {"stereo_128k_q2", 2, 128, 2},
+};
+
+typedef struct {
+    double  secs;
+    unsigned long hash;
+    long    bytes;
+} result_t;
+
+
+/* the corpus: a voice like harmonic series with a wandering pitch and a
+   syllable rate envelope, plus noise bursts and a slow chirp; the right
+   channel is a delayed and filtered copy, so joint stereo has work to do */
+static short *
+make_corpus(int frames)
+{
+    short  *pcm = malloc(sizeof(short) * 2 * frames);
+    unsigned int seed = 12345;
+    double  phase = 0, chirp_phase = 0, lp = 0;
+    int     i, h;
+
+    if (pcm == NULL)
+        return NULL;
+
+    for (i = 0; i < frames; i++) {
+        double  t = (double) i / SAMPLE_RATE;
+        double  f0 = 140 + 40 * sin(2 * M_PI * 0.7 * t);
+        double  env = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+        double  v = 0, noise;
+
+        phase += 2 * M_PI * f0 / SAMPLE_RATE;
+        for (h = 1; h <= 12; h++)
+            v += sin(h * phase) / h;
+        v *= env * 0.25;
+
+        seed = seed * 1103515245 + 12345;
+        noise = ((seed >> 16) & 0x7fff) / 16384.0 - 1;
+        if (fmod(t, 2.0) > 1.7)
+            v += 0.3 * noise;
+
+        chirp_phase += 2 * M_PI * (200 + 3000 * fmod(t, 5.0) / 5.0) / SAMPLE_RATE;
+        v += 0.05 * sin(chirp_phase);
+
+        lp += 0.2 * (v - lp);
+        pcm[2 * i + 0] = 32767 * 0.8 * v;
+        pcm[2 * i + 1] = 32767 * 0.8 * (i >= 240 ? lp : 0);
+    }
+    return pcm;
+}
+
+static double
+cpu_secs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long
+fnv1a(unsigned long h, const unsigned char *p, int n)
+{
+    while (n-- > 0) {
+        h ^= *p++;
+        h *= 1099511628211UL;
+    }
+    return h;
+}
+
+static int
+encode(const config_t * cfg, int simd, const short *pcm, int frames, result_t * res)
+{
+    lame_global_flags *gfp;
+    static short mono[BLOCK];
+    static unsigned char mp3buf[BLOCK * 5 / 4 + 7200];
+    double  start;
+    int     i, n, rc;
+
+    gfp = lame_init();
+    if (gfp == NULL)
+        return -1;
+    lame_set_in_samplerate(gfp, SAMPLE_RATE);
+    lame_set_num_channels(gfp, cfg->channels);
+    lame_set_brate(gfp, cfg->kbps);
+    lame_set_quality(gfp, cfg->quality);
+    lame_set_bWriteVbrTag(gfp, 0);
+    lame_set_asm_optimizations(gfp, MMX, simd);
+    lame_set_asm_optimizations(gfp, SSE, simd);
+    lame_set_asm_optimizations(gfp, NEON, simd);
+    if (lame_init_params(gfp) < 0) {
+        lame_close(gfp);
+        return -1;
+    }
+
+    res->hash = 14695981039346656037UL;
+    res->bytes = 0;
+
+    start = cpu_secs();
+    for (i = 0; i < frames; i += n) {
+        n = (frames - i < BLOCK ? frames - i : BLOCK);
+        if (cfg->channels == 2) {
+            rc = lame_encode_buffer_interleaved(gfp, (short *) pcm + 2 * i, n, mp3buf,
+                                                sizeof(mp3buf));
+        }
+        else {
+            int     j;
+            for (j = 0; j < n; j++)
+                mono[j] = pcm[2 * (i + j)];
+            rc = lame_encode_buffer(gfp, mono, NULL, n, mp3buf, sizeof(mp3buf));
+        }
+        if (rc < 0)
+            break;
+        res->hash = fnv1a(res->hash, mp3buf, rc);
+        res->bytes += rc;
+    }
+    if (rc >= 0) {
+        rc = lame_encode_flush(gfp, mp3buf, sizeof(mp3buf));
+        if (rc >= 0) {
+            res->hash = fnv1a(res->hash, mp3buf, rc);
+            res->bytes += rc;
+        }
+    }
+    res->secs = cpu_secs() - start;
+
+    lame_close(gfp);
+    return rc < 0 ? -1 : 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int     secs = (argc > 1 ? atoi(argv[1]) : DEFAULT_SECS);
+    int     frames, i, errors = 0;
+    short  *pcm;
+
+    if (secs <= 0) {
+        fprintf(stderr, "usage: %s [secs]\n", argv[0]);
+        return 1;
+    }
+    frames = secs * SAMPLE_RATE;
+    pcm = make_corpus(frames);
+    if (pcm == NULL) {
+        fprintf(stderr, "failed to allocate corpus\n");
+        return 1;
+    }
+
+    for (i = 0; i < (int) (sizeof(configs) / sizeof(configs[0])); i++) {
+        result_t simd, scalar;
+        int     identical;
+
+        if (encode(&configs[i], 1, pcm, frames, &simd) < 0 ||
+            encode(&configs[i], 0, pcm, frames, &scalar) < 0) {
+            fprintf(stderr, "%s: encode failed\n", configs[i].name);
+            errors++;
+            continue;
+        }
+        identical = (simd.hash == scalar.hash && simd.bytes == scalar.bytes);
+        if (!identical)
+            errors++;
+
+        printf("{\"config\":\"%s\", \"audio_secs\":%d, \"mp3_bytes\":%ld, "
+               "\"simd_rtf\":%.1f, \"scalar_rtf\":%.1f, \"speedup\":%.2f, \"identical\":%s}\n",
+               configs[i].name, secs, simd.bytes,
+               secs / simd.secs, secs / scalar.secs, scalar.secs / simd.secs,
+               identical ? "true" : "false");
+    }
+
+    free(pcm);
+    return errors ? 1 : 0;
+}
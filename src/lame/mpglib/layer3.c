@@ -722,7 +722,9 @@ III_dequantize_sample(PMPSTR mp, real xr[SBLIMIT][SSLIMIT], int *scf,
     {
         int     i;
 
-        for (i = (&xr[SBLIMIT][0] - xrpnt) >> 1; i > 0; i--) {
+        /* the end of xr is computed as a pointer one past the last element,
+           &xr[SBLIMIT][0] indexes past the end of xr */
+        for (i = ((real *) xr + SBLIMIT * SSLIMIT - xrpnt) >> 1; i > 0; i--) {
             *xrpnt++ = 0.0;
             *xrpnt++ = 0.0;
         }
@@ -1073,7 +1075,7 @@ III_dequantize_sample(PMPSTR mp, real xr[SBLIMIT][SSLIMIT], int *scf,
         /* 
          * zero part
          */
-        for (i = (&xr[SBLIMIT][0] - xrpnt) >> 1; i; i--) {
+        for (i = ((real *) xr + SBLIMIT * SSLIMIT - xrpnt) >> 1; i; i--) {
             *xrpnt++ = 0.0;
             *xrpnt++ = 0.0;
         }
@@ -39,6 +39,16 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #include <stdlib.h> /* allocations */
 #endif /* LODEPNG_COMPILE_ALLOCATORS */
 
+#if defined(LODEPNG_COMPILE_SIMD) && defined(LODEPNG_COMPILE_DECODER)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LODEPNG_SSE2
+#include <emmintrin.h> /* SSE2 unfilters */
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LODEPNG_NEON
+#include <arm_neon.h> /* NEON unfilters */
+#endif
+#endif /* LODEPNG_COMPILE_SIMD && LODEPNG_COMPILE_DECODER */
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
 #pragma warning( disable : 4244 ) /*implicit conversions: not warned by gcc -Wall -Wextra and requires too much casts*/
 #pragma warning( disable : 4996 ) /*VS does not like fopen, but fopen_s is not standard C so unusable here*/
@@ -615,6 +625,7 @@ typedef struct HuffmanTree {
   /* for reading only */
   unsigned char* table_len; /*length of symbol from lookup table, or max length if secondary lookup needed*/
   unsigned short* table_value; /*value of symbol from lookup table, or pointer to secondary table if needed*/
+  unsigned* table_multi; /*literals decoded at once from MULTIBITS bits, see HuffmanTree_makeMultiTable*/
 } HuffmanTree;
 
 static void HuffmanTree_init(HuffmanTree* tree) {
@@ -622,6 +633,7 @@ static void HuffmanTree_init(HuffmanTree* tree) {
   tree->lengths = 0;
   tree->table_len = 0;
   tree->table_value = 0;
+  tree->table_multi = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree) {
@@ -629,6 +641,7 @@ static void HuffmanTree_cleanup(HuffmanTree* tree) {
   lodepng_free(tree->lengths);
   lodepng_free(tree->table_len);
   lodepng_free(tree->table_value);
+  lodepng_free(tree->table_multi);
 }
 
 /* amount of bits for first huffman table lookup (aka root bits), see HuffmanTree_makeTable and huffmanDecodeSymbol.*/
@@ -1046,6 +1059,38 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree) {
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/* amount of bits for the multi literal table, see HuffmanTree_makeMultiTable. At most 15. */
+#define MULTIBITS 12u
+
+/*
+Makes the table for decoding several literals with one lookup, for the literal/length
+tree. Each entry holds up to 3 literals whose codes fit in its MULTIBITS bits, in
+bits 0-23, their total code length in bits 24-27 and their count in bits 28-29.
+An entry is 0 if the first symbol is not a literal or is longer than FIRSTBITS or
+MULTIBITS, then huffmanDecodeSymbol must be used. Uses the first table of makeTable.
+*/
+static unsigned HuffmanTree_makeMultiTable(HuffmanTree* tree) {
+  static const unsigned mask = (1u << FIRSTBITS) - 1u;
+  unsigned i;
+  tree->table_multi = (unsigned*)lodepng_malloc((1u << MULTIBITS) * sizeof(*tree->table_multi));
+  if(!tree->table_multi) return 83; /*alloc fail*/
+  for(i = 0; i != (1u << MULTIBITS); ++i) {
+    unsigned entry = 0, used = 0, num = 0;
+    while(num < 3) {
+      /*bits past MULTIBITS are unknown and 0 here, but don't matter to symbols of at most MULTIBITS - used bits*/
+      unsigned code = (i >> used) & mask;
+      unsigned l = tree->table_len[code];
+      unsigned value = tree->table_value[code];
+      if(l > FIRSTBITS || used + l > MULTIBITS || value > 255) break;
+      entry |= value << (num * 8u);
+      used += l;
+      ++num;
+    }
+    tree->table_multi[i] = num ? (entry | (used << 24u) | (num << 28u)) : 0;
+  }
+  return 0;
+}
+
 /*
 returns the code. The bit reader must already have been ensured at least 15 bits
 */
@@ -1213,35 +1258,41 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
-/*inflate a block with dynamic of fixed Huffman tree. btype must be 1 or 2.*/
-static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
-                                    unsigned btype, size_t max_output_size) {
+/*
+Decodes the symbols of a block with the given trees until the end code, which sets
+*done, or until out has stop_size bytes or the reader is at bit stop_bp, so that a
+streaming caller can refill its input or use the output. Returns error.
+*/
+static unsigned inflateHuffmanSymbols(ucvector* out, LodePNGBitReader* reader,
+                                      const HuffmanTree* tree_ll, const HuffmanTree* tree_d, size_t max_output_size,
+                                      size_t stop_size, size_t stop_bp, int* done) {
   unsigned error = 0;
-  HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
-  HuffmanTree tree_d; /*the huffman tree for distance codes*/
-  const size_t reserved_size = 260; /* must be at least 258 for max length, and a few extra for adding a few extra literals */
-  int done = 0;
+  const size_t reserved_size = 262; /* must be at least 258 for max length, and a few extra for adding a few extra literals */
 
   if(!ucvector_reserve(out, out->size + reserved_size)) return 83; /*alloc fail*/
 
-  HuffmanTree_init(&tree_ll);
-  HuffmanTree_init(&tree_d);
-
-  if(btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d);
-  else /*if(btype == 2)*/ error = getTreeInflateDynamic(&tree_ll, &tree_d, reader);
-
-
-  while(!error && !done) /*decode all symbols until end reached, breaks at end code*/ {
+  while(!error && !*done) /*decode all symbols until end reached, breaks at end code*/ {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll;
+    unsigned code_ll, multi;
     /* ensure enough bits for 2 huffman code reads (15 bits each): if the first is a literal, a second literal is read at once. This
     appears to be slightly faster, than ensuring 20 bits here for 1 huffman symbol and the potential 5 extra bits for the length symbol.*/
     ensureBits32(reader, 30);
-    code_ll = huffmanDecodeSymbol(reader, &tree_ll);
-    if(code_ll <= 255) {
-      /*slightly faster code path if multiple literals in a row*/
-      out->data[out->size++] = (unsigned char)code_ll;
-      code_ll = huffmanDecodeSymbol(reader, &tree_ll);
+    multi = tree_ll->table_multi[peekBits(reader, MULTIBITS)];
+    if(multi) {
+      /*up to 3 short literals at once, then the next symbol from the remaining bits. Writes 3 bytes, uses count.*/
+      out->data[out->size + 0] = (unsigned char)multi;
+      out->data[out->size + 1] = (unsigned char)(multi >> 8u);
+      out->data[out->size + 2] = (unsigned char)(multi >> 16u);
+      out->size += multi >> 28u;
+      advanceBits(reader, (multi >> 24u) & 15u);
+      code_ll = huffmanDecodeSymbol(reader, tree_ll);
+    } else {
+      code_ll = huffmanDecodeSymbol(reader, tree_ll);
+      if(code_ll <= 255) {
+        /*slightly faster code path if multiple literals in a row*/
+        out->data[out->size++] = (unsigned char)code_ll;
+        code_ll = huffmanDecodeSymbol(reader, tree_ll);
+      }
     }
     if(code_ll <= 255) /*literal symbol*/ {
       out->data[out->size++] = (unsigned char)code_ll;
@@ -1263,7 +1314,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
 
       /*part 3: get distance code*/
       ensureBits32(reader, 28); /* up to 15 for the huffman symbol, up to 13 for the extra bits */
-      code_d = huffmanDecodeSymbol(reader, &tree_d);
+      code_d = huffmanDecodeSymbol(reader, tree_d);
       if(code_d > 29) {
         if(code_d <= 31) {
           ERROR_BREAK(18); /*error: invalid distance code (30-31 are never used)*/
@@ -1297,7 +1348,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
         lodepng_memcpy(out->data + start, out->data + backward, length);
       }
     } else if(code_ll == 256) {
-      done = 1; /*end code, finish the loop*/
+      *done = 1; /*end code, finish the loop*/
     } else /*if(code_ll == INVALIDSYMBOL)*/ {
       ERROR_BREAK(16); /*error: tried to read disallowed huffman symbol*/
     }
@@ -1314,8 +1365,29 @@ static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
     if(max_output_size && out->size > max_output_size) {
       ERROR_BREAK(109); /*error, larger than max size*/
     }
+    if(out->size >= stop_size || reader->bp >= stop_bp) break;
   }
 
+  return error;
+}
+
+/*inflate a block with dynamic of fixed Huffman tree. btype must be 1 or 2.*/
+static unsigned inflateHuffmanBlock(ucvector* out, LodePNGBitReader* reader,
+                                    unsigned btype, size_t max_output_size) {
+  unsigned error = 0;
+  HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
+  HuffmanTree tree_d; /*the huffman tree for distance codes*/
+  int done = 0;
+
+  HuffmanTree_init(&tree_ll);
+  HuffmanTree_init(&tree_d);
+
+  if(btype == 1) error = getTreeInflateFixed(&tree_ll, &tree_d);
+  else /*if(btype == 2)*/ error = getTreeInflateDynamic(&tree_ll, &tree_d, reader);
+  if(!error) error = HuffmanTree_makeMultiTable(&tree_ll);
+  if(!error) error = inflateHuffmanSymbols(out, reader, &tree_ll, &tree_d, max_output_size,
+                                           (size_t)(-1), (size_t)(-1), &done);
+
   HuffmanTree_cleanup(&tree_ll);
   HuffmanTree_cleanup(&tree_d);
 
@@ -1714,7 +1786,8 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize) {
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize,
+                                     unsigned final) {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
   2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
 
@@ -1725,7 +1798,7 @@ static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, s
     unsigned char firstbyte;
     size_t pos = out->size;
 
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
 
     LEN = 65535;
@@ -2044,8 +2117,32 @@ static unsigned deflateFixed(LodePNGBitWriter* writer, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings) {
+/*
+Adds the last windowsize bytes before inpos to the hash chains, so that the data
+from inpos on can refer back to them, like to an earlier block of the same stream.
+*/
+static void hashPreset(Hash* hash, const unsigned char* in, size_t inpos, size_t insize, unsigned windowsize) {
+  size_t pos = inpos > windowsize ? inpos - windowsize : 0;
+  unsigned hashval, numzeros = 0;
+  for(; pos < inpos; ++pos) {
+    hashval = getHash(in, insize, pos);
+    if(hashval == 0) {
+      if(numzeros == 0) numzeros = countZeros(in, insize, pos);
+      else if(pos + numzeros > insize || in[pos + numzeros - 1] != 0) --numzeros;
+    } else {
+      numzeros = 0;
+    }
+    updateHashChain(hash, pos & (windowsize - 1), hashval, (unsigned short)numzeros);
+  }
+}
+
+/*
+Deflates in[inpos..insize-1], with in[0..inpos-1] as the history that matches
+may refer to. If final is 0, the output ends with an empty stored block rather
+than a final block, so it is byte aligned and may be followed by more deflate data.
+*/
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t inpos, size_t insize,
+                                 unsigned final, const LodePNGCompressSettings* settings) {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
   Hash hash;
@@ -2054,42 +2151,72 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   LodePNGBitWriter_init(&writer, out);
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
-  else if(settings->btype == 1) blocksize = insize;
+  else if(settings->btype == 0) {
+    error = deflateNoCompression(out, in + inpos, insize - inpos, final);
+    if(!error && !final) writeBits(&writer, 0, 3);
+    blocksize = 0;
+  }
+  else if(settings->btype == 1) blocksize = insize - inpos;
   else /*if(settings->btype == 2)*/ {
     /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-    blocksize = insize / 8u + 8;
+    blocksize = (insize - inpos) / 8u + 8;
     if(blocksize < 65536) blocksize = 65536;
     if(blocksize > 262144) blocksize = 262144;
   }
 
-  numdeflateblocks = (insize + blocksize - 1) / blocksize;
-  if(numdeflateblocks == 0) numdeflateblocks = 1;
+  if(settings->btype != 0) {
+    numdeflateblocks = blocksize == 0 ? 1 : (insize - inpos + blocksize - 1) / blocksize;
+    if(numdeflateblocks == 0) numdeflateblocks = 1;
 
-  error = hash_init(&hash, settings->windowsize);
-
-  if(!error) {
-    for(i = 0; i != numdeflateblocks && !error; ++i) {
-      unsigned final = (i == numdeflateblocks - 1);
-      size_t start = i * blocksize;
-      size_t end = start + blocksize;
-      if(end > insize) end = insize;
+    error = hash_init(&hash, settings->windowsize);
+    if(!error && inpos != 0) hashPreset(&hash, in, inpos, insize, settings->windowsize);
 
-      if(settings->btype == 1) error = deflateFixed(&writer, &hash, in, start, end, settings, final);
-      else if(settings->btype == 2) error = deflateDynamic(&writer, &hash, in, start, end, settings, final);
+    if(!error) {
+      for(i = 0; i != numdeflateblocks && !error; ++i) {
+        unsigned lastblock = (i == numdeflateblocks - 1);
+        size_t start = inpos + i * blocksize;
+        size_t end = start + blocksize;
+        if(end > insize) end = insize;
+
+        if(settings->btype == 1) error = deflateFixed(&writer, &hash, in, start, end, settings, final && lastblock);
+        else if(settings->btype == 2) error = deflateDynamic(&writer, &hash, in, start, end, settings, final && lastblock);
+      }
+      /*the 3 bits of an empty stored block header, which is then padded to the byte boundary*/
+      if(!error && !final) writeBits(&writer, 0, 3);
     }
+
+    hash_cleanup(&hash);
   }
 
-  hash_cleanup(&hash);
+  /*LEN and NLEN of the empty stored block*/
+  if(!error && !final) {
+    if(!ucvector_resize(out, out->size + 4)) return 83; /*alloc fail*/
+    out->data[out->size - 4] = 0;
+    out->data[out->size - 3] = 0;
+    out->data[out->size - 2] = 255;
+    out->data[out->size - 1] = 255;
+  }
 
   return error;
 }
 
+unsigned lodepng_deflate_part(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t inpos, size_t insize, unsigned final,
+                              const LodePNGCompressSettings* settings) {
+  ucvector v = ucvector_init(*out, *outsize);
+  unsigned error;
+  if(inpos > insize) return 125; /*error: the history is longer than the input*/
+  error = lodepng_deflatev(&v, in, inpos, insize, final, settings);
+  *out = v.data;
+  *outsize = v.size;
+  return error;
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings) {
   ucvector v = ucvector_init(*out, *outsize);
-  unsigned error = lodepng_deflatev(&v, in, insize, settings);
+  unsigned error = lodepng_deflatev(&v, in, 0, insize, 1, settings);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -2633,10 +2760,10 @@ static const unsigned lodepng_crc32_table7[256] = {
   0x2c8e0fffu, 0xe0240f61u, 0x6eab0882u, 0xa201081cu, 0xa8c40105u, 0x646e019bu, 0xeae10678u, 0x264b06e6u
 };
 
-/* Computes the cyclic redundancy check as used by PNG chunks*/
-unsigned lodepng_crc32(const unsigned char* data, size_t length) {
+/*Updates the CRC register r, which starts at 0xffffffff and is xor'ed with it at the end,
+with more data. Used for data that is not in memory at once.*/
+static unsigned lodepng_crc32_update(unsigned r, const unsigned char* data, size_t length) {
   /*Using the Slicing by Eight algorithm*/
-  unsigned r = 0xffffffffu;
   while(length >= 8) {
     r = lodepng_crc32_table7[(data[0] ^ (r & 0xffu))] ^
         lodepng_crc32_table6[(data[1] ^ ((r >> 8) & 0xffu))] ^
@@ -2652,7 +2779,12 @@ unsigned lodepng_crc32(const unsigned char* data, size_t length) {
   while(length--) {
     r = lodepng_crc32_table0[(r ^ *data++) & 0xffu] ^ (r >> 8);
   }
-  return r ^ 0xffffffffu;
+  return r;
+}
+
+/* Computes the cyclic redundancy check as used by PNG chunks*/
+unsigned lodepng_crc32(const unsigned char* data, size_t length) {
+  return lodepng_crc32_update(0xffffffffu, data, length) ^ 0xffffffffu;
 }
 #else /* LODEPNG_COMPILE_CRC */
 /*in this case, the function is only declared here, and must be defined externally
@@ -4443,6 +4575,213 @@ unsigned lodepng_inspect(unsigned* w, unsigned* h, LodePNGState* state,
   return state->error;
 }
 
+#if defined(LODEPNG_SSE2) || defined(LODEPNG_NEON)
+/*
+SIMD versions of the unfilters, for the filter types and pixel sizes they handle,
+with the same results as unfilterScanline's plain C:
+-up, any bytewidth: 16 bytes at a time
+-sub, bytewidth 3 or 4: 4 pixels at a time, with a prefix sum of the pixels
+-average and paeth, bytewidth 3 or 4: a pixel at a time, with the channels in
+ parallel, since each pixel depends on the previous one
+Return 1 if the scanline was unfiltered, 0 to use the plain C code. recon and
+scanline may be the same memory, scanline is read ahead of recon being written.
+*/
+
+/*the 3 or 4 bytes of a pixel, in an unsigned*/
+static LODEPNG_INLINE unsigned simdGetPixel(const unsigned char* p, size_t bytewidth) {
+  unsigned v = (unsigned)p[0] | ((unsigned)p[1] << 8u) | ((unsigned)p[2] << 16u);
+  if(bytewidth == 4) v |= (unsigned)p[3] << 24u;
+  return v;
+}
+
+static LODEPNG_INLINE void simdSetPixel(unsigned char* p, unsigned v, size_t bytewidth) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8u);
+  p[2] = (unsigned char)(v >> 16u);
+  if(bytewidth == 4) p[3] = (unsigned char)(v >> 24u);
+}
+#endif /*LODEPNG_SSE2 || LODEPNG_NEON*/
+
+#ifdef LODEPNG_SSE2
+static LODEPNG_INLINE __m128i sse2Select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static LODEPNG_INLINE __m128i sse2Abs16(__m128i v) {
+  return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+static void unfilterSubSSE2(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length) {
+  size_t i = 0;
+  __m128i prev = _mm_setzero_si128(); /*the previous pixel, in each pixel position*/
+  if(bytewidth == 4) {
+    for(; i + 16 <= length; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, prev);
+      _mm_storeu_si128((__m128i*)(recon + i), x);
+      prev = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+  } else {
+    /*4 pixels of 3 bytes, 12 of the 16 bytes loaded*/
+    const __m128i mask = _mm_cvtsi32_si128(0xffffff);
+    for(; i + 16 <= length; i += 12) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+      x = _mm_add_epi8(x, prev);
+      _mm_storel_epi64((__m128i*)(recon + i), x);
+      simdSetPixel(recon + i + 8, (unsigned)_mm_cvtsi128_si32(_mm_srli_si128(x, 8)), 4);
+      prev = _mm_and_si128(_mm_srli_si128(x, 9), mask);
+      prev = _mm_or_si128(prev, _mm_slli_si128(prev, 3));
+      prev = _mm_or_si128(prev, _mm_slli_si128(prev, 6));
+    }
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + (i >= bytewidth ? recon[i - bytewidth] : 0);
+}
+
+static unsigned unfilterScanlineSimd(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                     size_t bytewidth, unsigned char filterType, size_t length) {
+  size_t i = 0;
+  if(filterType == 2 && precon) {
+    for(; i + 16 <= length; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)(scanline + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(precon + i));
+      _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+    }
+    for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+    return 1;
+  }
+  if(bytewidth != 3 && bytewidth != 4) return 0;
+  if(filterType == 1) {
+    unfilterSubSSE2(recon, scanline, bytewidth, length);
+    return 1;
+  }
+  if(filterType == 3 && precon) {
+    /*the average rounded down is the rounded up average of avg_epu8, less the low bit of a ^ b*/
+    const __m128i ones = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for(; i + bytewidth <= length; i += bytewidth) {
+      __m128i b = _mm_cvtsi32_si128((int)simdGetPixel(precon + i, bytewidth));
+      __m128i x = _mm_cvtsi32_si128((int)simdGetPixel(scanline + i, bytewidth));
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), ones));
+      a = _mm_add_epi8(x, avg);
+      simdSetPixel(recon + i, (unsigned)_mm_cvtsi128_si32(a), bytewidth);
+    }
+    return i == length;
+  }
+  if(filterType == 4 && precon) {
+    /*in 16 bit lanes: pa = |p - a| = |b - c|, pb = |p - b| = |a - c|, pc = |p - c| = |a + b - 2c|*/
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowbyte = _mm_set1_epi16(0xff);
+    __m128i a = zero, c = zero;
+    for(; i + bytewidth <= length; i += bytewidth) {
+      __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)simdGetPixel(precon + i, bytewidth)), zero);
+      __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)simdGetPixel(scanline + i, bytewidth)), zero);
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = _mm_add_epi16(pa, pb);
+      __m128i smallest, nearest;
+      pa = sse2Abs16(pa);
+      pb = sse2Abs16(pb);
+      pc = sse2Abs16(pc);
+      smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      /*a if pa is smallest, else b if pb is, else c, the order of paethPredictor*/
+      nearest = sse2Select(_mm_cmpeq_epi16(smallest, pb), b, c);
+      nearest = sse2Select(_mm_cmpeq_epi16(smallest, pa), a, nearest);
+      a = _mm_and_si128(_mm_add_epi16(x, nearest), lowbyte);
+      simdSetPixel(recon + i, (unsigned)_mm_cvtsi128_si32(_mm_packus_epi16(a, a)), bytewidth);
+      c = b;
+    }
+    return i == length;
+  }
+  return 0;
+}
+#endif /*LODEPNG_SSE2*/
+
+#ifdef LODEPNG_NEON
+static void unfilterSubNEON(unsigned char* recon, const unsigned char* scanline, size_t bytewidth, size_t length) {
+  size_t i = 0;
+  const uint8x16_t zero = vdupq_n_u8(0);
+  uint8x16_t prev = zero; /*the previous pixel, in each pixel position*/
+  if(bytewidth == 4) {
+    for(; i + 16 <= length; i += 16) {
+      uint8x16_t x = vld1q_u8(scanline + i);
+      x = vaddq_u8(x, vextq_u8(zero, x, 12));
+      x = vaddq_u8(x, vextq_u8(zero, x, 8));
+      x = vaddq_u8(x, prev);
+      vst1q_u8(recon + i, x);
+      prev = vreinterpretq_u8_u32(vdupq_n_u32(vgetq_lane_u32(vreinterpretq_u32_u8(x), 3)));
+    }
+  } else {
+    /*4 pixels of 3 bytes, 12 of the 16 bytes loaded*/
+    static const unsigned char maskbytes[16] = {255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    const uint8x16_t mask = vld1q_u8(maskbytes);
+    for(; i + 16 <= length; i += 12) {
+      uint8x16_t x = vld1q_u8(scanline + i);
+      x = vaddq_u8(x, vextq_u8(zero, x, 13));
+      x = vaddq_u8(x, vextq_u8(zero, x, 10));
+      x = vaddq_u8(x, prev);
+      vst1_u8(recon + i, vget_low_u8(x));
+      simdSetPixel(recon + i + 8, vgetq_lane_u32(vreinterpretq_u32_u8(x), 2), 4);
+      prev = vandq_u8(vextq_u8(x, zero, 9), mask);
+      prev = vorrq_u8(prev, vextq_u8(zero, prev, 13));
+      prev = vorrq_u8(prev, vextq_u8(zero, prev, 10));
+    }
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + (i >= bytewidth ? recon[i - bytewidth] : 0);
+}
+
+static unsigned unfilterScanlineSimd(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                     size_t bytewidth, unsigned char filterType, size_t length) {
+  size_t i = 0;
+  if(filterType == 2 && precon) {
+    for(; i + 16 <= length; i += 16) {
+      vst1q_u8(recon + i, vaddq_u8(vld1q_u8(scanline + i), vld1q_u8(precon + i)));
+    }
+    for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+    return 1;
+  }
+  if(bytewidth != 3 && bytewidth != 4) return 0;
+  if(filterType == 1) {
+    unfilterSubNEON(recon, scanline, bytewidth, length);
+    return 1;
+  }
+  if(filterType == 3 && precon) {
+    /*vhadd is the average rounded down*/
+    uint8x8_t a = vdup_n_u8(0);
+    for(; i + bytewidth <= length; i += bytewidth) {
+      uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(simdGetPixel(precon + i, bytewidth)));
+      uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(simdGetPixel(scanline + i, bytewidth)));
+      a = vadd_u8(x, vhadd_u8(a, b));
+      simdSetPixel(recon + i, vget_lane_u32(vreinterpret_u32_u8(a), 0), bytewidth);
+    }
+    return i == length;
+  }
+  if(filterType == 4 && precon) {
+    /*pa = |p - a| = |b - c|, pb = |p - b| = |a - c|, pc = |p - c| = |a + b - 2c|, in 16 bits*/
+    uint8x8_t a = vdup_n_u8(0), c = vdup_n_u8(0);
+    for(; i + bytewidth <= length; i += bytewidth) {
+      uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(simdGetPixel(precon + i, bytewidth)));
+      uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(simdGetPixel(scanline + i, bytewidth)));
+      uint16x8_t pa = vabdl_u8(b, c);
+      uint16x8_t pb = vabdl_u8(a, c);
+      uint16x8_t pc = vabdq_u16(vaddl_u8(a, b), vaddl_u8(c, c));
+      uint16x8_t smallest = vminq_u16(pc, vminq_u16(pa, pb));
+      /*a if pa is smallest, else b if pb is, else c, the order of paethPredictor*/
+      uint8x8_t nearest = vbsl_u8(vmovn_u16(vceqq_u16(smallest, pb)), b, c);
+      nearest = vbsl_u8(vmovn_u16(vceqq_u16(smallest, pa)), a, nearest);
+      a = vadd_u8(x, nearest);
+      simdSetPixel(recon + i, vget_lane_u32(vreinterpret_u32_u8(a), 0), bytewidth);
+      c = b;
+    }
+    return i == length;
+  }
+  return 0;
+}
+#endif /*LODEPNG_NEON*/
+
 static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
                                  size_t bytewidth, unsigned char filterType, size_t length) {
   /*
@@ -4455,6 +4794,9 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#if defined(LODEPNG_SSE2) || defined(LODEPNG_NEON)
+  if(unfilterScanlineSimd(recon, scanline, precon, bytewidth, filterType, length)) return 0;
+#endif /*LODEPNG_SSE2 || LODEPNG_NEON*/
   switch(filterType) {
     case 0:
       for(i = 0; i != length; ++i) recon[i] = scanline[i];
@@ -5570,6 +5912,414 @@ unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h, const u
   return lodepng_decode_memory(out, w, h, in, insize, LCT_RGB, 8);
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / PNG Row Streaming Decoder                                              / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+/*size of the compressed input buffer, and how much of it is kept ahead of the bit
+reader: enough for a dynamic block header, and for the symbols between refills*/
+#define ROWSTREAM_INSIZE 65536u
+#define ROWSTREAM_INAHEAD 1024u
+/*the inflated data is kept for the deflate window, 32K, behind its end*/
+#define ROWSTREAM_WINDOW 32768u
+
+typedef struct RowStream {
+  LodePNGReadCallback read;
+  void* read_user;
+  unsigned chunk_left; /*bytes of the current IDAT chunk not yet read*/
+  unsigned chunk_crc; /*running CRC of the current IDAT chunk*/
+  unsigned idat_end; /*all IDAT chunks have been read*/
+  const LodePNGDecoderSettings* settings;
+  unsigned char* in; /*compressed input, the data of the bit reader*/
+  LodePNGBitReader reader;
+  HuffmanTree tree_ll;
+  HuffmanTree tree_d;
+  unsigned block; /*0: at a block header, 1: in a stored block, 2: in a huffman block*/
+  unsigned final; /*the current block is the last one*/
+  unsigned done; /*the last block has ended*/
+  size_t stored_left; /*bytes left of the stored block*/
+  ucvector out; /*inflated data: the window and the data not yet read*/
+  size_t out_pos; /*start of the inflated data not yet read*/
+  unsigned adler; /*adler32 of the inflated data read so far*/
+} RowStream;
+
+static unsigned rowStreamInit(RowStream* s, LodePNGReadCallback read, void* read_user,
+                              const LodePNGDecoderSettings* settings) {
+  lodepng_memset(s, 0, sizeof(*s));
+  s->read = read;
+  s->read_user = read_user;
+  s->settings = settings;
+  s->adler = 1u;
+  HuffmanTree_init(&s->tree_ll);
+  HuffmanTree_init(&s->tree_d);
+  s->out = ucvector_init(0, 0);
+  s->in = (unsigned char*)lodepng_malloc(ROWSTREAM_INSIZE);
+  if(!s->in) return 83; /*alloc fail*/
+  return LodePNGBitReader_init(&s->reader, s->in, 0);
+}
+
+static void rowStreamCleanup(RowStream* s) {
+  HuffmanTree_cleanup(&s->tree_ll);
+  HuffmanTree_cleanup(&s->tree_d);
+  lodepng_free(s->out.data);
+  lodepng_free(s->in);
+}
+
+/*reads exactly size bytes of the file, error 30 if it ends first*/
+static unsigned rowStreamRead(RowStream* s, unsigned char* buf, size_t size) {
+  while(size) {
+    size_t n = s->read(s->read_user, buf, size);
+    if(n == 0 || n > size) return 30; /*chunk broken off at end of file*/
+    buf += n;
+    size -= n;
+  }
+  return 0;
+}
+
+/*starts reading the data of an IDAT chunk, given its length and type*/
+static unsigned rowStreamStartChunk(RowStream* s, const unsigned char* header) {
+  if(lodepng_chunk_length(header) > 2147483647) return 63; /*chunk length larger than the max PNG chunk size*/
+  s->chunk_left = lodepng_chunk_length(header);
+#ifdef LODEPNG_COMPILE_CRC
+  s->chunk_crc = lodepng_crc32_update(0xffffffffu, header + 4, 4);
+#endif /*LODEPNG_COMPILE_CRC*/
+  return 0;
+}
+
+/*ends the current IDAT chunk, checking its CRC, and starts the next chunk if that is an IDAT too*/
+static unsigned rowStreamNextChunk(RowStream* s) {
+  unsigned char buf[8];
+  unsigned error = rowStreamRead(s, buf, 4);
+  if(error) return error;
+#ifdef LODEPNG_COMPILE_CRC
+  if(!s->settings->ignore_crc && lodepng_read32bitInt(buf) != (s->chunk_crc ^ 0xffffffffu)) return 57; /*invalid CRC*/
+#endif /*LODEPNG_COMPILE_CRC*/
+  error = rowStreamRead(s, buf, 8);
+  if(error) return error;
+  if(!lodepng_chunk_type_equals(buf, "IDAT")) {
+    s->idat_end = 1;
+    return 0;
+  }
+  return rowStreamStartChunk(s, buf);
+}
+
+/*moves the unread input to the start of the buffer and reads IDAT data after it, if less
+than ROWSTREAM_INAHEAD bytes are left. The reader's bit pointer must be within its data.*/
+static unsigned rowStreamFill(RowStream* s) {
+  size_t start = s->reader.bp >> 3u, size = s->reader.size, i;
+  unsigned error = 0;
+  if(size - start >= ROWSTREAM_INAHEAD || s->idat_end) return 0;
+  for(i = start; i < size; ++i) s->in[i - start] = s->in[i]; /*overlapping, so no lodepng_memcpy*/
+  size -= start;
+  s->reader.bp -= start << 3u;
+  while(!error && size < ROWSTREAM_INSIZE && !s->idat_end) {
+    if(s->chunk_left == 0) {
+      error = rowStreamNextChunk(s);
+    } else {
+      size_t n = ROWSTREAM_INSIZE - size;
+      if(n > s->chunk_left) n = s->chunk_left;
+      error = rowStreamRead(s, s->in + size, n);
+#ifdef LODEPNG_COMPILE_CRC
+      s->chunk_crc = lodepng_crc32_update(s->chunk_crc, s->in + size, n);
+#endif /*LODEPNG_COMPILE_CRC*/
+      s->chunk_left -= (unsigned)n;
+      size += n;
+    }
+  }
+  s->reader.size = size;
+  s->reader.bitsize = size << 3u;
+  return error;
+}
+
+/*inflates until size bytes are unread, or the end of the deflate data*/
+static unsigned rowStreamInflate(RowStream* s, size_t size) {
+  unsigned error = 0;
+  while(!error && !s->done && s->out.size - s->out_pos < size) {
+    error = rowStreamFill(s);
+    if(error) break;
+    if(s->block == 0) {
+      unsigned BTYPE;
+      if(s->reader.bitsize - s->reader.bp < 3) ERROR_BREAK(52); /*error, bit pointer will jump past memory*/
+      ensureBits9(&s->reader, 3);
+      s->final = readBits(&s->reader, 1);
+      BTYPE = readBits(&s->reader, 2);
+      if(BTYPE == 3) ERROR_BREAK(20); /*error: invalid BTYPE*/
+      if(BTYPE == 0) {
+        size_t bytepos = (s->reader.bp + 7u) >> 3u;
+        unsigned LEN, NLEN;
+        if(bytepos + 4 >= s->reader.size) ERROR_BREAK(52); /*error, bit pointer will jump past memory*/
+        LEN = (unsigned)s->in[bytepos] + ((unsigned)s->in[bytepos + 1] << 8u);
+        NLEN = (unsigned)s->in[bytepos + 2] + ((unsigned)s->in[bytepos + 3] << 8u);
+        if(!s->settings->zlibsettings.ignore_nlen && LEN + NLEN != 65535) ERROR_BREAK(21);
+        s->reader.bp = (bytepos + 4) << 3u;
+        s->stored_left = LEN;
+        s->block = 1;
+      } else {
+        HuffmanTree_cleanup(&s->tree_ll);
+        HuffmanTree_cleanup(&s->tree_d);
+        HuffmanTree_init(&s->tree_ll);
+        HuffmanTree_init(&s->tree_d);
+        if(BTYPE == 1) error = getTreeInflateFixed(&s->tree_ll, &s->tree_d);
+        else error = getTreeInflateDynamic(&s->tree_ll, &s->tree_d, &s->reader);
+        if(!error) error = HuffmanTree_makeMultiTable(&s->tree_ll);
+        s->block = 2;
+      }
+    } else if(s->block == 1) {
+      size_t bytepos = s->reader.bp >> 3u; /*stored data is byte aligned*/
+      size_t n = s->reader.size - bytepos;
+      if(n > s->stored_left) n = s->stored_left;
+      if(n == 0 && s->stored_left) ERROR_BREAK(23); /*error: reading outside of in buffer*/
+      if(!ucvector_reserve(&s->out, s->out.size + n)) ERROR_BREAK(83); /*alloc fail*/
+      if(n) lodepng_memcpy(s->out.data + s->out.size, s->in + bytepos, n);
+      s->out.size += n;
+      s->reader.bp += n << 3u;
+      s->stored_left -= n;
+      if(!s->stored_left) s->block = 0;
+    } else {
+      /*stop for a refill while there is still input ahead, unless that was the last of it*/
+      size_t stop_bp = s->idat_end ? (size_t)(-1) : (s->reader.size - ROWSTREAM_INAHEAD) << 3u;
+      int end = 0;
+      error = inflateHuffmanSymbols(&s->out, &s->reader, &s->tree_ll, &s->tree_d, 0, s->out_pos + size, stop_bp, &end);
+      if(end) s->block = 0;
+    }
+    if(s->block == 0 && s->final) s->done = 1;
+  }
+  return error;
+}
+
+/*points data to the next size bytes of inflated data and marks them read*/
+static unsigned rowStreamTake(RowStream* s, const unsigned char** data, size_t size) {
+  unsigned error;
+  /*drop the inflated data that is read and out of the window, once there is enough of it*/
+  size_t drop = s->out.size > ROWSTREAM_WINDOW ? s->out.size - ROWSTREAM_WINDOW : 0;
+  if(drop > s->out_pos) drop = s->out_pos;
+  if(drop >= ROWSTREAM_WINDOW) {
+    size_t i;
+    for(i = drop; i < s->out.size; ++i) s->out.data[i - drop] = s->out.data[i];
+    s->out.size -= drop;
+    s->out_pos -= drop;
+  }
+  error = rowStreamInflate(s, size);
+  if(error) return error;
+  if(s->out.size - s->out_pos < size) return 91; /*decompressed size doesn't match prediction*/
+  *data = s->out.data + s->out_pos;
+  s->out_pos += size;
+  if(!s->settings->zlibsettings.ignore_adler32) s->adler = update_adler32(s->adler, *data, (unsigned)size);
+  return 0;
+}
+
+/*reads the next scanline, the filter type byte and length bytes, and unfilters it into recon*/
+static unsigned rowStreamScanline(RowStream* s, unsigned char* recon, const unsigned char* precon,
+                                  size_t bytewidth, size_t length) {
+  const unsigned char* scanline;
+  unsigned error = rowStreamTake(s, &scanline, length + 1);
+  if(error) return error;
+  return unfilterScanline(recon, scanline + 1, precon, bytewidth, scanline[0], length);
+}
+
+/*after the last scanline: the deflate data must end there, then the adler32 of the zlib data*/
+static unsigned rowStreamFinish(RowStream* s) {
+  size_t bytepos;
+  unsigned error = rowStreamInflate(s, 1);
+  if(error) return error;
+  if(s->out.size != s->out_pos) return 91; /*decompressed size doesn't match prediction*/
+  error = rowStreamFill(s);
+  /*check the CRC of the last IDAT chunk, if its data has all been read*/
+  if(!error && !s->idat_end && s->chunk_left == 0) error = rowStreamNextChunk(s);
+  if(error || s->settings->zlibsettings.ignore_adler32) return error;
+  bytepos = (s->reader.bp + 7u) >> 3u;
+  if(bytepos + 4 > s->reader.size) return 52; /*error, bit pointer will jump past memory*/
+  if(lodepng_read32bitInt(s->in + bytepos) != s->adler) return 58; /*error, adler checksum not correct*/
+  return 0;
+}
+
+/*composes an even row of an Adam7 image, which has pixels of the first 6 passes only*/
+static void Adam7_composeRow(unsigned char* out, const unsigned char* passes, const unsigned passw[7],
+                             const size_t padded_passstart[8], unsigned y, unsigned bpp) {
+  unsigned i, x;
+  for(i = 0; i != 6; ++i) {
+    size_t linebytes = (passw[i] * bpp + 7u) / 8u;
+    const unsigned char* line;
+    if(passw[i] == 0 || y < ADAM7_IY[i] || (y - ADAM7_IY[i]) % ADAM7_DY[i] != 0) continue;
+    line = passes + padded_passstart[i] + (size_t)((y - ADAM7_IY[i]) / ADAM7_DY[i]) * linebytes;
+    if(bpp >= 8) {
+      size_t bytewidth = bpp / 8u;
+      for(x = 0; x != passw[i]; ++x) {
+        lodepng_memcpy(out + (ADAM7_IX[i] + (size_t)x * ADAM7_DX[i]) * bytewidth, line + x * bytewidth, bytewidth);
+      }
+    } else {
+      for(x = 0; x != passw[i]; ++x) {
+        size_t ibp = (size_t)x * bpp;
+        size_t obp = (ADAM7_IX[i] + (size_t)x * ADAM7_DX[i]) * bpp;
+        unsigned b;
+        for(b = 0; b != bpp; ++b) setBitOfReversedStream(&obp, out, readBitFromReversedStream(&ibp, line));
+      }
+    }
+  }
+}
+
+/*collects converted rows into a band, and gives full bands to the row callback*/
+typedef struct RowBand {
+  LodePNGRowCallback callback;
+  void* user;
+  unsigned char* rows;
+  size_t rowbytes;
+  unsigned band_h, w, h;
+  unsigned y; /*first row of the band*/
+  unsigned count; /*rows in the band*/
+} RowBand;
+
+static unsigned rowBandAdd(RowBand* band, const unsigned char* scanline, const LodePNGState* state) {
+  unsigned error = lodepng_convert(band->rows + band->count * band->rowbytes, scanline,
+                                   &state->info_raw, &state->info_png.color, band->w, 1);
+  if(error) return error;
+  if(++band->count == band->band_h || band->y + band->count == band->h) {
+    if(band->callback(band->user, band->rows, band->y, band->count, band->w, band->h)) return 124;
+    band->y += band->count;
+    band->count = 0;
+  }
+  return 0;
+}
+
+/*reads the chunks before the image data, up to and including the header of the first IDAT chunk*/
+static unsigned rowStreamReadChunks(RowStream* s, LodePNGState* state) {
+  unsigned error = 0;
+  while(!error) {
+    unsigned char header[8];
+    unsigned char* chunk;
+    unsigned chunkLength;
+    error = rowStreamRead(s, header, 8);
+    if(error) break;
+    chunkLength = lodepng_chunk_length(header);
+    if(chunkLength > 2147483647) CERROR_BREAK(error, 63);
+    if(lodepng_chunk_type_equals(header, "IDAT")) return rowStreamStartChunk(s, header);
+    if(lodepng_chunk_type_equals(header, "IEND")) {
+      /*no image data: the zlib data is empty*/
+      s->idat_end = 1;
+      break;
+    }
+    if(!lodepng_chunk_type_name_valid(header)) CERROR_BREAK(error, 121); /* invalid chunk type name */
+    if(lodepng_chunk_reserved(header)) CERROR_BREAK(error, 122); /* invalid third lowercase character */
+    /*error: unknown critical chunk (5th bit of first byte of chunk type is 0)*/
+    if(!state->decoder.ignore_critical && !lodepng_chunk_ancillary(header) &&
+       !lodepng_chunk_type_equals(header, "PLTE")) {
+      CERROR_BREAK(error, 69);
+    }
+    chunk = (unsigned char*)lodepng_malloc((size_t)chunkLength + 12);
+    if(!chunk) CERROR_BREAK(error, 83); /*alloc fail*/
+    lodepng_memcpy(chunk, header, 8);
+    error = rowStreamRead(s, chunk + 8, (size_t)chunkLength + 4);
+    /*reads the chunks lodepng_inspect_chunk knows and checks their CRC, ignores others*/
+    if(!error) error = lodepng_inspect_chunk(state, 0, chunk, (size_t)chunkLength + 12);
+    lodepng_free(chunk);
+  }
+  return error;
+}
+
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state, unsigned band_h,
+                             LodePNGReadCallback read, void* read_user, LodePNGRowCallback callback, void* user) {
+  RowStream s;
+  RowBand band;
+  unsigned char header[33];
+  unsigned char* passes = 0; /*the unfiltered first 6 Adam7 passes*/
+  unsigned char* lines = 0; /*two scanlines, and a composed Adam7 row*/
+  unsigned bpp = 0, y;
+  size_t bytewidth = 0, linebytes = 0;
+  unsigned error = rowStreamInit(&s, read, read_user, &state->decoder);
+
+  *w = *h = 0;
+  band.rows = 0;
+  if(band_h == 0) band_h = 1;
+
+  if(!error) error = rowStreamRead(&s, header, 33);
+  if(!error) error = lodepng_inspect(w, h, state, header, 33);
+  if(!error && lodepng_pixel_overflow(*w, *h, &state->info_png.color, &state->info_raw)) {
+    error = 92; /*overflow possible due to amount of pixels*/
+  }
+  if(!error) error = rowStreamReadChunks(&s, state);
+  if(!error && state->info_png.color.colortype == LCT_PALETTE && !state->info_png.color.palette) {
+    error = 106; /* error: PNG file must have PLTE chunk if color type is palette */
+  }
+
+  /*the zlib header*/
+  if(!error) error = rowStreamFill(&s);
+  if(!error && s.reader.size < 2) error = 53; /*error, size of zlib data too small*/
+  if(!error) {
+    if((s.in[0] * 256 + s.in[1]) % 31 != 0) error = 24; /*256 * in[0] + in[1] must be a multiple of 31*/
+    else if((s.in[0] & 15) != 8 || ((s.in[0] >> 4) & 15) > 7) error = 25; /*only compression method 8*/
+    else if(((s.in[1] >> 5) & 1) != 0) error = 26; /*no preset dictionary*/
+    s.reader.bp = 16;
+  }
+
+  if(!error) {
+    bpp = lodepng_get_bpp(&state->info_png.color);
+    bytewidth = (bpp + 7u) / 8u;
+    linebytes = ((size_t)(*w) * bpp + 7u) / 8u;
+    band.callback = callback;
+    band.user = user;
+    band.rowbytes = lodepng_get_raw_size(*w, 1, &state->info_raw);
+    band.band_h = band_h < *h ? band_h : *h;
+    band.w = *w;
+    band.h = *h;
+    band.y = band.count = 0;
+    band.rows = (unsigned char*)lodepng_malloc(band.rowbytes * band.band_h);
+    lines = (unsigned char*)lodepng_malloc(linebytes * 3);
+    if(!band.rows || !lines) error = 83; /*alloc fail*/
+  }
+
+  if(!error && state->info_png.interlace_method == 0) {
+    unsigned char* cur = lines;
+    unsigned char* prev = lines + linebytes;
+    for(y = 0; !error && y != *h; ++y) {
+      unsigned char* swap = cur;
+      error = rowStreamScanline(&s, cur, y ? prev : 0, bytewidth, linebytes);
+      if(!error) error = rowBandAdd(&band, cur, state);
+      cur = prev;
+      prev = swap;
+    }
+  } else if(!error) {
+    /*The odd rows are the last pass. The first 6 passes have all of the even rows, they
+    are kept, then the rows are given in order as the scanlines of the last pass come.*/
+    unsigned passw[7], passh[7], i;
+    size_t filter_passstart[8], padded_passstart[8], passstart[8];
+    unsigned char* cur = lines;
+    unsigned char* prev = lines + linebytes;
+    unsigned char* row = lines + linebytes * 2;
+
+    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, *w, *h, bpp);
+    passes = (unsigned char*)lodepng_malloc(padded_passstart[6] + 1);
+    if(!passes) error = 83; /*alloc fail*/
+    for(i = 0; !error && i != 6; ++i) {
+      size_t passbytes = (passw[i] * bpp + 7u) / 8u;
+      for(y = 0; !error && y != passh[i]; ++y) {
+        unsigned char* recon = passes + padded_passstart[i] + y * passbytes;
+        error = rowStreamScanline(&s, recon, y ? recon - passbytes : 0, bytewidth, passbytes);
+      }
+    }
+    for(y = 0; !error && y != *h; ++y) {
+      if(y & 1u) {
+        unsigned char* swap = cur;
+        error = rowStreamScanline(&s, cur, y > 1 ? prev : 0, bytewidth, linebytes);
+        if(!error) error = rowBandAdd(&band, cur, state);
+        cur = prev;
+        prev = swap;
+      } else {
+        Adam7_composeRow(row, passes, passw, padded_passstart, y, bpp);
+        error = rowBandAdd(&band, row, state);
+      }
+    }
+  }
+
+  if(!error) error = rowStreamFinish(&s);
+
+  lodepng_free(passes);
+  lodepng_free(lines);
+  lodepng_free(band.rows);
+  rowStreamCleanup(&s);
+  state->error = error;
+  return error;
+}
+
 #ifdef LODEPNG_COMPILE_DISK
 unsigned lodepng_decode_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename,
                              LodePNGColorType colortype, unsigned bitdepth) {
@@ -5592,6 +6342,29 @@ unsigned lodepng_decode32_file(unsigned char** out, unsigned* w, unsigned* h, co
 unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h, const char* filename) {
   return lodepng_decode_file(out, w, h, filename, LCT_RGB, 8);
 }
+
+static size_t lodepng_read_file_callback(void* user, unsigned char* buf, size_t size) {
+  return fread(buf, 1, size, (FILE*)user);
+}
+
+unsigned lodepng_decode32_file_rows(unsigned* w, unsigned* h, const char* filename, unsigned band_h,
+                                    LodePNGRowCallback callback, void* user) {
+  unsigned error;
+  LodePNGState state;
+  FILE* file = fopen(filename, "rb");
+  *w = *h = 0;
+  if(!file) return 78;
+  lodepng_state_init(&state);
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  /*disable reading things that this function doesn't output*/
+  state.decoder.read_text_chunks = 0;
+  state.decoder.remember_unknown_chunks = 0;
+#endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
+  error = lodepng_decode_rows(w, h, &state, band_h, lodepng_read_file_callback, file, callback, user);
+  lodepng_state_cleanup(&state);
+  fclose(file);
+  return error;
+}
 #endif /*LODEPNG_COMPILE_DISK*/
 
 void lodepng_decoder_settings_init(LodePNGDecoderSettings* settings) {
@@ -7023,6 +7796,8 @@ const char* lodepng_error_text(unsigned code) {
     case 121: return "invalid chunk type name: may only contain [a-zA-Z]";
     case 122: return "invalid chunk type name: third character must be uppercase";
     case 123: return "invalid ICC profile size";
+    case 124: return "the row callback of lodepng_decode_rows stopped decoding";
+    case 125: return "lodepng_deflate_part: the history is longer than the input";
   }
   return "unknown error code";
 }
@@ -102,6 +102,13 @@ or comment out LODEPNG_COMPILE_CRC below*/
 #define LODEPNG_COMPILE_CRC
 #endif
 
+/*SSE2 (x86) or NEON (ARM) versions of the PNG unfilters, used when the compiler
+targets those instruction sets. Their output is identical to that of the portable code.*/
+#ifndef LODEPNG_NO_COMPILE_SIMD
+/*pass -DLODEPNG_NO_COMPILE_SIMD to the compiler to disable this, or comment out LODEPNG_COMPILE_SIMD below*/
+#define LODEPNG_COMPILE_SIMD
+#endif
+
 /*compile the C++ version (you can disable the C++ wrapper here even when compiling for C++)*/
 #ifdef __cplusplus
 #ifndef LODEPNG_NO_COMPILE_CPP
@@ -160,6 +167,13 @@ unsigned lodepng_decode32(unsigned char** out, unsigned* w, unsigned* h,
 unsigned lodepng_decode24(unsigned char** out, unsigned* w, unsigned* h,
                           const unsigned char* in, size_t insize);
 
+/*Callbacks of the streaming decoder, see lodepng_decode_rows.
+The read callback gives up to size bytes of the PNG file in buf, returns the amount, 0 at the end of the file.
+The row callback gets rows y to y + h - 1 of the image of size w_image * h_image, returns nonzero to stop decoding.*/
+typedef size_t (*LodePNGReadCallback)(void* user, unsigned char* buf, size_t size);
+typedef unsigned (*LodePNGRowCallback)(void* user, const unsigned char* rows, unsigned y, unsigned h,
+                                       unsigned w_image, unsigned h_image);
+
 #ifdef LODEPNG_COMPILE_DISK
 /*
 Load PNG from disk, from file with given name.
@@ -184,6 +198,11 @@ NOTE: Wide-character filenames are not supported, you can use an external method
 to handle such files and decode in-memory.*/
 unsigned lodepng_decode24_file(unsigned char** out, unsigned* w, unsigned* h,
                                const char* filename);
+
+/*Same as lodepng_decode_rows with the file with given name, and always decodes to
+32-bit RGBA rows, see lodepng_decode_rows.*/
+unsigned lodepng_decode32_file_rows(unsigned* w, unsigned* h, const char* filename, unsigned band_h,
+                                    LodePNGRowCallback callback, void* user);
 #endif /*LODEPNG_COMPILE_DISK*/
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -992,6 +1011,21 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+/*
+Streaming decode, for big images with little memory. Same as lodepng_decode, but
+reads the PNG with the read callback, inflates and unfilters a few scanlines at a
+time, and gives bands of up to band_h rows in the color type of state->info_raw
+to the row callback, in order from the top. Each row is
+lodepng_get_raw_size(w, 1, &state->info_raw) bytes.
+Memory used is the 64KB input buffer, the 32KB deflate window and a few rows, not the
+image. Adam7 interlaced images also keep the first 6 passes, half the pixels in the
+color type of the PNG, since the odd rows come in the last pass.
+A nonzero return of the row callback stops decoding with error 124.
+Chunks after the image data are not read, and custom_zlib and custom_inflate are not used.
+*/
+unsigned lodepng_decode_rows(unsigned* w, unsigned* h, LodePNGState* state, unsigned band_h,
+                             LodePNGReadCallback read, void* read_user, LodePNGRowCallback callback, void* user);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 /*
@@ -1160,6 +1194,19 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Compress a part of a deflate stream, for compressing the parts of a buffer in
+parallel. Reallocates the out buffer and appends the data.
+in[inpos..insize-1] is compressed, and the last windowsize bytes of
+in[0..inpos-1], which are the end of the previous part, may be referred to.
+If final is 0, the output ends with an empty stored block (a zlib sync flush)
+rather than with the final block, so it is byte aligned, and the next part's
+output can be appended to it. The zlib header and adler32 trailer are not added.
+*/
+unsigned lodepng_deflate_part(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t inpos, size_t insize, unsigned final,
+                              const LodePNGCompressSettings* settings);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -28,6 +28,7 @@ freely, subject to the following restrictions:
 
 #include "lodepng.h"
 
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <vector>
@@ -61,6 +62,7 @@ bool verbose = false;
 bool do_decode = false;
 bool do_encode = false;
 bool decode_encoded = false; // do the decoding benchmark on the encoded images rather than the original inputs
+bool do_filters = false; // run the per filter type benchmark on the generated corpus
 
 std::string dumpdir;
 
@@ -264,6 +266,152 @@ void testFile(const std::string& filename) {
   if(verbose) std::cout << std::endl;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Filter benchmark: a fixed, generated corpus is encoded with each PNG filter
+// type for all scanlines, and decoded, giving the decode rate per filter in
+// MB/s of decoded pixels. Each is also encoded with stored (uncompressed)
+// deflate blocks and decoded ignoring the checksums, so that unfiltering is
+// most of the decode time. The decoded pixels must equal the corpus pixels.
+
+unsigned corpus_seed = 1;
+
+unsigned corpusRand() {
+  corpus_seed = corpus_seed * 1103515245u + 12345u;
+  return (corpus_seed >> 16) & 32767u;
+}
+
+unsigned char clampByte(double v) {
+  return v < 0 ? 0 : v > 255 ? 255 : (unsigned char)v;
+}
+
+void addCorpusImage(std::vector<Image>& corpus, const std::string& name, unsigned w, unsigned h, LodePNGColorType colorType) {
+  Image image;
+  image.name = name;
+  image.width = w;
+  image.height = h;
+  image.colorType = colorType;
+  image.bitDepth = 8;
+  image.data.resize((size_t)w * h * (colorType == LCT_RGBA ? 4 : 3));
+  corpus.push_back(image);
+}
+
+// Images like the ones the apps decode: an icon with soft edged transparency,
+// a photo like image with gradients and noise, and a map like image with flat
+// areas and lines.
+void makeCorpus(std::vector<Image>& corpus) {
+  corpus_seed = 1;
+
+  addCorpusImage(corpus, "icon", 256, 256, LCT_RGBA);
+  {
+    Image& image = corpus.back();
+    for(unsigned y = 0; y < image.height; y++)
+    for(unsigned x = 0; x < image.width; x++) {
+      unsigned char* p = &image.data[(y * image.width + x) * 4];
+      double sun = 80 - std::sqrt((x - 100.0) * (x - 100.0) + (y - 100.0) * (y - 100.0));
+      double cloud = 60 - std::sqrt((x - 150.0) * (x - 150.0) / 2 + (y - 170.0) * (y - 170.0));
+      if(cloud > 0) {
+        p[0] = p[1] = p[2] = clampByte(200 + y / 8);
+        p[3] = clampByte(cloud * 64);
+      } else {
+        p[0] = 255; p[1] = clampByte(160 + sun); p[2] = 0;
+        p[3] = clampByte(sun * 64);
+      }
+    }
+  }
+
+  addCorpusImage(corpus, "photo", 1024, 768, LCT_RGB);
+  {
+    Image& image = corpus.back();
+    for(unsigned y = 0; y < image.height; y++)
+    for(unsigned x = 0; x < image.width; x++) {
+      unsigned char* p = &image.data[(y * image.width + x) * 3];
+      double v = std::sin(x / 50.0) * std::cos(y / 70.0);
+      p[0] = clampByte(128 + 100 * v + (corpusRand() % 16) - 8);
+      p[1] = clampByte(100 + 80 * std::sin((x + y) / 90.0) + (corpusRand() % 16) - 8);
+      p[2] = clampByte(60 + y / 6 + (corpusRand() % 16) - 8);
+    }
+  }
+
+  addCorpusImage(corpus, "map", 1024, 1024, LCT_RGBA);
+  {
+    static const unsigned char colors[4][3] = {{238, 235, 226}, {200, 222, 180}, {170, 210, 240}, {250, 250, 245}};
+    Image& image = corpus.back();
+    for(unsigned y = 0; y < image.height; y++)
+    for(unsigned x = 0; x < image.width; x++) {
+      unsigned char* p = &image.data[(y * image.width + x) * 4];
+      const unsigned char* c = colors[(x / 160 + (y / 120) * 3) % 3];
+      if((x + 2 * y) % 97 < 3 || (3 * x + y) % 151 < 2) c = colors[3];
+      else if(x % 128 < 2 || y % 128 < 2) c = colors[2];
+      p[0] = c[0]; p[1] = c[1]; p[2] = c[2]; p[3] = 255;
+    }
+  }
+}
+
+// returns the seconds to decode the png NUM_DECODE times
+double timeFilterDecode(const std::vector<unsigned char>& png, const Image& image, bool ignore_checksums) {
+  lodepng::State state;
+  state.info_raw.colortype = image.colorType;
+  state.info_raw.bitdepth = image.bitDepth;
+  state.decoder.ignore_crc = ignore_checksums;
+  state.decoder.zlibsettings.ignore_adler32 = ignore_checksums;
+
+  double t0 = getTime();
+  for(int i = 0; i < NUM_DECODE; i++) {
+    unsigned char* decoded = 0;
+    unsigned w, h;
+    unsigned error = lodepng_decode(&decoded, &w, &h, &state, png.data(), png.size());
+    assertEquals(0, error, "decoder error");
+    assertTrue(w == image.width && h == image.height &&
+               std::equal(image.data.begin(), image.data.end(), decoded), "decoded pixels differ, " + image.name);
+    free(decoded);
+  }
+  return getTime() - t0;
+}
+
+void testFilters() {
+  static const char* names[5] = {"none", "sub", "up", "average", "paeth"};
+  std::vector<Image> corpus;
+  size_t raw_size = 0;
+
+  makeCorpus(corpus);
+  for(size_t i = 0; i < corpus.size(); i++) raw_size += corpus[i].data.size();
+
+  for(int filter = 0; filter < 5; filter++) {
+    double dec_time = 0, stored_time = 0;
+    size_t png_size = 0;
+
+    for(size_t i = 0; i < corpus.size(); i++) {
+      Image& image = corpus[i];
+      for(int stored = 0; stored < 2; stored++) {
+        std::vector<unsigned char> png;
+        lodepng::State state;
+        state.info_raw.colortype = image.colorType;
+        state.info_raw.bitdepth = image.bitDepth;
+        state.info_png.color.colortype = image.colorType;
+        state.info_png.color.bitdepth = image.bitDepth;
+        state.encoder.auto_convert = 0;
+        state.encoder.filter_palette_zero = 0;
+        state.encoder.filter_strategy = (LodePNGFilterStrategy)(LFS_ZERO + filter);
+        if(stored) state.encoder.zlibsettings.btype = 0;
+        assertEquals(0, lodepng::encode(png, image.data, image.width, image.height, state), "encoder error");
+
+        if(stored) {
+          stored_time += timeFilterDecode(png, image, true);
+        } else {
+          dec_time += timeFilterDecode(png, image, false);
+          png_size += png.size();
+        }
+      }
+    }
+
+    double mb = NUM_DECODE * raw_size / 1024.0 / 1024.0;
+    std::cout << "filter " << names[filter] << ": decode " << (mb / dec_time) << " MB/s, "
+              << "stored " << (mb / stored_time) << " MB/s, "
+              << "png size " << png_size << " (" << (100.0 * png_size / raw_size) << "%)" << std::endl;
+  }
+}
+
 void showHelp(int argc, char *argv[]) {
   (void)argc;
   std::cout << "Usage: " << argv[0] << " png_filenames... [OPTIONS...] [--dumpdir directory]" << std::endl;
@@ -273,6 +421,7 @@ void showHelp(int argc, char *argv[]) {
   std::cout << "  -d: decode only" << std::endl;
   std::cout << "  -e: encode only" << std::endl;
   std::cout << "  -o: decode on original images rather than encoded ones (always true if -d without -e)" << std::endl;
+  std::cout << "  -f: decode a generated corpus encoded with each filter type, and report MB/s per filter type; no filenames needed" << std::endl;
   std::cout << "  -m: apply modifications to encoder and decoder settings, the modification itself must be implemented or changed in the benchmark source code (search for apply_mods in the code, for encode and for decode)" << std::endl;
 }
 
@@ -292,6 +441,7 @@ int main(int argc, char *argv[]) {
     else if(arg == "-e") do_encode ? (do_decode = false) : (do_encode = true);
     else if(arg == "-o") decode_encoded = false;
     else if(arg == "-m") apply_mods = true;
+    else if(arg == "-f") do_filters = true;
     else if(arg == "--dumpdir" && i + 1 < argc) {
       dumpdir = argv[++i];
     }
@@ -300,6 +450,11 @@ int main(int argc, char *argv[]) {
 
   if(!do_encode) decode_encoded = false;
 
+  if(do_filters) {
+    testFilters();
+    if(files.empty()) return 0;
+  }
+
   if(files.empty()) {
     std::cout << "must give .png filenames to benchamrk" << std::endl;
     showHelp(argc, argv);
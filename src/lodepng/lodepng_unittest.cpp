@@ -1194,6 +1194,68 @@ void testCompressZlib() {
   testCompressStringZlib("lodepng_zlib_decompress(&out2, &outsize2, out, outsize, &lodepng_default_decompress_settings);", true);
 }
 
+//deflates the parts of in separately, each with the previous data as history, and inflates the joined parts
+void testDeflateParts(const std::vector<unsigned char>& in, const std::vector<size_t>& splits, unsigned btype) {
+  std::cout << "testDeflateParts: size " << in.size() << ", " << (splits.size() + 1) << " parts, btype " << btype << std::endl;
+  LodePNGCompressSettings settings;
+  lodepng_compress_settings_init(&settings);
+  settings.btype = btype;
+
+  unsigned char* out = 0;
+  size_t outsize = 0;
+  size_t start = 0;
+  for(size_t i = 0; i <= splits.size(); i++) {
+    size_t end = i < splits.size() ? splits[i] : in.size();
+    unsigned error = lodepng_deflate_part(&out, &outsize, in.empty() ? 0 : &in[0], start, end,
+                                          i == splits.size(), &settings);
+    ASSERT_NO_PNG_ERROR(error);
+    if(i < splits.size()) {
+      //a sync flush ends each part but the last
+      assertTrue(outsize >= 4);
+      ASSERT_EQUALS(0, out[outsize - 4]);
+      ASSERT_EQUALS(0, out[outsize - 3]);
+      ASSERT_EQUALS(255, out[outsize - 2]);
+      ASSERT_EQUALS(255, out[outsize - 1]);
+    }
+    start = end;
+  }
+
+  unsigned char* out2 = 0;
+  size_t outsize2 = 0;
+  unsigned error = lodepng_inflate(&out2, &outsize2, out, outsize, &lodepng_default_decompress_settings);
+  ASSERT_NO_PNG_ERROR(error);
+  ASSERT_EQUALS(in.size(), outsize2);
+  for(size_t i = 0; i < in.size(); i++) ASSERT_EQUALS(in[i], out2[i]);
+
+  free(out);
+  free(out2);
+}
+
+void testDeflateParts() {
+  std::vector<unsigned char> in;
+  std::vector<size_t> splits;
+  srand(1234);
+  for(size_t i = 0; i < 1000; i++) in.push_back((unsigned char)(rand() & 255));
+  for(size_t i = 0; i < 1000; i++) in.push_back(in[i]);
+  for(size_t i = 0; i < 100000; i++) in.push_back((unsigned char)(i % 7 == 0 ? rand() & 3 : 0));
+
+  splits.push_back(1000);
+  splits.push_back(2000);
+  splits.push_back(2001);
+  splits.push_back(2001);
+  splits.push_back(50000);
+  for(unsigned btype = 0; btype < 3; btype++) testDeflateParts(in, splits, btype);
+  testDeflateParts(in, std::vector<size_t>(), 2);
+  testDeflateParts(std::vector<unsigned char>(), std::vector<size_t>(1, 0), 2);
+
+  //the second part repeats the first, and is compressed to a few bytes by referring to its history
+  unsigned char* out = 0;
+  size_t outsize = 0;
+  ASSERT_NO_PNG_ERROR(lodepng_deflate_part(&out, &outsize, &in[0], 1000, 2000, 1, &lodepng_default_compress_settings));
+  assertTrue(outsize < 100);
+  free(out);
+}
+
 void testDiskCompressZlib(const std::string& filename) {
   std::cout << "testDiskCompressZlib: File " << filename << std::endl;
 
@@ -3972,6 +4034,7 @@ void doMain() {
 
   //Zlib
   testCompressZlib();
+  testDeflateParts();
   testHuffmanCodeLengths();
   testCustomZlibCompress();
   testCustomZlibCompress2();
@@ -511,6 +511,11 @@ struct Picoc_Struct {
     jmp_buf PicocExitBuf;
 #endif
 
+#ifdef UNIX_HOST
+    /* source files mapped by PicocPlatformScanFile */
+    struct PlatformSourceView *SourceViews;
+#endif
+
     /* string table */
     struct Table StringTable;
     struct TableEntry *StringHashTable[STRING_TABLE_SIZE];
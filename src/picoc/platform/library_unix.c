@@ -283,6 +283,46 @@ void Sdl_render_multiline_text (struct ParseState *Parser, struct Value *ReturnV
     sdlx_render_multiline_text(y_top, y_display_begin, y_display_end, lines, n);
 }
 
+//
+// render text view
+//
+
+void Sdl_text_view_create (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char **lines = Param[0]->Val->Pointer;
+    int    n     = Param[1]->Val->Integer;
+
+    ReturnValue->Val->Pointer = sdlx_text_view_create(lines, n);
+}
+
+void Sdl_text_view_num_lines (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_text_view_t *tv = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = sdlx_text_view_num_lines(tv);
+}
+
+void Sdl_text_view_render (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_text_view_t *tv              = Param[0]->Val->Pointer;
+    int               y_top           = Param[1]->Val->Integer;
+    int               y_display_begin = Param[2]->Val->Integer;
+    int               y_display_end   = Param[3]->Val->Integer;
+
+    sdlx_text_view_render(tv, y_top, y_display_begin, y_display_end);
+}
+
+void Sdl_text_view_destroy (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_text_view_t *tv = Param[0]->Val->Pointer;
+
+    sdlx_text_view_destroy(tv);
+}
+
 //
 // render rectangle, lines, circles, points
 //
@@ -384,6 +424,28 @@ void Sdl_create_texture_from_pixels (struct ParseState *Parser, struct Value *Re
     ReturnValue->Val->Pointer = (char*)texture; 
 }
 
+void Sdl_create_texture_from_png_file (struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char           *dir      = Param[0]->Val->Pointer;
+    char           *filename = Param[1]->Val->Pointer;
+    sdlx_texture_t *texture;
+
+    texture = sdlx_create_texture_from_png_file(dir, filename);
+    ReturnValue->Val->Pointer = (char*)texture; 
+}
+
+void Sdl_create_texture_from_png_file_rows (struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char           *dir      = Param[0]->Val->Pointer;
+    char           *filename = Param[1]->Val->Pointer;
+    sdlx_texture_t *texture;
+
+    texture = sdlx_create_texture_from_png_file_rows(dir, filename);
+    ReturnValue->Val->Pointer = (char*)texture; 
+}
+
 void Sdl_create_filled_circle_texture (struct ParseState *Parser, struct Value *ReturnValue,
 	struct Value **Param, int NumArgs)
 {
@@ -609,6 +671,14 @@ void Sdl_audio_ctl (struct ParseState *Parser, struct Value *ReturnValue,
     sdlx_audio_ctl(req);
 }
 
+void Sdl_audio_seek (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int ms = Param[0]->Val->Integer;
+
+    sdlx_audio_seek(ms);
+}
+
 void Sdl_audio_state (struct ParseState *Parser, struct Value *ReturnValue,
 	struct Value **Param, int NumArgs)
 {
@@ -660,6 +730,140 @@ void Sdl_stop_playbackcapture (struct ParseState *Parser, struct Value *ReturnVa
     sdlx_stop_playbackcapture();
 }
 
+void Sdl_sound_load (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char *dir      = Param[0]->Val->Pointer;
+    char *filename = Param[1]->Val->Pointer;
+    sdlx_sound_t *snd;
+
+    snd = sdlx_sound_load(dir, filename);
+    ReturnValue->Val->Pointer = snd;
+}
+
+void Sdl_sound_create_tones (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_tone_t  *tones = Param[0]->Val->Pointer;
+    sdlx_sound_t *snd;
+
+    snd = sdlx_sound_create_tones(tones);
+    ReturnValue->Val->Pointer = snd;
+}
+
+void Sdl_sound_free (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_sound_t *snd = Param[0]->Val->Pointer;
+
+    sdlx_sound_free(snd);
+}
+
+void Sdl_sound_duration_ms (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_sound_t *snd = Param[0]->Val->Pointer;
+    int ms;
+
+    ms = sdlx_sound_duration_ms(snd);
+    ReturnValue->Val->Integer = ms;
+}
+
+void Sdl_voice_play (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_sound_t *snd  = Param[0]->Val->Pointer;
+    double        gain = Param[1]->Val->FP;
+    double        pan  = Param[2]->Val->FP;
+    bool          loop = Param[3]->Val->Integer;
+    int voice;
+
+    voice = sdlx_voice_play(snd, gain, pan, loop);
+    ReturnValue->Val->Integer = voice;
+}
+
+void Sdl_voice_stop (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int voice = Param[0]->Val->Integer;
+
+    sdlx_voice_stop(voice);
+}
+
+void Sdl_voice_set (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int    voice = Param[0]->Val->Integer;
+    double gain  = Param[1]->Val->FP;
+    double pan   = Param[2]->Val->FP;
+
+    sdlx_voice_set(voice, gain, pan);
+}
+
+void Sdl_voice_active (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int voice = Param[0]->Val->Integer;
+
+    ReturnValue->Val->Integer = sdlx_voice_active(voice);
+}
+
+void Sdl_spectrogram_create (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int fft_size = Param[0]->Val->Integer;
+    int hop      = Param[1]->Val->Integer;
+    int history  = Param[2]->Val->Integer;
+
+    ReturnValue->Val->Pointer = sdlx_spectrogram_create(fft_size, hop, history);
+}
+
+void Sdl_spectrogram_destroy (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_spectrogram_t *sg = Param[0]->Val->Pointer;
+
+    sdlx_spectrogram_destroy(sg);
+}
+
+void Sdl_spectrogram_num_bins (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_spectrogram_t *sg = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = sdlx_spectrogram_num_bins(sg);
+}
+
+void Sdl_spectrogram_bin_hz (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_spectrogram_t *sg = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->FP = sdlx_spectrogram_bin_hz(sg);
+}
+
+void Sdl_spectrogram_read (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_spectrogram_t *sg       = Param[0]->Val->Pointer;
+    long               *seq      = Param[1]->Val->Pointer;
+    double             *db       = Param[2]->Val->Pointer;
+    int                 max_cols = Param[3]->Val->Integer;
+
+    ReturnValue->Val->Integer = sdlx_spectrogram_read(sg, seq, db, max_cols);
+}
+
+void Sdl_spectrogram_peak_hz (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_spectrogram_t *sg      = Param[0]->Val->Pointer;
+    double              min_hz  = Param[1]->Val->FP;
+    double              max_hz  = Param[2]->Val->FP;
+    double             *peak_db = Param[3]->Val->Pointer;
+
+    ReturnValue->Val->FP = sdlx_spectrogram_peak_hz(sg, min_hz, max_hz, peak_db);
+}
+
 //
 // sensors
 //
@@ -770,6 +974,63 @@ void Sdl_sensor_read_humidity (struct ParseState *Parser, struct Value *ReturnVa
     ReturnValue->Val->Integer = rc;
 }
 
+void Sdl_sensor_set_rate (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int    id      = Param[0]->Val->Integer;
+    double rate_hz = Param[1]->Val->FP;
+
+    ReturnValue->Val->Integer = sdlx_sensor_set_rate(id, rate_hz);
+}
+
+void Sdl_sensor_stream_read (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    int     id           = Param[0]->Val->Integer;
+    long   *cursor       = Param[1]->Val->Pointer;
+    long   *timestamp_us = Param[2]->Val->Pointer;
+    double *values       = Param[3]->Val->Pointer;
+    int     num_values   = Param[4]->Val->Integer;
+    int     max_samples  = Param[5]->Val->Integer;
+
+    ReturnValue->Val->Integer = sdlx_sensor_stream_read(id, cursor, timestamp_us, values,
+                                                        num_values, max_samples);
+}
+
+void Sdl_sensor_fusion_start (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    ReturnValue->Val->Integer = sdlx_sensor_fusion_start();
+}
+
+void Sdl_sensor_fusion_stop (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_sensor_fusion_stop();
+}
+
+void Sdl_sensor_get_orientation (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_orientation_t *o = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = sdlx_sensor_get_orientation(o);
+}
+
+void Sdl_sensor_record_start (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char *path = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = sdlx_sensor_record_start(path);
+}
+
+void Sdl_sensor_record_stop (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    sdlx_sensor_record_stop();
+}
+
 //
 // misc
 //
@@ -833,6 +1094,12 @@ struct LibraryFunction SdlFunctions[] = {
     { Sdl_render_printf_xyctr,     "sdlx_loc_t *sdlx_render_printf_xyctr(int x, int y, char *fmt, ...);" },
     { Sdl_render_multiline_text,   "void sdlx_render_multiline_text(int y_top, int y_display_begin, int y_display_end, char **lines, int n);" },
 
+    // render text view
+    { Sdl_text_view_create,        "sdlx_text_view_t *sdlx_text_view_create(char **lines, int n);" },
+    { Sdl_text_view_num_lines,     "int sdlx_text_view_num_lines(sdlx_text_view_t *tv);" },
+    { Sdl_text_view_render,        "void sdlx_text_view_render(sdlx_text_view_t *tv, int y_top, int y_display_begin, int y_display_end);" },
+    { Sdl_text_view_destroy,       "void sdlx_text_view_destroy(sdlx_text_view_t *tv);" },
+
     // render rectangle, lines, circles, points
     { Sdl_render_rect,     "void sdlx_render_rect(int x, int y, int w, int h, int line_width, int color);" },
     { Sdl_render_fill_rect,"void sdlx_render_fill_rect(int x, int y, int w, int h, int color);" },
@@ -844,6 +1111,8 @@ struct LibraryFunction SdlFunctions[] = {
 
     // render using textures
     { Sdl_create_texture_from_pixels,   "sdlx_texture_t *sdlx_create_texture_from_pixels(unsigned char *pixels, int w, int h);" },
+    { Sdl_create_texture_from_png_file, "sdlx_texture_t *sdlx_create_texture_from_png_file(char *dir, char *filename);" },
+    { Sdl_create_texture_from_png_file_rows, "sdlx_texture_t *sdlx_create_texture_from_png_file_rows(char *dir, char *filename);" },
     { Sdl_create_filled_circle_texture, "sdlx_texture_t *sdlx_create_filled_circle_texture(int radius, int color);" },
     { Sdl_create_text_texture,          "sdlx_texture_t *sdlx_create_text_texture(char *str);" },
     { Sdl_render_texture,               "sdlx_loc_t *sdlx_render_texture(int x, int y, int w, int h, sdlx_texture_t *texture);" },
@@ -875,12 +1144,27 @@ struct LibraryFunction SdlFunctions[] = {
     { Sdl_audio_play_tones,             "int sdlx_audio_play_tones(sdlx_tone_t *tones);" },
     { Sdl_audio_file_duration,          "int sdlx_audio_file_duration(char *dir, char *filename);" },
     { Sdl_audio_ctl,                    "void sdlx_audio_ctl(int req);" },
+    { Sdl_audio_seek,                   "void sdlx_audio_seek(int ms);" },
     { Sdl_audio_state,                  "void sdlx_audio_state(sdlx_audio_state_t * state);" },
     { Sdl_audio_print_device_info,      "void sdlx_audio_print_devices_info(void);" },
     { Sdl_audio_create_test_file,       "void sdlx_audio_create_test_file(char *dir, char *filename, int duration_secs, int freq);" },
     { Sdl_audio_play_new,               "int sdlx_audio_play_new(char *dir, char *filename);" },
     { Sdl_start_playbackcapture,        "void sdlx_start_playbackcapture(char *dir, char *filename);" },
     { Sdl_stop_playbackcapture,         "void sdlx_stop_playbackcapture(void);" },
+    { Sdl_sound_load,                   "sdlx_sound_t *sdlx_sound_load(char *dir, char *filename);" },
+    { Sdl_sound_create_tones,           "sdlx_sound_t *sdlx_sound_create_tones(sdlx_tone_t *tones);" },
+    { Sdl_sound_free,                   "void sdlx_sound_free(sdlx_sound_t *snd);" },
+    { Sdl_sound_duration_ms,            "int sdlx_sound_duration_ms(sdlx_sound_t *snd);" },
+    { Sdl_voice_play,                   "int sdlx_voice_play(sdlx_sound_t *snd, double gain, double pan, bool loop);" },
+    { Sdl_voice_stop,                   "void sdlx_voice_stop(int voice);" },
+    { Sdl_voice_set,                    "void sdlx_voice_set(int voice, double gain, double pan);" },
+    { Sdl_voice_active,                 "bool sdlx_voice_active(int voice);" },
+    { Sdl_spectrogram_create,           "sdlx_spectrogram_t *sdlx_spectrogram_create(int fft_size, int hop, int history);" },
+    { Sdl_spectrogram_destroy,          "void sdlx_spectrogram_destroy(sdlx_spectrogram_t *sg);" },
+    { Sdl_spectrogram_num_bins,         "int sdlx_spectrogram_num_bins(sdlx_spectrogram_t *sg);" },
+    { Sdl_spectrogram_bin_hz,           "double sdlx_spectrogram_bin_hz(sdlx_spectrogram_t *sg);" },
+    { Sdl_spectrogram_read,             "int sdlx_spectrogram_read(sdlx_spectrogram_t *sg, long *seq, double *db, int max_cols);" },
+    { Sdl_spectrogram_peak_hz,          "double sdlx_spectrogram_peak_hz(sdlx_spectrogram_t *sg, double min_hz, double max_hz, double *peak_db);" },
 
     // sensors
     { Sdl_sensor_get_info_tbl,          "sdlx_sensor_info_t *sdlx_sensor_get_info_tbl(int *num_sensors);" },
@@ -893,6 +1177,13 @@ struct LibraryFunction SdlFunctions[] = {
     { Sdl_sensor_read_pressure,         "int sdlx_sensor_read_pressure(double *millibars);" },
     { Sdl_sensor_read_temperature,      "int sdlx_sensor_read_temperature(double *degrees_c);" },
     { Sdl_sensor_read_humidity,         "int sdlx_sensor_read_humidity(double *percent);" },
+    { Sdl_sensor_set_rate,              "int sdlx_sensor_set_rate(int id, double rate_hz);" },
+    { Sdl_sensor_stream_read,           "int sdlx_sensor_stream_read(int id, long *cursor, long *timestamp_us, double *values, int num_values, int max_samples);" },
+    { Sdl_sensor_fusion_start,          "int sdlx_sensor_fusion_start(void);" },
+    { Sdl_sensor_fusion_stop,           "void sdlx_sensor_fusion_stop(void);" },
+    { Sdl_sensor_get_orientation,       "int sdlx_sensor_get_orientation(sdlx_orientation_t *o);" },
+    { Sdl_sensor_record_start,          "int sdlx_sensor_record_start(char *path);" },
+    { Sdl_sensor_record_stop,           "void sdlx_sensor_record_stop(void);" },
 
     // misc
     { Sdl_show_toast,                   "void sdlx_show_toast(char *msg);" },
@@ -901,6 +1192,9 @@ struct LibraryFunction SdlFunctions[] = {
 
 const char SdlDefs[] = "\
 typedef struct sdlx_texture sdlx_texture_t; \n\
+typedef struct sdlx_text_view sdlx_text_view_t; \n\
+typedef struct sdlx_sound sdlx_sound_t; \n\
+typedef struct sdlx_spectrogram sdlx_spectrogram_t; \n\
 typedef struct { \n\
     int x; \n\
     int y; \n\
@@ -936,6 +1230,14 @@ typedef struct { \n\
     int   type; \n\
     char *name; \n\
 } sdlx_sensor_info_t; \n\
+typedef struct { \n\
+    long   timestamp_us; \n\
+    double q[4]; \n\
+    double roll; \n\
+    double pitch; \n\
+    double heading; \n\
+    double up[3]; \n\
+} sdlx_orientation_t; \n\
 typedef struct { \n\
     int ptsize; \n\
     int char_width; \n\
@@ -993,6 +1295,10 @@ typedef struct { \n\
 #define AUDIO_REQ_STOP     1 \n\
 #define AUDIO_REQ_PAUSE    2 \n\
 #define AUDIO_REQ_UNPAUSE  3 \n\
+#define AUDIO_REQ_SEEK     4 \n\
+\n\
+#define SDLX_MIXER_MAX_VOICES 32 \n\
+#define SDLX_CAPTURE_SAMPLE_RATE 48000 \n\
 \n\
 #define ASENSOR_TYPE_ACCELEROMETER       1 \n\
 #define ASENSOR_TYPE_MAGNETIC_FIELD      2 \n\
@@ -1030,6 +1336,9 @@ typedef struct { \n\
 #define ASENSOR_TYPE_HEADING 42 \n\
 \n\
 #define INVALID_NUMBER 999999999 \n\
+\n\
+#define SDLX_SENSOR_STREAM_LEN 1024 \n\
+#define SDLX_SENSOR_MAX_VALUES 6 \n\
 ";
 
 // -----------------  UTILS PLATFORM ROUTINES  --------------------------
@@ -1185,6 +1494,299 @@ void Util_sync_file (struct ParseState *Parser, struct Value *ReturnValue,
     util_sync_file(addr, len);
 }
 
+//
+// utils file view routines
+//
+
+void Util_view_file (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char *dir    = Param[0]->Val->Pointer;
+    char *fn     = Param[1]->Val->Pointer;
+    int   advice = Param[2]->Val->Integer;
+    int  *len    = Param[3]->Val->Pointer;
+
+    ReturnValue->Val->Pointer = util_view_file(dir, fn, advice, len);
+}
+
+void Util_view_retain (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    void *data = Param[0]->Val->Pointer;
+
+    util_view_retain(data);
+}
+
+void Util_view_release (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    void *data = Param[0]->Val->Pointer;
+
+    util_view_release(data);
+}
+
+void Util_view_advise (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    void *data   = Param[0]->Val->Pointer;
+    int   advice = Param[1]->Val->Integer;
+
+    util_view_advise(data, advice);
+}
+
+//
+// utils time series routines
+//
+
+void Util_ts_open (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char *dir             = Param[0]->Val->Pointer;
+    char *name            = Param[1]->Val->Pointer;
+    int   record_size     = Param[2]->Val->Integer;
+    int   segment_records = Param[3]->Val->Integer;
+    bool  read_only       = Param[4]->Val->Integer;
+
+    ReturnValue->Val->Pointer = util_ts_open(dir, name, record_size, segment_records, read_only);
+}
+
+void Util_ts_close (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts = Param[0]->Val->Pointer;
+
+    util_ts_close(ts);
+}
+
+void Util_ts_set_policy (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts                  = Param[0]->Val->Pointer;
+    long       max_age             = Param[1]->Val->LongInteger;
+    long       max_records         = Param[2]->Val->LongInteger;
+    long       downsample_age      = Param[3]->Val->LongInteger;
+    long       downsample_interval = Param[4]->Val->LongInteger;
+
+    util_ts_set_policy(ts, max_age, max_records, downsample_age, downsample_interval);
+}
+
+void Util_ts_append (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts     = Param[0]->Val->Pointer;
+    void      *record = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_ts_append(ts, record);
+}
+
+void Util_ts_sync (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_ts_sync(ts);
+}
+
+void Util_ts_clear (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_ts_clear(ts);
+}
+
+void Util_ts_count (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->LongInteger = util_ts_count(ts);
+}
+
+void Util_ts_query (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts      = Param[0]->Val->Pointer;
+    long       t_start = Param[1]->Val->LongInteger;
+    long       t_end   = Param[2]->Val->LongInteger;
+    void      *records = Param[3]->Val->Pointer;
+    int        max     = Param[4]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_ts_query(ts, t_start, t_end, records, max);
+}
+
+void Util_ts_query_downsample (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts       = Param[0]->Val->Pointer;
+    long       t_start  = Param[1]->Val->LongInteger;
+    long       t_end    = Param[2]->Val->LongInteger;
+    long       interval = Param[3]->Val->LongInteger;
+    void      *records  = Param[4]->Val->Pointer;
+    int        max      = Param[5]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_ts_query_downsample(ts, t_start, t_end, interval, records, max);
+}
+
+void Util_ts_latest (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_ts_t *ts      = Param[0]->Val->Pointer;
+    void      *records = Param[1]->Val->Pointer;
+    int        max     = Param[2]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_ts_latest(ts, records, max);
+}
+
+//
+// utils key value store routines
+//
+
+void Util_kv_open (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    char *dir  = Param[0]->Val->Pointer;
+    char *name = Param[1]->Val->Pointer;
+    bool  sync = Param[2]->Val->Integer;
+
+    ReturnValue->Val->Pointer = util_kv_open(dir, name, sync);
+}
+
+void Util_kv_close (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv = Param[0]->Val->Pointer;
+
+    util_kv_close(kv);
+}
+
+void Util_kv_put (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv    = Param[0]->Val->Pointer;
+    char      *key   = Param[1]->Val->Pointer;
+    void      *value = Param[2]->Val->Pointer;
+    int        len   = Param[3]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_kv_put(kv, key, value, len);
+}
+
+void Util_kv_get (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv    = Param[0]->Val->Pointer;
+    char      *key   = Param[1]->Val->Pointer;
+    void      *value = Param[2]->Val->Pointer;
+    int        max   = Param[3]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_kv_get(kv, key, value, max);
+}
+
+void Util_kv_delete (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv  = Param[0]->Val->Pointer;
+    char      *key = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_kv_delete(kv, key);
+}
+
+void Util_kv_count (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->LongInteger = util_kv_count(kv);
+}
+
+void Util_kv_sync (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_kv_sync(kv);
+}
+
+void Util_kv_compact (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_kv_compact(kv);
+}
+
+void Util_kv_batch_create (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    ReturnValue->Val->Pointer = util_kv_batch_create();
+}
+
+void Util_kv_batch_free (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_batch_t *b = Param[0]->Val->Pointer;
+
+    util_kv_batch_free(b);
+}
+
+void Util_kv_batch_put (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_batch_t *b     = Param[0]->Val->Pointer;
+    char            *key   = Param[1]->Val->Pointer;
+    void            *value = Param[2]->Val->Pointer;
+    int              len   = Param[3]->Val->Integer;
+
+    util_kv_batch_put(b, key, value, len);
+}
+
+void Util_kv_batch_delete (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_batch_t *b   = Param[0]->Val->Pointer;
+    char            *key = Param[1]->Val->Pointer;
+
+    util_kv_batch_delete(b, key);
+}
+
+void Util_kv_batch_commit (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t       *kv = Param[0]->Val->Pointer;
+    util_kv_batch_t *b  = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_kv_batch_commit(kv, b);
+}
+
+void Util_kv_iter_create (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_t *kv    = Param[0]->Val->Pointer;
+    char      *start = Param[1]->Val->Pointer;
+    char      *end   = Param[2]->Val->Pointer;
+
+    ReturnValue->Val->Pointer = util_kv_iter_create(kv, start, end);
+}
+
+void Util_kv_iter_free (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_iter_t *it = Param[0]->Val->Pointer;
+
+    util_kv_iter_free(it);
+}
+
+void Util_kv_iter_next (struct ParseState *Parser, struct Value *ReturnValue,
+	struct Value **Param, int NumArgs)
+{
+    util_kv_iter_t *it    = Param[0]->Val->Pointer;
+    char          **key   = Param[1]->Val->Pointer;
+    void           *value = Param[2]->Val->Pointer;
+    int             max   = Param[3]->Val->Integer;
+
+    ReturnValue->Val->Integer = util_kv_iter_next(it, key, value, max);
+}
+
 //
 // utils params
 //
@@ -1195,10 +1797,10 @@ void Util_get_str_param(struct ParseState *Parser, struct Value *ReturnValue,
     char *dir           = Param[0]->Val->Pointer;
     char *name          = Param[1]->Val->Pointer;
     char *default_value = Param[2]->Val->Pointer;
-    char *value;
+    char *value         = Param[3]->Val->Pointer;
+    int   max_value     = Param[4]->Val->Integer;
 
-    value = util_get_str_param(dir, name, default_value);
-    ReturnValue->Val->Pointer = value;
+    ReturnValue->Val->Pointer = util_get_str_param(dir, name, default_value, value, max_value);
 }
 
 void Util_set_str_param(struct ParseState *Parser, struct Value *ReturnValue,
@@ -1302,6 +1904,126 @@ void Util_json_get_value(struct ParseState *Parser, struct Value *ReturnValue,
     ReturnValue->Val->Pointer = value;
 }
 
+void Util_json_query_compile(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char *path = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Pointer = util_json_query_compile(path);
+}
+
+void Util_json_query_free(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_json_query_t *q = Param[0]->Val->Pointer;
+
+    util_json_query_free(q);
+}
+
+void Util_json_query(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    void              *json_item = Param[0]->Val->Pointer;
+    util_json_query_t *q         = Param[1]->Val->Pointer;
+    json_value_t      *value     = Param[2]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_query(json_item, q, value);
+}
+
+void Util_json_array_size(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    void *json_array = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_array_size(json_array);
+}
+
+void Util_json_cursor_init(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    json_cursor_t *cursor     = Param[0]->Val->Pointer;
+    void          *json_array = Param[1]->Val->Pointer;
+
+    util_json_cursor_init(cursor, json_array);
+}
+
+void Util_json_cursor_next(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    json_cursor_t *cursor = Param[0]->Val->Pointer;
+    json_value_t  *value  = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_cursor_next(cursor, value);
+}
+
+void Util_json_stream_open_fd(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    int fd = Param[0]->Val->Integer;
+
+    ReturnValue->Val->Pointer = util_json_stream_open_fd(fd);
+}
+
+void Util_json_stream_open_file(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char *dir  = Param[0]->Val->Pointer;
+    char *file = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Pointer = util_json_stream_open_file(dir, file);
+}
+
+void Util_json_stream_open_mem(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char *mem = Param[0]->Val->Pointer;
+    int   len = Param[1]->Val->Integer;
+
+    ReturnValue->Val->Pointer = util_json_stream_open_mem(mem, len);
+}
+
+void Util_json_stream_close(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_json_stream_t *s = Param[0]->Val->Pointer;
+
+    util_json_stream_close(s);
+}
+
+void Util_json_stream_next(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_json_stream_t *s  = Param[0]->Val->Pointer;
+    json_event_t       *ev = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_stream_next(s, ev);
+}
+
+void Util_json_stream_skip(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_json_stream_t *s = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_stream_skip(s);
+}
+
+void Util_json_stream_error(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_json_stream_t *s = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Pointer = util_json_stream_error(s);
+}
+
+void Util_json_path_match(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char *path    = Param[0]->Val->Pointer;
+    char *pattern = Param[1]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_json_path_match(path, pattern);
+}
+
 //
 // utils read/write 32-bit RGBA png files
 //
@@ -1336,6 +2058,118 @@ void Util_write_png_file(struct ParseState *Parser, struct Value *ReturnValue,
     ReturnValue->Val->Integer = rc;
 }
 
+void Util_write_png_file_ex(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char          *dir         = Param[0]->Val->Pointer;
+    char          *filename    = Param[1]->Val->Pointer;
+    unsigned char *pixels      = Param[2]->Val->Pointer;
+    int            w           = Param[3]->Val->Integer;
+    int            h           = Param[4]->Val->Integer;
+    bool           fast        = Param[5]->Val->Integer;
+    int            num_threads = Param[6]->Val->Integer;
+    int            rc;
+
+    rc = util_write_png_file_ex(dir, filename, pixels, w, h, fast, num_threads);
+
+    ReturnValue->Val->Integer = rc;
+}
+
+void Util_write_png_file_async(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char          *dir      = Param[0]->Val->Pointer;
+    char          *filename = Param[1]->Val->Pointer;
+    unsigned char *pixels   = Param[2]->Val->Pointer;
+    int            w        = Param[3]->Val->Integer;
+    int            h        = Param[4]->Val->Integer;
+    bool           fast     = Param[5]->Val->Integer;
+    int            rc;
+
+    rc = util_write_png_file_async(dir, filename, pixels, w, h, fast);
+
+    ReturnValue->Val->Integer = rc;
+}
+
+//
+// utils fft
+//
+
+void Util_fft_create(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    int n = Param[0]->Val->Integer;
+
+    ReturnValue->Val->Pointer = util_fft_create(n);
+}
+
+void Util_fft_destroy(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_fft_t *fft = Param[0]->Val->Pointer;
+
+    util_fft_destroy(fft);
+}
+
+void Util_fft_size(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_fft_t *fft = Param[0]->Val->Pointer;
+
+    ReturnValue->Val->Integer = util_fft_size(fft);
+}
+
+void Util_fft_forward(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_fft_t *fft = Param[0]->Val->Pointer;
+    double     *in  = Param[1]->Val->Pointer;
+    double     *out = Param[2]->Val->Pointer;
+
+    util_fft_forward(fft, in, out);
+}
+
+void Util_fft_inverse(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_fft_t *fft = Param[0]->Val->Pointer;
+    double     *in  = Param[1]->Val->Pointer;
+    double     *out = Param[2]->Val->Pointer;
+
+    util_fft_inverse(fft, in, out);
+}
+
+void Util_fft_power_db(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    util_fft_t *fft = Param[0]->Val->Pointer;
+    double     *in  = Param[1]->Val->Pointer;
+    double     *db  = Param[2]->Val->Pointer;
+
+    util_fft_power_db(fft, in, db);
+}
+
+//
+// utils mp3 transcode
+//
+
+void Util_mp3_transcode(struct ParseState *Parser, struct Value *ReturnValue,
+        struct Value **Param, int NumArgs)
+{
+    char *dir          = Param[0]->Val->Pointer;
+    char *raw_fn       = Param[1]->Val->Pointer;
+    char *mp3_fn       = Param[2]->Val->Pointer;
+    int   sample_rate  = Param[3]->Val->Integer;
+    int   channels     = Param[4]->Val->Integer;
+    int   bitrate_kbps = Param[5]->Val->Integer;
+    int   num_threads  = Param[6]->Val->Integer;
+    int   rc;
+
+    rc = util_mp3_transcode(dir, raw_fn, mp3_fn, sample_rate, channels, bitrate_kbps, num_threads);
+
+    ReturnValue->Val->Integer = rc;
+}
+
 //
 // utils java methods
 //
@@ -1464,8 +2298,41 @@ struct LibraryFunction UtilsFunctions[] = {
     { Util_map_file,         "void *util_map_file(char *dir, char *file, int len, bool create_if_needed, bool read_only, int *created_flag);" },
     { Util_unmap_file,       "void util_unmap_file(void *addr, int len);" },
     { Util_sync_file,        "void util_sync_file(void *addr, int len);" },
+    // file view
+    { Util_view_file,        "void *util_view_file(char *dir, char *fn, int advice, int *len);" },
+    { Util_view_retain,      "void util_view_retain(void *data);" },
+    { Util_view_release,     "void util_view_release(void *data);" },
+    { Util_view_advise,      "void util_view_advise(void *data, int advice);" },
+    // time series
+    { Util_ts_open,          "util_ts_t *util_ts_open(char *dir, char *name, int record_size, int segment_records, bool read_only);" },
+    { Util_ts_close,         "void util_ts_close(util_ts_t *ts);" },
+    { Util_ts_set_policy,    "void util_ts_set_policy(util_ts_t *ts, long max_age, long max_records, long downsample_age, long downsample_interval);" },
+    { Util_ts_append,        "int util_ts_append(util_ts_t *ts, void *record);" },
+    { Util_ts_sync,          "int util_ts_sync(util_ts_t *ts);" },
+    { Util_ts_clear,         "int util_ts_clear(util_ts_t *ts);" },
+    { Util_ts_count,         "long util_ts_count(util_ts_t *ts);" },
+    { Util_ts_query,         "int util_ts_query(util_ts_t *ts, long t_start, long t_end, void *records, int max);" },
+    { Util_ts_query_downsample, "int util_ts_query_downsample(util_ts_t *ts, long t_start, long t_end, long interval, void *records, int max);" },
+    { Util_ts_latest,        "int util_ts_latest(util_ts_t *ts, void *records, int max);" },
+    // key value store
+    { Util_kv_open,          "util_kv_t *util_kv_open(char *dir, char *name, bool sync);" },
+    { Util_kv_close,         "void util_kv_close(util_kv_t *kv);" },
+    { Util_kv_put,           "int util_kv_put(util_kv_t *kv, char *key, void *value, int len);" },
+    { Util_kv_get,           "int util_kv_get(util_kv_t *kv, char *key, void *value, int max);" },
+    { Util_kv_delete,        "int util_kv_delete(util_kv_t *kv, char *key);" },
+    { Util_kv_count,         "long util_kv_count(util_kv_t *kv);" },
+    { Util_kv_sync,          "int util_kv_sync(util_kv_t *kv);" },
+    { Util_kv_compact,       "int util_kv_compact(util_kv_t *kv);" },
+    { Util_kv_batch_create,  "util_kv_batch_t *util_kv_batch_create(void);" },
+    { Util_kv_batch_free,    "void util_kv_batch_free(util_kv_batch_t *b);" },
+    { Util_kv_batch_put,     "void util_kv_batch_put(util_kv_batch_t *b, char *key, void *value, int len);" },
+    { Util_kv_batch_delete,  "void util_kv_batch_delete(util_kv_batch_t *b, char *key);" },
+    { Util_kv_batch_commit,  "int util_kv_batch_commit(util_kv_t *kv, util_kv_batch_t *b);" },
+    { Util_kv_iter_create,   "util_kv_iter_t *util_kv_iter_create(util_kv_t *kv, char *start, char *end);" },
+    { Util_kv_iter_free,     "void util_kv_iter_free(util_kv_iter_t *it);" },
+    { Util_kv_iter_next,     "int util_kv_iter_next(util_kv_iter_t *it, char **key, void *value, int max);" },
     // params get/set
-    { Util_get_str_param,    "char *util_get_str_param(char *dir, char *name, char *default_value);" },
+    { Util_get_str_param,    "char *util_get_str_param(char *dir, char *name, char *default_value, char *value, int max_value);" },
     { Util_set_str_param,    "void util_set_str_param(char *dir, char *name, char *value);" },
     { Util_get_numeric_param,"double util_get_numeric_param(char *dir, char *name, double default_value);" },
     { Util_set_numeric_param,"void util_set_numeric_param(char *dir, char *name, double value);" },
@@ -1476,9 +2343,34 @@ struct LibraryFunction UtilsFunctions[] = {
     { Util_json_parse,       "void *util_json_parse(char *str, char **end_ptr);" },
     { Util_json_free,        "void util_json_free(void *json_root);" },
     { Util_json_get_value,   "json_value_t *util_json_get_value(void *json_item, ...);" },
+    { Util_json_query_compile, "util_json_query_t *util_json_query_compile(char *path);" },
+    { Util_json_query_free,  "void util_json_query_free(util_json_query_t *q);" },
+    { Util_json_query,       "int util_json_query(void *json_item, util_json_query_t *q, json_value_t *value);" },
+    { Util_json_array_size,  "int util_json_array_size(void *json_array);" },
+    { Util_json_cursor_init, "void util_json_cursor_init(json_cursor_t *cursor, void *json_array);" },
+    { Util_json_cursor_next, "int util_json_cursor_next(json_cursor_t *cursor, json_value_t *value);" },
+    { Util_json_stream_open_fd,   "util_json_stream_t *util_json_stream_open_fd(int fd);" },
+    { Util_json_stream_open_file, "util_json_stream_t *util_json_stream_open_file(char *dir, char *file);" },
+    { Util_json_stream_open_mem,  "util_json_stream_t *util_json_stream_open_mem(char *mem, int len);" },
+    { Util_json_stream_close,     "void util_json_stream_close(util_json_stream_t *s);" },
+    { Util_json_stream_next,      "int util_json_stream_next(util_json_stream_t *s, json_event_t *ev);" },
+    { Util_json_stream_skip,      "int util_json_stream_skip(util_json_stream_t *s);" },
+    { Util_json_stream_error,     "char *util_json_stream_error(util_json_stream_t *s);" },
+    { Util_json_path_match,       "bool util_json_path_match(char *path, char *pattern);" },
     // png file read/write
     { Util_read_png_file,    "int util_read_png_file(char *dir, char *filename, unsigned char **pixels, int *w, int *h);" },
     { Util_write_png_file,   "int util_write_png_file(char *dir, char *filename, unsigned char *pixels, int w, int h);" },
+    { Util_write_png_file_ex, "int util_write_png_file_ex(char *dir, char *filename, unsigned char *pixels, int w, int h, bool fast, int num_threads);" },
+    { Util_write_png_file_async, "int util_write_png_file_async(char *dir, char *filename, unsigned char *pixels, int w, int h, bool fast);" },
+    // fft
+    { Util_fft_create,       "util_fft_t *util_fft_create(int n);" },
+    { Util_fft_destroy,      "void util_fft_destroy(util_fft_t *fft);" },
+    { Util_fft_size,         "int util_fft_size(util_fft_t *fft);" },
+    { Util_fft_forward,      "void util_fft_forward(util_fft_t *fft, double *in, double *out);" },
+    { Util_fft_inverse,      "void util_fft_inverse(util_fft_t *fft, double *in, double *out);" },
+    { Util_fft_power_db,     "void util_fft_power_db(util_fft_t *fft, double *in, double *db);" },
+    // mp3 transcode
+    { Util_mp3_transcode,    "int util_mp3_transcode(char *dir, char *raw_fn, char *mp3_fn, int sample_rate, int channels, int bitrate_kbps, int num_threads);" },
     // call java: location
     { Util_get_location,     "void util_get_location(double *latitude, double *longitude, double *altitude);" },
     // call java: text to speech
@@ -1501,6 +2393,16 @@ struct LibraryFunction UtilsFunctions[] = {
     { NULL, NULL } };
 
 const char UtilsDefs[] = "\
+#define UTIL_VIEW_NORMAL     0 \n\
+#define UTIL_VIEW_SEQUENTIAL 1 \n\
+#define UTIL_VIEW_RANDOM     2 \n\
+#define UTIL_VIEW_WILLNEED   4 \n\
+\n\
+typedef struct util_ts util_ts_t; \n\
+typedef struct util_kv util_kv_t; \n\
+typedef struct util_kv_batch util_kv_batch_t; \n\
+typedef struct util_kv_iter util_kv_iter_t; \n\
+\n\
 #define JSON_TYPE_UNDEFINED 0 \n\
 #define JSON_TYPE_FLAG      1 \n\
 #define JSON_TYPE_NUMBER    2 \n\
@@ -1518,6 +2420,31 @@ typedef struct { \n\
         void  *object; \n\
     } u; \n\
 } json_value_t; \n\
+\n\
+typedef struct util_json_query util_json_query_t; \n\
+typedef struct { \n\
+    void *next; \n\
+    int   index; \n\
+} json_cursor_t; \n\
+\n\
+#define JSON_EVENT_ERROR        -1 \n\
+#define JSON_EVENT_END          0 \n\
+#define JSON_EVENT_OBJECT_START 1 \n\
+#define JSON_EVENT_OBJECT_END   2 \n\
+#define JSON_EVENT_ARRAY_START  3 \n\
+#define JSON_EVENT_ARRAY_END    4 \n\
+#define JSON_EVENT_VALUE        5 \n\
+typedef struct util_json_stream util_json_stream_t; \n\
+typedef struct { \n\
+    int           event; \n\
+    int           depth; \n\
+    char         *path; \n\
+    char         *key; \n\
+    int           index; \n\
+    json_value_t  value; \n\
+} json_event_t; \n\
+\n\
+typedef struct util_fft util_fft_t; \n\
 ";
 
 // -----------------  SVCS PLATFORM ROUTINES  --------------------------
@@ -1,6 +1,8 @@
 #include "../picoc.h"
 #include "../interpreter.h"
 
+#include <utils.h>
+
 #ifdef USE_READLINE
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -35,7 +37,23 @@ void PlatformInit(Picoc *pc)
 void PlatformInit(Picoc *pc) { }
 #endif
 
-void PlatformCleanup(Picoc *pc) { }
+/* a source file mapped by PicocPlatformScanFile; the source text is kept
+   until cleanup, for the error messages */
+struct PlatformSourceView {
+    struct PlatformSourceView *Next;
+    char *SourceStr;
+};
+
+void PlatformCleanup(Picoc *pc)
+{
+    struct PlatformSourceView *View;
+
+    while ((View = pc->SourceViews) != NULL) {
+        pc->SourceViews = View->Next;
+        util_view_release(View->SourceStr);
+        free(View);
+    }
+}
 
 /* get a line of interactive input */
 char *PlatformGetLine(char *Buf, int MaxLen, const char *Prompt)
@@ -115,10 +133,34 @@ char *PlatformReadFile(Picoc *pc, const char *FileName)
     return ReadText;
 }
 
-/* read and scan a file for definitions */
+/* read and scan a file for definitions; the file is mapped rather than
+   read, except a file starting with "#!", whose first line is changed;
+   the mapping stays valid while the file is replaced, because
+   util_write_file renames a new file into place rather than truncating */
 void PicocPlatformScanFile(Picoc *pc, const char *FileName)
 {
-    char *SourceStr = PlatformReadFile(pc, FileName);
+    struct PlatformSourceView *View;
+    char *SourceStr;
+    int SourceLen;
+
+    SourceStr = util_view_file((char *)FileName, NULL, UTIL_VIEW_SEQUENTIAL, &SourceLen);
+    if (SourceStr != NULL && !(SourceStr[0] == '#' && SourceStr[1] == '!')) {
+        View = malloc(sizeof(struct PlatformSourceView));
+        if (View == NULL) {
+            util_view_release(SourceStr);
+            ProgramFailNoParser(pc, "out of memory\n");
+        }
+        View->SourceStr = SourceStr;
+        View->Next = pc->SourceViews;
+        pc->SourceViews = View;
+
+        PicocParse(pc, FileName, SourceStr, strlen(SourceStr), true, false, false,
+            gEnableDebugger);
+        return;
+    }
+    util_view_release(SourceStr);
+
+    SourceStr = PlatformReadFile(pc, FileName);
 
     /* ignore "#!/path/to/picoc" .. by replacing the "#!" with "//" */
     if (SourceStr != NULL && SourceStr[0] == '#' && SourceStr[1] == '!') {